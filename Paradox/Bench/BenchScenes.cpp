@@ -0,0 +1,753 @@
+#include "BenchScenes.h"
+#include "../Physics/Random.h"
+#include <utility>
+
+// Height of every box stack, in boxes
+static const unsigned stackHeight = 10;
+
+// Number of links in every ragdoll chain
+static const unsigned chainLength = 10;
+
+// Points in the cloud the convex pile's hulls are built from
+static const unsigned hullCloudSize = 16;
+
+// Seed shared by every scene so runs are repeatable
+static const unsigned sceneSeed = 1234;
+
+// Primitives against the ground, and broadphase pairs, in each part
+// of the contact generator's work
+static const unsigned groundPartSize = 512;
+static const unsigned pairPartSize = 256;
+
+// The most contacts any detector the generator runs finds for a pair,
+// other than a hull against the ground, which finds one per vertex
+static const unsigned maxPairContacts = 16;
+
+SceneContactGenerator::SceneContactGenerator()
+	:
+	friction(0.9),
+	restitution(0.1),
+	usePairCache(false),
+	world(NULL),
+	restarting(false)
+{
+	ground.direction = Vector3(0, 1, 0);
+	ground.offset = 0;
+}
+
+// Checks whether the bounding spheres of two primitives overlap
+static inline bool BoundsOverlap(const Vector3& one, double oneRadius,
+								 const Vector3& two, double twoRadius)
+{
+	double radius = oneRadius + twoRadius;
+	return (one - two).squareMagnitude() < radius * radius;
+}
+
+unsigned SceneContactGenerator::AddContact(Contact* nextContact, unsigned limit)
+{
+	CollisionData data;
+	data.contactArray = nextContact;
+	data.Reset(limit);
+	data.friction = friction;
+	data.restitution = restitution;
+	data.tolerance = 0;
+
+	for (CollisionBox* box : boxes) box->CalculateInternals();
+	for (CollisionSphere* sphere : spheres) sphere->CalculateInternals();
+	for (CollisionCapsule* capsule : capsules) capsule->CalculateInternals();
+	for (CollisionConvexHull* hull : hulls) hull->CalculateInternals();
+
+	// Run again in the same step, the GJK caches start where they did
+	if (restarting) convexPairs.RestartFrame();
+	else
+	{
+		if (usePairCache) pairs.BeginFrame();
+		convexPairs.BeginFrame();
+	}
+	restarting = false;
+
+	Collide(&data);
+
+	// A run that fills its' room stops short and may be run again with
+	// more, so the pairs it did not reach are kept for that run
+	if (data.HasMoreContacts())
+	{
+		if (usePairCache) pairs.EndFrame();
+		convexPairs.EndFrame();
+	}
+
+	return data.contactCount;
+}
+
+void SceneContactGenerator::RestartContacts()
+{
+	restarting = true;
+}
+
+void SceneContactGenerator::AddParts(PartKind kind, size_t count, unsigned partSize)
+{
+	for (unsigned begin = 0; begin < count; begin += partSize)
+	{
+		ContactPart part = { kind, begin, begin + partSize < count ? begin + partSize : (unsigned)count };
+		parts.push_back(part);
+	}
+}
+
+unsigned SceneContactGenerator::BeginContactParts()
+{
+	// Only the broadphase's pairs are split, and the manifolds of the
+	// pair cache are not safe to update from many threads
+	if (usePairCache || !world || world->GetBroadphase() == BroadphaseType::None) return 0;
+
+	for (CollisionBox* box : boxes) box->CalculateInternals();
+	for (CollisionSphere* sphere : spheres) sphere->CalculateInternals();
+	for (CollisionCapsule* capsule : capsules) capsule->CalculateInternals();
+	for (CollisionConvexHull* hull : hulls) hull->CalculateInternals();
+
+	convexPairs.BeginFrame();
+	MapBodies();
+
+	const std::vector<PotentialContact>& potentialContacts = world->GetPotentialContacts();
+	pairCaches.assign(potentialContacts.size(), NULL);
+	for (size_t i = 0; i < potentialContacts.size(); i++)
+	{
+		unsigned one = potentialContacts[i].body[0]->GetStoreIndex();
+		unsigned two = potentialContacts[i].body[1]->GetStoreIndex();
+		if (IsConvexPair(one, two)) pairCaches[i] = FindConvexCache(one, two);
+	}
+
+	// In the order the contacts are found when the work is not split
+	parts.clear();
+	AddParts(PartKind::GroundBoxes, boxes.size(), groundPartSize);
+	AddParts(PartKind::GroundSpheres, spheres.size(), groundPartSize);
+	AddParts(PartKind::GroundCapsules, capsules.size(), groundPartSize);
+	AddParts(PartKind::GroundHulls, hulls.size(), groundPartSize);
+	AddParts(PartKind::Pairs, potentialContacts.size(), pairPartSize);
+	return (unsigned)parts.size();
+}
+
+// Points the collision data after the contacts committed to the arena,
+// growing it first if it has less than the given room left
+static void MakeRoom(ContactArena& output, CollisionData& data, unsigned needed)
+{
+	if (data.contactsLeft >= (int)needed) return;
+
+	output.Commit(data.contactCount);
+	while (output.GetRoom() < needed) output.Grow();
+	data.contactArray = output.GetNext();
+	data.Reset(output.GetRoom());
+}
+
+void SceneContactGenerator::AddContactPart(unsigned part, ContactArena& output)
+{
+	CollisionData data;
+	data.contactArray = output.GetNext();
+	data.Reset(output.GetRoom());
+	data.friction = friction;
+	data.restitution = restitution;
+	data.tolerance = 0;
+
+	const ContactPart& range = parts[part];
+	const std::vector<PotentialContact>& potentialContacts = world->GetPotentialContacts();
+	for (unsigned i = range.begin; i < range.end; i++)
+	{
+		switch (range.kind)
+		{
+		case PartKind::GroundBoxes:
+			MakeRoom(output, data, 8);
+			CollisionDetector::BoxAndHalfSpace(*boxes[i], ground, &data);
+			break;
+
+		case PartKind::GroundSpheres:
+			MakeRoom(output, data, 1);
+			CollisionDetector::SphereAndHalfSpace(*spheres[i], ground, &data);
+			break;
+
+		case PartKind::GroundCapsules:
+			MakeRoom(output, data, 2);
+			CollisionDetector::CapsuleAndHalfSpace(*capsules[i], ground, &data);
+			break;
+
+		case PartKind::GroundHulls:
+			MakeRoom(output, data, hulls[i]->hull->GetVertexCount());
+			CollisionDetector::ConvexHullAndHalfSpace(*hulls[i], ground, &data);
+			break;
+
+		case PartKind::Pairs:
+			MakeRoom(output, data, maxPairContacts);
+			CollidePair(potentialContacts[i].body[0]->GetStoreIndex(), potentialContacts[i].body[1]->GetStoreIndex(),
+				pairCaches[i], &data);
+			break;
+		}
+	}
+
+	output.Commit(data.contactCount);
+}
+
+void SceneContactGenerator::EndContactParts()
+{
+	convexPairs.EndFrame();
+}
+
+unsigned SceneContactGenerator::BoxAndHalfSpace(const CollisionBox& box, CollisionData* data)
+{
+	if (usePairCache) return pairs.BoxAndHalfSpace(box, ground, data);
+	return CollisionDetector::BoxAndHalfSpace(box, ground, data);
+}
+
+unsigned SceneContactGenerator::SphereAndHalfSpace(const CollisionSphere& sphere, CollisionData* data)
+{
+	if (usePairCache) return pairs.SphereAndHalfSpace(sphere, ground, data);
+	return CollisionDetector::SphereAndHalfSpace(sphere, ground, data);
+}
+
+unsigned SceneContactGenerator::BoxAndBox(const CollisionBox& one, const CollisionBox& two, CollisionData* data)
+{
+	if (usePairCache) return pairs.BoxAndBox(one, two, data);
+	return CollisionDetector::BoxAndBox(one, two, data);
+}
+
+unsigned SceneContactGenerator::BoxAndSphere(const CollisionBox& box, const CollisionSphere& sphere, CollisionData* data)
+{
+	if (usePairCache) return pairs.BoxAndSphere(box, sphere, data);
+	return CollisionDetector::BoxAndSphere(box, sphere, data);
+}
+
+unsigned SceneContactGenerator::SphereAndSphere(const CollisionSphere& one, const CollisionSphere& two, CollisionData* data)
+{
+	if (usePairCache) return pairs.SphereAndSphere(one, two, data);
+	return CollisionDetector::SphereAndSphere(one, two, data);
+}
+
+void SceneContactGenerator::Collide(CollisionData* data)
+{
+	// Primitives against the ground
+	for (CollisionBox* box : boxes)
+	{
+		if (!data->HasMoreContacts()) return;
+		BoxAndHalfSpace(*box, data);
+	}
+
+	for (CollisionSphere* sphere : spheres)
+	{
+		if (!data->HasMoreContacts()) return;
+		SphereAndHalfSpace(*sphere, data);
+	}
+
+	for (CollisionCapsule* capsule : capsules)
+	{
+		if (!data->HasMoreContacts()) return;
+		CollisionDetector::CapsuleAndHalfSpace(*capsule, ground, data);
+	}
+
+	for (CollisionConvexHull* hull : hulls)
+	{
+		if (!data->HasMoreContacts()) return;
+		CollisionDetector::ConvexHullAndHalfSpace(*hull, ground, data);
+	}
+
+	if (world && world->GetBroadphase() != BroadphaseType::None)
+	{
+		CollidePotentialContacts(data);
+		return;
+	}
+
+	// Primitives against each other
+	for (size_t i = 0; i < boxes.size(); i++)
+	{
+		const CollisionBox& one = *boxes[i];
+		Vector3 oneCentre = one.GetAxis(3);
+		double oneRadius = one.halfSize.magnitude();
+
+		for (size_t j = i + 1; j < boxes.size(); j++)
+		{
+			const CollisionBox& two = *boxes[j];
+			if (!BoundsOverlap(oneCentre, oneRadius, two.GetAxis(3), two.halfSize.magnitude())) continue;
+
+			if (!data->HasMoreContacts()) return;
+			BoxAndBox(one, two, data);
+		}
+
+		for (CollisionSphere* sphere : spheres)
+		{
+			if (!BoundsOverlap(oneCentre, oneRadius, sphere->GetAxis(3), sphere->radius)) continue;
+
+			if (!data->HasMoreContacts()) return;
+			BoxAndSphere(one, *sphere, data);
+		}
+	}
+
+	for (size_t i = 0; i < spheres.size(); i++)
+	{
+		const CollisionSphere& one = *spheres[i];
+		Vector3 oneCentre = one.GetAxis(3);
+
+		for (size_t j = i + 1; j < spheres.size(); j++)
+		{
+			if (!BoundsOverlap(oneCentre, one.radius, spheres[j]->GetAxis(3), spheres[j]->radius)) continue;
+
+			if (!data->HasMoreContacts()) return;
+			SphereAndSphere(one, *spheres[j], data);
+		}
+	}
+
+	if ((capsules.empty() && hulls.empty()) || !world) return;
+
+	// Capsules and hulls against everything
+	MapBodies();
+	unsigned numBodies = world->GetBodyCount();
+	for (unsigned one = 0; one < numBodies; one++)
+	{
+		for (unsigned two = one + 1; two < numBodies; two++)
+		{
+			if (!bodyCapsules[one] && !bodyHulls[one] && !bodyCapsules[two] && !bodyHulls[two]) continue;
+			if (!BoundsOverlap(bodyCentres[one], bodyRadii[one], bodyCentres[two], bodyRadii[two])) continue;
+
+			if (!data->HasMoreContacts()) return;
+			ConvexPair(one, two, FindConvexCache(one, two), data);
+		}
+	}
+}
+
+void SceneContactGenerator::MapBodies()
+{
+	unsigned numBodies = world->GetBodyCount();
+	bodyBoxes.assign(numBodies, NULL);
+	bodySpheres.assign(numBodies, NULL);
+	bodyCapsules.assign(numBodies, NULL);
+	bodyHulls.assign(numBodies, NULL);
+	bodyCentres.resize(numBodies);
+	bodyRadii.assign(numBodies, 0);
+
+	for (CollisionBox* box : boxes)
+	{
+		unsigned index = box->body->GetStoreIndex();
+		bodyBoxes[index] = box;
+		bodyCentres[index] = box->GetAxis(3);
+		bodyRadii[index] = box->halfSize.magnitude();
+	}
+	for (CollisionSphere* sphere : spheres)
+	{
+		unsigned index = sphere->body->GetStoreIndex();
+		bodySpheres[index] = sphere;
+		bodyCentres[index] = sphere->GetAxis(3);
+		bodyRadii[index] = sphere->radius;
+	}
+	for (CollisionCapsule* capsule : capsules)
+	{
+		unsigned index = capsule->body->GetStoreIndex();
+		bodyCapsules[index] = capsule;
+		bodyCentres[index] = capsule->GetAxis(3);
+		bodyRadii[index] = capsule->halfHeight + capsule->radius;
+	}
+	for (CollisionConvexHull* hull : hulls)
+	{
+		unsigned index = hull->body->GetStoreIndex();
+		bodyHulls[index] = hull;
+		bodyCentres[index] = hull->GetAxis(3);
+		bodyRadii[index] = hull->hull->GetHalfSize().magnitude();
+	}
+}
+
+void SceneContactGenerator::OrderConvexPair(unsigned& one, unsigned& two) const
+{
+	if (!bodyHulls[one] && (bodyHulls[two] || !bodyCapsules[one])) std::swap(one, two);
+}
+
+GJKCache* SceneContactGenerator::FindConvexCache(unsigned one, unsigned two)
+{
+	OrderConvexPair(one, two);
+
+	if (const CollisionConvexHull* hull = bodyHulls[one])
+	{
+		if (bodyHulls[two]) return &convexPairs.Get(hull, bodyHulls[two]);
+		if (bodyCapsules[two]) return &convexPairs.Get(hull, bodyCapsules[two]);
+		if (bodyBoxes[two]) return &convexPairs.Get(hull, bodyBoxes[two]);
+		if (bodySpheres[two]) return &convexPairs.Get(hull, bodySpheres[two]);
+		return NULL;
+	}
+
+	if (bodyBoxes[two]) return &convexPairs.Get(bodyCapsules[one], bodyBoxes[two]);
+	return NULL;
+}
+
+unsigned SceneContactGenerator::ConvexPair(unsigned one, unsigned two, GJKCache* cache, CollisionData* data)
+{
+	OrderConvexPair(one, two);
+
+	if (const CollisionConvexHull* hull = bodyHulls[one])
+	{
+		if (const CollisionConvexHull* other = bodyHulls[two])
+		{
+			return CollisionDetector::ConvexHullAndConvexHull(*hull, *other, data, cache);
+		}
+		if (const CollisionCapsule* capsule = bodyCapsules[two])
+		{
+			return CollisionDetector::ConvexHullAndCapsule(*hull, *capsule, data, cache);
+		}
+		if (const CollisionBox* box = bodyBoxes[two])
+		{
+			return CollisionDetector::ConvexHullAndBox(*hull, *box, data, cache);
+		}
+		if (const CollisionSphere* sphere = bodySpheres[two])
+		{
+			return CollisionDetector::ConvexHullAndSphere(*hull, *sphere, data, cache);
+		}
+		return 0;
+	}
+
+	const CollisionCapsule& capsule = *bodyCapsules[one];
+	if (bodyCapsules[two]) return CollisionDetector::CapsuleAndCapsule(capsule, *bodyCapsules[two], data);
+	if (bodySpheres[two]) return CollisionDetector::CapsuleAndSphere(capsule, *bodySpheres[two], data);
+	if (const CollisionBox* box = bodyBoxes[two])
+	{
+		return CollisionDetector::CapsuleAndBox(capsule, *box, data, cache);
+	}
+	return 0;
+}
+
+unsigned SceneContactGenerator::CollidePair(unsigned one, unsigned two, GJKCache* convexCache, CollisionData* data)
+{
+	if (bodyBoxes[one] && bodyBoxes[two]) return BoxAndBox(*bodyBoxes[one], *bodyBoxes[two], data);
+	if (bodyBoxes[one] && bodySpheres[two]) return BoxAndSphere(*bodyBoxes[one], *bodySpheres[two], data);
+	if (bodySpheres[one] && bodyBoxes[two]) return BoxAndSphere(*bodyBoxes[two], *bodySpheres[one], data);
+	if (bodySpheres[one] && bodySpheres[two]) return SphereAndSphere(*bodySpheres[one], *bodySpheres[two], data);
+	if (IsConvexPair(one, two)) return ConvexPair(one, two, convexCache, data);
+	return 0;
+}
+
+void SceneContactGenerator::CollidePotentialContacts(CollisionData* data)
+{
+	MapBodies();
+
+	for (const PotentialContact& pair : world->GetPotentialContacts())
+	{
+		if (!data->HasMoreContacts()) return;
+
+		unsigned one = pair.body[0]->GetStoreIndex();
+		unsigned two = pair.body[1]->GetStoreIndex();
+		CollidePair(one, two, IsConvexPair(one, two) ? FindConvexCache(one, two) : NULL, data);
+	}
+}
+
+void BenchScene::Step(double duration)
+{
+	world->StartFrame();
+	world->RunPhysics(duration);
+}
+
+// Puts the body into a known resting state at the given location
+static void InitBody(RigidBody* body, const Vector3& position,
+					 const Quaternion& orientation, double mass,
+					 const Matrix3& inertiaTensor)
+{
+	body->SetPosition(position);
+	body->SetOrientation(orientation);
+	body->SetVelocity(0, 0, 0);
+	body->SetRotation(0, 0, 0);
+	body->SetInverseMass(1.0 / mass);
+	body->SetInertiaTensor(inertiaTensor);
+	body->SetDamping(0.95, 0.8);
+	body->SetAcceleration(Vector3::GRAVITY);
+	body->ClearAccumulators();
+	body->SetAwakeStatus();
+	body->SetCanSleep();
+	body->CalculateDerivedData();
+}
+
+static CollisionBox* AddBox(BenchScene* scene, const Vector3& position,
+							const Quaternion& orientation, const Vector3& halfSize,
+							double mass)
+{
+	scene->bodies.push_back(std::make_unique<RigidBody>());
+	RigidBody* body = scene->bodies.back().get();
+
+	Matrix3 tensor;
+	tensor.setBlockInertiaTensor(halfSize, mass);
+	InitBody(body, position, orientation, mass, tensor);
+
+	scene->boxes.push_back(std::make_unique<CollisionBox>());
+	CollisionBox* box = scene->boxes.back().get();
+	box->body = body;
+	box->halfSize = halfSize;
+	box->CalculateInternals();
+
+	scene->generator.boxes.push_back(box);
+	scene->world->AddBody(body);
+	scene->world->SetBroadphaseBounds(body, halfSize);
+	return box;
+}
+
+static CollisionSphere* AddSphere(BenchScene* scene, const Vector3& position,
+								  double radius, double mass)
+{
+	scene->bodies.push_back(std::make_unique<RigidBody>());
+	RigidBody* body = scene->bodies.back().get();
+
+	double coeff = 0.4 * mass * radius * radius;
+	Matrix3 tensor;
+	tensor.setInertiaTensorCoeffs(coeff, coeff, coeff);
+	InitBody(body, position, Quaternion(), mass, tensor);
+
+	scene->spheres.push_back(std::make_unique<CollisionSphere>());
+	CollisionSphere* sphere = scene->spheres.back().get();
+	sphere->body = body;
+	sphere->radius = radius;
+	sphere->CalculateInternals();
+
+	scene->generator.spheres.push_back(sphere);
+	scene->world->AddBody(body);
+	scene->world->SetBroadphaseBounds(body, Vector3(radius, radius, radius));
+	return sphere;
+}
+
+static CollisionCapsule* AddCapsule(BenchScene* scene, const Vector3& position,
+									const Quaternion& orientation, double radius,
+									double halfHeight, double mass)
+{
+	scene->bodies.push_back(std::make_unique<RigidBody>());
+	RigidBody* body = scene->bodies.back().get();
+
+	// Taken as a solid cylinder of the capsule's full height
+	double height = 2.0 * (halfHeight + radius);
+	double across = mass * (3.0 * radius * radius + height * height) / 12.0;
+	Matrix3 tensor;
+	tensor.setInertiaTensorCoeffs(across, 0.5 * mass * radius * radius, across);
+	InitBody(body, position, orientation, mass, tensor);
+
+	scene->capsules.push_back(std::make_unique<CollisionCapsule>());
+	CollisionCapsule* capsule = scene->capsules.back().get();
+	capsule->body = body;
+	capsule->radius = radius;
+	capsule->halfHeight = halfHeight;
+	capsule->CalculateInternals();
+
+	scene->generator.capsules.push_back(capsule);
+	scene->world->AddBody(body);
+	scene->world->SetBroadphaseBounds(body, capsule->GetBodyHalfSize());
+	return capsule;
+}
+
+static CollisionConvexHull* AddHull(BenchScene* scene, const Vector3& position,
+									const Quaternion& orientation, const ConvexHull* shape,
+									double mass)
+{
+	scene->bodies.push_back(std::make_unique<RigidBody>());
+	RigidBody* body = scene->bodies.back().get();
+
+	// Taken as the box around the hull
+	Matrix3 tensor;
+	tensor.setBlockInertiaTensor(shape->GetHalfSize(), mass);
+	InitBody(body, position, orientation, mass, tensor);
+
+	scene->hulls.push_back(std::make_unique<CollisionConvexHull>());
+	CollisionConvexHull* hull = scene->hulls.back().get();
+	hull->body = body;
+	hull->hull = shape;
+	hull->CalculateInternals();
+
+	scene->generator.hulls.push_back(hull);
+	scene->world->AddBody(body);
+	scene->world->SetBroadphaseBounds(body, hull->GetBodyHalfSize());
+	return hull;
+}
+
+// Creates an empty scene with room for the given number of contacts
+static std::unique_ptr<BenchScene> CreateScene(const char* name, unsigned maxContacts)
+{
+	std::unique_ptr<BenchScene> scene = std::make_unique<BenchScene>();
+	scene->name = name;
+	scene->world = std::make_unique<World>(maxContacts);
+	scene->generator.world = scene->world.get();
+	return scene;
+}
+
+std::unique_ptr<BenchScene> CreateBoxStackScene(unsigned size)
+{
+	unsigned numBodies = size * size * stackHeight;
+	std::unique_ptr<BenchScene> scene = CreateScene("box_stack", numBodies * 8);
+
+	Vector3 halfSize(0.5, 0.5, 0.5);
+	for (unsigned x = 0; x < size; x++)
+	{
+		for (unsigned z = 0; z < size; z++)
+		{
+			for (unsigned y = 0; y < stackHeight; y++)
+			{
+				Vector3 position(x * 1.5, halfSize.y + y * 2.0 * halfSize.y, z * 1.5);
+				AddBox(scene.get(), position, Quaternion(), halfSize, 1.0);
+			}
+		}
+	}
+
+	scene->world->AddContactGenerator(&scene->generator);
+	return scene;
+}
+
+std::unique_ptr<BenchScene> CreateSpherePileScene(unsigned size)
+{
+	unsigned numBodies = size * size * size;
+	std::unique_ptr<BenchScene> scene = CreateScene("sphere_pile", numBodies * 8);
+
+	Random random(sceneSeed);
+	const double radius = 0.5;
+	for (unsigned y = 0; y < size; y++)
+	{
+		for (unsigned x = 0; x < size; x++)
+		{
+			for (unsigned z = 0; z < size; z++)
+			{
+				Vector3 position(x * 1.1, radius + 0.1 + y * 1.1, z * 1.1);
+				position += random.randomXZVector(0.05);
+				AddSphere(scene.get(), position, radius, 1.0);
+			}
+		}
+	}
+
+	scene->world->AddContactGenerator(&scene->generator);
+	return scene;
+}
+
+std::unique_ptr<BenchScene> CreateRagdollChainScene(unsigned size)
+{
+	unsigned numBodies = size * chainLength;
+	std::unique_ptr<BenchScene> scene = CreateScene("ragdoll_chain", numBodies * 8);
+
+	Random random(sceneSeed);
+	Vector3 halfSize(0.4, 0.15, 0.15);
+	for (unsigned chain = 0; chain < size; chain++)
+	{
+		Vector3 start(0, 2.0 + (chain % 4) * 0.5, chain * 1.0);
+		RigidBody* previous = NULL;
+
+		for (unsigned link = 0; link < chainLength; link++)
+		{
+			Vector3 position = start + Vector3(link * 1.0, 0, 0);
+			CollisionBox* box = AddBox(scene.get(), position, Quaternion(), halfSize, 1.0);
+			box->body->SetVelocity(random.randomVector(1.0));
+
+			if (previous)
+			{
+				scene->joints.push_back(std::make_unique<Joint>());
+				Joint* joint = scene->joints.back().get();
+				joint->set(previous, Vector3(0.5, 0, 0), box->body, Vector3(-0.5, 0, 0), 0.05);
+				scene->world->AddContactGenerator(joint);
+			}
+			previous = box->body;
+		}
+	}
+
+	scene->world->AddContactGenerator(&scene->generator);
+	return scene;
+}
+
+std::unique_ptr<BenchScene> CreateFreeBodiesScene(unsigned size)
+{
+	std::unique_ptr<BenchScene> scene = CreateScene("free_bodies", 1);
+
+	Random random(sceneSeed);
+	Vector3 halfSize(0.5, 0.25, 0.125);
+	for (unsigned x = 0; x < size; x++)
+	{
+		for (unsigned y = 0; y < size; y++)
+		{
+			for (unsigned z = 0; z < size; z++)
+			{
+				Vector3 position(x * 2.0, 10.0 + y * 2.0, z * 2.0);
+				CollisionBox* box = AddBox(scene.get(), position, Quaternion(), halfSize, 1.0);
+				box->body->SetVelocity(random.randomVector(5.0));
+				box->body->SetRotation(random.randomVector(5.0));
+			}
+		}
+	}
+
+	// Only the integrator runs, there are no contacts to generate
+	return scene;
+}
+
+std::unique_ptr<BenchScene> CreateConvexPileScene(unsigned size)
+{
+	unsigned numBodies = size * size * 4;
+	std::unique_ptr<BenchScene> scene = CreateScene("convex_pile", numBodies * hullCloudSize);
+
+	// Every hull is the same rough ball of points
+	Random random(sceneSeed);
+	std::vector<Vector3> cloud;
+	for (unsigned i = 0; i < hullCloudSize; i++)
+	{
+		cloud.push_back(random.randomVector(Vector3(0.5, 0.4, 0.45)));
+	}
+	scene->hullShapes.push_back(std::make_unique<ConvexHull>());
+	ConvexHull* shape = scene->hullShapes.back().get();
+	shape->Build(cloud.data(), hullCloudSize);
+
+	// Columns of alternating capsules and hulls dropped at angles
+	for (unsigned x = 0; x < size; x++)
+	{
+		for (unsigned z = 0; z < size; z++)
+		{
+			for (unsigned y = 0; y < 4; y++)
+			{
+				Vector3 position(x * 1.6, 1.0 + y * 1.6, z * 1.6);
+				position += random.randomXZVector(0.2);
+				Quaternion orientation = random.randomQuaternion();
+
+				if ((x + y + z) % 2) AddCapsule(scene.get(), position, orientation, 0.3, 0.4, 1.0);
+				else AddHull(scene.get(), position, orientation, shape, 1.0);
+			}
+		}
+	}
+
+	scene->world->AddContactGenerator(&scene->generator);
+	return scene;
+}
+
+std::unique_ptr<BenchScene> CreateBulletScene(unsigned size)
+{
+	unsigned numBodies = size * size;
+	std::unique_ptr<BenchScene> scene = CreateScene("bullets", numBodies * 8);
+
+	// The wall stands clear of the ground, so that it has no contacts
+	// of its' own, and nothing moves it
+	CollisionBox* wall = AddBox(scene.get(), Vector3(0, 3.5, 0), Quaternion(), Vector3(0.05, 3.0, 3.0), 1.0);
+	wall->body->SetInverseMass(0);
+	wall->body->SetInverseInertiaTensor(Matrix3());
+	wall->body->SetAcceleration(Vector3());
+	scene->world->AddQueryShape(wall);
+
+	// Each bullet moves about ten times its' own width a step, from a
+	// little further back than the last so that they reach the wall on
+	// every part of the step
+	Vector3 halfSize(0.1, 0.1, 0.1);
+	for (unsigned y = 0; y < size; y++)
+	{
+		for (unsigned z = 0; z < size; z++)
+		{
+			unsigned index = y * size + z;
+			Vector3 position(-4.0 - 0.037 * index, 1.0 + 5.0 * y / size, -2.5 + 5.0 * z / size);
+			CollisionBox* bullet = AddBox(scene.get(), position, Quaternion(), halfSize, 0.1);
+			bullet->body->SetVelocity(120.0, 0, 0);
+			bullet->body->SetAcceleration(Vector3());
+			bullet->body->SetCanSleep(false);
+			bullet->body->SetContinuousRadius(0.08);
+		}
+	}
+
+	scene->world->UpdateQueryShapes();
+	scene->world->AddContactGenerator(&scene->generator);
+	return scene;
+}
+
+const BenchSceneDesc* GetBenchScenes()
+{
+	static const BenchSceneDesc scenes[] =
+	{
+		{ "box_stack", CreateBoxStackScene, 4 },
+		{ "sphere_pile", CreateSpherePileScene, 6 },
+		{ "ragdoll_chain", CreateRagdollChainScene, 12 },
+		{ "free_bodies", CreateFreeBodiesScene, 24 },
+		{ "convex_pile", CreateConvexPileScene, 4 },
+		{ NULL, NULL, 0 }
+	};
+	return scenes;
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the scripted scenes driven by the physics
+ * benchmark runner. Each scene owns its bodies, collision primitives
+ * and contact generators, and a world they are registered with.
+ */
+
+#include "../Physics/world.h"
+#include "../Physics/CollideFine.h"
+#include "../Physics/ContactManifold.h"
+#include "../Physics/ConvexHull.h"
+#include "../Physics/GJK.h"
+#include "../Physics/Joints.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * A contact generator that runs the fine collision detector over
+ * every pair of primitives in a scene, and every primitive against
+ * the ground plane. Pairs are rejected early with a bounding sphere
+ * test so that only overlapping pairs reach the narrowphase.
+ *
+ * With the pair cache turned on, every pair keeps a persistent
+ * manifold instead of having its' contacts found from scratch.
+ * When the world has a broadphase, only the pairs it reports are
+ * tested against each other. Pairs with a capsule or hull in them
+ * that go through GJK always keep its' cache from step to step.
+ *
+ * With a broadphase and without the pair cache, the work is split
+ * into parts the world runs on its' workers: the primitives against
+ * the ground and the broadphase's pairs, a range of each per part.
+ */
+class SceneContactGenerator : public ContactGenerator
+{
+public:
+	std::vector<CollisionBox*> boxes;
+	std::vector<CollisionSphere*> spheres;
+	std::vector<CollisionCapsule*> capsules;
+	std::vector<CollisionConvexHull*> hulls;
+
+	// The immovable ground plane every primitive rests on
+	CollisionPlane ground;
+
+	double friction;
+	double restitution;
+
+	ContactPairCache pairs;
+	bool usePairCache;
+
+	GJKPairCache convexPairs;
+
+	// The world whose broadphase pairs are tested
+	World* world;
+
+	SceneContactGenerator();
+
+	virtual unsigned AddContact(Contact* nextContact, unsigned limit);
+	virtual void RestartContacts();
+
+	virtual unsigned BeginContactParts();
+	virtual void AddContactPart(unsigned part, ContactArena& output);
+	virtual void EndContactParts();
+
+private:
+	// Runs every pair through the detector or the pair cache
+	void Collide(CollisionData* data);
+
+	// Runs the pairs found by the world's broadphase
+	void CollidePotentialContacts(CollisionData* data);
+
+	unsigned BoxAndHalfSpace(const CollisionBox& box, CollisionData* data);
+	unsigned SphereAndHalfSpace(const CollisionSphere& sphere, CollisionData* data);
+	unsigned BoxAndBox(const CollisionBox& one, const CollisionBox& two, CollisionData* data);
+	unsigned BoxAndSphere(const CollisionBox& box, const CollisionSphere& sphere, CollisionData* data);
+	unsigned SphereAndSphere(const CollisionSphere& one, const CollisionSphere& two, CollisionData* data);
+
+	// Finds the primitive of each body in the world
+	void MapBodies();
+
+	// Runs the pair of bodies with the given store indices through the
+	// detector, the cache is used if they go through GJK
+	unsigned CollidePair(unsigned one, unsigned two, GJKCache* convexCache, CollisionData* data);
+
+	// Checks whether either of the bodies is a capsule or hull
+	bool IsConvexPair(unsigned one, unsigned two) const
+	{
+		return bodyCapsules[one] || bodyHulls[one] || bodyCapsules[two] || bodyHulls[two];
+	}
+
+	// Puts a pair of bodies, one of which is a capsule or hull, in the
+	// order the detector takes them: hulls first, then capsules
+	void OrderConvexPair(unsigned& one, unsigned& two) const;
+
+	// Returns the GJK cache of the pair, NULL if it does not go through GJK
+	GJKCache* FindConvexCache(unsigned one, unsigned two);
+
+	// Runs the pair of bodies with the given store indices, one of which
+	// is a capsule or hull, through the detector
+	unsigned ConvexPair(unsigned one, unsigned two, GJKCache* cache, CollisionData* data);
+
+	// What each part of the work covers: the primitives of one kind
+	// against the ground, or a range of the broadphase's pairs
+	enum class PartKind
+	{
+		GroundBoxes,
+		GroundSpheres,
+		GroundCapsules,
+		GroundHulls,
+		Pairs
+	};
+
+	struct ContactPart
+	{
+		PartKind kind;
+		unsigned begin;
+		unsigned end;
+	};
+
+	std::vector<ContactPart> parts;
+
+	// Adds parts covering count items of the given kind
+	void AddParts(PartKind kind, size_t count, unsigned partSize);
+
+	// By broadphase pair, its' GJK cache if it has one. They are found
+	// before the parts run as the cache is not safe to add to from many
+	// threads at once
+	std::vector<GJKCache*> pairCaches;
+
+	// The primitive of each body in the world, by store index
+	std::vector<const CollisionBox*> bodyBoxes;
+	std::vector<const CollisionSphere*> bodySpheres;
+	std::vector<const CollisionCapsule*> bodyCapsules;
+	std::vector<const CollisionConvexHull*> bodyHulls;
+
+	// The centre and bounding radius of each body's primitive
+	std::vector<Vector3> bodyCentres;
+	std::vector<double> bodyRadii;
+
+	// Set when the world is about to run us again in the same step
+	bool restarting;
+};
+
+/**
+ * Holds everything needed to step one scripted scene.
+ */
+class BenchScene
+{
+public:
+	std::string name;
+
+	std::vector<std::unique_ptr<RigidBody>> bodies;
+	std::vector<std::unique_ptr<CollisionBox>> boxes;
+	std::vector<std::unique_ptr<CollisionSphere>> spheres;
+	std::vector<std::unique_ptr<CollisionCapsule>> capsules;
+	std::vector<std::unique_ptr<CollisionConvexHull>> hulls;
+	std::vector<std::unique_ptr<Joint>> joints;
+
+	// The shapes the hull primitives share
+	std::vector<std::unique_ptr<ConvexHull>> hullShapes;
+
+	SceneContactGenerator generator;
+
+	std::unique_ptr<World> world;
+
+	// Advances the scene by one simulation step
+	void Step(double duration);
+};
+
+// Columns of boxes stacked on top of each other, size x size columns
+std::unique_ptr<BenchScene> CreateBoxStackScene(unsigned size);
+
+// Spheres dropped onto the ground in a loose pile, size^3 spheres
+std::unique_ptr<BenchScene> CreateSpherePileScene(unsigned size);
+
+// Chains of jointed boxes falling onto the ground, size chains of 10 links
+std::unique_ptr<BenchScene> CreateRagdollChainScene(unsigned size);
+
+// Tumbling boxes with nothing to collide with, size^3 boxes
+std::unique_ptr<BenchScene> CreateFreeBodiesScene(unsigned size);
+
+// Capsules and convex hulls dropped into a heap, size x size columns of 4
+std::unique_ptr<BenchScene> CreateConvexPileScene(unsigned size);
+
+/**
+ * Small boxes fired at a thin immovable wall, size x size of them, with
+ * continuous collision detection on. The wall is the scene's only query
+ * shape. Not in the scene table, the CCD benchmark runs it.
+ */
+std::unique_ptr<BenchScene> CreateBulletScene(unsigned size);
+
+/**
+ * Describes a scene that can be selected from the command line.
+ */
+struct BenchSceneDesc
+{
+	const char* name;
+	std::unique_ptr<BenchScene> (*create)(unsigned size);
+	unsigned defaultSize;
+};
+
+// Returns the table of available scenes, terminated by a null name
+const BenchSceneDesc* GetBenchScenes();
+
+// Returns the number of heap allocations the process has made, the
+// benchmark runner counts them
+unsigned long long GetAllocationCount();
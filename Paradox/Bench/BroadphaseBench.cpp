@@ -0,0 +1,462 @@
+#include "BroadphaseBench.h"
+#include "../Physics/BVHPairs.h"
+#include "../Physics/CollideCoarse.h"
+#include "../Physics/DynamicTree.h"
+#include "../Physics/PooledBVH.h"
+#include "../Physics/Random.h"
+#include "../Physics/StaticTree.h"
+#include "../Physics/SweepAndPrune.h"
+#include "../Physics/WorkerPool.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+// Seed shared by every field so runs are repeatable
+static const unsigned fieldSeed = 4321;
+
+// Field sizes the broadphases are compared at
+static const unsigned fieldSizes[] = { 1000, 5000, 10000, 50000 };
+
+// Field sizes the static trees are built over
+static const unsigned staticFieldSizes[] = { 10000, 50000, 200000 };
+
+// Number of boxes each static tree is queried with
+static const unsigned staticQueries = 10000;
+
+// Share of the boxes left moving in a resting field
+static const double restingMovingShare = 0.05;
+
+// Boxes drifting around a cube, bouncing off its' walls
+struct BoxField
+{
+	std::unique_ptr<RigidBody[]> bodies;
+	std::vector<Vector3> positions;
+	std::vector<Vector3> velocities;
+	std::vector<Vector3> halfSizes;
+	double extent;
+
+	// Only the given share of the boxes is set moving, the rest stay put
+	BoxField(unsigned size, double movingShare = 1.0)
+		:
+		bodies(new RigidBody[size])
+	{
+		// Keep the same density at every size, about one box per 8 units
+		extent = 2.0 * cbrt((double)size);
+
+		Random random(fieldSeed);
+		for (unsigned i = 0; i < size; i++)
+		{
+			positions.push_back(random.randomVector(Vector3(), Vector3(extent, extent, extent)));
+			Vector3 velocity = random.randomVector(2.0);
+			velocities.push_back(i < size * movingShare ? velocity : Vector3());
+			halfSizes.push_back(random.randomVector(Vector3(0.1, 0.1, 0.1), Vector3(0.6, 0.6, 0.6)));
+		}
+	}
+
+	unsigned Size() const
+	{
+		return (unsigned)positions.size();
+	}
+
+	BoundingBoxVolume GetVolume(unsigned i) const
+	{
+		return BoundingBoxVolume(positions[i] - halfSizes[i], positions[i] + halfSizes[i]);
+	}
+
+	void Step(double duration)
+	{
+		for (unsigned i = 0; i < Size(); i++)
+		{
+			positions[i] += velocities[i] * duration;
+			for (unsigned axis = 0; axis < 3; axis++)
+			{
+				if (positions[i][axis] < 0 || positions[i][axis] > extent) velocities[i][axis] = -velocities[i][axis];
+			}
+		}
+	}
+};
+
+static double SecondsSince(const std::chrono::steady_clock::time_point& start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Times testing every pair of boxes against each other, for one step
+static double TimeBruteForce(const BoxField& field, unsigned long long* pairs)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	unsigned long long found = 0;
+	for (unsigned i = 0; i < field.Size(); i++)
+	{
+		BoundingBoxVolume one = field.GetVolume(i);
+		for (unsigned j = i + 1; j < field.Size(); j++)
+		{
+			BoundingBoxVolume two = field.GetVolume(j);
+			if (one.Overlaps(&two)) found++;
+		}
+	}
+
+	*pairs = found;
+	return SecondsSince(start);
+}
+
+// Counts the pairs of bounding spheres of the boxes that overlap, testing
+// every pair, as the sphere hierarchies should find
+static unsigned long long CountSpherePairs(const BoxField& field)
+{
+	unsigned long long found = 0;
+	for (unsigned i = 0; i < field.Size(); i++)
+	{
+		BoundingSphereVolume one(field.positions[i], field.halfSizes[i].magnitude());
+		for (unsigned j = i + 1; j < field.Size(); j++)
+		{
+			BoundingSphereVolume two(field.positions[j], field.halfSizes[j].magnitude());
+			if (one.Overlaps(&two)) found++;
+		}
+	}
+	return found;
+}
+
+// Checks that each way of searching a sphere BVHNode hierarchy finds
+// the pairs testing every pair does, printing what each found
+static bool CheckBVHNodePairs(const BoxField& field, WorkerPool& pool)
+{
+	BVHNode<BoundingSphereVolume>* root = NULL;
+	for (unsigned i = 0; i < field.Size(); i++)
+	{
+		BoundingSphereVolume volume(field.positions[i], field.halfSizes[i].magnitude());
+		if (root) root->Insert(&field.bodies[i], volume);
+		else root = new BVHNode<BoundingSphereVolume>(NULL, volume, &field.bodies[i]);
+	}
+
+	unsigned long long expected = CountSpherePairs(field);
+
+	std::vector<PotentialContact> contacts(field.Size() * 16);
+	unsigned long long fixed = root->GetPotentialContacts(contacts.data(), (unsigned)contacts.size());
+
+	contacts.clear();
+	unsigned long long grown = root->GetPotentialContacts(contacts);
+
+	BVHPairFinder<BoundingSphereVolume> finder;
+	std::vector<PotentialContact> found;
+	unsigned long long threaded = finder.GetPotentialContacts(root, found, pool);
+	bool sameOrder = found.size() == contacts.size();
+	for (size_t i = 0; sameOrder && i < found.size(); i++)
+	{
+		sameOrder = found[i].body[0] == contacts[i].body[0] && found[i].body[1] == contacts[i].body[1];
+	}
+
+	delete root;
+
+	bool matched = fixed == expected && grown == expected && threaded == expected && sameOrder;
+	printf("%-8u %-8s %-16s %12s %12llu\n", field.Size(), "start", "brute_sphere", "-", expected);
+	if (!matched)
+	{
+		printf("bvh_sphere found %llu pairs into an array, %llu into a list and %llu on the pool%s\n",
+			fixed, grown, threaded, sameOrder ? "" : ", in a different order");
+	}
+	return matched;
+}
+
+// Times rebuilding a sphere BVHNode hierarchy and finding its' pairs every
+// step, into a fixed array or on the given pool when there is one
+static double TimeBVHNode(BoxField& field, unsigned steps, double duration, unsigned long long* pairs,
+	WorkerPool* pool = NULL)
+{
+	BVHPairFinder<BoundingSphereVolume> finder;
+	std::vector<PotentialContact> found;
+
+	std::vector<PotentialContact> contacts(field.Size() * 16);
+	unsigned long long total = 0;
+	double elapsed = 0;
+
+	for (unsigned step = 0; step < steps; step++)
+	{
+		field.Step(duration);
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		// BVHNode cannot move its' leaves, so the hierarchy is built anew
+		BVHNode<BoundingSphereVolume>* root = NULL;
+		for (unsigned i = 0; i < field.Size(); i++)
+		{
+			BoundingSphereVolume volume(field.positions[i], field.halfSizes[i].magnitude());
+			if (root) root->Insert(&field.bodies[i], volume);
+			else root = new BVHNode<BoundingSphereVolume>(NULL, volume, &field.bodies[i]);
+		}
+		if (pool)
+		{
+			found.clear();
+			total += finder.GetPotentialContacts(root, found, *pool);
+		}
+		else
+		{
+			total += root->GetPotentialContacts(contacts.data(), (unsigned)contacts.size());
+		}
+
+		elapsed += SecondsSince(start);
+		delete root;
+	}
+
+	*pairs = total / steps;
+	return elapsed / steps;
+}
+
+// Times moving the boxes in a dynamic tree and finding its' pairs every
+// step, on the given pool when there is one
+static double TimeDynamicTree(BoxField& field, unsigned steps, double duration, unsigned long long* pairs,
+	WorkerPool* pool = NULL)
+{
+	DynamicAABBTree tree;
+	std::vector<unsigned> proxies;
+	for (unsigned i = 0; i < field.Size(); i++)
+	{
+		proxies.push_back(tree.CreateProxy(field.GetVolume(i), &field.bodies[i]));
+	}
+
+	std::vector<PotentialContact> contacts;
+	unsigned long long found = 0;
+	double elapsed = 0;
+
+	for (unsigned step = 0; step < steps; step++)
+	{
+		field.Step(duration);
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		for (unsigned i = 0; i < field.Size(); i++)
+		{
+			tree.MoveProxy(proxies[i], field.GetVolume(i), field.velocities[i] * duration);
+		}
+		contacts.clear();
+		if (pool) found += tree.GetPotentialContacts(contacts, *pool);
+		else found += tree.GetPotentialContacts(contacts);
+
+		elapsed += SecondsSince(start);
+	}
+
+	*pairs = found / steps;
+	return elapsed / steps;
+}
+
+// Times taking each moving box out of a pooled hierarchy and putting
+// it back where it now is, then finding the pairs, every step
+static double TimePooledBVH(BoxField& field, unsigned steps, double duration, unsigned long long* pairs)
+{
+	PooledBVH hierarchy;
+	std::vector<unsigned> leaves;
+	for (unsigned i = 0; i < field.Size(); i++)
+	{
+		leaves.push_back(hierarchy.Insert(&field.bodies[i], field.GetVolume(i)));
+	}
+
+	std::vector<PotentialContact> contacts;
+	unsigned long long found = 0;
+	double elapsed = 0;
+
+	for (unsigned step = 0; step < steps; step++)
+	{
+		field.Step(duration);
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		for (unsigned i = 0; i < field.Size(); i++)
+		{
+			if (field.velocities[i].squareMagnitude() == 0) continue;
+
+			hierarchy.Remove(leaves[i]);
+			leaves[i] = hierarchy.Insert(&field.bodies[i], field.GetVolume(i));
+		}
+		contacts.clear();
+		found += hierarchy.GetPotentialContacts(contacts);
+
+		elapsed += SecondsSince(start);
+	}
+
+	*pairs = found / steps;
+	return elapsed / steps;
+}
+
+// Times updating the sweep and prune boxes and finding its' pairs every step
+static double TimeSweepAndPrune(BoxField& field, unsigned steps, double duration, unsigned long long* pairs)
+{
+	SweepAndPrune sweep;
+	std::vector<unsigned> proxies;
+	for (unsigned i = 0; i < field.Size(); i++)
+	{
+		proxies.push_back(sweep.CreateProxy(field.GetVolume(i), &field.bodies[i]));
+	}
+
+	// Sort the ends once outside the timing, as the tree is built outside it
+	std::vector<PotentialContact> contacts;
+	sweep.GetPotentialContacts(contacts);
+
+	unsigned long long found = 0;
+	double elapsed = 0;
+
+	for (unsigned step = 0; step < steps; step++)
+	{
+		field.Step(duration);
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		for (unsigned i = 0; i < field.Size(); i++)
+		{
+			sweep.MoveProxy(proxies[i], field.GetVolume(i));
+		}
+		contacts.clear();
+		found += sweep.GetPotentialContacts(contacts);
+
+		elapsed += SecondsSince(start);
+	}
+
+	*pairs = found / steps;
+	return elapsed / steps;
+}
+
+bool RunBroadphaseBench(unsigned steps, unsigned threads)
+{
+	const double duration = 1.0 / 60.0;
+
+	WorkerPool pool(threads);
+	printf("threads: %u\n", pool.GetThreadCount());
+
+	printf("%-8s %-8s %-16s %12s %12s\n", "boxes", "field", "broadphase", "ms/step", "pairs");
+
+	bool matched = true;
+	for (unsigned size : fieldSizes)
+	{
+		unsigned long long pairs = 0;
+		double time;
+
+		BoxField bruteField(size);
+		time = TimeBruteForce(bruteField, &pairs);
+		printf("%-8u %-8s %-16s %12.3f %12llu\n", size, "-", "brute_force", time * 1000.0, pairs);
+		matched = CheckBVHNodePairs(bruteField, pool) && matched;
+
+		// Every box moving, then a field where nearly all are at rest
+		for (unsigned resting = 0; resting < 2; resting++)
+		{
+			double share = resting ? restingMovingShare : 1.0;
+			const char* name = resting ? "resting" : "moving";
+
+			BoxField sphereField(size, share);
+			time = TimeBVHNode(sphereField, steps, duration, &pairs);
+			printf("%-8u %-8s %-16s %12.3f %12llu\n", size, name, "bvh_sphere", time * 1000.0, pairs);
+
+			BoxField sphereThreadsField(size, share);
+			time = TimeBVHNode(sphereThreadsField, steps, duration, &pairs, &pool);
+			printf("%-8u %-8s %-16s %12.3f %12llu\n", size, name, "bvh_sphere_mt", time * 1000.0, pairs);
+
+			BoxField treeField(size, share);
+			time = TimeDynamicTree(treeField, steps, duration, &pairs);
+			printf("%-8u %-8s %-16s %12.3f %12llu\n", size, name, "dynamic_tree", time * 1000.0, pairs);
+
+			BoxField treeThreadsField(size, share);
+			time = TimeDynamicTree(treeThreadsField, steps, duration, &pairs, &pool);
+			printf("%-8u %-8s %-16s %12.3f %12llu\n", size, name, "dynamic_tree_mt", time * 1000.0, pairs);
+
+			BoxField poolField(size, share);
+			time = TimePooledBVH(poolField, steps, duration, &pairs);
+			printf("%-8u %-8s %-16s %12.3f %12llu\n", size, name, "bvh_pool", time * 1000.0, pairs);
+
+			BoxField sweepField(size, share);
+			time = TimeSweepAndPrune(sweepField, steps, duration, &pairs);
+			printf("%-8u %-8s %-16s %12.3f %12llu\n", size, name, "sweep_prune", time * 1000.0, pairs);
+		}
+	}
+
+	printf(matched ? "every bvh_sphere search found the brute force pairs\n" : "bvh_sphere searches lost pairs\n");
+	return matched;
+}
+
+// Counts the leaves of a BVHNode hierarchy whose volumes overlap the given box
+static unsigned QueryHierarchy(const BVHNode<BoundingBoxVolume>* node, const BoundingBoxVolume& volume)
+{
+	if (!node->volume.Overlaps(&volume)) return 0;
+	if (node->IsLeaf()) return 1;
+	return QueryHierarchy(node->children[0], volume) + QueryHierarchy(node->children[1], volume);
+}
+
+// Sums the surface areas of a BVHNode hierarchy the way StaticAABBTree::GetCost does
+static double HierarchyArea(const BVHNode<BoundingBoxVolume>* node)
+{
+	double area = node->volume.GetSurfaceArea();
+	if (node->IsLeaf()) return area;
+	return area + HierarchyArea(node->children[0]) + HierarchyArea(node->children[1]);
+}
+
+// Prints one row of the static tree table, leaving out the cost if it is not known
+static void PrintStaticRow(unsigned size, const char* tree, double buildTime, double queryTime,
+	unsigned long long hits, double cost)
+{
+	printf("%-8u %-16s %12.3f %12.3f %12llu ", size, tree, buildTime * 1000.0, queryTime * 1000.0, hits);
+	if (cost > 0) printf("%10.1f\n", cost);
+	else printf("%10s\n", "-");
+}
+
+void RunStaticTreeBench(unsigned threads)
+{
+	WorkerPool pool(threads);
+	printf("threads: %u\n", pool.GetThreadCount());
+	printf("%-8s %-16s %12s %12s %12s %10s\n", "boxes", "tree", "build ms", "query ms", "hits", "sah cost");
+
+	for (unsigned size : staticFieldSizes)
+	{
+		BoxField field(size, 0);
+		std::vector<RigidBody*> bodies;
+		std::vector<BoundingBoxVolume> volumes;
+		for (unsigned i = 0; i < size; i++)
+		{
+			bodies.push_back(&field.bodies[i]);
+			volumes.push_back(field.GetVolume(i));
+		}
+
+		// Query boxes of the same sizes, scattered over the same space
+		BoxField queryField(staticQueries);
+		for (unsigned i = 0; i < staticQueries; i++)
+		{
+			queryField.positions[i] *= field.extent / queryField.extent;
+		}
+
+		unsigned long long hits = 0;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		BVHNode<BoundingBoxVolume>* root = new BVHNode<BoundingBoxVolume>(NULL, volumes[0], bodies[0]);
+		for (unsigned i = 1; i < size; i++) root->Insert(bodies[i], volumes[i]);
+		double buildTime = SecondsSince(start);
+
+		start = std::chrono::steady_clock::now();
+		for (unsigned i = 0; i < staticQueries; i++) hits += QueryHierarchy(root, queryField.GetVolume(i));
+		double queryTime = SecondsSince(start);
+		PrintStaticRow(size, "bvh_insert", buildTime, queryTime, hits, HierarchyArea(root) / root->volume.GetSurfaceArea());
+		delete root;
+
+		// The dynamic tree fattens its' boxes, so it finds a few more
+		DynamicAABBTree dynamicTree;
+		start = std::chrono::steady_clock::now();
+		for (unsigned i = 0; i < size; i++) dynamicTree.CreateProxy(volumes[i], bodies[i]);
+		buildTime = SecondsSince(start);
+
+		hits = 0;
+		start = std::chrono::steady_clock::now();
+		for (unsigned i = 0; i < staticQueries; i++) dynamicTree.Query(queryField.GetVolume(i), [&](RigidBody*) { hits++; });
+		PrintStaticRow(size, "dynamic_tree", buildTime, SecondsSince(start), hits, 0);
+
+		for (unsigned parallel = 0; parallel < 2; parallel++)
+		{
+			StaticAABBTree staticTree;
+			start = std::chrono::steady_clock::now();
+			staticTree.Build(bodies.data(), volumes.data(), size, parallel ? &pool : NULL);
+			buildTime = SecondsSince(start);
+
+			hits = 0;
+			start = std::chrono::steady_clock::now();
+			for (unsigned i = 0; i < staticQueries; i++) staticTree.Query(queryField.GetVolume(i), [&](RigidBody*) { hits++; });
+			PrintStaticRow(size, parallel ? "static_sah_mt" : "static_sah", buildTime, SecondsSince(start), hits,
+				staticTree.GetCost());
+		}
+	}
+}
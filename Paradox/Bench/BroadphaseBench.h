@@ -0,0 +1,28 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the broadphase benchmarks, which time finding
+ * the overlapping pairs in fields of moving boxes of growing size,
+ * using each of the broadphases the physics library offers, and
+ * building trees over fields of boxes that do not move.
+ */
+
+/**
+ * Runs the benchmark over fields of 1k to 50k boxes, stepping each
+ * field the given number of times, and prints a table of results.
+ * Multi-threaded rows use the given number of threads, zero for one
+ * per hardware thread. Before stepping each field, checks that the
+ * sphere BVHNode searches find every pair of overlapping spheres.
+ * Returns true if none of them lost a pair.
+ */
+bool RunBroadphaseBench(unsigned steps, unsigned threads);
+
+/**
+ * Builds trees over fields of 10k to 200k boxes at rest, one box at a
+ * time and all at once, and prints how long each took to build and
+ * to answer a batch of box queries. The bulk builds use the given
+ * number of threads, zero for one per hardware thread.
+ */
+void RunStaticTreeBench(unsigned threads);
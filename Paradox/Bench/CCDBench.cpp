@@ -0,0 +1,87 @@
+#include "CCDBench.h"
+#include "BenchScenes.h"
+#include <chrono>
+#include <cstdio>
+
+// Sizes the bullet scene is run at, size x size bullets
+static const unsigned bulletSizes[] = { 4, 8, 16 };
+
+// Size of the free bodies scene the common path is timed on
+static const unsigned freeBodiesSize = 24;
+
+static const double stepDuration = 1.0 / 60.0;
+
+static double SecondsSince(const std::chrono::steady_clock::time_point& start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// What one run of a scene measured
+struct CCDRunResult
+{
+	double stepTime;
+	double continuousTime;
+	unsigned long long swept;
+	unsigned long long stopped;
+};
+
+// Steps the scene, adding up the world's counters
+static CCDRunResult RunSteps(BenchScene* scene, unsigned steps)
+{
+	CCDRunResult run = {};
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (unsigned step = 0; step < steps; step++)
+	{
+		scene->Step(stepDuration);
+
+		const WorldStats& stats = scene->world->GetStats();
+		run.continuousTime += stats.continuousTime;
+		run.swept += stats.bodiesSwept;
+		run.stopped += stats.bodiesStopped;
+	}
+	run.stepTime = SecondsSince(start);
+	return run;
+}
+
+// Counts the bullets that ended up past the wall, the first body
+static unsigned CountPassed(const BenchScene& scene)
+{
+	double wallFace = scene.bodies[0]->GetPosition().x + scene.boxes[0]->halfSize.x;
+
+	unsigned passed = 0;
+	for (size_t i = 1; i < scene.bodies.size(); i++)
+	{
+		if (scene.bodies[i]->GetPosition().x > wallFace) passed++;
+	}
+	return passed;
+}
+
+void RunCCDBench(unsigned steps)
+{
+	printf("%-12s %8s %-4s %10s %10s %12s %10s %10s\n", "scene", "bodies", "ccd", "passed", "ms/step",
+		"ccd us/step", "swept", "stopped");
+
+	for (unsigned size : bulletSizes)
+	{
+		for (bool continuous : { false, true })
+		{
+			std::unique_ptr<BenchScene> scene = CreateBulletScene(size);
+			if (!continuous)
+			{
+				for (auto& body : scene->bodies) body->SetContinuousRadius(0);
+			}
+
+			CCDRunResult run = RunSteps(scene.get(), steps);
+			printf("%-12s %8u %-4s %10u %10.4f %12.2f %10llu %10llu\n", scene->name.c_str(),
+				(unsigned)scene->bodies.size() - 1, continuous ? "on" : "off", CountPassed(*scene),
+				run.stepTime * 1e3 / steps, run.continuousTime * 1e6 / steps, run.swept, run.stopped);
+		}
+	}
+
+	// No body here is swept, the only cost is looking for ones that are
+	std::unique_ptr<BenchScene> scene = CreateFreeBodiesScene(freeBodiesSize);
+	CCDRunResult run = RunSteps(scene.get(), steps);
+	printf("%-12s %8u %-4s %10s %10.4f %12.2f %10llu %10llu\n", scene->name.c_str(),
+		(unsigned)scene->bodies.size(), "off", "-", run.stepTime * 1e3 / steps,
+		run.continuousTime * 1e6 / steps, run.swept, run.stopped);
+}
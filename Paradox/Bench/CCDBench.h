@@ -0,0 +1,17 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the continuous collision detection benchmark,
+ * which fires small fast boxes at a thin wall with and without it.
+ */
+
+/**
+ * Runs the bullet scene at several sizes for the given number of steps
+ * with continuous collision detection off and on, and prints a table of
+ * how many bullets passed through the wall and what each step cost.
+ * Then times the free bodies scene, where no body is swept, to show the
+ * cost to bodies that do not use it.
+ */
+void RunCCDBench(unsigned steps);
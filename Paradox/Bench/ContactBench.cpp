@@ -0,0 +1,110 @@
+#include "ContactBench.h"
+#include "BenchScenes.h"
+#include <cstdio>
+#include <vector>
+
+static const double stepDuration = 1.0 / 60.0;
+
+// Steps of the growing run before allocations are counted, by when
+// the arena has grown to fit
+static const unsigned growthSteps = 30;
+
+// What one run of a scene did
+struct ContactRun
+{
+	unsigned bodyCount;
+	unsigned long long contacts;
+	unsigned mostContacts;
+	unsigned capacity;
+	unsigned long long regenerated;
+	unsigned long long overflows;
+	unsigned long long dropped;
+	unsigned long long allocations;
+	unsigned long long hash;
+};
+
+// Runs the scene with the arena shrunk to the given room first, and
+// the given limit on contacts if it is not zero
+static ContactRun RunScene(const BenchSceneDesc& desc, unsigned steps, unsigned room, unsigned limit)
+{
+	std::unique_ptr<BenchScene> scene = desc.create(desc.defaultSize);
+	World* world = scene->world.get();
+	world->SetDeterministic(true);
+	if (room) world->ShrinkContacts(room);
+	world->SetContactLimit(limit);
+
+	ContactRun run = ContactRun();
+	for (unsigned step = 0; step < steps; step++)
+	{
+		unsigned long long allocationsBefore = GetAllocationCount();
+		scene->Step(stepDuration);
+		if (step >= growthSteps) run.allocations += GetAllocationCount() - allocationsBefore;
+
+		const WorldStats& stats = world->GetStats();
+		run.contacts += stats.contactsGenerated;
+		if (stats.contactsGenerated > run.mostContacts) run.mostContacts = stats.contactsGenerated;
+		run.regenerated += stats.contactsRegenerated;
+		run.overflows += stats.contactOverflows;
+		run.dropped += stats.contactsDropped;
+	}
+
+	// The counters of the generators add up to the world's, scenes with
+	// nothing to collide with do not add their generator
+	std::vector<const ContactGenerator*> generators(1, &scene->generator);
+	for (const std::unique_ptr<Joint>& joint : scene->joints) generators.push_back(joint.get());
+
+	unsigned long long generated = 0, regenerated = 0, dropped = 0;
+	for (const ContactGenerator* generator : generators)
+	{
+		const ContactGeneratorStats* generatorStats = world->GetContactGeneratorStats(generator);
+		if (!generatorStats) continue;
+		generated += generatorStats->generated;
+		regenerated += generatorStats->regenerated;
+		dropped += generatorStats->dropped;
+	}
+	if (generated != run.contacts || regenerated != run.regenerated || dropped != run.dropped)
+	{
+		printf("%s: generator counters do not add up to the steps'\n", desc.name);
+	}
+
+	run.bodyCount = world->GetBodyCount();
+	run.capacity = world->GetContactCapacity();
+	run.hash = world->HashState();
+	return run;
+}
+
+static void PrintRun(const BenchSceneDesc& desc, const char* name, const ContactRun& run, unsigned steps,
+	const char* matched)
+{
+	unsigned countedSteps = steps > growthSteps ? steps - growthSteps : 1;
+	printf("%-14s %8u %-8s %10.1f %8u %10u %8llu %9llu %10.1f %12.2f %8s\n", desc.name, run.bodyCount, name,
+		(double)run.contacts / steps, run.mostContacts, run.capacity, run.regenerated, run.overflows,
+		(double)run.dropped / steps, (double)run.allocations / countedSteps, matched);
+}
+
+bool RunContactBench(unsigned steps)
+{
+	printf("%-14s %8s %-8s %10s %8s %10s %8s %9s %10s %12s %8s\n", "scene", "bodies", "room", "contacts",
+		"most", "capacity", "reruns", "overflows", "dropped", "allocs/step", "matched");
+
+	bool passed = true;
+	for (const BenchSceneDesc* desc = GetBenchScenes(); desc->name; desc++)
+	{
+		ContactRun given = RunScene(*desc, steps, 0, 0);
+		ContactRun grown = RunScene(*desc, steps, 1, 0);
+
+		// The limit is below what the scene needs, unless it has no contacts
+		unsigned limit = given.mostContacts / 4 > 0 ? given.mostContacts / 4 : 1;
+		ContactRun limited = RunScene(*desc, steps, limit, limit);
+
+		bool matched = grown.hash == given.hash && grown.contacts == given.contacts;
+		passed = matched && passed;
+
+		PrintRun(*desc, "given", given, steps, "-");
+		PrintRun(*desc, "grown", grown, steps, matched ? "yes" : "NO");
+		PrintRun(*desc, "limited", limited, steps, "-");
+	}
+
+	printf(passed ? "every grown run matched\n" : "grown runs diverged\n");
+	return passed;
+}
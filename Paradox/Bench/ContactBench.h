@@ -0,0 +1,22 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the contact storage benchmark, which checks that
+ * the world's contact arena grows to fit the contacts of a step
+ * without changing the simulation, and reports what a limit drops.
+ */
+
+/**
+ * Runs each scene in deterministic mode for the given number of steps
+ * three times: with the room for contacts the scene gives its' world,
+ * with room for a single contact to start with, and with a limit of
+ * a quarter of the contacts the first run needed. Prints the contacts
+ * per step, the room the arena grew to, the times generators were run
+ * again, the steps that overflowed the limit and the contacts per step
+ * they dropped, the allocations per step once the room has grown, and
+ * whether the growing run ended where the first did. Returns true if
+ * every growing run matched.
+ */
+bool RunContactBench(unsigned steps);
@@ -0,0 +1,343 @@
+#include "ConvexBench.h"
+#include "../Physics/ConvexHull.h"
+#include "../Physics/GJK.h"
+#include "../Physics/Random.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// Seed shared by every set of pairs so runs are repeatable
+static const unsigned pairSeed = 1357;
+
+// Random pairs each kind of check is run on
+static const unsigned checkPairs = 20000;
+
+// Pairs of shapes moved together in the timed runs
+static const unsigned movingPairs = 1000;
+
+// How far apart the shapes of a pair wander, for their sizes
+static const double pairRange = 1.5;
+
+// Points in the cloud the hull of the mixed pairs is built from
+static const unsigned cloudSize = 24;
+
+// Vertex counts hull pairs are timed at
+static const unsigned hullSizes[] = { 8, 16, 32, 64 };
+
+// Times each hull is built to time quickhull
+static const unsigned hullBuilds = 200;
+
+static double SecondsSince(const std::chrono::steady_clock::time_point& start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Places the body at the given position and orientation
+static void PlaceBody(RigidBody* body, const Vector3& position, const Quaternion& orientation)
+{
+	body->SetPosition(position);
+	body->SetOrientation(orientation);
+	body->CalculateDerivedData();
+}
+
+// How closely GJK agreed with CollisionDetector for one kind of pair
+struct CheckResult
+{
+	unsigned contacts;
+
+	// Pairs only one of the two found a contact for, past the tolerance
+	unsigned mismatches;
+
+	double maxError;
+};
+
+// Adds the depths found for one pair to the result
+static void CompareDepths(CheckResult* result, unsigned expectedCount, double expected, const GJKResult& found)
+{
+	// Grazing contacts may go either way
+	static const double tolerance = 1e-6;
+
+	bool foundContact = found.distance < 0;
+	if (expectedCount && foundContact)
+	{
+		result->contacts++;
+		double error = fabs(expected + found.distance);
+		if (error > result->maxError) result->maxError = error;
+	}
+	else if (expectedCount && expected > tolerance) result->mismatches++;
+	else if (foundContact && -found.distance > tolerance) result->mismatches++;
+}
+
+static void PrintCheck(const char* pair, const CheckResult& result)
+{
+	printf("%-16s %10u %10u %12.2e\n", pair, result.contacts, result.mismatches, result.maxError);
+}
+
+// Checks random sphere and box pairs against CollisionDetector
+static void CheckAgainstDetector()
+{
+	Random random(pairSeed);
+	RigidBody bodyOne, bodyTwo;
+	Contact contacts[16];
+	CollisionData data;
+	data.contactArray = contacts;
+	data.friction = 0;
+	data.restitution = 0;
+	data.tolerance = 0;
+
+	CheckResult spheres = {}, boxSpheres = {}, boxes = {};
+	for (unsigned i = 0; i < checkPairs; i++)
+	{
+		PlaceBody(&bodyOne, Vector3(), random.randomQuaternion());
+		PlaceBody(&bodyTwo, random.randomVector(2.0), random.randomQuaternion());
+
+		CollisionSphere sphereOne, sphereTwo;
+		sphereOne.body = &bodyOne;
+		sphereOne.radius = random.randomDouble(0.2, 1.0);
+		sphereTwo.body = &bodyTwo;
+		sphereTwo.radius = random.randomDouble(0.2, 1.0);
+		sphereOne.CalculateInternals();
+		sphereTwo.CalculateInternals();
+
+		CollisionBox boxOne, boxTwo;
+		boxOne.body = &bodyOne;
+		boxOne.halfSize = random.randomVector(Vector3(0.2, 0.2, 0.2), Vector3(1, 1, 1));
+		boxTwo.body = &bodyTwo;
+		boxTwo.halfSize = random.randomVector(Vector3(0.2, 0.2, 0.2), Vector3(1, 1, 1));
+		boxOne.CalculateInternals();
+		boxTwo.CalculateInternals();
+
+		GJKResult result;
+
+		data.Reset(16);
+		unsigned count = CollisionDetector::SphereAndSphere(sphereOne, sphereTwo, &data);
+		GJKSolver::Query(MakeSupportShape(sphereOne), MakeSupportShape(sphereTwo), &result);
+		CompareDepths(&spheres, count, count ? contacts[0].penetration : 0, result);
+
+		// The box test needs the sphere's centre outside the box
+		Vector3 centre = boxOne.GetTransform().transformInverse(sphereTwo.GetAxis(3));
+		if (fabs(centre.x) > boxOne.halfSize.x || fabs(centre.y) > boxOne.halfSize.y ||
+			fabs(centre.z) > boxOne.halfSize.z)
+		{
+			data.Reset(16);
+			count = CollisionDetector::BoxAndSphere(boxOne, sphereTwo, &data);
+			GJKSolver::Query(MakeSupportShape(boxOne), MakeSupportShape(sphereTwo), &result);
+			CompareDepths(&boxSpheres, count, count ? contacts[0].penetration : 0, result);
+		}
+
+		// Box pairs give one contact, at the depth of the axis they are
+		// parted along most easily
+		data.Reset(16);
+		count = CollisionDetector::BoxAndBox(boxOne, boxTwo, &data);
+		GJKSolver::Query(MakeSupportShape(boxOne), MakeSupportShape(boxTwo), &result);
+		CompareDepths(&boxes, count, count ? contacts[0].penetration : 0, result);
+	}
+
+	printf("%-16s %10s %10s %12s\n", "check", "contacts", "mismatch", "max error");
+	PrintCheck("sphere_sphere", spheres);
+	PrintCheck("box_sphere", boxSpheres);
+	PrintCheck("box_box", boxes);
+	printf("\n");
+}
+
+// The kinds of pair the timed runs move about
+enum class ConvexPairType
+{
+	BoxBox,
+	CapsuleBox,
+	CylinderBox,
+	HullBox,
+	HullHull
+};
+
+struct ConvexPairDesc
+{
+	const char* name;
+	ConvexPairType type;
+};
+
+static const ConvexPairDesc convexPairs[] =
+{
+	{ "box_box", ConvexPairType::BoxBox },
+	{ "capsule_box", ConvexPairType::CapsuleBox },
+	{ "cylinder_box", ConvexPairType::CylinderBox },
+	{ "hull_box", ConvexPairType::HullBox },
+	{ "hull_hull", ConvexPairType::HullHull },
+};
+
+/**
+ * A pair of shapes turning and drifting about each other, a little
+ * each step, as a pair of touching bodies would.
+ */
+struct MovingPair
+{
+	Vector3 position;
+	Quaternion orientationOne;
+	Quaternion orientationTwo;
+	Vector3 velocity;
+	Vector3 spinOne;
+	Vector3 spinTwo;
+
+	double sizeOne;
+	double sizeTwo;
+};
+
+// Makes the shape of the given kind for one side of a pair. Hulls are
+// searched by climbing, or by testing every vertex if not asked to
+static SupportShape MakePairShape(ConvexPairType type, bool second, double size, const Matrix4& transform,
+	const ConvexHull& hull, bool climb)
+{
+	if (type == ConvexPairType::HullHull || (type == ConvexPairType::HullBox && !second))
+	{
+		if (climb) return MakeHullShape(NULL, transform, &hull);
+		return MakePointsShape(NULL, transform, hull.GetVertices(), hull.GetVertexCount());
+	}
+	if (second) return MakeBoxShape(NULL, transform, Vector3(size, size * 0.8, size * 0.6));
+
+	if (type == ConvexPairType::CapsuleBox) return MakeCapsuleShape(NULL, transform, size * 0.5, size);
+	if (type == ConvexPairType::CylinderBox) return MakeCylinderShape(NULL, transform, size * 0.6, size);
+	return MakeBoxShape(NULL, transform, Vector3(size * 0.6, size, size * 0.8));
+}
+
+// What a timed run measured
+struct ConvexRunResult
+{
+	double time;
+	unsigned long long iterations;
+	unsigned long long epaIterations;
+	unsigned long long touching;
+};
+
+// Moves the pairs for the given number of steps, querying each one
+// every step, warm started from the last step if asked
+static ConvexRunResult RunPairs(ConvexPairType type, std::vector<MovingPair> pairs, unsigned steps,
+	bool warmStart, const ConvexHull& hull, bool climb)
+{
+	static const double stepDuration = 1.0 / 60.0;
+
+	GJKPairCache caches;
+	ConvexRunResult run = {};
+	double elapsed = 0;
+	for (unsigned step = 0; step < steps; step++)
+	{
+		for (MovingPair& pair : pairs)
+		{
+			pair.position.addScaledVector(pair.velocity, stepDuration);
+
+			// Keep the pair close enough to touch now and then
+			for (unsigned axis = 0; axis < 3; axis++)
+			{
+				if (fabs(pair.position[axis]) > pairRange * (pair.sizeOne + pair.sizeTwo))
+				{
+					pair.velocity[axis] = -pair.velocity[axis];
+				}
+			}
+
+			pair.orientationOne.AddScaledVector(pair.spinOne, stepDuration);
+			pair.orientationOne.Normalize();
+			pair.orientationTwo.AddScaledVector(pair.spinTwo, stepDuration);
+			pair.orientationTwo.Normalize();
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		caches.BeginFrame();
+		for (MovingPair& pair : pairs)
+		{
+			Matrix4 transformOne, transformTwo;
+			transformOne.setOrientationAndPos(pair.orientationOne, Vector3());
+			transformTwo.setOrientationAndPos(pair.orientationTwo, pair.position);
+
+			SupportShape one = MakePairShape(type, false, pair.sizeOne, transformOne, hull, climb);
+			SupportShape two = MakePairShape(type, true, pair.sizeTwo, transformTwo, hull, climb);
+
+			GJKResult result;
+			GJKCache* cache = warmStart ? &caches.Get(&pair.orientationOne, &pair.orientationTwo) : NULL;
+			GJKSolver::Query(one, two, &result, cache);
+			run.iterations += result.iterations;
+			run.epaIterations += result.epaIterations;
+			if (result.distance < 0) run.touching++;
+		}
+		caches.EndFrame();
+		elapsed += SecondsSince(start);
+	}
+
+	run.time = elapsed;
+	return run;
+}
+
+static void PrintRun(const char* pair, const char* mode, const ConvexRunResult& run, double queries)
+{
+	printf("%-14s %-6s %10.1f %10.2f %10.2f %10.1f\n", pair, mode, run.time * 1e9 / queries,
+		run.iterations / queries, run.epaIterations / queries, 100.0 * run.touching / queries);
+}
+
+void RunConvexBench(unsigned steps)
+{
+	CheckAgainstDetector();
+
+	Random random(pairSeed);
+
+	// A rough ball of points, most of which end up on the hull
+	std::vector<Vector3> cloud;
+	for (unsigned i = 0; i < cloudSize; i++)
+	{
+		Vector3 point = random.randomVector(1.0);
+		point.normalise();
+		cloud.push_back(point * random.randomDouble(0.8, 1.0));
+	}
+	ConvexHull hull;
+	hull.Build(cloud.data(), cloudSize);
+
+	std::vector<MovingPair> pairs(movingPairs);
+	for (MovingPair& pair : pairs)
+	{
+		pair.sizeOne = random.randomDouble(0.5, 1.0);
+		pair.sizeTwo = random.randomDouble(0.5, 1.0);
+		pair.position = random.randomVector(pairRange * (pair.sizeOne + pair.sizeTwo));
+		pair.orientationOne = random.randomQuaternion();
+		pair.orientationTwo = random.randomQuaternion();
+		pair.velocity = random.randomVector(0.5);
+		pair.spinOne = random.randomVector(1.0);
+		pair.spinTwo = random.randomVector(1.0);
+	}
+
+	printf("%-14s %-6s %10s %10s %10s %10s\n", "pair", "start", "ns/query", "gjk iters", "epa iters", "touching %");
+
+	double queries = (double)steps * movingPairs;
+	for (const ConvexPairDesc& desc : convexPairs)
+	{
+		PrintRun(desc.name, "cold", RunPairs(desc.type, pairs, steps, false, hull, true), queries);
+		PrintRun(desc.name, "warm", RunPairs(desc.type, pairs, steps, true, hull, true), queries);
+	}
+
+	// Hulls of points on a sphere, so that every point is a vertex,
+	// searched as plain points and as hulls
+	printf("\n%-14s %10s %10s %12s %12s %12s %12s\n", "hull_hull", "vertices", "build us",
+		"points ns", "points warm", "hull ns", "hull warm");
+
+	for (unsigned size : hullSizes)
+	{
+		std::vector<Vector3> points;
+		for (unsigned i = 0; i < size; i++)
+		{
+			Vector3 point = random.randomVector(1.0);
+			point.normalise();
+			points.push_back(point);
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		ConvexHull sized;
+		for (unsigned i = 0; i < hullBuilds; i++) sized.Build(points.data(), size);
+		double buildTime = SecondsSince(start) * 1e6 / hullBuilds;
+
+		ConvexRunResult plain = RunPairs(ConvexPairType::HullHull, pairs, steps, false, sized, false);
+		ConvexRunResult plainWarm = RunPairs(ConvexPairType::HullHull, pairs, steps, true, sized, false);
+		ConvexRunResult climbed = RunPairs(ConvexPairType::HullHull, pairs, steps, false, sized, true);
+		ConvexRunResult climbedWarm = RunPairs(ConvexPairType::HullHull, pairs, steps, true, sized, true);
+
+		printf("%-14u %10u %10.1f %12.1f %12.1f %12.1f %12.1f\n", size, sized.GetVertexCount(), buildTime,
+			plain.time * 1e9 / queries, plainWarm.time * 1e9 / queries,
+			climbed.time * 1e9 / queries, climbedWarm.time * 1e9 / queries);
+	}
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the convex narrowphase benchmark, which checks
+ * GJK and EPA against the box and sphere tests of CollisionDetector,
+ * then times them on pairs of moving convex shapes with and without
+ * their simplex cache.
+ */
+
+/**
+ * Checks the penetration GJK finds against CollisionDetector for
+ * random sphere and box pairs, then moves pairs of each kind of
+ * shape for the given number of steps and prints a table of results.
+ */
+void RunConvexBench(unsigned steps);
@@ -0,0 +1,76 @@
+#include "GenerateBench.h"
+#include "BenchScenes.h"
+#include <cstdio>
+#include <thread>
+
+static const double stepDuration = 1.0 / 60.0;
+
+// Steps run before timing, so that the scenes have settled into piles
+static const unsigned settleSteps = 30;
+
+static const unsigned threadCounts[] = { 1, 2, 4, 8 };
+
+// A scene large enough to have tens of thousands of pairs
+struct GenerateScene
+{
+	std::unique_ptr<BenchScene> (*create)(unsigned size);
+	unsigned size;
+};
+
+bool RunGenerateBench(unsigned steps)
+{
+	const GenerateScene scenes[] =
+	{
+		{ CreateSpherePileScene, 16 },
+		{ CreateBoxStackScene, 20 },
+		{ CreateConvexPileScene, 12 }
+	};
+
+	printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+	printf("%-14s %8s %8s %10s %10s %12s %8s %8s\n", "scene", "bodies", "threads", "pairs", "contacts",
+		"generate ms", "speedup", "matched");
+
+	bool matched = true;
+	for (const GenerateScene& desc : scenes)
+	{
+		double oneThreadTime = 0;
+		unsigned long long oneThreadHash = 0;
+		for (unsigned threads : threadCounts)
+		{
+			std::unique_ptr<BenchScene> scene = desc.create(desc.size);
+			World* world = scene->world.get();
+			world->SetDeterministic(true);
+			world->SetBroadphase(BroadphaseType::DynamicTree);
+			world->SetThreadCount(threads);
+
+			for (unsigned step = 0; step < settleSteps; step++) scene->Step(stepDuration);
+
+			double generateTime = 0;
+			unsigned long long pairs = 0, contacts = 0;
+			for (unsigned step = 0; step < steps; step++)
+			{
+				scene->Step(stepDuration);
+				const WorldStats& stats = world->GetStats();
+				generateTime += stats.generateTime;
+				pairs += stats.potentialContacts;
+				contacts += stats.contactsGenerated;
+			}
+
+			unsigned long long hash = world->HashState();
+			if (threads == 1)
+			{
+				oneThreadTime = generateTime;
+				oneThreadHash = hash;
+			}
+			bool same = hash == oneThreadHash;
+			matched = same && matched;
+
+			printf("%-14s %8u %8u %10.1f %10.1f %12.3f %8.2f %8s\n", scene->name.c_str(), world->GetBodyCount(),
+				world->GetThreadCount(), (double)pairs / steps, (double)contacts / steps, generateTime * 1e3 / steps,
+				generateTime > 0 ? oneThreadTime / generateTime : 0.0, same ? "yes" : "NO");
+		}
+	}
+
+	printf(matched ? "every thread count matched\n" : "thread counts diverged\n");
+	return matched;
+}
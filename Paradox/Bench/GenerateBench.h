@@ -0,0 +1,19 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the contact generation benchmark, which times
+ * the narrowphase over the broadphase's pairs on the world's workers
+ * and checks that the contacts do not depend on the thread count.
+ */
+
+/**
+ * Runs large sphere pile, box stack and convex pile scenes with the
+ * dynamic tree broadphase, with one, two, four and eight threads, for
+ * the given number of steps each. Prints the pairs and contacts per
+ * step, the time spent generating contacts and its' speedup over one
+ * thread, and whether the state after the run matches one thread's.
+ * Returns true if every run matched.
+ */
+bool RunGenerateBench(unsigned steps);
@@ -0,0 +1,95 @@
+#include "LockstepBench.h"
+#include "BenchScenes.h"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+static const double stepDuration = 1.0 / 60.0;
+
+// Threads the threaded runs resolve islands on
+static const unsigned lockstepThreads = 4;
+
+// Times each world's state is hashed to time hashing
+static const unsigned hashRounds = 100;
+
+static double SecondsSince(const std::chrono::steady_clock::time_point& start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// One way of running a scene that must give the same hashes as the others
+struct LockstepRun
+{
+	const char* name;
+	IntegratorPath path;
+	unsigned threads;
+};
+
+// Runs the scene the given way, returning the hash after every step
+static std::vector<unsigned long long> RunHashes(const BenchSceneDesc& desc, unsigned size,
+	const LockstepRun& run, unsigned steps, unsigned* bodyCount, double* hashTime)
+{
+	std::unique_ptr<BenchScene> scene = desc.create(size);
+	scene->world->SetDeterministic(true);
+	scene->world->SetIntegratorPath(run.path);
+	scene->world->SetThreadCount(run.threads);
+
+	std::vector<unsigned long long> hashes;
+	for (unsigned step = 0; step < steps; step++)
+	{
+		scene->Step(stepDuration);
+		hashes.push_back(scene->world->GetStats().stateHash);
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	unsigned long long hash = 0;
+	for (unsigned round = 0; round < hashRounds; round++) hash ^= scene->world->HashState();
+	*hashTime = SecondsSince(start) / hashRounds;
+	*bodyCount = scene->world->GetBodyCount();
+
+	// Keep the hashing from being optimised away
+	if (hash == 1) printf(" ");
+	return hashes;
+}
+
+bool RunLockstepBench(unsigned steps, unsigned size)
+{
+	const LockstepRun runs[] =
+	{
+		{ "scalar", IntegratorPath::Scalar, 1 },
+		{ "repeat", IntegratorPath::Scalar, 1 },
+		{ "threads", IntegratorPath::Scalar, lockstepThreads },
+		{ GetIntegratorPathName(GetBestIntegratorPath()), GetBestIntegratorPath(), 1 },
+		{ "widest+mt", GetBestIntegratorPath(), lockstepThreads }
+	};
+
+	printf("%-14s %8s %-10s %18s %10s %10s\n", "scene", "bodies", "run", "final hash", "diverged", "hash us");
+
+	bool matched = true;
+	for (const BenchSceneDesc* desc = GetBenchScenes(); desc->name; desc++)
+	{
+		unsigned sceneSize = size ? size : desc->defaultSize;
+		std::vector<unsigned long long> reference;
+		for (const LockstepRun& run : runs)
+		{
+			unsigned bodyCount;
+			double hashTime;
+			std::vector<unsigned long long> hashes = RunHashes(*desc, sceneSize, run, steps, &bodyCount, &hashTime);
+			if (reference.empty()) reference = hashes;
+
+			// The first step whose hash differs from the first run's
+			unsigned diverged = 0;
+			while (diverged < steps && hashes[diverged] == reference[diverged]) diverged++;
+			if (diverged < steps) matched = false;
+
+			char divergedText[16] = "-";
+			if (diverged < steps) snprintf(divergedText, sizeof(divergedText), "%u", diverged + 1);
+
+			printf("%-14s %8u %-10s %18llx %10s %10.2f\n", desc->name, bodyCount, run.name,
+				hashes.back(), divergedText, hashTime * 1e6);
+		}
+	}
+
+	printf(matched ? "every run matched\n" : "runs diverged\n");
+	return matched;
+}
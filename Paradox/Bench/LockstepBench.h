@@ -0,0 +1,19 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the lockstep check, which runs every scene in
+ * deterministic mode several ways and compares the state hash the
+ * world records at each step.
+ */
+
+/**
+ * Runs each bench scene at the given size, or its' default size if
+ * zero, for the given number of steps in deterministic mode: twice on
+ * the scalar path with one thread, then with several threads, then on
+ * the widest path the processor has. Prints the step each run first
+ * differed from the first run at, if any, and how long hashing takes.
+ * Returns true if every run matched.
+ */
+bool RunLockstepBench(unsigned steps, unsigned size);
@@ -0,0 +1,574 @@
+#include "MeshBench.h"
+#include "../Physics/CollideFine.h"
+#include "../Physics/Heightfield.h"
+#include "../Physics/Random.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "../include/tiny_obj_loader.h"
+
+// Seed shared by every set of queries so runs are repeatable
+static const unsigned querySeed = 2468;
+
+// Samples along each side of the checked terrain
+static const unsigned checkSide = 48;
+
+// Queries of each kind the checks make
+static const unsigned checkQueries = 5000;
+
+// Samples along each side of the timed terrain, two triangles a cell
+// makes just under a million triangles
+static const unsigned terrainSide = 708;
+
+// Triangles in the timed soup, and the size of the cube they fill
+static const unsigned soupTriangles = 1000000;
+static const double soupSize = 400.0;
+
+// Queries of each kind the timed runs make
+static const unsigned timedQueries = 100000;
+
+// The room a contact query is given
+static const unsigned maxContacts = 256;
+
+static double SecondsSince(const std::chrono::steady_clock::time_point& start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * A vertex laid out as the renderer's are, with the position first and
+ * other attributes after it, so meshes are built from strided data as
+ * they would be from a loaded Model.
+ */
+struct InterleavedVertex
+{
+	float position[3];
+	float uv[2];
+	float normal[3];
+};
+
+// Rolling ground, a few waves across the terrain
+static double TerrainHeight(double x, double z)
+{
+	return 4.0 * sin(x * 0.05) * cos(z * 0.07) + 1.5 * sin(x * 0.23 + z * 0.31) + 0.3 * cos(x * 1.7 - z * 1.3);
+}
+
+// Fills in the heights of a terrain with the given number of samples a side
+static std::vector<double> MakeTerrain(unsigned side, double spacing)
+{
+	std::vector<double> heights(side * side);
+	for (unsigned row = 0; row < side; row++)
+	{
+		for (unsigned column = 0; column < side; column++)
+		{
+			heights[row * side + column] = TerrainHeight(column * spacing, row * spacing);
+		}
+	}
+	return heights;
+}
+
+// Builds a mesh of the same triangles as the heightfield, from
+// interleaved vertices
+static void BuildMeshOfField(const Heightfield& field, TriangleMesh* mesh)
+{
+	unsigned columns = field.GetColumns(), rows = field.GetRows();
+	std::vector<InterleavedVertex> vertices(columns * rows);
+	for (unsigned row = 0; row < rows; row++)
+	{
+		for (unsigned column = 0; column < columns; column++)
+		{
+			Vector3 point = field.GetPoint(column, row);
+			InterleavedVertex& vertex = vertices[row * columns + column];
+			vertex.position[0] = (float)point.x;
+			vertex.position[1] = (float)point.y;
+			vertex.position[2] = (float)point.z;
+		}
+	}
+
+	std::vector<uint32_t> indices;
+	indices.reserve(3 * field.GetTriangleCount());
+	for (unsigned row = 0; row + 1 < rows; row++)
+	{
+		for (unsigned column = 0; column + 1 < columns; column++)
+		{
+			uint32_t corner = row * columns + column;
+			uint32_t quad[6] = { corner, corner + columns + 1, corner + 1, corner, corner + columns, corner + columns + 1 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+
+	mesh->Build(vertices[0].position, sizeof(InterleavedVertex), (unsigned)vertices.size(),
+		indices.data(), (unsigned)indices.size());
+}
+
+// Builds a heightfield whose samples are exactly the floats a mesh of
+// it would hold, so the two can be compared exactly
+static void BuildFloatField(unsigned side, double spacing, Heightfield* field)
+{
+	std::vector<double> heights = MakeTerrain(side, spacing);
+	for (double& height : heights) height = (float)height;
+	field->Build(heights.data(), side, side, spacing, spacing, Vector3());
+}
+
+// The triangles of a collider, in the order of their numbers, for the
+// checks to test one by one
+struct TriangleList
+{
+	std::vector<Vector3> corners;
+
+	unsigned GetCount() const
+	{
+		return (unsigned)corners.size() / 3;
+	}
+};
+
+static TriangleList ListTriangles(const Heightfield& field)
+{
+	TriangleList list;
+	list.corners.resize(3 * field.GetTriangleCount());
+	for (unsigned triangle = 0; triangle < field.GetTriangleCount(); triangle++)
+	{
+		field.GetTriangle(triangle, &list.corners[3 * triangle]);
+	}
+	return list;
+}
+
+// Places the body at the given position and orientation
+static void PlaceBody(RigidBody* body, const Vector3& position, const Quaternion& orientation)
+{
+	body->SetPosition(position);
+	body->SetOrientation(orientation);
+	body->CalculateDerivedData();
+}
+
+// The three primitives a contact query is made with, on one body
+struct QueryPrimitives
+{
+	RigidBody body;
+	CollisionSphere sphere;
+	CollisionBox box;
+	CollisionCapsule capsule;
+
+	QueryPrimitives()
+	{
+		sphere.body = &body;
+		box.body = &body;
+		capsule.body = &body;
+	}
+
+	// Moves the body and sizes the primitives at random
+	void Place(Random& random, const Vector3& position)
+	{
+		PlaceBody(&body, position, random.randomQuaternion());
+
+		sphere.radius = random.randomDouble(0.3, 1.5);
+		box.halfSize = random.randomVector(Vector3(0.3, 0.3, 0.3), Vector3(1.5, 1.5, 1.5));
+		capsule.radius = random.randomDouble(0.2, 0.8);
+		capsule.halfHeight = random.randomDouble(0.3, 1.5);
+
+		sphere.CalculateInternals();
+		box.CalculateInternals();
+		capsule.CalculateInternals();
+	}
+};
+
+static CollisionData MakeCollisionData(Contact* contacts)
+{
+	CollisionData data;
+	data.contactArray = contacts;
+	data.friction = 0;
+	data.restitution = 0;
+	data.tolerance = 0;
+	data.Reset(maxContacts);
+	return data;
+}
+
+// Sums the penetrations of the contacts found, for comparing two ways
+// of finding the same contacts
+static double SumPenetration(const CollisionData& data)
+{
+	double sum = 0;
+	for (unsigned i = 0; i < data.contactCount; i++) sum += data.contactArray[i].penetration;
+	return sum;
+}
+
+// How closely a collider agreed with testing every triangle
+struct MeshCheckResult
+{
+	unsigned queries;
+	unsigned hits;
+	unsigned mismatches;
+};
+
+static void PrintCheck(const char* name, const MeshCheckResult& result)
+{
+	printf("%-22s %10u %10u %10u\n", name, result.queries, result.hits, result.mismatches);
+}
+
+// Casts the ray at every triangle in the list, returning the distance
+// to the nearest or a negative value if it meets none
+static double CastAtEveryTriangle(const TriangleList& list, const Vector3& origin, const Vector3& direction, double length)
+{
+	double nearest = -1;
+	for (unsigned triangle = 0; triangle < list.GetCount(); triangle++)
+	{
+		double distance;
+		const Vector3* corners = &list.corners[3 * triangle];
+		if (RayHitsTriangle(origin, direction, nearest < 0 ? length : nearest,
+			corners[0], corners[1], corners[2], &distance)) nearest = distance;
+	}
+	return nearest;
+}
+
+// Adds one ray's result to the check, the hits agreeing if they are
+// at the same distance
+static void CompareRay(MeshCheckResult* result, double expected, bool found, const TriangleRayHit& hit)
+{
+	result->queries++;
+	if (found) result->hits++;
+
+	if ((expected >= 0) != found) result->mismatches++;
+	else if (found && fabs(expected - hit.distance) > 1e-9) result->mismatches++;
+}
+
+// Adds one contact query's result to the check, the contacts agreeing
+// if there are as many and they are as deep
+static void CompareContacts(MeshCheckResult* result, const CollisionData& expected, const CollisionData& found)
+{
+	result->queries++;
+	if (found.contactCount > 0) result->hits++;
+
+	if (expected.contactCount != found.contactCount ||
+		fabs(SumPenetration(expected) - SumPenetration(found)) > 1e-9) result->mismatches++;
+}
+
+/**
+ * Checks ray casts and contacts of a terrain built as a mesh and as a
+ * heightfield against testing every one of its' triangles, two sided
+ * for the mesh and one sided for the heightfield.
+ */
+static void CheckAgainstEveryTriangle()
+{
+	static const double spacing = 1.0;
+
+	Heightfield field;
+	BuildFloatField(checkSide, spacing, &field);
+	TriangleMesh mesh;
+	BuildMeshOfField(field, &mesh);
+	TriangleList list = ListTriangles(field);
+
+	Random random(querySeed);
+	double extent = (checkSide - 1) * spacing;
+
+	MeshCheckResult meshRays = {}, fieldRays = {};
+	for (unsigned i = 0; i < checkQueries; i++)
+	{
+		// Rays from inside and outside the terrain, some running level
+		Vector3 origin = random.randomVector(Vector3(-5, -8, -5), Vector3(extent + 5, 12, extent + 5));
+		Vector3 direction = random.randomVector(1.0);
+		if (i % 8 == 0) direction.y = 0;
+		if (direction.squareMagnitude() == 0) continue;
+		direction.normalise();
+		double length = random.randomDouble(1, extent * 2);
+
+		double expected = CastAtEveryTriangle(list, origin, direction, length);
+
+		TriangleRayHit hit;
+		bool found = mesh.RayCast(origin, direction, length, &hit);
+		CompareRay(&meshRays, expected, found, hit);
+
+		found = field.RayCast(origin, direction, length, &hit);
+		CompareRay(&fieldRays, expected, found, hit);
+	}
+
+	const Vector3 fieldUp(0, 1, 0);
+	Contact expectedContacts[maxContacts], foundContacts[maxContacts];
+	MeshCheckResult results[6] = {};
+	QueryPrimitives primitives;
+	for (unsigned i = 0; i < checkQueries; i++)
+	{
+		double x = random.randomDouble(-2, extent + 2);
+		double z = random.randomDouble(-2, extent + 2);
+		primitives.Place(random, Vector3(x, TerrainHeight(x, z) + random.randomDouble(-2, 2), z));
+
+		for (unsigned oneSided = 0; oneSided < 2; oneSided++)
+		{
+			for (unsigned shape = 0; shape < 3; shape++)
+			{
+				// The heightfield looks for what has sunk below it straight down
+				const Vector3* up = oneSided ? &fieldUp : NULL;
+				CollisionData expected = MakeCollisionData(expectedContacts);
+				for (unsigned triangle = 0; triangle < list.GetCount(); triangle++)
+				{
+					const Vector3* c = &list.corners[3 * triangle];
+					if (shape == 0) CollisionDetector::SphereAndTriangle(primitives.sphere, c[0], c[1], c[2], triangle, oneSided == 1, &expected, up);
+					if (shape == 1) CollisionDetector::BoxAndTriangle(primitives.box, c[0], c[1], c[2], triangle, oneSided == 1, &expected, up);
+					if (shape == 2) CollisionDetector::CapsuleAndTriangle(primitives.capsule, c[0], c[1], c[2], triangle, oneSided == 1, &expected, up);
+				}
+
+				CollisionData found = MakeCollisionData(foundContacts);
+				if (oneSided)
+				{
+					if (shape == 0) CollisionDetector::SphereAndHeightfield(primitives.sphere, field, &found);
+					if (shape == 1) CollisionDetector::BoxAndHeightfield(primitives.box, field, &found);
+					if (shape == 2) CollisionDetector::CapsuleAndHeightfield(primitives.capsule, field, &found);
+				}
+				else
+				{
+					if (shape == 0) CollisionDetector::SphereAndTriangleMesh(primitives.sphere, mesh, &found);
+					if (shape == 1) CollisionDetector::BoxAndTriangleMesh(primitives.box, mesh, &found);
+					if (shape == 2) CollisionDetector::CapsuleAndTriangleMesh(primitives.capsule, mesh, &found);
+				}
+				CompareContacts(&results[oneSided * 3 + shape], expected, found);
+			}
+		}
+	}
+
+	printf("%-22s %10s %10s %10s\n", "check", "queries", "hits", "mismatch");
+	PrintCheck("mesh_ray", meshRays);
+	PrintCheck("heightfield_ray", fieldRays);
+	PrintCheck("mesh_sphere", results[0]);
+	PrintCheck("mesh_box", results[1]);
+	PrintCheck("mesh_capsule", results[2]);
+	PrintCheck("heightfield_sphere", results[3]);
+	PrintCheck("heightfield_box", results[4]);
+	PrintCheck("heightfield_capsule", results[5]);
+	printf("\n");
+}
+
+// What a timed run of queries against one collider measured
+struct MeshRunResult
+{
+	unsigned triangles;
+	double buildTime;
+	double rayTime;
+	unsigned rayHits;
+	double contactTimes[3];
+	unsigned contacts[3];
+};
+
+static void PrintRun(const char* name, const MeshRunResult& run)
+{
+	printf("%-18s %10u %10.1f %10.0f %6.1f%% %12.0f %12.0f %12.0f %10.2f\n",
+		name,
+		run.triangles,
+		run.buildTime * 1000.0,
+		timedQueries / run.rayTime,
+		100.0 * run.rayHits / timedQueries,
+		timedQueries / run.contactTimes[0],
+		timedQueries / run.contactTimes[1],
+		timedQueries / run.contactTimes[2],
+		(double)(run.contacts[0] + run.contacts[1] + run.contacts[2]) / (3 * timedQueries));
+}
+
+// The queries a timed run makes, the same for every collider of a size
+struct TimedQueries
+{
+	std::vector<Vector3> rayOrigins;
+	std::vector<Vector3> rayDirections;
+	std::vector<Vector3> positions;
+};
+
+/**
+ * Makes rays looking down and across from above the given box, and
+ * places for bodies near the ground within it, found by the given
+ * function of x and z.
+ */
+template <class Ground>
+static TimedQueries MakeQueries(const BoundingBoxVolume& volume, Ground ground)
+{
+	Random random(querySeed);
+	TimedQueries queries;
+	Vector3 size = volume.max - volume.min;
+	for (unsigned i = 0; i < timedQueries; i++)
+	{
+		Vector3 origin = random.randomVector(volume.min, volume.max);
+		origin.y = volume.max.y + random.randomDouble(1, 10);
+		Vector3 direction = random.randomVector(Vector3(-1, -1, -1), Vector3(1, -0.1, 1));
+		direction.normalise();
+		queries.rayOrigins.push_back(origin);
+		queries.rayDirections.push_back(direction);
+
+		double x = volume.min.x + random.randomDouble(size.x);
+		double z = volume.min.z + random.randomDouble(size.z);
+		queries.positions.push_back(Vector3(x, ground(x, z) + random.randomDouble(-0.5, 1.5), z));
+	}
+	return queries;
+}
+
+// Runs one kind of contact query against a mesh or heightfield
+static unsigned Collide(const QueryPrimitives& body, unsigned shape, const TriangleMesh& mesh, CollisionData* data)
+{
+	if (shape == 0) return CollisionDetector::SphereAndTriangleMesh(body.sphere, mesh, data);
+	if (shape == 1) return CollisionDetector::BoxAndTriangleMesh(body.box, mesh, data);
+	return CollisionDetector::CapsuleAndTriangleMesh(body.capsule, mesh, data);
+}
+
+static unsigned Collide(const QueryPrimitives& body, unsigned shape, const Heightfield& field, CollisionData* data)
+{
+	if (shape == 0) return CollisionDetector::SphereAndHeightfield(body.sphere, field, data);
+	if (shape == 1) return CollisionDetector::BoxAndHeightfield(body.box, field, data);
+	return CollisionDetector::CapsuleAndHeightfield(body.capsule, field, data);
+}
+
+// Times the queries against a mesh or heightfield
+template <class Collider>
+static void RunQueries(const Collider& collider, const TimedQueries& queries, double rayLength, MeshRunResult* run)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	run->rayHits = 0;
+	for (unsigned i = 0; i < timedQueries; i++)
+	{
+		TriangleRayHit hit;
+		if (collider.RayCast(queries.rayOrigins[i], queries.rayDirections[i], rayLength, &hit)) run->rayHits++;
+	}
+	run->rayTime = SecondsSince(start);
+
+	// Place every body first, so only the contact tests are timed
+	Random random(querySeed);
+	std::vector<QueryPrimitives> bodies(timedQueries);
+	for (unsigned i = 0; i < timedQueries; i++) bodies[i].Place(random, queries.positions[i]);
+
+	Contact contacts[maxContacts];
+	for (unsigned shape = 0; shape < 3; shape++)
+	{
+		run->contacts[shape] = 0;
+		start = std::chrono::steady_clock::now();
+		for (unsigned i = 0; i < timedQueries; i++)
+		{
+			CollisionData data = MakeCollisionData(contacts);
+			run->contacts[shape] += Collide(bodies[i], shape, collider, &data);
+		}
+		run->contactTimes[shape] = SecondsSince(start);
+	}
+}
+
+// Scatters small triangles of random size and facing through a cube
+static void MakeSoup(std::vector<Vector3>& vertices, std::vector<uint32_t>& indices)
+{
+	Random random(querySeed);
+	for (unsigned triangle = 0; triangle < soupTriangles; triangle++)
+	{
+		Vector3 centre = random.randomVector(Vector3(), Vector3(soupSize, soupSize, soupSize));
+		for (unsigned corner = 0; corner < 3; corner++)
+		{
+			indices.push_back((uint32_t)vertices.size());
+			vertices.push_back(centre + random.randomVector(1.5));
+		}
+	}
+}
+
+/**
+ * Loads the OBJ file at the given path as the renderer's LoadModel
+ * does, with x and z swapped, into interleaved vertices. Returns false
+ * if it could not be read.
+ */
+static bool LoadObjFile(const char* path, std::vector<InterleavedVertex>& vertices, std::vector<uint32_t>& indices)
+{
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string err;
+	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, path)) return false;
+
+	vertices.resize(attrib.vertices.size() / 3);
+	for (unsigned i = 0; i < vertices.size(); i++)
+	{
+		vertices[i].position[0] = attrib.vertices[3 * i + 2];
+		vertices[i].position[1] = attrib.vertices[3 * i + 1];
+		vertices[i].position[2] = attrib.vertices[3 * i + 0];
+	}
+
+	for (const tinyobj::shape_t& shape : shapes)
+	{
+		for (const tinyobj::index_t& index : shape.mesh.indices) indices.push_back((uint32_t)index.vertex_index);
+	}
+	return !indices.empty();
+}
+
+void RunMeshBench(const char* objPath)
+{
+	CheckAgainstEveryTriangle();
+
+	printf("%-18s %10s %10s %10s %7s %12s %12s %12s %10s\n",
+		"collider", "triangles", "build ms", "rays/s", "hit", "spheres/s", "boxes/s", "capsules/s", "contacts");
+
+	static const double spacing = 0.5;
+	std::vector<double> heights = MakeTerrain(terrainSide, spacing);
+	auto terrain = [](double x, double z) { return TerrainHeight(x, z); };
+
+	MeshRunResult run = {};
+	Heightfield field;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	field.Build(heights.data(), terrainSide, terrainSide, spacing, spacing, Vector3());
+	run.buildTime = SecondsSince(start);
+	run.triangles = field.GetTriangleCount();
+
+	TimedQueries queries = MakeQueries(field.GetVolume(), terrain);
+	double rayLength = 1000.0;
+	RunQueries(field, queries, rayLength, &run);
+	PrintRun("terrain_field", run);
+
+	{
+		TriangleMesh mesh;
+		start = std::chrono::steady_clock::now();
+		BuildMeshOfField(field, &mesh);
+		run.buildTime = SecondsSince(start);
+		run.triangles = mesh.GetTriangleCount();
+		RunQueries(mesh, queries, rayLength, &run);
+		PrintRun("terrain_mesh", run);
+	}
+
+	{
+		std::vector<Vector3> vertices;
+		std::vector<uint32_t> indices;
+		MakeSoup(vertices, indices);
+
+		TriangleMesh mesh;
+		start = std::chrono::steady_clock::now();
+		mesh.Build(vertices.data(), (unsigned)vertices.size(), indices.data(), (unsigned)indices.size());
+		run.buildTime = SecondsSince(start);
+		run.triangles = mesh.GetTriangleCount();
+
+		// Bodies anywhere in the soup
+		queries = MakeQueries(mesh.GetVolume(), [](double, double) { return soupSize * 0.5; });
+		Random random(querySeed);
+		for (Vector3& position : queries.positions) position.y = random.randomDouble(soupSize);
+		RunQueries(mesh, queries, rayLength, &run);
+		PrintRun("triangle_soup", run);
+	}
+
+	if (objPath)
+	{
+		std::vector<InterleavedVertex> vertices;
+		std::vector<uint32_t> indices;
+		if (!LoadObjFile(objPath, vertices, indices))
+		{
+			printf("could not load %s\n", objPath);
+			return;
+		}
+
+		TriangleMesh mesh;
+		start = std::chrono::steady_clock::now();
+		mesh.Build(vertices[0].position, sizeof(InterleavedVertex), (unsigned)vertices.size(),
+			indices.data(), (unsigned)indices.size());
+		run.buildTime = SecondsSince(start);
+		run.triangles = mesh.GetTriangleCount();
+
+		// Bodies on the ground, found by casting down onto it
+		BoundingBoxVolume volume = mesh.GetVolume();
+		queries = MakeQueries(volume,
+			[&](double x, double z)
+			{
+				TriangleRayHit hit;
+				Vector3 above(x, volume.max.y + 1, z);
+				if (mesh.RayCast(above, Vector3(0, -1, 0), 1e6, &hit)) return hit.point.y;
+				return volume.min.y;
+			});
+		RunQueries(mesh, queries, rayLength, &run);
+		PrintRun("obj", run);
+	}
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the static mesh benchmark, which checks the
+ * triangle mesh and heightfield colliders against testing every
+ * triangle, then times building them and querying them on meshes of
+ * a million triangles.
+ */
+
+/**
+ * Checks ray casts and contacts against every triangle of small
+ * meshes, then builds a million triangle terrain as a mesh and a
+ * heightfield, and a million triangle soup, and prints a table of
+ * their build times and query rates. The OBJ file at the given path
+ * is loaded and timed as well, when there is one.
+ */
+void RunMeshBench(const char* objPath);
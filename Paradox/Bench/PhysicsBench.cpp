@@ -0,0 +1,384 @@
+/**
+ * @file
+ *
+ * Headless benchmark runner for the physics library. Drives
+ * World::RunPhysics over the scripted scenes in BenchScenes and
+ * reports throughput, per-phase timings and heap allocations.
+ *
+ * Usage: physics_bench [--scene name|all] [--size n] [--steps n] [--warmup n]
+ *                      [--integrator scalar|sse|avx2] [--deterministic] [--threads n]
+ *                      [--solver resolver|impulse] [--manifolds]
+ *                      [--broadphase none|tree|sap]
+ *        physics_bench --broadphase-bench [--steps n] [--threads n]
+ *        physics_bench --static-tree-bench [--threads n]
+ *        physics_bench --volume-bench [--steps n]
+ *        physics_bench --query-bench [--threads n]
+ *        physics_bench --convex-bench [--steps n]
+ *        physics_bench --mesh-bench [--mesh file.obj]
+ *        physics_bench --sat-bench [--steps n]
+ *        physics_bench --ccd-bench [--steps n]
+ *        physics_bench --timestep-bench [--steps n]
+ *        physics_bench --lockstep-bench [--steps n] [--size n]
+ *        physics_bench --snapshot-bench [--steps n]
+ *        physics_bench --pool-bench [--steps n]
+ *        physics_bench --contact-bench [--steps n]
+ *        physics_bench --generate-bench [--steps n]
+ *
+ * The drift column is how far bodies have moved from where the scene
+ * placed them, on average, which stays small for a stable stack.
+ */
+
+#include "BenchScenes.h"
+#include "BroadphaseBench.h"
+#include "CCDBench.h"
+#include "ContactBench.h"
+#include "ConvexBench.h"
+#include "GenerateBench.h"
+#include "LockstepBench.h"
+#include "MeshBench.h"
+#include "PoolBench.h"
+#include "QueryBench.h"
+#include "SATBench.h"
+#include "SnapshotBench.h"
+#include "TimestepBench.h"
+#include "VolumeBench.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// Counts every heap allocation made by the process
+static std::atomic<unsigned long long> allocationCount(0);
+
+void* operator new(size_t size)
+{
+	allocationCount++;
+	if (void* p = malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	allocationCount++;
+	if (void* p = malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+unsigned long long GetAllocationCount()
+{
+	return allocationCount;
+}
+
+struct BenchOptions
+{
+	const char* scene;
+	unsigned size;
+	unsigned steps;
+	unsigned warmup;
+	double duration;
+
+	// Integrator path to use, the widest supported one if not given
+	const char* integrator;
+	bool deterministic;
+
+	// Threads to resolve contacts on, zero for one per hardware thread
+	unsigned threads;
+
+	// Contact solver to use, the world's default if not given
+	const char* solver;
+
+	// Keeps persistent manifolds for colliding pairs
+	bool manifolds;
+
+	// Broadphase to use, the world's default if not given
+	const char* broadphase;
+};
+
+static void PrintUsage()
+{
+	printf("usage: physics_bench [--scene name|all] [--size n] [--steps n] [--warmup n]\n");
+	printf("                     [--integrator scalar|sse|avx2] [--deterministic] [--threads n]\n");
+	printf("                     [--solver resolver|impulse] [--manifolds]\n");
+	printf("                     [--broadphase none|tree|sap]\n");
+	printf("       physics_bench --broadphase-bench [--steps n] [--threads n]\n");
+	printf("       physics_bench --static-tree-bench [--threads n]\n");
+	printf("       physics_bench --volume-bench [--steps n]\n");
+	printf("       physics_bench --query-bench [--threads n]\n");
+	printf("       physics_bench --convex-bench [--steps n]\n");
+	printf("       physics_bench --mesh-bench [--mesh file.obj]\n");
+	printf("       physics_bench --sat-bench [--steps n]\n");
+	printf("       physics_bench --ccd-bench [--steps n]\n");
+	printf("       physics_bench --timestep-bench [--steps n]\n");
+	printf("       physics_bench --lockstep-bench [--steps n] [--size n]\n");
+	printf("       physics_bench --snapshot-bench [--steps n]\n");
+	printf("       physics_bench --pool-bench [--steps n]\n");
+	printf("       physics_bench --contact-bench [--steps n]\n");
+	printf("       physics_bench --generate-bench [--steps n]\n");
+	printf("scenes:");
+	for (const BenchSceneDesc* desc = GetBenchScenes(); desc->name; desc++)
+	{
+		printf(" %s", desc->name);
+	}
+	printf("\n");
+}
+
+// Returns the path with the given name, or the widest supported one
+static IntegratorPath ParseIntegratorPath(const char* name)
+{
+	if (!strcmp(name, "scalar")) return IntegratorPath::Scalar;
+	if (!strcmp(name, "sse")) return IntegratorPath::SSE;
+	if (!strcmp(name, "avx2")) return IntegratorPath::AVX2;
+	return GetBestIntegratorPath();
+}
+
+// Returns the solver with the given name
+static ContactSolverType ParseContactSolver(const char* name)
+{
+	if (!strcmp(name, "impulse")) return ContactSolverType::SequentialImpulse;
+	return ContactSolverType::Resolver;
+}
+
+static const char* GetContactSolverName(ContactSolverType type)
+{
+	return type == ContactSolverType::SequentialImpulse ? "impulse" : "resolver";
+}
+
+// Returns the broadphase with the given name
+static BroadphaseType ParseBroadphase(const char* name)
+{
+	if (!strcmp(name, "tree")) return BroadphaseType::DynamicTree;
+	if (!strcmp(name, "sap")) return BroadphaseType::SweepAndPrune;
+	return BroadphaseType::None;
+}
+
+// Returns the mean distance of the scene's bodies from the given positions
+static double MeasureDrift(const BenchScene& scene, const std::vector<Vector3>& start)
+{
+	if (start.empty()) return 0;
+
+	double drift = 0;
+	for (unsigned b = 0; b < start.size(); b++)
+	{
+		drift += (scene.bodies[b]->GetPosition() - start[b]).magnitude();
+	}
+	return drift / start.size();
+}
+
+static void RunScene(const BenchSceneDesc& desc, const BenchOptions& options)
+{
+	unsigned size = options.size ? options.size : desc.defaultSize;
+	std::unique_ptr<BenchScene> scene = desc.create(size);
+
+	BodyStore& store = scene->world->GetBodyStore();
+	if (options.integrator) store.SetIntegratorPath(ParseIntegratorPath(options.integrator));
+	store.SetDeterministic(options.deterministic);
+	scene->world->SetThreadCount(options.threads);
+	if (options.solver) scene->world->SetContactSolver(ParseContactSolver(options.solver));
+	scene->generator.usePairCache = options.manifolds;
+	if (options.broadphase) scene->world->SetBroadphase(ParseBroadphase(options.broadphase));
+
+	std::vector<Vector3> startPositions;
+	for (const std::unique_ptr<RigidBody>& body : scene->bodies) startPositions.push_back(body->GetPosition());
+
+	// Let the scene settle into its steady state before measuring
+	for (unsigned i = 0; i < options.warmup; i++) scene->Step(options.duration);
+
+	double integrateTime = 0, broadphaseTime = 0, generateTime = 0, resolveTime = 0;
+	unsigned long long pairs = 0, contacts = 0, islands = 0;
+
+	unsigned long long allocationsBefore = allocationCount;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	for (unsigned i = 0; i < options.steps; i++)
+	{
+		scene->Step(options.duration);
+
+		const WorldStats& stats = scene->world->GetStats();
+		integrateTime += stats.integrateTime;
+		broadphaseTime += stats.broadphaseTime;
+		pairs += stats.potentialContacts;
+		generateTime += stats.generateTime;
+		resolveTime += stats.resolveTime;
+		contacts += stats.contactsGenerated;
+		islands += stats.islandCount;
+	}
+
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	unsigned long long allocations = allocationCount - allocationsBefore;
+
+	double steps = (double)options.steps;
+	printf("%-14s %7u %10.1f %12.4f %13.4f %8.1f %12.4f %12.4f %10.1f %9.1f %12.2f %8.3f  %-9s %s%s%s\n",
+		desc.name,
+		(unsigned)scene->bodies.size(),
+		elapsed > 0 ? steps / elapsed : 0.0,
+		integrateTime * 1000.0 / steps,
+		broadphaseTime * 1000.0 / steps,
+		pairs / steps,
+		generateTime * 1000.0 / steps,
+		resolveTime * 1000.0 / steps,
+		contacts / steps,
+		islands / steps,
+		allocations / steps,
+		MeasureDrift(*scene, startPositions),
+		GetContactSolverName(scene->world->GetContactSolver()),
+		GetIntegratorPathName(store.GetIntegratorPath()),
+		store.IsDeterministic() ? " deterministic" : "",
+		options.manifolds ? " manifolds" : "");
+}
+
+int main(int argc, char** argv)
+{
+	BenchOptions options = { "all", 0, 300, 30, 1.0 / 60.0, NULL, false, 0, NULL, false, NULL };
+	bool broadphaseBench = false;
+	bool staticTreeBench = false;
+	bool volumeBench = false;
+	bool queryBench = false;
+	bool convexBench = false;
+	bool meshBench = false;
+	bool satBench = false;
+	bool ccdBench = false;
+	bool timestepBench = false;
+	bool lockstepBench = false;
+	bool snapshotBench = false;
+	bool poolBench = false;
+	bool contactBench = false;
+	bool generateBench = false;
+	const char* meshPath = NULL;
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+		if (!strcmp(argv[i], "--scene") && hasValue) options.scene = argv[++i];
+		else if (!strcmp(argv[i], "--size") && hasValue) options.size = (unsigned)atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--steps") && hasValue) options.steps = (unsigned)atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--warmup") && hasValue) options.warmup = (unsigned)atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--integrator") && hasValue) options.integrator = argv[++i];
+		else if (!strcmp(argv[i], "--deterministic")) options.deterministic = true;
+		else if (!strcmp(argv[i], "--threads") && hasValue) options.threads = (unsigned)atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--solver") && hasValue) options.solver = argv[++i];
+		else if (!strcmp(argv[i], "--manifolds")) options.manifolds = true;
+		else if (!strcmp(argv[i], "--broadphase") && hasValue) options.broadphase = argv[++i];
+		else if (!strcmp(argv[i], "--broadphase-bench")) broadphaseBench = true;
+		else if (!strcmp(argv[i], "--static-tree-bench")) staticTreeBench = true;
+		else if (!strcmp(argv[i], "--volume-bench")) volumeBench = true;
+		else if (!strcmp(argv[i], "--query-bench")) queryBench = true;
+		else if (!strcmp(argv[i], "--convex-bench")) convexBench = true;
+		else if (!strcmp(argv[i], "--mesh-bench")) meshBench = true;
+		else if (!strcmp(argv[i], "--mesh") && hasValue) meshPath = argv[++i];
+		else if (!strcmp(argv[i], "--sat-bench")) satBench = true;
+		else if (!strcmp(argv[i], "--ccd-bench")) ccdBench = true;
+		else if (!strcmp(argv[i], "--timestep-bench")) timestepBench = true;
+		else if (!strcmp(argv[i], "--lockstep-bench")) lockstepBench = true;
+		else if (!strcmp(argv[i], "--snapshot-bench")) snapshotBench = true;
+		else if (!strcmp(argv[i], "--pool-bench")) poolBench = true;
+		else if (!strcmp(argv[i], "--contact-bench")) contactBench = true;
+		else if (!strcmp(argv[i], "--generate-bench")) generateBench = true;
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (options.steps == 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	if (broadphaseBench) return RunBroadphaseBench(options.steps, options.threads) ? 0 : 1;
+
+	if (staticTreeBench)
+	{
+		RunStaticTreeBench(options.threads);
+		return 0;
+	}
+
+	if (volumeBench)
+	{
+		RunVolumeBench(options.steps);
+		return 0;
+	}
+
+	if (queryBench)
+	{
+		RunQueryBench(options.threads);
+		return 0;
+	}
+
+	if (convexBench)
+	{
+		RunConvexBench(options.steps);
+		return 0;
+	}
+
+	if (meshBench)
+	{
+		RunMeshBench(meshPath);
+		return 0;
+	}
+
+	if (satBench)
+	{
+		RunSATBench(options.steps);
+		return 0;
+	}
+
+	if (ccdBench)
+	{
+		RunCCDBench(options.steps);
+		return 0;
+	}
+
+	if (timestepBench)
+	{
+		RunTimestepBench(options.steps);
+		return 0;
+	}
+
+	// These fail if any run diverged, so they can be used as checks
+	if (lockstepBench) return RunLockstepBench(options.steps, options.size) ? 0 : 1;
+	if (snapshotBench) return RunSnapshotBench(options.steps) ? 0 : 1;
+	if (poolBench) return RunPoolBench(options.steps) ? 0 : 1;
+	if (contactBench) return RunContactBench(options.steps) ? 0 : 1;
+	if (generateBench) return RunGenerateBench(options.steps) ? 0 : 1;
+
+	bool found = false;
+	for (const BenchSceneDesc* desc = GetBenchScenes(); desc->name; desc++)
+	{
+		if (!strcmp(options.scene, "all") || !strcmp(options.scene, desc->name)) found = true;
+	}
+
+	if (options.integrator && strcmp(options.integrator, "scalar") &&
+		strcmp(options.integrator, "sse") && strcmp(options.integrator, "avx2")) found = false;
+
+	if (options.solver && strcmp(options.solver, "resolver") && strcmp(options.solver, "impulse")) found = false;
+	if (options.broadphase && strcmp(options.broadphase, "none") && strcmp(options.broadphase, "tree") &&
+		strcmp(options.broadphase, "sap")) found = false;
+
+	if (!found)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	printf("%-14s %7s %10s %12s %13s %8s %12s %12s %10s %9s %12s %8s  %-9s %s\n",
+		"scene", "bodies", "steps/s", "integrate ms", "broadphase ms", "pairs", "generate ms", "resolve ms", "contacts", "islands", "allocs/step",
+		"drift", "solver", "integrator");
+
+	for (const BenchSceneDesc* desc = GetBenchScenes(); desc->name; desc++)
+	{
+		if (strcmp(options.scene, "all") && strcmp(options.scene, desc->name)) continue;
+
+		RunScene(*desc, options);
+	}
+
+	return 0;
+}
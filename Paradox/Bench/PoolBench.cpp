@@ -0,0 +1,141 @@
+#include "PoolBench.h"
+#include "BenchScenes.h"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+// Bodies spawned each frame, and the frames each lives for
+static const unsigned spawnPerFrame = 500;
+static const unsigned lifetimeFrames = 30;
+
+static double SecondsSince(const std::chrono::steady_clock::time_point& start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Sets a freshly made body up as a piece of debris thrown from the origin
+static void SetUpDebris(RigidBody* body, unsigned number)
+{
+	double spread = (double)(number % 17) - 8.0;
+	body->SetPosition(Vector3(0, 2, 0));
+	body->SetVelocity(Vector3(spread, 5.0, 0.5 * spread));
+	body->SetMass(0.25);
+	body->SetAcceleration(Vector3::GRAVITY);
+	body->SetAwakeStatus();
+}
+
+// How a run makes and gets rid of its' bodies
+enum class SpawnMethod
+{
+	NewAndDelete,
+	Pool,
+	ReservedPool
+};
+
+// Runs the frames spawning and despawning debris, printing a row
+static void TimeSpawning(const char* name, SpawnMethod method, unsigned frames)
+{
+	World world(16);
+	unsigned alive = spawnPerFrame * lifetimeFrames;
+	if (method == SpawnMethod::ReservedPool) world.ReserveBodies(alive);
+
+	// The bodies alive, oldest first round the ring
+	std::vector<RigidBody*> spawnedBodies(alive, NULL);
+	std::vector<BodyHandle> spawnedHandles(alive, invalidBodyHandle);
+
+	// The frames before this many are alive are not measured
+	unsigned warmup = method == SpawnMethod::ReservedPool ? 0 : lifetimeFrames;
+
+	double elapsed = 0;
+	unsigned long long allocations = 0;
+	unsigned number = 0;
+	for (unsigned frame = 0; frame < warmup + frames; frame++)
+	{
+		unsigned long long allocationsBefore = GetAllocationCount();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		for (unsigned i = 0; i < spawnPerFrame; i++, number++)
+		{
+			unsigned place = number % alive;
+			if (method == SpawnMethod::NewAndDelete)
+			{
+				delete spawnedBodies[place];
+				RigidBody* body = new RigidBody;
+				world.AddBody(body);
+				SetUpDebris(body, number);
+				spawnedBodies[place] = body;
+			}
+			else
+			{
+				if (spawnedHandles[place] != invalidBodyHandle) world.DestroyBody(spawnedHandles[place]);
+				BodyHandle handle = world.CreateBody();
+				SetUpDebris(world.GetBody(handle), number);
+				spawnedHandles[place] = handle;
+			}
+		}
+
+		if (frame < warmup) continue;
+		elapsed += SecondsSince(start);
+		allocations += GetAllocationCount() - allocationsBefore;
+	}
+
+	for (RigidBody* body : spawnedBodies) delete body;
+
+	double bodies = (double)frames * spawnPerFrame;
+	printf("%-14s %8u %10u %12.1f %14.2f\n", name, frames * spawnPerFrame, alive, elapsed * 1e9 / bodies,
+		(double)allocations / frames);
+}
+
+// Destroys bodies and makes others in their slots, checking that the
+// handles of the destroyed ones are refused. Returns true if they were
+static bool CheckStaleHandles()
+{
+	World world(16);
+	bool passed = true;
+
+	// Handles kept after destroying, each slot then taken by a new body
+	std::vector<BodyHandle> stale;
+	std::vector<BodyHandle> current;
+	for (unsigned i = 0; i < 64; i++) current.push_back(world.CreateBody());
+	for (unsigned round = 0; round < 4; round++)
+	{
+		for (BodyHandle& handle : current)
+		{
+			passed = world.DestroyBody(handle) && passed;
+			stale.push_back(handle);
+			handle = world.CreateBody();
+		}
+	}
+
+	unsigned caught = 0;
+	for (BodyHandle handle : stale)
+	{
+		if (!world.IsValid(handle) && !world.GetBody(handle) && !world.DestroyBody(handle)) caught++;
+	}
+	for (BodyHandle handle : current)
+	{
+		RigidBody* body = world.GetBody(handle);
+		passed = body && body->GetHandle() == handle && passed;
+	}
+
+	// Bodies the world did not make are left to their owner
+	RigidBody added;
+	BodyHandle addedHandle = world.AddBody(&added);
+	passed = !world.DestroyBody(addedHandle) && world.GetBody(addedHandle) == &added && passed;
+	world.RemoveBody(&added);
+
+	passed = caught == stale.size() && world.GetBodyCount() == current.size() && passed;
+	printf("%u of %u stale handles caught, %u bodies alive: %s\n", caught, (unsigned)stale.size(),
+		world.GetBodyCount(), passed ? "passed" : "FAILED");
+	return passed;
+}
+
+bool RunPoolBench(unsigned frames)
+{
+	printf("%-14s %8s %10s %12s %14s\n", "method", "spawned", "alive", "ns per body", "allocs/frame");
+	TimeSpawning("new+delete", SpawnMethod::NewAndDelete, frames);
+	TimeSpawning("pool", SpawnMethod::Pool, frames);
+	TimeSpawning("pool reserved", SpawnMethod::ReservedPool, frames);
+	printf("\n");
+	return CheckStaleHandles();
+}
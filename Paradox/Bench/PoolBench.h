@@ -0,0 +1,21 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the body pool benchmark, which spawns and
+ * despawns debris bodies every frame and checks that handles of
+ * destroyed bodies are caught.
+ */
+
+/**
+ * Runs the given number of frames of a world spawning a few hundred
+ * debris bodies a frame, each living for half a second, first with
+ * bodies made with new and added to the world, then with the world's
+ * CreateBody and DestroyBody, with and without reserving room first.
+ * Prints the time per body created and destroyed and the allocations
+ * per frame once the number alive is steady. Then checks that handles
+ * kept after their body is destroyed are refused once the slot holds
+ * another body. Returns true if every stale handle was caught.
+ */
+bool RunPoolBench(unsigned frames);
@@ -0,0 +1,161 @@
+#include "QueryBench.h"
+#include "../Physics/Random.h"
+#include "../Physics/SceneQuery.h"
+#include "../Physics/WorkerPool.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+// Seed shared by every field so runs are repeatable
+static const unsigned fieldSeed = 2468;
+
+// Numbers of shapes in each field, half spheres and half boxes
+static const unsigned fieldSizes[] = { 1000, 10000, 50000 };
+
+// Number of queries in each batch
+static const unsigned batchSize = 10000;
+
+// Longest line of sight tested
+static const double sightRange = 20.0;
+
+// Spheres and boxes lying about on the ground, and queries among them
+struct QueryField
+{
+	std::unique_ptr<RigidBody[]> bodies;
+	std::vector<CollisionSphere> spheres;
+	std::vector<CollisionBox> boxes;
+	CollisionPlane ground;
+	double extent;
+
+	SceneQuery scene;
+
+	std::vector<RayQuery> rays;
+	std::vector<SphereSweepQuery> sweeps;
+	std::vector<SphereOverlapQuery> overlaps;
+
+	QueryField(unsigned size)
+		:
+		bodies(new RigidBody[size]),
+		spheres(size / 2),
+		boxes(size - size / 2)
+	{
+		// Keep the same density at every size, about one shape per 9 square units
+		extent = 3.0 * sqrt((double)size);
+
+		Random random(fieldSeed);
+		for (unsigned i = 0; i < size; i++)
+		{
+			RigidBody& body = bodies[i];
+			body.SetPosition(random.randomVector(Vector3(0, 0, 0), Vector3(extent, 3, extent)));
+			body.SetOrientation(random.randomQuaternion());
+			body.CalculateDerivedData();
+		}
+
+		for (unsigned i = 0; i < spheres.size(); i++)
+		{
+			spheres[i].body = &bodies[i];
+			spheres[i].radius = 0.2 + random.randomDouble(0, 0.6);
+			scene.AddSphere(&spheres[i]);
+		}
+		for (unsigned i = 0; i < boxes.size(); i++)
+		{
+			boxes[i].body = &bodies[spheres.size() + i];
+			boxes[i].halfSize = random.randomVector(Vector3(0.2, 0.2, 0.2), Vector3(1, 1, 1));
+			scene.AddBox(&boxes[i]);
+		}
+
+		ground.direction = Vector3(0, 1, 0);
+		ground.offset = 0;
+		scene.AddPlane(&ground);
+
+		// Every other ray is a line of sight between two points at head
+		// height, the rest probe straight down for the ground
+		for (unsigned i = 0; i < batchSize; i++)
+		{
+			Vector3 start = random.randomVector(Vector3(0, 1, 0), Vector3(extent, 2, extent));
+			if (i % 2)
+			{
+				rays.push_back(MakeSegmentQuery(start, start + random.randomXZVector(sightRange)));
+			}
+			else
+			{
+				RayQuery probe = { start, Vector3(0, -1, 0), 10.0 };
+				rays.push_back(probe);
+			}
+
+			SphereSweepQuery sweep = { rays[i].origin, rays[i].direction, rays[i].length, 0.3, NULL };
+			sweeps.push_back(sweep);
+
+			SphereOverlapQuery overlap = { start, 1.0 };
+			overlaps.push_back(overlap);
+		}
+	}
+};
+
+static double SecondsSince(const std::chrono::steady_clock::time_point& start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Counts the queries that hit something
+static unsigned CountHits(const std::vector<QueryHit>& hits)
+{
+	unsigned count = 0;
+	for (const QueryHit& hit : hits)
+	{
+		if (hit.shape != SceneQuery::nullShape) count++;
+	}
+	return count;
+}
+
+static void PrintRow(unsigned size, const char* query, double time, unsigned hits)
+{
+	printf("%-8u %-16s %12.3f %12.1f %12u\n", size, query, time * 1000.0, time * 1e9 / batchSize, hits);
+}
+
+void RunQueryBench(unsigned threads)
+{
+	WorkerPool pool(threads);
+	printf("threads: %u\n", pool.GetThreadCount());
+	printf("%-8s %-16s %12s %12s %12s\n", "shapes", "query", "ms/batch", "ns/query", "hits");
+
+	for (unsigned size : fieldSizes)
+	{
+		QueryField field(size);
+		std::vector<QueryHit> hits(batchSize);
+		std::vector<QueryOverlap> overlaps;
+
+		// One ray per call, so every packet has a single lane
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (unsigned i = 0; i < batchSize; i++) field.scene.CastRays(&field.rays[i], 1, &hits[i]);
+		PrintRow(size, "ray_single", SecondsSince(start), CountHits(hits));
+
+		start = std::chrono::steady_clock::now();
+		field.scene.CastRays(field.rays.data(), batchSize, hits.data());
+		PrintRow(size, "ray_batch", SecondsSince(start), CountHits(hits));
+
+		start = std::chrono::steady_clock::now();
+		field.scene.CastRays(field.rays.data(), batchSize, hits.data(), &pool);
+		PrintRow(size, "ray_batch_mt", SecondsSince(start), CountHits(hits));
+
+		start = std::chrono::steady_clock::now();
+		field.scene.SweepSpheres(field.sweeps.data(), batchSize, hits.data());
+		PrintRow(size, "sweep_batch", SecondsSince(start), CountHits(hits));
+
+		start = std::chrono::steady_clock::now();
+		field.scene.SweepSpheres(field.sweeps.data(), batchSize, hits.data(), &pool);
+		PrintRow(size, "sweep_batch_mt", SecondsSince(start), CountHits(hits));
+
+		overlaps.clear();
+		start = std::chrono::steady_clock::now();
+		unsigned found = field.scene.OverlapSpheres(field.overlaps.data(), batchSize, overlaps);
+		PrintRow(size, "overlap_batch", SecondsSince(start), found);
+
+		overlaps.clear();
+		start = std::chrono::steady_clock::now();
+		found = field.scene.OverlapSpheres(field.overlaps.data(), batchSize, overlaps, &pool);
+		PrintRow(size, "overlap_batch_mt", SecondsSince(start), found);
+	}
+}
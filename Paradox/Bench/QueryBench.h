@@ -0,0 +1,16 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the scene query benchmark, which times batches
+ * of line of sight rays, ground probes, sphere sweeps and overlap
+ * tests against fields of spheres and boxes of growing size.
+ */
+
+/**
+ * Runs the benchmark over fields of 1k to 50k shapes on a ground
+ * plane and prints a table of results. Multi-threaded rows use the
+ * given number of threads, zero for one per hardware thread.
+ */
+void RunQueryBench(unsigned threads);
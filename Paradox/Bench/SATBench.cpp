@@ -0,0 +1,246 @@
+#include "SATBench.h"
+#include "../Physics/CollideFine.h"
+#include "../Physics/Random.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Seed shared by every set of pairs so runs are repeatable
+static const unsigned pairSeed = 2468;
+
+// Other boxes each box is tested against in one batch
+static const unsigned batchSize = 16;
+
+// Batches of random pairs each kind of check is run on
+static const unsigned checkBatches = 4000;
+
+// Batches of pairs in each timed set
+static const unsigned timedBatches = 1000;
+
+static double SecondsSince(const std::chrono::steady_clock::time_point& start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// How the second box of each pair is turned against the first
+enum class PairTurn
+{
+	// Both turned at random
+	Random,
+
+	// Both turned the same way, so their faces are parallel
+	Parallel,
+
+	// Turned by a hair, so the crossed axes are almost too short to test
+	NearlyParallel
+};
+
+/**
+ * Sets of boxes, each tested against the next batch of boxes. The
+ * bodies are never moved once placed, so the boxes can point at them.
+ */
+struct BoxBatches
+{
+	std::vector<RigidBody> bodies;
+	std::vector<CollisionBox> boxes;
+	std::vector<const CollisionBox*> others;
+
+	BoxBatches(unsigned batches, PairTurn turn, double range, Random* random)
+		:
+		bodies(batches * (batchSize + 1)),
+		boxes(batches * (batchSize + 1))
+	{
+		for (unsigned batch = 0; batch < batches; batch++)
+		{
+			Quaternion orientation = random->randomQuaternion();
+			for (unsigned i = 0; i <= batchSize; i++)
+			{
+				unsigned index = batch * (batchSize + 1) + i;
+				Quaternion turned = orientation;
+				if (turn == PairTurn::Random) turned = random->randomQuaternion();
+				else if (turn == PairTurn::NearlyParallel && i > 0)
+				{
+					turned.AddScaledVector(random->randomVector(0.01), 1.0);
+					turned.Normalize();
+				}
+
+				// Boxes in a parallel batch sit on a grid, so that some
+				// faces meet exactly
+				Vector3 position = i == 0 ? Vector3() : random->randomVector(range);
+				if (turn == PairTurn::Parallel && i > 0 && i % 2 == 0)
+				{
+					position = Vector3((double)(i % 3), 0.5 * (i % 4), 0.25 * (i % 5));
+				}
+
+				bodies[index].SetPosition(position);
+				bodies[index].SetOrientation(turned);
+				bodies[index].CalculateDerivedData();
+
+				boxes[index].body = &bodies[index];
+				boxes[index].halfSize = random->randomVector(Vector3(0.2, 0.2, 0.2), Vector3(1, 1, 1));
+				if (turn == PairTurn::Parallel && i % 2 == 0) boxes[index].halfSize = Vector3(0.5, 0.5, 0.5);
+				boxes[index].CalculateInternals();
+
+				if (i > 0) others.push_back(&boxes[index]);
+			}
+		}
+	}
+
+	unsigned GetBatchCount() const
+	{
+		return (unsigned)others.size() / batchSize;
+	}
+
+	const CollisionBox& GetBox(unsigned batch) const
+	{
+		return boxes[batch * (batchSize + 1)];
+	}
+
+	const CollisionBox* const* GetOthers(unsigned batch) const
+	{
+		return &others[batch * batchSize];
+	}
+};
+
+static void PrepareData(CollisionData* data, Contact* contacts)
+{
+	data->contactArray = contacts;
+	data->friction = 0;
+	data->restitution = 0;
+	data->tolerance = 0;
+	data->Reset(batchSize);
+}
+
+static bool SameBits(double a, double b)
+{
+	return !memcmp(&a, &b, sizeof(double));
+}
+
+static bool SameBits(const Vector3& a, const Vector3& b)
+{
+	return SameBits(a.x, b.x) && SameBits(a.y, b.y) && SameBits(a.z, b.z);
+}
+
+static bool SameContact(const Contact& a, const Contact& b)
+{
+	return SameBits(a.contactNormal, b.contactNormal) && SameBits(a.contactPoint, b.contactPoint) &&
+		SameBits(a.penetration, b.penetration) && a.feature == b.feature &&
+		a.body[0] == b.body[0] && a.body[1] == b.body[1];
+}
+
+// Compares the three tests on every pair of the batches, printing
+// how many pairs touched and how many disagreed with the scalar test
+static void CheckBatches(const char* name, const BoxBatches& batches)
+{
+	Contact scalarContacts[batchSize], packedContacts[batchSize], batchedContacts[batchSize];
+	CollisionData scalar, packed, batched;
+	PrepareData(&scalar, scalarContacts);
+	PrepareData(&packed, packedContacts);
+	PrepareData(&batched, batchedContacts);
+
+	unsigned pairs = 0, touching = 0, packedMismatches = 0, batchedMismatches = 0;
+	for (unsigned batch = 0; batch < batches.GetBatchCount(); batch++)
+	{
+		const CollisionBox& one = batches.GetBox(batch);
+		const CollisionBox* const* others = batches.GetOthers(batch);
+
+		scalar.Reset(batchSize);
+		packed.Reset(batchSize);
+		for (unsigned i = 0; i < batchSize; i++)
+		{
+			Contact* scalarContact = scalar.contacts;
+			Contact* packedContact = packed.contacts;
+			unsigned expected = CollisionDetector::BoxAndBoxScalar(one, *others[i], &scalar);
+			unsigned found = CollisionDetector::BoxAndBox(one, *others[i], &packed);
+
+			pairs++;
+			touching += expected;
+			if (expected != found || (expected && !SameContact(*scalarContact, *packedContact))) packedMismatches++;
+		}
+
+		batched.Reset(batchSize);
+		CollisionDetector::BoxAndBoxes(one, others, batchSize, &batched);
+		if (batched.contactCount != scalar.contactCount) batchedMismatches++;
+		for (unsigned i = 0; i < batched.contactCount && i < scalar.contactCount; i++)
+		{
+			if (!SameContact(scalarContacts[i], batchedContacts[i])) batchedMismatches++;
+		}
+	}
+
+	printf("%-16s %10u %10u %10u %10u\n", name, pairs, touching, packedMismatches, batchedMismatches);
+}
+
+// The tests the timed runs compare
+enum class SATTest
+{
+	Scalar,
+	Packed,
+	Batched
+};
+
+static const char* satTestNames[] = { "scalar", "packed", "batched" };
+
+// Runs the test over every pair of the batches the given number of
+// times, returning the seconds taken and counting the contacts found
+static double TimeBatches(SATTest test, const BoxBatches& batches, unsigned rounds, unsigned long long* contacts)
+{
+	Contact buffer[batchSize];
+	CollisionData data;
+	PrepareData(&data, buffer);
+
+	*contacts = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (unsigned round = 0; round < rounds; round++)
+	{
+		for (unsigned batch = 0; batch < batches.GetBatchCount(); batch++)
+		{
+			const CollisionBox& one = batches.GetBox(batch);
+			const CollisionBox* const* others = batches.GetOthers(batch);
+
+			data.Reset(batchSize);
+			if (test == SATTest::Batched) CollisionDetector::BoxAndBoxes(one, others, batchSize, &data);
+			else if (test == SATTest::Packed)
+			{
+				for (unsigned i = 0; i < batchSize; i++) CollisionDetector::BoxAndBox(one, *others[i], &data);
+			}
+			else
+			{
+				for (unsigned i = 0; i < batchSize; i++) CollisionDetector::BoxAndBoxScalar(one, *others[i], &data);
+			}
+			*contacts += data.contactCount;
+		}
+	}
+	return SecondsSince(start);
+}
+
+void RunSATBench(unsigned steps)
+{
+	Random random(pairSeed);
+
+	printf("%-16s %10s %10s %10s %10s\n", "check", "pairs", "touching", "packed", "batched");
+	CheckBatches("random", BoxBatches(checkBatches, PairTurn::Random, 1.5, &random));
+	CheckBatches("parallel", BoxBatches(checkBatches, PairTurn::Parallel, 1.5, &random));
+	CheckBatches("nearly_parallel", BoxBatches(checkBatches, PairTurn::NearlyParallel, 1.5, &random));
+	printf("\n");
+
+	// Most pairs of the first set touch, few of the second do, so
+	// that the second mostly times the early out
+	BoxBatches touching(timedBatches, PairTurn::Random, 1.0, &random);
+	BoxBatches apart(timedBatches, PairTurn::Random, 4.0, &random);
+	const BoxBatches* sets[] = { &touching, &apart };
+	const char* setNames[] = { "touching", "apart" };
+
+	printf("%-16s %-8s %10s %10s\n", "set", "test", "ns/pair", "touching %");
+	double pairs = (double)steps * timedBatches * batchSize;
+	for (unsigned set = 0; set < 2; set++)
+	{
+		for (SATTest test : { SATTest::Scalar, SATTest::Packed, SATTest::Batched })
+		{
+			unsigned long long contacts;
+			double time = TimeBatches(test, *sets[set], steps, &contacts);
+			printf("%-16s %-8s %10.1f %10.1f\n", setNames[set], satTestNames[(int)test],
+				time * 1e9 / pairs, 100.0 * contacts / pairs);
+		}
+	}
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the box separating axis benchmark, which checks
+ * that CollisionDetector::BoxAndBox and BoxAndBoxes give the same
+ * contacts as the axis by axis test, then times all three.
+ */
+
+/**
+ * Checks the contacts of random box pairs, some turned at random and
+ * some with parallel faces, against BoxAndBoxScalar to the last bit,
+ * then runs over sets of mostly touching and mostly apart pairs the
+ * given number of times and prints a table of how long each test took.
+ */
+void RunSATBench(unsigned steps);
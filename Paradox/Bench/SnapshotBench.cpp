@@ -0,0 +1,160 @@
+#include "SnapshotBench.h"
+#include "BenchScenes.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+static const double stepDuration = 1.0 / 60.0;
+
+// Sizes of the free bodies scene timed, size^3 bodies
+static const unsigned freeBodiesSizes[] = { 10, 22 };
+
+// Frames the timed ring holds, and times each is saved and restored
+static const unsigned timedSlots = 8;
+static const unsigned timedRounds = 200;
+
+// Frames the rollback check goes back
+static const unsigned rollbackFrames = 30;
+
+static double SecondsSince(const std::chrono::steady_clock::time_point& start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Pushes one body each frame, a different one and a different way
+// each time, so that a replay has to apply the inputs of every frame
+class PushInput : public FrameInput
+{
+public:
+	BenchScene* scene;
+
+	// Frames from this one on push the other way
+	unsigned changedFrame;
+
+	virtual void ApplyInput(World* /*world*/, unsigned frame)
+	{
+		RigidBody* body = scene->bodies[(frame * 7) % scene->bodies.size()].get();
+		if (!body->HasFiniteMass()) return;
+
+		double strength = frame >= changedFrame ? -40.0 : 40.0;
+		body->AddForce(Vector3(strength, 0.5 * strength, 0.25 * strength) * body->GetMass());
+		body->SetAwakeStatus();
+	}
+};
+
+// Times saving and restoring the scene's world, printing a row
+static void TimeSnapshots(BenchScene* scene)
+{
+	World* world = scene->world.get();
+
+	// A few steps first so that the solver has impulses cached
+	for (unsigned step = 0; step < 10; step++) scene->Step(stepDuration);
+
+	size_t slotSize = world->GetSnapshotSize();
+	std::vector<double> memory(slotSize / sizeof(double) * timedSlots);
+	SnapshotRing ring(memory.data(), slotSize, timedSlots);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (unsigned round = 0; round < timedRounds; round++) world->SaveSnapshot(ring, round);
+	double saveTime = SecondsSince(start) / timedRounds;
+
+	start = std::chrono::steady_clock::now();
+	for (unsigned round = 0; round < timedRounds; round++)
+	{
+		world->RestoreSnapshot(ring, timedRounds - 1 - round % timedSlots);
+	}
+	double restoreTime = SecondsSince(start) / timedRounds;
+
+	start = std::chrono::steady_clock::now();
+	for (unsigned step = 0; step < 10; step++) scene->Step(stepDuration);
+	double stepTime = SecondsSince(start) / 10;
+
+	SnapshotHeader header;
+	memcpy(&header, ring.GetSlot(timedRounds - 1), sizeof(header));
+	printf("%-14s %8u %10.1f %10.1f %12.1f %12.1f %10.3f\n", scene->name.c_str(), world->GetBodyCount(),
+		header.size / 1024.0, slotSize / 1024.0, saveTime * 1e6, restoreTime * 1e6, stepTime * 1e3);
+}
+
+// Runs the scene with inputs, saving every frame, then rolls back and
+// resimulates. Prints whether the replay with the same inputs ended
+// where the first run did, and the one with changed inputs did not
+static bool CheckRollback(const BenchSceneDesc& desc, unsigned steps)
+{
+	std::unique_ptr<BenchScene> scene = desc.create(desc.defaultSize > 8 ? 8 : desc.defaultSize);
+	World* world = scene->world.get();
+	world->SetDeterministic(true);
+	world->SetBroadphase(BroadphaseType::DynamicTree);
+	world->SetContactSolver(ContactSolverType::SequentialImpulse);
+
+	PushInput input;
+	input.scene = scene.get();
+	input.changedFrame = steps;
+
+	size_t slotSize = world->GetSnapshotSize();
+	std::vector<double> memory(slotSize / sizeof(double) * (rollbackFrames + 1));
+	SnapshotRing ring(memory.data(), slotSize, rollbackFrames + 1);
+
+	// The generator's GJK caches are not the world's to save, so they
+	// are kept alongside the ring
+	std::vector<GJKPairCache> convexPairs(rollbackFrames + 1);
+
+	for (unsigned frame = 0; frame < steps; frame++)
+	{
+		world->SaveSnapshot(ring, frame);
+		convexPairs[frame % convexPairs.size()] = scene->generator.convexPairs;
+		world->StartFrame();
+		input.ApplyInput(world, frame);
+		world->RunPhysics(stepDuration);
+	}
+	world->SaveSnapshot(ring, steps);
+	unsigned long long expected = world->HashState();
+
+	unsigned fromFrame = steps - rollbackFrames;
+	const GJKPairCache& fromPairs = convexPairs[fromFrame % convexPairs.size()];
+	scene->generator.convexPairs = fromPairs;
+	bool replayed = world->Resimulate(ring, fromFrame, steps, stepDuration, &input);
+	unsigned long long replayHash = world->HashState();
+
+	// The same again from the snapshots the replay saved, then with the
+	// pushes of the replayed frames turned around
+	scene->generator.convexPairs = fromPairs;
+	replayed = replayed && world->Resimulate(ring, fromFrame, steps, stepDuration, &input);
+	bool matched = replayed && replayHash == expected && world->HashState() == expected;
+
+	input.changedFrame = fromFrame;
+	scene->generator.convexPairs = fromPairs;
+	world->Resimulate(ring, fromFrame, steps, stepDuration, &input);
+	bool changed = world->HashState() != expected;
+
+	printf("%-14s %8u %10u %18llx %18llx %8s %8s\n", desc.name, world->GetBodyCount(), fromFrame, expected,
+		replayHash, matched ? "yes" : "NO", changed ? "yes" : "NO");
+	return matched && changed;
+}
+
+bool RunSnapshotBench(unsigned steps)
+{
+	printf("%-14s %8s %10s %10s %12s %12s %10s\n", "scene", "bodies", "used kb", "slot kb", "save us",
+		"restore us", "step ms");
+	for (unsigned size : freeBodiesSizes)
+	{
+		std::unique_ptr<BenchScene> scene = CreateFreeBodiesScene(size);
+		TimeSnapshots(scene.get());
+	}
+	std::unique_ptr<BenchScene> stack = CreateBoxStackScene(8);
+	stack->world->SetContactSolver(ContactSolverType::SequentialImpulse);
+	TimeSnapshots(stack.get());
+	printf("\n");
+
+	if (steps <= rollbackFrames) steps = rollbackFrames + 1;
+	printf("%-14s %8s %10s %18s %18s %8s %8s\n", "scene", "bodies", "from", "hash", "replayed", "matched",
+		"changed");
+
+	bool passed = true;
+	for (const BenchSceneDesc* desc = GetBenchScenes(); desc->name; desc++)
+	{
+		passed = CheckRollback(*desc, steps) && passed;
+	}
+	printf(passed ? "every replay matched\n" : "replays diverged\n");
+	return passed;
+}
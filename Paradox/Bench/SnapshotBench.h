@@ -0,0 +1,19 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the snapshot benchmark, which times saving and
+ * restoring the world's state and checks that rolling a scene back
+ * and running it again ends where it was.
+ */
+
+/**
+ * Times World::SaveSnapshot and RestoreSnapshot on the free bodies
+ * scene at about a thousand and ten thousand bodies, against a step.
+ * Then runs each scene in deterministic mode for the given number of
+ * steps with pushes as input, rolls it back a number of frames and
+ * resimulates, printing whether the state hash matches the first run.
+ * Returns true if every replay matched.
+ */
+bool RunSnapshotBench(unsigned steps);
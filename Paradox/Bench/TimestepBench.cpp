@@ -0,0 +1,120 @@
+#include "TimestepBench.h"
+#include "BenchScenes.h"
+#include "../Physics/FixedTimestep.h"
+#include "../Physics/Random.h"
+#include <chrono>
+#include <cstdio>
+#include <math.h>
+
+// Seed for the uneven frame times, so runs are repeatable
+static const unsigned frameSeed = 1357;
+
+static const double stepDuration = 1.0 / 60.0;
+static const unsigned maxStepsPerFrame = 4;
+
+// Size of the box stack stepped alongside, to give the frames some work
+static const unsigned stackSize = 4;
+
+// Speed of the body whose drawn position is checked
+static const double bodySpeed = 10.0;
+
+static double SecondsSince(const std::chrono::steady_clock::time_point& start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// The patterns of frame times the scheduler is fed
+enum class FrameProfile
+{
+	Steady60,
+	Steady144,
+	Steady30,
+	Uneven,
+	Stalls
+};
+
+static const char* frameProfileNames[] = { "60hz", "144hz", "30hz", "uneven", "stalls" };
+
+// Returns how long the given frame of the profile takes, in seconds
+static double GetFrameDuration(FrameProfile profile, unsigned frame, Random* random)
+{
+	switch (profile)
+	{
+	case FrameProfile::Steady60: return 1.0 / 60.0;
+	case FrameProfile::Steady144: return 1.0 / 144.0;
+	case FrameProfile::Steady30: return 1.0 / 30.0;
+	case FrameProfile::Uneven: return random->randomDouble(0.004, 0.04);
+	default: return frame % 100 == 99 ? 0.5 : 1.0 / 60.0;
+	}
+}
+
+void RunTimestepBench(unsigned frames)
+{
+	printf("%-8s %8s %8s %6s %10s %10s %10s %12s %12s\n", "profile", "frames", "steps", "max", "real s",
+		"dropped s", "ms/frame", "raw err", "lerp err");
+
+	for (FrameProfile profile : { FrameProfile::Steady60, FrameProfile::Steady144, FrameProfile::Steady30,
+		FrameProfile::Uneven, FrameProfile::Stalls })
+	{
+		Random random(frameSeed);
+		std::unique_ptr<BenchScene> scene = CreateBoxStackScene(stackSize);
+
+		// Moves along x at a constant speed, so it should be drawn the
+		// same distance further on as each frame's real time
+		RigidBody body;
+		body.SetMass(1);
+		body.SetDamping(1, 1);
+		body.SetAcceleration(0, 0, 0);
+		body.SetVelocity(bodySpeed, 0, 0);
+		body.SetCanSleep(false);
+		body.CalculateDerivedData();
+
+		FixedTimestep clock(stepDuration, maxStepsPerFrame);
+		TransformInterpolator interpolator;
+
+		double realTime = 0, physicsTime = 0;
+		double lastRaw = 0, lastDrawn = 0;
+		double rawError = 0, drawnError = 0;
+		unsigned maxSteps = 0;
+		bool started = false;
+
+		for (unsigned frame = 0; frame < frames; frame++)
+		{
+			double frameDuration = GetFrameDuration(profile, frame, &random);
+			double dropped = clock.GetDroppedTime();
+			realTime += frameDuration;
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			unsigned steps = clock.Advance(frameDuration);
+			for (unsigned step = 0; step < steps; step++)
+			{
+				if (step == steps - 1) interpolator.Capture(*body.GetStore());
+				body.Integrate(clock.GetStepDuration());
+				scene->Step(clock.GetStepDuration());
+			}
+			physicsTime += SecondsSince(start);
+			if (steps > maxSteps) maxSteps = steps;
+
+			double raw = body.GetPosition().x;
+			double drawn = interpolator.GetTransform(body, clock.GetAlpha()).getAxisVector(3).x;
+
+			// Frames that dropped time cannot keep up, so only the ones
+			// that kept it are checked, in steps of distance off. Until
+			// the first step there is nothing to draw between.
+			if (started && clock.GetDroppedTime() == dropped)
+			{
+				double expected = bodySpeed * frameDuration;
+				double step = bodySpeed * stepDuration;
+				rawError = fmax(rawError, fabs(raw - lastRaw - expected) / step);
+				drawnError = fmax(drawnError, fabs(drawn - lastDrawn - expected) / step);
+			}
+			lastRaw = raw;
+			lastDrawn = drawn;
+			started = clock.GetStepCount() > 0;
+		}
+
+		printf("%-8s %8u %8llu %6u %10.3f %10.3f %10.4f %12.4f %12.4f\n",
+			frameProfileNames[(int)profile], frames, clock.GetStepCount(), maxSteps, realTime,
+			clock.GetDroppedTime(), physicsTime * 1e3 / frames, rawError, drawnError);
+	}
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the fixed timestep benchmark, which feeds the
+ * scheduler made up frame times and checks how evenly the frames
+ * drawn from it move.
+ */
+
+/**
+ * For each of a set of frame rates, some steady, some uneven and one
+ * with long stalls, runs the given number of frames of the box stack
+ * through a FixedTimestep. Prints the steps run, the most run in one
+ * frame, the time the cap dropped and the physics cost per frame,
+ * with how far from where it should be a body moving at a constant
+ * speed is drawn, with and without interpolation between steps.
+ */
+void RunTimestepBench(unsigned frames);
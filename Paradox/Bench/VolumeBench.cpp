@@ -0,0 +1,147 @@
+#include "VolumeBench.h"
+#include "BenchScenes.h"
+#include "../Physics/CollideCoarse.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Frame length the scenes are stepped with
+static const double stepDuration = 1.0 / 60.0;
+
+// Scenes made of boxes and the sizes they are run at. Free bodies is
+// kept small as every pair is tested
+struct VolumeBenchScene
+{
+	const char* name;
+	unsigned size;
+};
+
+static const VolumeBenchScene volumeScenes[] =
+{
+	{ "box_stack", 4 },
+	{ "ragdoll_chain", 12 },
+	{ "free_bodies", 12 },
+};
+
+static double SecondsSince(const std::chrono::steady_clock::time_point& start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Makes the bounding volume of the given kind around a box
+static BoundingSphereVolume MakeSphere(const CollisionBox& box)
+{
+	return BoundingSphereVolume(box.GetAxis(3), box.halfSize.magnitude());
+}
+
+static BoundingBoxVolume MakeBox(const CollisionBox& box)
+{
+	const Matrix4& transform = box.GetTransform();
+	Vector3 centre = transform.getAxisVector(3);
+	Vector3 extent;
+	for (unsigned axis = 0; axis < 3; axis++)
+	{
+		const double* row = transform.data + axis * 4;
+		extent[axis] = abs(row[0]) * box.halfSize.x + abs(row[1]) * box.halfSize.y + abs(row[2]) * box.halfSize.z;
+	}
+	return BoundingBoxVolume(centre - extent, centre + extent);
+}
+
+static BoundingOrientedBoxVolume MakeOrientedBox(const CollisionBox& box)
+{
+	return BoundingOrientedBoxVolume(box.GetTransform(), box.halfSize);
+}
+
+// What was measured for one kind of volume in one scene
+struct VolumeResult
+{
+	// Pairs whose volumes overlap, out of every pair of boxes
+	unsigned long long pairs;
+
+	// Time for one overlap test, in nanoseconds
+	double testTime;
+
+	// Time to build a BVHNode hierarchy and search it, in milliseconds
+	double hierarchyTime;
+	unsigned hierarchyPairs;
+};
+
+template <class BoundingVolumeClass>
+static VolumeResult MeasureVolumes(const BenchScene& scene,
+	BoundingVolumeClass (*make)(const CollisionBox& box))
+{
+	std::vector<BoundingVolumeClass> volumes;
+	for (const std::unique_ptr<CollisionBox>& box : scene.boxes) volumes.push_back(make(*box));
+	unsigned count = (unsigned)volumes.size();
+
+	VolumeResult result;
+
+	// Every pair against each other
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	unsigned long long pairs = 0;
+	for (unsigned i = 0; i < count; i++)
+	{
+		for (unsigned j = i + 1; j < count; j++)
+		{
+			if (volumes[i].Overlaps(&volumes[j])) pairs++;
+		}
+	}
+	double tests = count * (count - 1) * 0.5;
+	result.testTime = tests > 0 ? SecondsSince(start) * 1e9 / tests : 0;
+	result.pairs = pairs;
+
+	// The same volumes in a hierarchy
+	start = std::chrono::steady_clock::now();
+	BVHNode<BoundingVolumeClass>* root = NULL;
+	for (unsigned i = 0; i < count; i++)
+	{
+		RigidBody* body = scene.boxes[i]->body;
+		if (root) root->Insert(body, volumes[i]);
+		else root = new BVHNode<BoundingVolumeClass>(NULL, volumes[i], body);
+	}
+	std::vector<PotentialContact> contacts;
+	result.hierarchyPairs = root ? root->GetPotentialContacts(contacts) : 0;
+	result.hierarchyTime = SecondsSince(start) * 1000.0;
+	delete root;
+
+	return result;
+}
+
+static void PrintResult(const char* scene, const char* volume, const VolumeResult& result,
+	unsigned long long exactPairs)
+{
+	// The share of the pairs let through that really touch
+	double efficiency = result.pairs > 0 ? 100.0 * exactPairs / result.pairs : 100.0;
+
+	printf("%-14s %-8s %10llu %12.1f %10.2f %12.3f %10u\n", scene, volume,
+		result.pairs, efficiency, result.testTime, result.hierarchyTime, result.hierarchyPairs);
+}
+
+void RunVolumeBench(unsigned steps)
+{
+	printf("%-14s %-8s %10s %12s %10s %12s %10s\n",
+		"scene", "volume", "pairs", "exact %", "ns/test", "bvh ms", "bvh pairs");
+
+	for (const VolumeBenchScene& entry : volumeScenes)
+	{
+		const BenchSceneDesc* desc = GetBenchScenes();
+		while (desc->name && strcmp(desc->name, entry.name)) desc++;
+		if (!desc->name) continue;
+
+		std::unique_ptr<BenchScene> scene = desc->create(entry.size);
+		for (unsigned step = 0; step < steps; step++) scene->Step(stepDuration);
+
+		VolumeResult spheres = MeasureVolumes(*scene, MakeSphere);
+		VolumeResult boxes = MeasureVolumes(*scene, MakeBox);
+		VolumeResult orientedBoxes = MeasureVolumes(*scene, MakeOrientedBox);
+
+		// The oriented box of a box is the box itself, so the pairs it
+		// lets through are the ones that really touch
+		unsigned long long exactPairs = orientedBoxes.pairs;
+
+		PrintResult(entry.name, "sphere", spheres, exactPairs);
+		PrintResult(entry.name, "aabb", boxes, exactPairs);
+		PrintResult(entry.name, "obb", orientedBoxes, exactPairs);
+	}
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the bounding volume benchmark, which compares
+ * how well spheres, axis aligned boxes and oriented boxes cull the
+ * pairs of bodies in the box-heavy bench scenes, and what it costs.
+ */
+
+/**
+ * Steps each box scene the given number of times, so that boxes have
+ * settled and turned, then prints a table of results for every kind
+ * of bounding volume.
+ */
+void RunVolumeBench(unsigned steps);
@@ -10,10 +10,11 @@ Graphics::Graphics(Config config)
 	:
 	m_D3DParams(config.width, config.height, true),
 	m_Gravity(Vector3(0.0, -2.0, 0.0)),
+	contacts(maxContacts),
 	resolver(maxContacts * 8),
 	physicsDemo(false)
 {
-	cData.contactArray = contacts;
+	cData.contactArray = NULL;
 	gt = GameTimer();
 	gt.Start();
 }
@@ -38,7 +39,8 @@ void Graphics::Init(HWND hwnd)
 
 		m_Gravity = Gravity(gravityAmount);
 
-		cubeBody.body = new RigidBody;
+		// The cube is a member rather than on the heap, so it goes with us
+		cubeBody.body = &cubeBodyRB;
 		cubeBody.body->SetPosition(Vector3(0, 4, 0));
 		cubeBody.body->SetMass(1.0f);
 		cubeBody.halfSize = Vector3(0.1, 0.1, 0.1);
@@ -145,30 +147,31 @@ void Graphics::Update()
 
 	if (physicsDemo)
 	{
-	//	float duration = (float)TimingData::get().lastFrameDuration * 0.001f;
-	//	if (duration <= 0.0f) return;
+		// Run the steps the real time since the last frame calls for,
+		// the simulation rate no longer depends on the frame rate
+		unsigned steps = physicsClock.Advance(gt.DeltaTime());
+		double duration = physicsClock.GetStepDuration();
 
-		float duration = 0.03f;
-
-		// Start with no forces or acceleration
-		cubeBody.body->ClearAccumulators();
-
-		// Add the forces acting on the cube
-		registry.updateForces(duration);
+		for (unsigned step = 0; step < steps; step++)
+		{
+			// The frame is drawn between the last two states
+			if (step == steps - 1) renderTransforms.Capture(*cubeBody.body->GetStore());
 
-	//	cubeBody.body->AddForce(gravityAmount);
+			// Start with no forces or acceleration
+			cubeBody.body->ClearAccumulators();
 
-		// Update the cubes physics
-	//	cubeBody.body->Integrate(duration);
+			// Add the forces acting on the cube
+			registry.updateForces(duration);
 
-		// Update the objects
-		updateObjects(duration);
+			// Update the objects
+			updateObjects(duration);
 
-		// Perform the contact generation
-		generateContacts();
+			// Perform the contact generation
+			generateContacts();
 
-		// Resolve the detected contacts
-		resolver.ResolveContacts(cData.contactArray, cData.contactCount, duration);
+			// Resolve the detected contacts
+			resolver.ResolveContacts(cData.contactArray, cData.contactCount, duration);
+		}
 	}
 
 	UpdateLightsSceneCB();
@@ -1371,7 +1374,7 @@ void Graphics::UpdateObjectCBs()
 
 			if (renderItem->name == "skull")
 			{
-				Matrix4 skullWorldMat = cubeBody.body->GetTransform();
+				Matrix4 skullWorldMat = renderTransforms.GetTransform(*cubeBody.body, physicsClock.GetAlpha());
 				float skullWorld0 = skullWorldMat.data[0];
 				float skullWorld1 = skullWorldMat.data[1];
 				float skullWorld2 = skullWorldMat.data[2];
@@ -2730,21 +2733,25 @@ void Graphics::generateContacts()
 	plane.direction = Vector3(0, 1, 0);
 	plane.offset = 0;
 
-	// Set up the collision data structure
-	cData.Reset(maxContacts);
-	cData.friction = 0.9;
-	cData.restitution = 0;
-	cData.tolerance = 0;
-
 //	Matrix4 transform, otherTransform;
 //	Vector3 position, otherPosition;
 
-	if (!cData.HasMoreContacts()) return;
-	if (CollisionDetector::BoxAndHalfSpace(cubeBody, plane, &cData))
+	// Set up the collision data structure and generate the contacts,
+	// again with more room if they filled it so none of them are lost
+	do
 	{
-		cubeBody.body->SetAcceleration(Vector3(0, 0, 0));
-		cubeBody.body->SetVelocity(Vector3(0, 0, 0));
-	};
+		cData.contactArray = contacts.GetContacts();
+		cData.Reset(contacts.GetCapacity());
+		cData.friction = 0.9;
+		cData.restitution = 0;
+		cData.tolerance = 0;
+
+		if (CollisionDetector::BoxAndHalfSpace(cubeBody, plane, &cData))
+		{
+			cubeBody.body->SetAcceleration(Vector3(0, 0, 0));
+			cubeBody.body->SetVelocity(Vector3(0, 0, 0));
+		};
+	} while (!cData.HasMoreContacts() && contacts.Grow());
 }
 
 void Graphics::updateObjects(double duration)
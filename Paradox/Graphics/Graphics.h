@@ -5,6 +5,7 @@
 #include "FrameResource.h"
 #include "../Physics/PhysicsApp.h"
 #include "../Physics/ForceGen.h"
+#include "../Physics/FixedTimestep.h"
 #include "LoadM3d.h"
 #include "../GameTimer.h"
 
@@ -136,11 +137,11 @@ public:
 
 protected:
 
-	// Holds the maximum number of contacts
+	// Holds the number of contacts there is room for to start with
 	const static unsigned maxContacts = 256;
 
-	// Holds the array of contacts
-	Contact contacts[maxContacts];
+	// Holds the contacts, given more room when they do not fit
+	ContactArena contacts;
 
 	// Holds the collision data structure for collision detection
 	CollisionData cData;
@@ -148,6 +149,12 @@ protected:
 	// Holds the contact resolver
 	ContactResolver resolver;
 
+	// Turns the real frame time into fixed physics steps
+	FixedTimestep physicsClock;
+
+	// Holds the bodies' state before the last step, to draw between steps
+	TransformInterpolator renderTransforms;
+
 private:
 	D3D12Params m_D3DParams;
 	D3D12Objects m_D3DObjects;
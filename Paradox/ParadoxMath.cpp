@@ -1,4 +1,4 @@
-#include "../ParadoxMath.h"
+#include "ParadoxMath.h"
 
 const Vector3 Vector3::GRAVITY = Vector3(0, -9.81, 0);
 const Vector3 Vector3::HIGH_GRAVITY = Vector3(0, -19.62, 0);
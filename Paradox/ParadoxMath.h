@@ -1,9 +1,16 @@
 #pragma once
+
+#ifdef _WIN32
 #include "Graphics/core.h"
 
 using namespace DirectX;
+#endif
+
+#include <math.h>
 
+#ifndef M_PI
 #define M_PI 3.14159265358979323846
+#endif
 
 /**
  * Holds a vector in 3 dimensions. Four data members are allocated
@@ -340,7 +347,7 @@ public:
 
 	}
 
-	void Quaternion::Normalize()
+	void Normalize()
 	{
 		double length = r * r + i * i + j * j + k * k;
 
@@ -368,10 +375,10 @@ public:
 		r = q.r * multiplier.r - q.i * multiplier.i - q.j * multiplier.j - q.k * multiplier.k;
 		i = q.r * multiplier.i + q.i * multiplier.r + q.j * multiplier.k - q.k * multiplier.j;
 		j = q.r * multiplier.j + q.j * multiplier.r + q.k * multiplier.i - q.i * multiplier.k;
-		k = q.r * multiplier.k + q.k * multiplier.r + q.i * multiplier.j - q.j * multiplier.k;
+		k = q.r * multiplier.k + q.k * multiplier.r + q.i * multiplier.j - q.j * multiplier.i;
 	}
 
-	void Quaternion::AddScaledVector(const Vector3& vector, double scale)
+	void AddScaledVector(const Vector3& vector, double scale)
 	{
 		Quaternion q(0, vector.x * scale, vector.y * scale, vector.z * scale);
 		q *= *this;
@@ -382,7 +389,7 @@ public:
 		k += q.k * (0.5);
 	}
 
-	void Quaternion::RotateByVector(const Vector3& vector)
+	void RotateByVector(const Vector3& vector)
 	{
 		Quaternion q(0, vector.x, vector.y, vector.z);
 		(*this) *= q;
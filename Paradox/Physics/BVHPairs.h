@@ -0,0 +1,187 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the parallel search for potential contacts over
+ * a BVHNode hierarchy, run on the world's worker pool.
+ */
+
+#include "CollideCoarse.h"
+#include "WorkerPool.h"
+
+/**
+ * Finds the same potential contacts as BVHNode::GetPotentialContacts,
+ * in the same order, spread over the threads of a worker pool.
+ *
+ * The top of the search is unrolled on the calling thread, one level
+ * at a time, until there are many more pairs of subtrees to search
+ * than threads. A pair of a subtree with itself stands for the pairs
+ * within that subtree. Each of those pairs is then an item for the pool, and
+ * threads that finish early take the next item still waiting, so one
+ * deep subtree does not hold the others up. Every thread appends to a
+ * list of its' own, and the lists are stitched together in item order
+ * at the end, so the result does not depend on the thread count.
+ */
+template<class BoundingVolumeClass>
+class BVHPairFinder : public WorkerTask
+{
+public:
+	typedef BVHNode<BoundingVolumeClass> Node;
+
+	// Creates a finder that aims for the given number of items per thread
+	BVHPairFinder(unsigned itemsPerThread = 16)
+		:
+		itemsPerThread(itemsPerThread)
+	{
+	}
+
+	/**
+	 * Checks the potential contacts from the given node downwards in
+	 * the hierarchy using the given pool, appending them to the given
+	 * list. Returns the number of potential contacts it found.
+	 */
+	unsigned GetPotentialContacts(const Node* root, std::vector<PotentialContact>& contacts, WorkerPool& pool);
+
+	// Returns how many items the last search was split into
+	unsigned GetItemCount() const
+	{
+		return (unsigned)items.size();
+	}
+
+	virtual void Execute(unsigned item, unsigned worker);
+
+private:
+	struct NodePair
+	{
+		const Node* one;
+		const Node* two;
+	};
+
+	// Where in its' worker's list an item put the contacts it found
+	struct ItemOutput
+	{
+		unsigned worker;
+		size_t begin;
+		size_t end;
+	};
+
+	// Unrolls the search from the root until there are at least the
+	// given number of items, or nothing left to unroll
+	void Split(const Node* root, unsigned target);
+
+	unsigned itemsPerThread;
+
+	std::vector<NodePair> items;
+	std::vector<NodePair> nextItems;
+	std::vector<ItemOutput> outputs;
+
+	// One list of contacts for each worker
+	std::vector<std::vector<PotentialContact>> buffers;
+};
+
+template<class BoundingVolumeClass>
+void BVHPairFinder<BoundingVolumeClass>::Split(const Node* root, unsigned target)
+{
+	items.clear();
+	NodePair top = { root, root };
+	items.push_back(top);
+
+	// Each pair is replaced by the pairs it would recurse into, in the
+	// order it would visit them, so the items keep the serial order
+	bool unrolled = true;
+	while (unrolled && items.size() < target)
+	{
+		unrolled = false;
+		nextItems.clear();
+
+		for (const NodePair& pair : items)
+		{
+			// The pairs within a subtree are those within each child,
+			// then those between the children
+			if (pair.one == pair.two)
+			{
+				if (pair.one->IsLeaf()) continue;
+
+				const Node* one = pair.one->children[0];
+				const Node* two = pair.one->children[1];
+				NodePair withinOne = { one, one };
+				NodePair withinTwo = { two, two };
+				NodePair between = { one, two };
+				nextItems.push_back(withinOne);
+				nextItems.push_back(withinTwo);
+				nextItems.push_back(between);
+				unrolled = true;
+				continue;
+			}
+
+			if (!pair.one->Overlaps(pair.two)) continue;
+
+			if (pair.one->IsLeaf() && pair.two->IsLeaf())
+			{
+				nextItems.push_back(pair);
+				continue;
+			}
+
+			NodePair first = pair;
+			NodePair second = pair;
+			if (pair.one->DescendsFirst(pair.two))
+			{
+				first.one = pair.one->children[0];
+				second.one = pair.one->children[1];
+			}
+			else
+			{
+				first.two = pair.two->children[0];
+				second.two = pair.two->children[1];
+			}
+			nextItems.push_back(first);
+			nextItems.push_back(second);
+			unrolled = true;
+		}
+
+		items.swap(nextItems);
+	}
+}
+
+template<class BoundingVolumeClass>
+unsigned BVHPairFinder<BoundingVolumeClass>::GetPotentialContacts(
+	const Node* root, std::vector<PotentialContact>& contacts, WorkerPool& pool)
+{
+	if (!root || root->IsLeaf()) return 0;
+
+	Split(root, pool.GetThreadCount() * itemsPerThread);
+
+	buffers.resize(pool.GetThreadCount());
+	for (std::vector<PotentialContact>& buffer : buffers) buffer.clear();
+	outputs.resize(items.size());
+
+	pool.Run(this, (unsigned)items.size());
+
+	size_t total = 0;
+	for (const ItemOutput& output : outputs) total += output.end - output.begin;
+
+	size_t first = contacts.size();
+	contacts.reserve(first + total);
+	for (const ItemOutput& output : outputs)
+	{
+		const std::vector<PotentialContact>& buffer = buffers[output.worker];
+		contacts.insert(contacts.end(), buffer.begin() + output.begin, buffer.begin() + output.end);
+	}
+
+	return (unsigned)(contacts.size() - first);
+}
+
+template<class BoundingVolumeClass>
+void BVHPairFinder<BoundingVolumeClass>::Execute(unsigned item, unsigned worker)
+{
+	std::vector<PotentialContact>& buffer = buffers[worker];
+
+	ItemOutput& output = outputs[item];
+	output.worker = worker;
+	output.begin = buffer.size();
+	const NodePair& pair = items[item];
+	if (pair.one == pair.two) pair.one->GetPotentialContacts(buffer);
+	else pair.one->GetPotentialContactsWith(pair.two, buffer);
+	output.end = buffer.size();
+}
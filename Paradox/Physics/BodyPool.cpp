@@ -0,0 +1,79 @@
+#include "BodyPool.h"
+#include <assert.h>
+#include <new>
+
+BodyPool::BodyPool()
+	:
+	count(0)
+{
+}
+
+BodyPool::~BodyPool()
+{
+	for (unsigned place = 0; place < alive.size(); place++)
+	{
+		if (!alive[place]) continue;
+		GetPlaceBody(place)->~RigidBody();
+	}
+}
+
+void BodyPool::AddBlock()
+{
+	blocks.push_back(std::unique_ptr<Block>(new Block));
+	alive.resize(blocks.size() * blockSize, false);
+	freePlaces.reserve(alive.size());
+
+	// Pushed backwards so that the block fills from its' start
+	unsigned first = (unsigned)(blocks.size() - 1) * blockSize;
+	for (unsigned i = blockSize; i > 0; i--) freePlaces.push_back(first + i - 1);
+}
+
+void BodyPool::Reserve(unsigned capacity)
+{
+	while (GetCapacity() < capacity) AddBlock();
+}
+
+unsigned BodyPool::FindPlace(const RigidBody* body) const
+{
+	// The slot may since hold a body of another store, or one the pool
+	// did not create, so the place must hold this very body
+	unsigned slot = body->GetHandle() & bodyHandleSlotMask;
+	if (slot >= slotPlaces.size()) return GetCapacity();
+
+	unsigned place = slotPlaces[slot];
+	if (place >= alive.size() || !alive[place] || GetPlaceBody(place) != body) return GetCapacity();
+	return place;
+}
+
+RigidBody* BodyPool::Create(BodyStore* store)
+{
+	if (freePlaces.empty()) AddBlock();
+
+	unsigned place = freePlaces.back();
+	freePlaces.pop_back();
+	alive[place] = true;
+	count++;
+
+	RigidBody* body = new (GetPlaceBody(place)) RigidBody(store);
+	unsigned slot = body->GetHandle() & bodyHandleSlotMask;
+	if (slot >= slotPlaces.size()) slotPlaces.resize(slot + 1, GetCapacity());
+	slotPlaces[slot] = place;
+	return body;
+}
+
+void BodyPool::Destroy(RigidBody* body)
+{
+	unsigned place = FindPlace(body);
+	assert(place < alive.size());
+
+	body->~RigidBody();
+	alive[place] = false;
+	freePlaces.push_back(place);
+	count--;
+}
+
+bool BodyPool::Owns(const RigidBody* body) const
+{
+	unsigned place = FindPlace(body);
+	return place < alive.size() && alive[place];
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the pool World creates its' own bodies in, so
+ * that bodies can be created and destroyed many times a second
+ * without going to the system allocator.
+ */
+
+#include "body.h"
+#include <memory>
+#include <vector>
+
+/**
+ * Holds rigid bodies in blocks of a fixed number each. A destroyed
+ * body's place goes on a free list and the next body created takes
+ * it, so once the pool has grown to the most bodies alive at once,
+ * creating and destroying bodies does not allocate. Blocks are never
+ * moved or freed before the pool is, so a body stays where it was
+ * created.
+ */
+class BodyPool
+{
+public:
+	// Bodies in each block the pool grows by
+	static const unsigned blockSize = 256;
+
+	BodyPool();
+
+	// Destroys any bodies still in the pool
+	~BodyPool();
+
+	BodyPool(const BodyPool&) = delete;
+	BodyPool& operator=(const BodyPool&) = delete;
+
+	// Creates a body in the given store, growing by a block if none are free
+	RigidBody* Create(BodyStore* store);
+
+	// Destroys a body the pool created, which removes it from its' store
+	void Destroy(RigidBody* body);
+
+	// Returns true if the body is one the pool created and has not destroyed
+	bool Owns(const RigidBody* body) const;
+
+	// Grows the pool to hold at least the given number of bodies
+	void Reserve(unsigned capacity);
+
+	// Returns the number of bodies alive in the pool
+	unsigned GetCount() const
+	{
+		return count;
+	}
+
+	// Returns the number of bodies the pool can hold without growing
+	unsigned GetCapacity() const
+	{
+		return (unsigned)blocks.size() * blockSize;
+	}
+
+private:
+	// Raw storage for a block of bodies, constructed as they are created
+	struct Block
+	{
+		alignas(RigidBody) unsigned char storage[blockSize * sizeof(RigidBody)];
+	};
+
+	std::vector<std::unique_ptr<Block>> blocks;
+
+	// Places not holding a body, taken from the back
+	std::vector<unsigned> freePlaces;
+
+	// By place, whether it holds a body
+	std::vector<bool> alive;
+
+	// By the handle slot of each body created, its' place, so that a
+	// body is found without searching the blocks
+	std::vector<unsigned> slotPlaces;
+
+	unsigned count;
+
+	void AddBlock();
+
+	// Returns the body at the given place, whether it holds one or not
+	RigidBody* GetPlaceBody(unsigned place) const
+	{
+		return (RigidBody*)blocks[place / blockSize]->storage + place % blockSize;
+	}
+
+	// Returns the place of the given body, or GetCapacity() if it is
+	// not a body the pool holds
+	unsigned FindPlace(const RigidBody* body) const;
+};
@@ -0,0 +1,487 @@
+#include "BodyStore.h"
+#include "body.h"
+#include <assert.h>
+#include <string.h>
+
+BodyStore::BodyStore()
+	:
+	integratorPath(GetBestIntegratorPath()),
+	deterministic(false),
+	dampingDuration(-1),
+	continuousCount(0)
+{
+}
+
+BodyStore::~BodyStore()
+{
+	// Any views still referring to us are orphaned, they must be
+	// moved to another store before we are destroyed
+	assert(views.empty() || this == &GetDefault());
+}
+
+BodyStore& BodyStore::GetDefault()
+{
+	// Never destroyed, so bodies with static lifetime stay valid
+	static BodyStore* defaultStore = new BodyStore();
+	return *defaultStore;
+}
+
+void BodyStore::Reserve(unsigned capacity)
+{
+	position.x.reserve(capacity); position.y.reserve(capacity); position.z.reserve(capacity);
+	velocity.x.reserve(capacity); velocity.y.reserve(capacity); velocity.z.reserve(capacity);
+	rotation.x.reserve(capacity); rotation.y.reserve(capacity); rotation.z.reserve(capacity);
+	orientation.r.reserve(capacity); orientation.i.reserve(capacity);
+	orientation.j.reserve(capacity); orientation.k.reserve(capacity);
+	inverseMass.reserve(capacity);
+	forceAccum.x.reserve(capacity); forceAccum.y.reserve(capacity); forceAccum.z.reserve(capacity);
+	torqueAccum.x.reserve(capacity); torqueAccum.y.reserve(capacity); torqueAccum.z.reserve(capacity);
+
+	acceleration.x.reserve(capacity); acceleration.y.reserve(capacity); acceleration.z.reserve(capacity);
+	linearDamping.reserve(capacity);
+	angularDamping.reserve(capacity);
+	linearDampingFactor.reserve(capacity);
+	angularDampingFactor.reserve(capacity);
+	inverseInertiaTensor.reserve(capacity);
+	isAwake.reserve(capacity);
+	canSleep.reserve(capacity);
+	motion.reserve(capacity);
+	continuousRadius.reserve(capacity);
+
+	lastFrameAcceleration.x.reserve(capacity);
+	lastFrameAcceleration.y.reserve(capacity);
+	lastFrameAcceleration.z.reserve(capacity);
+	inverseInertiaTensorWorld.reserve(capacity);
+	transformationMatrix.reserve(capacity);
+
+	views.reserve(capacity);
+	indexToHandle.reserve(capacity);
+	handleToIndex.reserve(capacity);
+	slotHandles.reserve(capacity);
+	freeSlots.reserve(capacity);
+}
+
+void BodyStore::Resize(size_t size)
+{
+	position.Resize(size);
+	velocity.Resize(size);
+	rotation.Resize(size);
+	orientation.Resize(size);
+	inverseMass.resize(size);
+	forceAccum.Resize(size);
+	torqueAccum.Resize(size);
+
+	acceleration.Resize(size);
+	linearDamping.resize(size);
+	angularDamping.resize(size);
+	linearDampingFactor.resize(size);
+	angularDampingFactor.resize(size);
+	inverseInertiaTensor.resize(size);
+	isAwake.resize(size);
+	canSleep.resize(size);
+	motion.resize(size);
+	continuousRadius.resize(size);
+
+	lastFrameAcceleration.Resize(size);
+	inverseInertiaTensorWorld.resize(size);
+	transformationMatrix.resize(size);
+
+	views.resize(size);
+	indexToHandle.resize(size);
+}
+
+BodyHandle BodyStore::Allocate(RigidBody* view)
+{
+	unsigned index = Size();
+	Resize(index + 1);
+
+	// Reuse the slot of a released body if there is one, its' handle
+	// was moved on to a new generation when the body was released
+	BodyHandle handle;
+	if (!freeSlots.empty())
+	{
+		unsigned slot = freeSlots.back();
+		freeSlots.pop_back();
+		handleToIndex[slot] = index;
+		handle = slotHandles[slot];
+	}
+	else
+	{
+		assert(handleToIndex.size() <= bodyHandleSlotMask);
+		handle = (BodyHandle)handleToIndex.size();
+		handleToIndex.push_back(index);
+		slotHandles.push_back(handle);
+	}
+
+	views[index] = view;
+	indexToHandle[index] = handle;
+
+	view->store = this;
+	view->index = index;
+
+	// Start from an unrotated, immovable body at the origin
+	position.Clear(index);
+	velocity.Clear(index);
+	rotation.Clear(index);
+	orientation.Set(index, Quaternion());
+	inverseMass[index] = 0;
+	forceAccum.Clear(index);
+	torqueAccum.Clear(index);
+
+	acceleration.Clear(index);
+	linearDamping[index] = 1;
+	angularDamping[index] = 1;
+	linearDampingFactor[index] = 1;
+	angularDampingFactor[index] = 1;
+	inverseInertiaTensor[index] = Matrix3();
+	isAwake[index] = true;
+	canSleep[index] = true;
+	motion[index] = sleepEpsilon * 2.0;
+	continuousRadius[index] = 0;
+
+	lastFrameAcceleration.Clear(index);
+	inverseInertiaTensorWorld[index] = Matrix3();
+	transformationMatrix[index] = Matrix4();
+
+	return handle;
+}
+
+void BodyStore::MoveBody(unsigned to, unsigned from)
+{
+	CopyBody(to, *this, from);
+
+	views[to] = views[from];
+	indexToHandle[to] = indexToHandle[from];
+	handleToIndex[indexToHandle[to] & bodyHandleSlotMask] = to;
+
+	views[to]->index = to;
+}
+
+void BodyStore::Release(unsigned index)
+{
+	assert(index < Size());
+
+	// The slot's next body gets a handle of the next generation, so
+	// this body's handle no longer matches it
+	BodyHandle handle = indexToHandle[index];
+	unsigned slot = handle & bodyHandleSlotMask;
+	BodyHandle next = handle + (1u << bodyHandleSlotBits);
+	if (next == invalidBodyHandle) next = slot;
+	slotHandles[slot] = next;
+	freeSlots.push_back(slot);
+
+	// Keep the arrays dense by filling the hole with the last body
+	SetContinuousRadius(index, 0);
+	unsigned last = Size() - 1;
+	if (index != last)
+	{
+		MoveBody(index, last);
+		SetContinuousRadius(last, 0);
+	}
+
+	Resize(last);
+}
+
+BodyHandle BodyStore::Adopt(RigidBody* view)
+{
+	BodyStore* source = view->store;
+	unsigned sourceIndex = view->index;
+	if (source == this) return indexToHandle[sourceIndex];
+
+	BodyHandle handle = Allocate(view);
+	CopyBody(view->index, *source, sourceIndex);
+
+	source->Release(sourceIndex);
+	return handle;
+}
+
+void BodyStore::CopyBody(unsigned index, const BodyStore& source, unsigned sourceIndex)
+{
+	position.Set(index, source.position.Get(sourceIndex));
+	velocity.Set(index, source.velocity.Get(sourceIndex));
+	rotation.Set(index, source.rotation.Get(sourceIndex));
+	orientation.Set(index, source.orientation.Get(sourceIndex));
+	inverseMass[index] = source.inverseMass[sourceIndex];
+	forceAccum.Set(index, source.forceAccum.Get(sourceIndex));
+	torqueAccum.Set(index, source.torqueAccum.Get(sourceIndex));
+
+	acceleration.Set(index, source.acceleration.Get(sourceIndex));
+	linearDamping[index] = source.linearDamping[sourceIndex];
+	angularDamping[index] = source.angularDamping[sourceIndex];
+	if (&source == this || source.dampingDuration == dampingDuration)
+	{
+		linearDampingFactor[index] = source.linearDampingFactor[sourceIndex];
+		angularDampingFactor[index] = source.angularDampingFactor[sourceIndex];
+	}
+	else UpdateDampingFactors(index, index + 1, dampingDuration);
+	inverseInertiaTensor[index] = source.inverseInertiaTensor[sourceIndex];
+	isAwake[index] = source.isAwake[sourceIndex];
+	canSleep[index] = source.canSleep[sourceIndex];
+	motion[index] = source.motion[sourceIndex];
+	SetContinuousRadius(index, source.continuousRadius[sourceIndex]);
+
+	lastFrameAcceleration.Set(index, source.lastFrameAcceleration.Get(sourceIndex));
+	inverseInertiaTensorWorld[index] = source.inverseInertiaTensorWorld[sourceIndex];
+	transformationMatrix[index] = source.transformationMatrix[sourceIndex];
+}
+
+void BodyStore::ClearAccumulators(unsigned begin, unsigned end)
+{
+	for (unsigned b = begin; b < end; b++)
+	{
+		forceAccum.x[b] = forceAccum.y[b] = forceAccum.z[b] = 0;
+		torqueAccum.x[b] = torqueAccum.y[b] = torqueAccum.z[b] = 0;
+	}
+}
+
+void BodyStore::CalculateDerivedData(unsigned begin, unsigned end)
+{
+	::CalculateDerivedData(integratorPath, GetArrays(), begin, end);
+}
+
+void BodyStore::Integrate(unsigned begin, unsigned end, double duration)
+{
+	// Damping only needs raising to the power of the duration when
+	// the duration changes, which with a fixed timestep is never
+	if (duration != dampingDuration)
+	{
+		UpdateDampingFactors(begin, end, duration);
+
+		// Only a full pass leaves every factor matching the duration
+		dampingDuration = (begin == 0 && end == Size()) ? duration : -1;
+	}
+
+	IntegrateBodies(integratorPath, GetArrays(), begin, end, duration, !deterministic);
+
+	// Update the kinetic energy store, and possibly
+	// put the body to sleep
+	double bias = Power(0.5, duration);
+	for (unsigned b = begin; b < end; b++)
+	{
+		if (!isAwake[b] || !canSleep[b]) continue;
+
+		double currentMotion =
+			velocity.x[b] * velocity.x[b] + velocity.y[b] * velocity.y[b] + velocity.z[b] * velocity.z[b] +
+			rotation.x[b] * rotation.x[b] + rotation.y[b] * rotation.y[b] + rotation.z[b] * rotation.z[b];
+
+		motion[b] = bias * motion[b] + (1 - bias) * currentMotion;
+
+		if (motion[b] < sleepEpsilon) SetAwake(b, false);
+		else if (motion[b] > 10 * sleepEpsilon) motion[b] = 10 * sleepEpsilon;
+	}
+}
+
+void BodyStore::UpdateDampingFactors(unsigned begin, unsigned end, double duration)
+{
+	for (unsigned b = begin; b < end; b++)
+	{
+		linearDampingFactor[b] = Power(linearDamping[b], duration);
+		angularDampingFactor[b] = Power(angularDamping[b], duration);
+	}
+}
+
+// The natural log of 2, split so that the high part times a small
+// whole number is exact
+static const double ln2High = 6.93147180369123816490e-01;
+static const double ln2Low = 1.90821492927058770002e-10;
+
+/**
+ * Raises a positive base to the given power with nothing but adds,
+ * multiplies and divides, which round the same everywhere, so the
+ * result does not depend on the C library. Bases of zero or less give
+ * zero, which is all damping needs.
+ */
+static double PortablePow(double base, double exponent)
+{
+	if (exponent == 0 || base == 1) return 1;
+	if (base <= 0) return 0;
+
+	// The log of the base is its' exponent times ln 2 plus the log of a
+	// mantissa near one, which the series for atanh finds quickly
+	int baseExponent;
+	double mantissa = frexp(base, &baseExponent);
+	if (mantissa < 0.70710678118654752440)
+	{
+		mantissa *= 2;
+		baseExponent--;
+	}
+	double s = (mantissa - 1) / (mantissa + 1);
+	double s2 = s * s;
+	double series = 0;
+	for (int n = 27; n >= 1; n -= 2) series = series * s2 + 1.0 / n;
+
+	double y = exponent * (baseExponent * ln2High + (baseExponent * ln2Low + 2 * s * series));
+	if (y < -746) return 0;
+	if (y > 710) return HUGE_VAL;
+
+	// e^y is 2^k times e^r, with r no more than half of ln 2 from zero
+	double k = floor(y / (ln2High + ln2Low) + 0.5);
+	double r = (y - k * ln2High) - k * ln2Low;
+	double result = 1;
+	for (int n = 20; n >= 1; n--) result = 1 + result * r / n;
+
+	return ldexp(result, (int)k);
+}
+
+double BodyStore::Power(double base, double exponent) const
+{
+	return deterministic ? PortablePow(base, exponent) : pow(base, exponent);
+}
+
+static const unsigned long long hashPrime = 1099511628211ull;
+
+/**
+ * Folds the bits of each value into the hash, a word at a time. Each
+ * word goes through an xor and a multiply by an odd number, both of
+ * which can be undone, so a change to any one word always changes the
+ * hash. Words are spread over four lanes so that the multiplies do not
+ * wait on each other.
+ */
+template <class T>
+static inline unsigned long long HashWord(unsigned long long lane, const T& value)
+{
+	unsigned long long word = 0;
+	memcpy(&word, &value, sizeof(T));
+	return (lane ^ word) * hashPrime;
+}
+
+template <class T>
+static void HashArray(unsigned long long lanes[4], const std::vector<T>& values, unsigned count)
+{
+	const T* data = values.data();
+	unsigned long long lane0 = lanes[0], lane1 = lanes[1], lane2 = lanes[2], lane3 = lanes[3];
+
+	unsigned i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		lane0 = HashWord(lane0, data[i]);
+		lane1 = HashWord(lane1, data[i + 1]);
+		lane2 = HashWord(lane2, data[i + 2]);
+		lane3 = HashWord(lane3, data[i + 3]);
+	}
+	if (i < count) lane0 = HashWord(lane0, data[i++]);
+	if (i < count) lane1 = HashWord(lane1, data[i++]);
+	if (i < count) lane2 = HashWord(lane2, data[i++]);
+
+	lanes[0] = lane0;
+	lanes[1] = lane1;
+	lanes[2] = lane2;
+	lanes[3] = lane3;
+}
+
+static void HashField(unsigned long long lanes[4], const Vector3Field& field, unsigned count)
+{
+	HashArray(lanes, field.x, count);
+	HashArray(lanes, field.y, count);
+	HashArray(lanes, field.z, count);
+}
+
+unsigned long long BodyStore::HashState() const
+{
+	unsigned count = Size();
+	unsigned long long lanes[4] = { 14695981039346656037ull, 1, 2, 3 };
+	lanes[0] = (lanes[0] ^ count) * hashPrime;
+
+	HashArray(lanes, indexToHandle, count);
+	HashField(lanes, position, count);
+	HashField(lanes, velocity, count);
+	HashField(lanes, rotation, count);
+	HashArray(lanes, orientation.r, count);
+	HashArray(lanes, orientation.i, count);
+	HashArray(lanes, orientation.j, count);
+	HashArray(lanes, orientation.k, count);
+	HashArray(lanes, inverseMass, count);
+	HashField(lanes, forceAccum, count);
+	HashField(lanes, torqueAccum, count);
+	HashField(lanes, acceleration, count);
+	HashArray(lanes, linearDamping, count);
+	HashArray(lanes, angularDamping, count);
+	HashArray(lanes, isAwake, count);
+	HashArray(lanes, canSleep, count);
+	HashArray(lanes, motion, count);
+	HashArray(lanes, continuousRadius, count);
+	HashField(lanes, lastFrameAcceleration, count);
+
+	// Join the lanes the same way, then spread the last words' bits
+	// over the whole hash
+	unsigned long long hash = lanes[0];
+	for (unsigned lane = 1; lane < 4; lane++) hash = (hash ^ lanes[lane]) * hashPrime;
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdull;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+IntegratorArrays BodyStore::GetArrays()
+{
+	IntegratorArrays arrays;
+
+	arrays.positionX = position.x.data(); arrays.positionY = position.y.data(); arrays.positionZ = position.z.data();
+	arrays.velocityX = velocity.x.data(); arrays.velocityY = velocity.y.data(); arrays.velocityZ = velocity.z.data();
+	arrays.rotationX = rotation.x.data(); arrays.rotationY = rotation.y.data(); arrays.rotationZ = rotation.z.data();
+	arrays.orientationR = orientation.r.data(); arrays.orientationI = orientation.i.data();
+	arrays.orientationJ = orientation.j.data(); arrays.orientationK = orientation.k.data();
+	arrays.inverseMass = inverseMass.data();
+	arrays.forceAccumX = forceAccum.x.data(); arrays.forceAccumY = forceAccum.y.data(); arrays.forceAccumZ = forceAccum.z.data();
+	arrays.torqueAccumX = torqueAccum.x.data(); arrays.torqueAccumY = torqueAccum.y.data(); arrays.torqueAccumZ = torqueAccum.z.data();
+	arrays.accelerationX = acceleration.x.data(); arrays.accelerationY = acceleration.y.data(); arrays.accelerationZ = acceleration.z.data();
+	arrays.linearDampingFactor = linearDampingFactor.data();
+	arrays.angularDampingFactor = angularDampingFactor.data();
+	arrays.lastFrameAccelerationX = lastFrameAcceleration.x.data();
+	arrays.lastFrameAccelerationY = lastFrameAcceleration.y.data();
+	arrays.lastFrameAccelerationZ = lastFrameAcceleration.z.data();
+	arrays.isAwake = isAwake.data();
+
+	// Matrix3 and Matrix4 are plain arrays of doubles
+	arrays.inverseInertiaTensor = inverseInertiaTensor.empty() ? NULL : inverseInertiaTensor[0].data;
+	arrays.inverseInertiaTensorWorld = inverseInertiaTensorWorld.empty() ? NULL : inverseInertiaTensorWorld[0].data;
+	arrays.transformationMatrix = transformationMatrix.empty() ? NULL : transformationMatrix[0].data;
+
+	return arrays;
+}
+
+void BodyStore::SetAwake(unsigned index, bool awake)
+{
+	if (awake)
+	{
+		isAwake[index] = true;
+
+		// Add some motion to stop RB falling asleep immediately
+		motion[index] = sleepEpsilon * 2.0f;
+	}
+	else
+	{
+		isAwake[index] = false;
+		velocity.Clear(index);
+		rotation.Clear(index);
+	}
+}
+
+void BodyStore::SetDamping(unsigned index, double linear, double angular)
+{
+	linearDamping[index] = linear;
+	angularDamping[index] = angular;
+	UpdateDampingFactors(index, index + 1, dampingDuration);
+}
+
+void BodyStore::SetContinuousRadius(unsigned index, double radius)
+{
+	if (continuousRadius[index] > 0) continuousCount--;
+	continuousRadius[index] = radius;
+	if (radius > 0) continuousCount++;
+}
+
+void BodyStore::SetIntegratorPath(IntegratorPath path)
+{
+	if (path == IntegratorPath::AVX2 && !IsIntegratorPathSupported(path)) path = IntegratorPath::SSE;
+	if (path == IntegratorPath::SSE && !IsIntegratorPathSupported(path)) path = IntegratorPath::Scalar;
+	integratorPath = path;
+}
+
+void BodyStore::SetDeterministic(bool deterministic)
+{
+	this->deterministic = deterministic;
+
+	// The damping factors are raised again by the other pow
+	dampingDuration = -1;
+}
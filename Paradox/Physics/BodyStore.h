@@ -0,0 +1,312 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the structure-of-arrays storage that backs
+ * every RigidBody. Each field of a body lives in its own contiguous
+ * array so that the per-frame passes (clearing accumulators,
+ * integration, derived data) stream linearly through only the
+ * fields they need, rather than pulling whole bodies through cache.
+ */
+
+#include "../ParadoxMath.h"
+#include "Integrator.h"
+#include <vector>
+
+class RigidBody;
+
+/**
+ * Identifies a body within a store. Handles stay valid while the
+ * body is in the store, even when other bodies are removed and the
+ * arrays are compacted.
+ *
+ * The low bits pick a slot, which is reused once its' body is
+ * removed, and the high bits count how many times it has been. So a
+ * handle kept after its' body is removed stays invalid even when the
+ * slot holds another body, until the count wraps around.
+ */
+typedef unsigned BodyHandle;
+
+const BodyHandle invalidBodyHandle = 0xffffffff;
+
+const unsigned bodyHandleSlotBits = 22;
+const BodyHandle bodyHandleSlotMask = (1u << bodyHandleSlotBits) - 1;
+
+/**
+ * Holds one vector valued field as three component arrays.
+ */
+struct Vector3Field
+{
+	std::vector<double> x;
+	std::vector<double> y;
+	std::vector<double> z;
+
+	Vector3 Get(unsigned index) const
+	{
+		return Vector3(x[index], y[index], z[index]);
+	}
+
+	void Set(unsigned index, const Vector3& vector)
+	{
+		x[index] = vector.x;
+		y[index] = vector.y;
+		z[index] = vector.z;
+	}
+
+	void Clear(unsigned index)
+	{
+		x[index] = y[index] = z[index] = 0;
+	}
+
+	void Resize(size_t size)
+	{
+		x.resize(size);
+		y.resize(size);
+		z.resize(size);
+	}
+};
+
+/**
+ * Holds one quaternion valued field as four component arrays.
+ */
+struct QuaternionField
+{
+	std::vector<double> r;
+	std::vector<double> i;
+	std::vector<double> j;
+	std::vector<double> k;
+
+	Quaternion Get(unsigned index) const
+	{
+		return Quaternion(r[index], i[index], j[index], k[index]);
+	}
+
+	void Set(unsigned index, const Quaternion& q)
+	{
+		r[index] = q.r;
+		i[index] = q.i;
+		j[index] = q.j;
+		k[index] = q.k;
+	}
+
+	void Resize(size_t size)
+	{
+		r.resize(size);
+		i.resize(size);
+		j.resize(size);
+		k.resize(size);
+	}
+};
+
+/**
+ * Stores the state of a set of rigid bodies as parallel arrays.
+ *
+ * Bodies are kept densely packed in [0, Size()): removing a body
+ * moves the last body into its place. RigidBody objects act as views
+ * onto a single index of a store, and are kept up to date when the
+ * body they refer to is moved.
+ */
+class BodyStore
+{
+public:
+	// Hot integration state
+	Vector3Field position;
+	Vector3Field velocity;
+	Vector3Field rotation;
+	QuaternionField orientation;
+	std::vector<double> inverseMass;
+	Vector3Field forceAccum;
+	Vector3Field torqueAccum;
+
+	// Per body constants and settings
+	Vector3Field acceleration;
+	std::vector<double> linearDamping;
+	std::vector<double> angularDamping;
+	std::vector<double> linearDampingFactor;
+	std::vector<double> angularDampingFactor;
+	std::vector<Matrix3> inverseInertiaTensor;
+	std::vector<unsigned char> isAwake;
+	std::vector<unsigned char> canSleep;
+	std::vector<double> motion;
+
+	// Radius of the sphere the world sweeps along the body's path each
+	// step, zero for bodies without continuous collision detection.
+	// Set with SetContinuousRadius, which keeps count of them
+	std::vector<double> continuousRadius;
+
+	// Derived data, rebuilt by CalculateDerivedData
+	Vector3Field lastFrameAcceleration;
+	std::vector<Matrix3> inverseInertiaTensorWorld;
+	std::vector<Matrix4> transformationMatrix;
+
+	BodyStore();
+	~BodyStore();
+
+	// Returns the store used by bodies that are not part of a world
+	static BodyStore& GetDefault();
+
+	// Returns the number of bodies in the store
+	unsigned Size() const
+	{
+		return (unsigned)views.size();
+	}
+
+	// Reserves room for the given number of bodies
+	void Reserve(unsigned capacity);
+
+	/**
+	 * Adds a body with default state to the store, viewed by the
+	 * given RigidBody, and returns its handle.
+	 */
+	BodyHandle Allocate(RigidBody* view);
+
+	/**
+	 * Removes the body at the given index, moving the last body
+	 * into its place.
+	 */
+	void Release(unsigned index);
+
+	/**
+	 * Moves the body viewed by the given RigidBody into this store,
+	 * copying all of its state. The view is updated to refer to
+	 * its new location.
+	 */
+	BodyHandle Adopt(RigidBody* view);
+
+	// Copies every field of one body onto another body
+	void CopyBody(unsigned index, const BodyStore& source, unsigned sourceIndex);
+
+	// Returns the dense index of the body with the given handle
+	unsigned GetIndex(BodyHandle handle) const
+	{
+		return handleToIndex[handle & bodyHandleSlotMask];
+	}
+
+	// Returns true if the handle is of a body still in the store
+	bool IsValid(BodyHandle handle) const
+	{
+		unsigned slot = handle & bodyHandleSlotMask;
+		return slot < slotHandles.size() && slotHandles[slot] == handle;
+	}
+
+	// Returns the handle of the body at the given dense index
+	BodyHandle GetHandle(unsigned index) const
+	{
+		return indexToHandle[index];
+	}
+
+	// Returns the view onto the body at the given dense index
+	RigidBody* GetView(unsigned index) const
+	{
+		return views[index];
+	}
+
+	/////////////////////////////////////////////
+	// Batched passes over a range of bodies
+	/////////////////////////////////////////////
+
+	// Clears the force and torque accumulators of the bodies in [begin, end)
+	void ClearAccumulators(unsigned begin, unsigned end);
+
+	// Rebuilds the transform and world inertia tensor of the bodies in [begin, end)
+	void CalculateDerivedData(unsigned begin, unsigned end);
+
+	/**
+	 * Integrates the bodies in [begin, end) forward by the given
+	 * duration, several bodies at a time on the selected integrator
+	 * path. Damping is only raised to the power of the duration when
+	 * the duration changes.
+	 */
+	void Integrate(unsigned begin, unsigned end, double duration);
+
+	// Wakes or sends to sleep the body at the given index
+	void SetAwake(unsigned index, bool awake);
+
+	// Sets the damping of the body at the given index
+	void SetDamping(unsigned index, double linear, double angular);
+
+	// Sets the continuous collision radius of the body at the given index
+	void SetContinuousRadius(unsigned index, double radius);
+
+	// Returns the number of bodies with a continuous collision radius,
+	// so that stores without any need not look for them
+	unsigned GetContinuousCount() const
+	{
+		return continuousCount;
+	}
+
+	/**
+	 * Selects the instruction set used by the batched passes. Paths
+	 * the processor does not support fall back to the widest one it
+	 * does. Defaults to the widest supported path.
+	 */
+	void SetIntegratorPath(IntegratorPath path);
+
+	IntegratorPath GetIntegratorPath() const
+	{
+		return integratorPath;
+	}
+
+	/**
+	 * In deterministic mode every path gives bit-identical results,
+	 * so a simulation replays exactly on any x86 processor. Outside
+	 * it the AVX2 path may use fused multiply-add, and damping is
+	 * raised to the power of the duration by the C library, whose
+	 * pow may round differently on another platform.
+	 */
+	void SetDeterministic(bool deterministic);
+
+	bool IsDeterministic() const
+	{
+		return deterministic;
+	}
+
+	/**
+	 * Returns a 64 bit hash of the state of every body, in store order,
+	 * taken from the bits of each value so that any difference at all
+	 * changes it. Transforms and world inertia tensors are left out, as
+	 * they follow from the rest.
+	 */
+	unsigned long long HashState() const;
+
+private:
+	// Grows every array to hold the given number of bodies
+	void Resize(size_t size);
+
+	// Moves the body at index from onto index to
+	void MoveBody(unsigned to, unsigned from);
+
+	// Raises the damping of the bodies in [begin, end) to the power of the duration
+	void UpdateDampingFactors(unsigned begin, unsigned end, double duration);
+
+	// Returns pow(base, exponent), worked out the same way on every
+	// platform in deterministic mode
+	double Power(double base, double exponent) const;
+
+	// Gathers pointers to every array for the integrator
+	IntegratorArrays GetArrays();
+
+	IntegratorPath integratorPath;
+	bool deterministic;
+
+	// Duration every damping factor was last raised to, or -1 if mixed
+	double dampingDuration;
+
+	unsigned continuousCount;
+
+	std::vector<RigidBody*> views;
+	std::vector<BodyHandle> indexToHandle;
+
+	// By slot, the index of its' body and the handle it has, or will
+	// be given next if the slot is free
+	std::vector<unsigned> handleToIndex;
+	std::vector<BodyHandle> slotHandles;
+
+	// The slots of removed bodies, to be reused
+	std::vector<unsigned> freeSlots;
+
+	// Stores are referenced by their views and cannot be copied
+	BodyStore(const BodyStore&);
+	BodyStore& operator=(const BodyStore&);
+};
@@ -1,4 +1,5 @@
 #include "CollideCoarse.h"
+#include <algorithm>
 
 BoundingSphereVolume::BoundingSphereVolume(const Vector3& centre, double radius)
 {
@@ -32,7 +33,7 @@ BoundingSphereVolume::BoundingSphereVolume(const BoundingSphereVolume& one, cons
 	else
 	{
 		distance = sqrt(distance);
-		radius = (distance + one.radius + two.radius * ((double)0.5));
+		radius = (distance + one.radius + two.radius) * ((double)0.5);
 
 		// The new centre is based on one's centre, moved toward
 		// two's centre by an amount proportional to the spheres'
@@ -59,3 +60,200 @@ double BoundingSphereVolume::GetGrowth(const BoundingSphereVolume& other) const
 	return newSphere.radius * newSphere.radius - radius * radius;
 }
 
+
+BoundingBoxVolume::BoundingBoxVolume(const BoundingBoxVolume& one, const BoundingBoxVolume& two)
+{
+	min = Vector3(std::min(one.min.x, two.min.x), std::min(one.min.y, two.min.y), std::min(one.min.z, two.min.z));
+	max = Vector3(std::max(one.max.x, two.max.x), std::max(one.max.y, two.max.y), std::max(one.max.z, two.max.z));
+}
+
+double BoundingBoxVolume::GetGrowth(const BoundingBoxVolume& other) const
+{
+	BoundingBoxVolume newBox(*this, other);
+	return newBox.GetSurfaceArea() - GetSurfaceArea();
+}
+
+BoundingOrientedBoxVolume::BoundingOrientedBoxVolume(const Vector3& centre, const Vector3 axes[3], const Vector3& halfSize)
+	:
+	centre(centre),
+	halfSize(halfSize)
+{
+	for (unsigned i = 0; i < 3; i++) this->axes[i] = axes[i];
+}
+
+BoundingOrientedBoxVolume::BoundingOrientedBoxVolume(const Matrix4& transform, const Vector3& halfSize)
+	:
+	centre(transform.getAxisVector(3)),
+	halfSize(halfSize)
+{
+	for (unsigned i = 0; i < 3; i++) axes[i] = transform.getAxisVector(i);
+}
+
+// Finds the box along the given axes that encloses both given boxes
+static void EncloseAlongAxes(const Vector3 axes[3], const BoundingOrientedBoxVolume& one,
+	const BoundingOrientedBoxVolume& two, Vector3* centre, Vector3* halfSize)
+{
+	*centre = Vector3();
+	for (unsigned i = 0; i < 3; i++)
+	{
+		// The shadows of both boxes on the axis, and the span of the two
+		double oneCentre = one.centre * axes[i];
+		double oneHalf = one.ProjectHalfLength(axes[i]);
+		double twoCentre = two.centre * axes[i];
+		double twoHalf = two.ProjectHalfLength(axes[i]);
+
+		double low = std::min(oneCentre - oneHalf, twoCentre - twoHalf);
+		double high = std::max(oneCentre + oneHalf, twoCentre + twoHalf);
+
+		centre->addScaledVector(axes[i], (low + high) * 0.5);
+		(*halfSize)[i] = (high - low) * 0.5;
+	}
+}
+
+BoundingOrientedBoxVolume::BoundingOrientedBoxVolume(const BoundingOrientedBoxVolume& one, const BoundingOrientedBoxVolume& two)
+{
+	Vector3 oneCentre, oneHalfSize;
+	EncloseAlongAxes(one.axes, one, two, &oneCentre, &oneHalfSize);
+
+	Vector3 twoCentre, twoHalfSize;
+	EncloseAlongAxes(two.axes, one, two, &twoCentre, &twoHalfSize);
+
+	// Keep whichever is smaller
+	if (oneHalfSize.x * oneHalfSize.y * oneHalfSize.z <= twoHalfSize.x * twoHalfSize.y * twoHalfSize.z)
+	{
+		*this = BoundingOrientedBoxVolume(oneCentre, one.axes, oneHalfSize);
+	}
+	else
+	{
+		*this = BoundingOrientedBoxVolume(twoCentre, two.axes, twoHalfSize);
+	}
+}
+
+double BoundingOrientedBoxVolume::GetGrowth(const BoundingOrientedBoxVolume& other) const
+{
+	BoundingOrientedBoxVolume newBox(*this, other);
+	return newBox.GetSurfaceArea() - GetSurfaceArea();
+}
+
+// Added to the absolute rotation terms so that nearly parallel edges,
+// whose cross product is close to zero, are not taken as separating
+static const double parallelEpsilon = 1e-9;
+
+bool BoundingOrientedBoxVolume::Overlaps(const BoundingOrientedBoxVolume* other) const
+{
+	// The other box's axes and centre in this box's frame, each row
+	// padded to four so it can be loaded two at a time. The padding
+	// is zero, which can never separate
+	double rotation[3][4];
+	double absRotation[3][4];
+	double t[3];
+
+	// Boxes far apart are rejected first, each box fits in a sphere
+	// no larger than the sum of its' half-sizes
+	Vector3 offset = other->centre - centre;
+	double reach = halfSize.x + halfSize.y + halfSize.z + other->halfSize.x + other->halfSize.y + other->halfSize.z;
+	if (offset.squareMagnitude() > reach * reach) return false;
+
+	for (unsigned i = 0; i < 3; i++)
+	{
+		for (unsigned j = 0; j < 3; j++)
+		{
+			rotation[i][j] = axes[i] * other->axes[j];
+			absRotation[i][j] = abs(rotation[i][j]) + parallelEpsilon;
+		}
+		rotation[i][3] = absRotation[i][3] = 0;
+		t[i] = offset * axes[i];
+	}
+
+	const double a[3] = { halfSize.x, halfSize.y, halfSize.z };
+	const double b[4] = { other->halfSize.x, other->halfSize.y, other->halfSize.z, 0 };
+
+	// This box's axes
+	for (unsigned i = 0; i < 3; i++)
+	{
+		double radius = a[i] + b[0] * absRotation[i][0] + b[1] * absRotation[i][1] + b[2] * absRotation[i][2];
+		if (abs(t[i]) > radius) return false;
+	}
+
+#ifdef PARADOX_SIMD_X86
+	// The remaining twelve axes, three at a time. Lanes hold the other
+	// box's axes j = 0, 1 in one register and j = 2 in the next
+	const __m128d signMask = _mm_set1_pd(-0.0);
+	int separated = 0;
+
+	// The other box's axes
+	{
+		__m128d radius[2], distance[2];
+		for (unsigned half = 0; half < 2; half++)
+		{
+			unsigned j = half * 2;
+			radius[half] = _mm_loadu_pd(&b[j]);
+			distance[half] = _mm_setzero_pd();
+			for (unsigned i = 0; i < 3; i++)
+			{
+				radius[half] = _mm_add_pd(radius[half], _mm_mul_pd(_mm_set1_pd(a[i]), _mm_loadu_pd(&absRotation[i][j])));
+				distance[half] = _mm_add_pd(distance[half], _mm_mul_pd(_mm_set1_pd(t[i]), _mm_loadu_pd(&rotation[i][j])));
+			}
+			separated |= _mm_movemask_pd(_mm_cmpgt_pd(_mm_andnot_pd(signMask, distance[half]), radius[half]));
+		}
+		if (separated) return false;
+	}
+
+	// This box's axes crossed with the other box's
+	for (unsigned i = 0; i < 3; i++)
+	{
+		unsigned i1 = (i + 1) % 3;
+		unsigned i2 = (i + 2) % 3;
+
+		// The row of absolute rotations turned by one and by two, so
+		// that lane j holds the entries for j + 1 and j + 2
+		const double* row = absRotation[i];
+		__m128d rowNext[2] = { _mm_set_pd(row[2], row[1]), _mm_set_pd(0, row[0]) };
+		__m128d rowAfter[2] = { _mm_set_pd(row[0], row[2]), _mm_set_pd(0, row[1]) };
+		__m128d bNext[2] = { _mm_set_pd(b[2], b[1]), _mm_set_pd(0, b[0]) };
+		__m128d bAfter[2] = { _mm_set_pd(b[0], b[2]), _mm_set_pd(0, b[1]) };
+
+		for (unsigned half = 0; half < 2; half++)
+		{
+			unsigned j = half * 2;
+			__m128d radius = _mm_add_pd(
+				_mm_mul_pd(_mm_set1_pd(a[i1]), _mm_loadu_pd(&absRotation[i2][j])),
+				_mm_mul_pd(_mm_set1_pd(a[i2]), _mm_loadu_pd(&absRotation[i1][j])));
+			radius = _mm_add_pd(radius, _mm_mul_pd(bNext[half], rowAfter[half]));
+			radius = _mm_add_pd(radius, _mm_mul_pd(bAfter[half], rowNext[half]));
+			__m128d distance = _mm_sub_pd(
+				_mm_mul_pd(_mm_set1_pd(t[i2]), _mm_loadu_pd(&rotation[i1][j])),
+				_mm_mul_pd(_mm_set1_pd(t[i1]), _mm_loadu_pd(&rotation[i2][j])));
+			separated |= _mm_movemask_pd(_mm_cmpgt_pd(_mm_andnot_pd(signMask, distance), radius));
+		}
+		if (separated) return false;
+	}
+#else
+	// The other box's axes
+	for (unsigned j = 0; j < 3; j++)
+	{
+		double radius = b[j] + a[0] * absRotation[0][j] + a[1] * absRotation[1][j] + a[2] * absRotation[2][j];
+		double distance = t[0] * rotation[0][j] + t[1] * rotation[1][j] + t[2] * rotation[2][j];
+		if (abs(distance) > radius) return false;
+	}
+
+	// This box's axes crossed with the other box's
+	for (unsigned i = 0; i < 3; i++)
+	{
+		unsigned i1 = (i + 1) % 3;
+		unsigned i2 = (i + 2) % 3;
+		for (unsigned j = 0; j < 3; j++)
+		{
+			unsigned j1 = (j + 1) % 3;
+			unsigned j2 = (j + 2) % 3;
+
+			double radius = a[i1] * absRotation[i2][j] + a[i2] * absRotation[i1][j] +
+				b[j1] * absRotation[i][j2] + b[j2] * absRotation[i][j1];
+			double distance = t[i2] * rotation[i1][j] - t[i1] * rotation[i2][j];
+			if (abs(distance) > radius) return false;
+		}
+	}
+#endif
+
+	return true;
+}
@@ -4,6 +4,11 @@
 #include <cstddef>
 #include <math.h>
 #include "contacts.h"
+#include "Integrator.h" // For PARADOX_SIMD_X86
+
+#ifdef PARADOX_SIMD_X86
+#include <emmintrin.h>
+#endif
 
 // Represents a bounding sphere that can be tested for overlap
 struct BoundingSphereVolume
@@ -43,6 +48,133 @@ public:
 	}
 };
 
+// Represents an axis aligned bounding box that can be tested for overlap
+struct BoundingBoxVolume
+{
+	Vector3 min;
+	Vector3 max;
+
+public:
+
+	BoundingBoxVolume() {}
+
+	// Creates a new bounding box with the given corners
+	BoundingBoxVolume(const Vector3& min, const Vector3& max)
+		:
+		min(min),
+		max(max)
+	{
+	}
+
+	// Creates a bounding box to enclose the two given bounding boxes
+	BoundingBoxVolume(const BoundingBoxVolume& one, const BoundingBoxVolume& two);
+
+	// Check if the bounding box overlaps with the other given bounding box
+	bool Overlaps(const BoundingBoxVolume* other) const
+	{
+#ifdef PARADOX_SIMD_X86
+		// x and y in one go, the padding after z is never set so it
+		// is left out
+		__m128d overlapXY = _mm_and_pd(
+			_mm_cmple_pd(_mm_loadu_pd(&min.x), _mm_loadu_pd(&other->max.x)),
+			_mm_cmple_pd(_mm_loadu_pd(&other->min.x), _mm_loadu_pd(&max.x)));
+		if (_mm_movemask_pd(overlapXY) != 3) return false;
+		return min.z <= other->max.z && other->min.z <= max.z;
+#else
+		return min.x <= other->max.x && other->min.x <= max.x &&
+			   min.y <= other->max.y && other->min.y <= max.y &&
+			   min.z <= other->max.z && other->min.z <= max.z;
+#endif
+	}
+
+	// Check if the bounding box wholly contains the other given bounding box
+	bool Contains(const BoundingBoxVolume& other) const
+	{
+		return min.x <= other.min.x && other.max.x <= max.x &&
+			   min.y <= other.min.y && other.max.y <= max.y &&
+			   min.z <= other.min.z && other.max.z <= max.z;
+	}
+
+	/**
+	* Reports how much this bounding box would have to grow by to
+	* incorporate the given bounding box, as the growth in surface area.
+	*/
+	double GetGrowth(const BoundingBoxVolume& other) const;
+
+	// Returns the volume of this bounding box
+	double GetSize() const
+	{
+		Vector3 extent = max - min;
+		return extent.x * extent.y * extent.z;
+	}
+
+	// Returns the surface area of this bounding box
+	double GetSurfaceArea() const
+	{
+		Vector3 extent = max - min;
+		return 2.0 * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+	}
+};
+
+// Represents a box turned to any orientation that can be tested for overlap
+struct BoundingOrientedBoxVolume
+{
+	Vector3 centre;
+
+	// The box's own axes in world space, unit length and at right angles
+	Vector3 axes[3];
+
+	Vector3 halfSize;
+
+public:
+
+	BoundingOrientedBoxVolume() {}
+
+	// Creates a new oriented box with the given centre, axes and half-sizes
+	BoundingOrientedBoxVolume(const Vector3& centre, const Vector3 axes[3], const Vector3& halfSize);
+
+	// Creates an oriented box with the given half-sizes around the
+	// origin of the given transform, turned with it
+	BoundingOrientedBoxVolume(const Matrix4& transform, const Vector3& halfSize);
+
+	/**
+	* Creates an oriented box to enclose the two given oriented boxes.
+	* The new box is lined up with the axes of one of the two, whichever
+	* gives the smaller box, so no square roots are needed.
+	*/
+	BoundingOrientedBoxVolume(const BoundingOrientedBoxVolume& one, const BoundingOrientedBoxVolume& two);
+
+	/**
+	* Check if the oriented box overlaps with the other given oriented
+	* box, by looking for a separating axis among the 15 candidates.
+	*/
+	bool Overlaps(const BoundingOrientedBoxVolume* other) const;
+
+	/**
+	* Reports how much this oriented box would have to grow by to
+	* incorporate the given oriented box, as the growth in surface area.
+	*/
+	double GetGrowth(const BoundingOrientedBoxVolume& other) const;
+
+	// Returns the volume of this oriented box
+	double GetSize() const
+	{
+		return 8.0 * halfSize.x * halfSize.y * halfSize.z;
+	}
+
+	// Returns the surface area of this oriented box
+	double GetSurfaceArea() const
+	{
+		return 8.0 * (halfSize.x * halfSize.y + halfSize.y * halfSize.z + halfSize.z * halfSize.x);
+	}
+
+	// Returns the half length of this oriented box's shadow on the given axis
+	double ProjectHalfLength(const Vector3& axis) const
+	{
+		return halfSize.x * abs(axes[0] * axis) + halfSize.y * abs(axes[1] * axis) + halfSize.z * abs(axes[2] * axis);
+	}
+};
+
 /**
 * Stores a potential contact to check later
 */
@@ -54,6 +186,9 @@ struct PotentialContact
 	RigidBody* body[2];
 };
 
+template<class BoundingVolumeClass>
+class BVHPairFinder;
+
 /**
 * A base class for nodes in a bounding volume hierarcy.
 * 
@@ -81,12 +216,16 @@ public:
 	// Holds the node immediately above us in the truee.
 	BVHNode* parent;
 
+	// Holds a single bounding volume encompassing all the
+	// descendents of this node.
+	BoundingVolumeClass volume;
+
 	// Creates a new node in the hierarchy with the given parameters.
 	BVHNode(BVHNode* parent, const BoundingVolumeClass& volume, RigidBody* body = NULL)
 		:
+		body(body),
 		parent(parent),
-		volume(volume),
-		body(body)
+		volume(volume)
 	{
 		children[0] = children[1] = NULL;
 	}
@@ -104,6 +243,14 @@ public:
 	*/
 	unsigned GetPotentialContacts(PotentialContact* contacts, unsigned limit) const;
 
+	/**
+	* Checks the potential contacts from this node downwards in
+	* hierarchy, appending them to the given list, which grows as
+	* needed so that no contacts are lost.
+	* Returns the number of potential contacts it found.
+	*/
+	unsigned GetPotentialContacts(std::vector<PotentialContact>& contacts) const;
+
 	/**
 	* Inserts the given rigidbody, with the given bounding volume,
 	* into the hierarchy. This may involve the creation of further
@@ -143,11 +290,32 @@ protected:
 		PotentialContact* contacts,
 		unsigned limit) const;
 
+	/**
+	* Checks the potential contacts between this node and the given other node,
+	* appending them to the given list.
+	*/
+	void GetPotentialContactsWith(
+		const BVHNode<BoundingVolumeClass>* other,
+		std::vector<PotentialContact>& contacts) const;
+
+	/**
+	* Returns true if the search for contacts with the given other node
+	* should descend into this node rather than the other one. If either
+	* is a leaf we descend the other, if both are branches the larger.
+	*/
+	bool DescendsFirst(const BVHNode<BoundingVolumeClass>* other) const
+	{
+		return other->IsLeaf() || (!IsLeaf() && volume.GetSize() >= other->volume.GetSize());
+	}
+
 	/**
 	* For non-leaf nodes, this method recalculates the bounding volume
 	* based on the bounding volumes of its' children.
 	*/
 	void RecalculateBoundingVolume(bool recurse = true);
+
+	// Splits the search for contacts into tasks for worker threads
+	friend class BVHPairFinder<BoundingVolumeClass>;
 };
 
 /**
@@ -161,7 +329,7 @@ bool BVHNode<BoundingVolumeClass>::Overlaps(
 	const BVHNode<BoundingVolumeClass>* other
 ) const
 {
-	return volume->Overlaps(other->volume);
+	return volume.Overlaps(&other->volume);
 }
 
 template<class BoundingVolumeClass>
@@ -243,7 +411,7 @@ BVHNode<BoundingVolumeClass>::~BVHNode()
 	if (children[0])
 	{
 		children[0]->parent = NULL;
-		delete children[1];
+		delete children[0];
 	}
 	if (children[1])
 	{
@@ -278,10 +446,20 @@ unsigned BVHNode<BoundingVolumeClass>::GetPotentialContacts(
 	// or if we're a leaf node.
 	if (IsLeaf() || limit == 0) return 0;
 
-	// Get the potential contacts of one of our children with the other
-	return children[0]->GetPotentialContactsWith(
-		children[1], contacts, limit
-	);
+	// Get the potential contacts within each of our children, then
+	// those of one of our children with the other
+	unsigned count = children[0]->GetPotentialContacts(contacts, limit);
+	if (limit > count)
+	{
+		count += children[1]->GetPotentialContacts(contacts + count, limit - count);
+	}
+	if (limit > count)
+	{
+		count += children[0]->GetPotentialContactsWith(
+			children[1], contacts + count, limit - count
+		);
+	}
+	return count;
 }
 
 template<class BoundingVolumeClass>
@@ -303,7 +481,7 @@ unsigned BVHNode<BoundingVolumeClass>::GetPotentialContactsWith(const BVHNode<Bo
 	// a leaf, then we descend the other. If both are branches,
 	// then we use the one with the largest size.
 	if (other->IsLeaf() ||
-		(!IsLeaf() && volume->GetSize() >= other->volume->GetSize()))
+		(!IsLeaf() && volume.GetSize() >= other->volume.GetSize()))
 	{
 		// Recurse into ourself
 		unsigned count = children[0]->GetPotentialContactsWith(
@@ -342,3 +520,46 @@ unsigned BVHNode<BoundingVolumeClass>::GetPotentialContactsWith(const BVHNode<Bo
 		}
 	}
 }
+
+template<class BoundingVolumeClass>
+unsigned BVHNode<BoundingVolumeClass>::GetPotentialContacts(
+	std::vector<PotentialContact>& contacts
+) const
+{
+	if (IsLeaf()) return 0;
+
+	size_t first = contacts.size();
+	children[0]->GetPotentialContacts(contacts);
+	children[1]->GetPotentialContacts(contacts);
+	children[0]->GetPotentialContactsWith(children[1], contacts);
+	return (unsigned)(contacts.size() - first);
+}
+
+template<class BoundingVolumeClass>
+void BVHNode<BoundingVolumeClass>::GetPotentialContactsWith(
+	const BVHNode<BoundingVolumeClass>* other,
+	std::vector<PotentialContact>& contacts
+) const
+{
+	if (!Overlaps(other)) return;
+
+	if (IsLeaf() && other->IsLeaf())
+	{
+		PotentialContact contact;
+		contact.body[0] = body;
+		contact.body[1] = other->body;
+		contacts.push_back(contact);
+		return;
+	}
+
+	if (DescendsFirst(other))
+	{
+		children[0]->GetPotentialContactsWith(other, contacts);
+		children[1]->GetPotentialContactsWith(other, contacts);
+	}
+	else
+	{
+		GetPotentialContactsWith(other->children[0], contacts);
+		GetPotentialContactsWith(other->children[1], contacts);
+	}
+}
@@ -1,14 +1,47 @@
 #include "CollideFine.h"
+#include "GJK.h"
+#include "Heightfield.h"
+#include "Integrator.h" // For PARADOX_SIMD_X86
 #include <memory.h>
 #include <assert.h>
 #include <cstdlib>
 #include <cstdio>
+#include <algorithm>
+#include <limits>
+
+#ifdef PARADOX_SIMD_X86
+#include <emmintrin.h>
+#endif
 
 void CollisionPrimitive::CalculateInternals()
 {
 	transform = body->GetTransform() * offset;
 }
 
+// Returns the half-sizes of a box around the body's origin holding a
+// box of the given half-sizes placed at the given offset from it
+static Vector3 OffsetHalfSize(const Matrix4& offset, const Vector3& halfSize)
+{
+	Vector3 result;
+	for (unsigned axis = 0; axis < 3; axis++)
+	{
+		const double* row = offset.data + axis * 4;
+		result[axis] = abs(row[3]) +
+			abs(row[0]) * halfSize.x + abs(row[1]) * halfSize.y + abs(row[2]) * halfSize.z;
+	}
+	return result;
+}
+
+Vector3 CollisionCapsule::GetBodyHalfSize() const
+{
+	return OffsetHalfSize(offset, Vector3(radius, halfHeight + radius, radius));
+}
+
+Vector3 CollisionConvexHull::GetBodyHalfSize() const
+{
+	return OffsetHalfSize(offset, hull->GetHalfSize());
+}
+
 bool IntersectionTests::SphereAndHalfSpace(const CollisionSphere& sphere, const CollisionPlane& plane)
 {
 	// Find the distance from the origin
@@ -36,6 +69,86 @@ static inline double TransformToAxis(const CollisionBox& box, const Vector3& axi
 		box.halfSize.z * abs(axis * box.GetAxis(2));
 }
 
+#ifdef PARADOX_SIMD_X86
+/**
+ * A box's axes and half-sizes, with each number repeated in both lanes
+ * of a register, for testing the box on two axes at once.
+ */
+struct PackedBox
+{
+	Vector3 axes[3];
+	__m128d axis[3][3];
+	__m128d halfSize[3];
+
+	PackedBox(const CollisionBox& box)
+	{
+		for (unsigned i = 0; i < 3; i++)
+		{
+			axes[i] = box.GetAxis(i);
+			axis[i][0] = _mm_set1_pd(axes[i].x);
+			axis[i][1] = _mm_set1_pd(axes[i].y);
+			axis[i][2] = _mm_set1_pd(axes[i].z);
+			halfSize[i] = _mm_set1_pd(box.halfSize[i]);
+		}
+	}
+};
+
+/**
+ * The fifteen axes the separating axis test checks two boxes on, in
+ * the order it checks them: box one's three, box two's three, then
+ * each of one's crossed with each of two's. The sixteenth is zero and
+ * only fills out the last pair of lanes. The crossed axes are left
+ * until the boxes' own axes have failed to part them.
+ */
+struct BoxAndBoxAxes
+{
+	double x[16];
+	double y[16];
+	double z[16];
+
+	BoxAndBoxAxes(const PackedBox& one, const PackedBox& two)
+	{
+		for (unsigned i = 0; i < 3; i++)
+		{
+			Set(i, one.axes[i]);
+			Set(i + 3, two.axes[i]);
+		}
+	}
+
+	void SetCrossedAxes(const PackedBox& one, const PackedBox& two)
+	{
+		for (unsigned i = 0; i < 3; i++)
+		{
+			for (unsigned j = 0; j < 3; j++) Set(6 + i * 3 + j, one.axes[i] % two.axes[j]);
+		}
+		Set(15, Vector3());
+	}
+
+	void Set(unsigned lane, const Vector3& axis)
+	{
+		x[lane] = axis.x;
+		y[lane] = axis.y;
+		z[lane] = axis.z;
+	}
+};
+
+// The dot product of two axes with the given vector, summed in the
+// same order as Vector3's
+static inline __m128d PackedDot(__m128d x, __m128d y, __m128d z, const __m128d* vector)
+{
+	return _mm_add_pd(_mm_add_pd(_mm_mul_pd(x, vector[0]), _mm_mul_pd(y, vector[1])), _mm_mul_pd(z, vector[2]));
+}
+
+// TransformToAxis for two axes at once
+static inline __m128d PackedTransformToAxis(const PackedBox& box, __m128d x, __m128d y, __m128d z)
+{
+	const __m128d signMask = _mm_set1_pd(-0.0);
+	__m128d result = _mm_mul_pd(box.halfSize[0], _mm_andnot_pd(signMask, PackedDot(x, y, z, box.axis[0])));
+	result = _mm_add_pd(result, _mm_mul_pd(box.halfSize[1], _mm_andnot_pd(signMask, PackedDot(x, y, z, box.axis[1]))));
+	return _mm_add_pd(result, _mm_mul_pd(box.halfSize[2], _mm_andnot_pd(signMask, PackedDot(x, y, z, box.axis[2]))));
+}
+#endif
+
 /**
  * This function checks if the two boxes overlap along
  * the given axis. The final parameter toCentre is used
@@ -71,6 +184,32 @@ bool IntersectionTests::BoxAndBox(const CollisionBox& one, const CollisionBox& t
 	// Find the vector between the two centres
 	Vector3 toCentre = two.GetAxis(3) - one.GetAxis(3);
 
+#ifdef PARADOX_SIMD_X86
+	// The same fifteen axes two at a time, unnormalised as below, so
+	// that the boxes overlap on exactly the axes they do below
+	PackedBox packedOne(one), packedTwo(two);
+	BoxAndBoxAxes axes(packedOne, packedTwo);
+	const __m128d centre[3] = { _mm_set1_pd(toCentre.x), _mm_set1_pd(toCentre.y), _mm_set1_pd(toCentre.z) };
+	const __m128d signMask = _mm_set1_pd(-0.0);
+
+	for (unsigned i = 0; i < 15; i += 2)
+	{
+		if (i == 6) axes.SetCrossedAxes(packedOne, packedTwo);
+
+		__m128d x = _mm_loadu_pd(&axes.x[i]);
+		__m128d y = _mm_loadu_pd(&axes.y[i]);
+		__m128d z = _mm_loadu_pd(&axes.z[i]);
+
+		__m128d distance = _mm_andnot_pd(signMask, PackedDot(x, y, z, centre));
+		__m128d reach = _mm_add_pd(PackedTransformToAxis(packedOne, x, y, z), PackedTransformToAxis(packedTwo, x, y, z));
+
+		// The last pair's second lane is padding
+		int separated = _mm_movemask_pd(_mm_cmpnlt_pd(distance, reach));
+		if (i == 14) separated &= 1;
+		if (separated) return false;
+	}
+	return true;
+#else
 	return (
 
 		// Check on box one's axes first
@@ -95,6 +234,7 @@ bool IntersectionTests::BoxAndBox(const CollisionBox& one, const CollisionBox& t
 		TEST_OVERLAP(one.GetAxis(2) % two.GetAxis(2))
 
 		);
+#endif
 }
 #undef TEST_OVERLAP
 
@@ -144,6 +284,7 @@ unsigned CollisionDetector::SphereAndTruePlane(const CollisionSphere& sphere, co
 	contact->penetration = penetration;
 	contact->contactPoint = position - plane.direction * centreDistance;
 	contact->SetBodyData(sphere.body, NULL, data->friction, data->restitution);
+	contact->feature = 1;
 
 	data->AddContacts(1);
 	return 1;
@@ -168,6 +309,7 @@ unsigned CollisionDetector::SphereAndHalfSpace(const CollisionSphere& sphere, co
 	contact->penetration = -ballDistance;
 	contact->contactPoint = position - plane.direction * (ballDistance + sphere.radius);
 	contact->SetBodyData(sphere.body, NULL, data->friction, data->restitution);
+	contact->feature = 1;
 
 	data->AddContacts(1);
 	return 1;
@@ -201,6 +343,7 @@ unsigned CollisionDetector::SphereAndSphere(const CollisionSphere& one, const Co
 	contact->contactPoint = positionOne + midline * (double)0.5;
 	contact->penetration = (one.radius + two.radius - size);
 	contact->SetBodyData(one.body, two.body, data->friction, data->restitution);
+	contact->feature = 1;
 
 	data->AddContacts(1);
 	return 1;
@@ -264,7 +407,8 @@ void FillPointFaceBoxBox(
 	const Vector3& toCentre,
 	CollisionData* data,
 	unsigned best,
-	double penetration
+	double penetration,
+	unsigned firstFeature
 )
 {
 	/**
@@ -279,9 +423,11 @@ void FillPointFaceBoxBox(
 	 * this axis.
 	 */
 	Vector3 normal = one.GetAxis(best);
+	unsigned face = best * 2;
 	if (one.GetAxis(best) * toCentre > 0)
 	{
 		normal = normal * -1.0f;
+		face++;
 	}
 
 	/**
@@ -289,15 +435,19 @@ void FillPointFaceBoxBox(
 	 * Using toCentre doesn't work.
 	 */
 	Vector3 vertex = two.halfSize;
-	if (two.GetAxis(0) * normal < 0) vertex.x = -vertex.x;
-	if (two.GetAxis(1) * normal < 0) vertex.y = -vertex.y;
-	if (two.GetAxis(2) * normal < 0) vertex.z = -vertex.z;
+	unsigned corner = 0;
+	if (two.GetAxis(0) * normal < 0) { vertex.x = -vertex.x; corner |= 1; }
+	if (two.GetAxis(1) * normal < 0) { vertex.y = -vertex.y; corner |= 2; }
+	if (two.GetAxis(2) * normal < 0) { vertex.z = -vertex.z; corner |= 4; }
 
 	// Create the contact data
 	contact->contactNormal = normal;
 	contact->penetration = penetration;
 	contact->contactPoint = two.GetTransform() * vertex;
 	contact->SetBodyData(one.body, two.body, data->friction, data->restitution);
+
+	// One feature for each pair of face and vertex
+	contact->feature = firstFeature + face * 8 + corner;
 }
 
 static inline Vector3 ContactPoint(
@@ -358,47 +508,86 @@ static inline Vector3 ContactPoint(
 	}
 }
 
-// This preprocessor definition is only used as a convenience 
-// in the BoxAndBox contact generation method.
-#define CHECK_OVERLAP(axis, index) \
-	if (!TryAxis(one, two, (axis), toCentre, (index), penetration, best)) return 0;
-
-unsigned CollisionDetector::BoxAndBox(const CollisionBox& one, const CollisionBox& two, CollisionData* data)
+#ifdef PARADOX_SIMD_X86
+/**
+ * Finds the penetration of the boxes on two of their axes at once,
+ * normalising the axes as TryAxis does, and sets a bit in the mask for
+ * each axis too short to test.
+ */
+static inline __m128d PackedPenetration(const PackedBox& one, const PackedBox& two, const __m128d* toCentre,
+	const BoxAndBoxAxes& axes, unsigned lane, int* skipped)
 {
-	// if (!IntersectionTests::BoxAndBox(one, two)) return 0;
+	__m128d x = _mm_loadu_pd(&axes.x[lane]);
+	__m128d y = _mm_loadu_pd(&axes.y[lane]);
+	__m128d z = _mm_loadu_pd(&axes.z[lane]);
 
-	// Find the vector between the two centres
-	Vector3 toCentre = two.GetAxis(3) - one.GetAxis(3);
+	__m128d square = _mm_add_pd(_mm_add_pd(_mm_mul_pd(x, x), _mm_mul_pd(y, y)), _mm_mul_pd(z, z));
+	*skipped = _mm_movemask_pd(_mm_cmplt_pd(square, _mm_set1_pd(0.0001)));
 
-	// We start assuming there is no contact
-	double penetration = INFINITY;
-	unsigned best = 0xffffff;
+	__m128d inverse = _mm_div_pd(_mm_set1_pd(1.0), _mm_sqrt_pd(square));
+	x = _mm_mul_pd(x, inverse);
+	y = _mm_mul_pd(y, inverse);
+	z = _mm_mul_pd(z, inverse);
 
-	// Now we check each axes, returning if it gives us
-   // a separating axis, and keeping track of the axis with
-   // the smallest penetration otherwise.
-	CHECK_OVERLAP(one.GetAxis(0), 0);
-	CHECK_OVERLAP(one.GetAxis(1), 1);
-	CHECK_OVERLAP(one.GetAxis(2), 2);
+	__m128d distance = _mm_andnot_pd(_mm_set1_pd(-0.0), PackedDot(x, y, z, toCentre));
+	return _mm_sub_pd(_mm_add_pd(PackedTransformToAxis(one, x, y, z), PackedTransformToAxis(two, x, y, z)), distance);
+}
 
-	CHECK_OVERLAP(two.GetAxis(0), 3);
-	CHECK_OVERLAP(two.GetAxis(1), 4);
-	CHECK_OVERLAP(two.GetAxis(2), 5);
+/**
+ * Checks the boxes on all fifteen axes two at a time, each worked out
+ * exactly as TryAxis does, returning false if any of them parts the
+ * boxes. The boxes' own axes are checked first, as most separated
+ * pairs are parted by one of them. Otherwise finds the axis of least
+ * penetration, the first of any that tie as with TryAxis, and the
+ * least of the boxes' own axes.
+ */
+static bool FindBoxAndBoxAxis(const PackedBox& one, const CollisionBox& two, const Vector3& toCentre,
+	double* penetration, unsigned* best, unsigned* bestSingleAxis)
+{
+	PackedBox packedTwo(two);
+	BoxAndBoxAxes axes(one, packedTwo);
+	const __m128d centre[3] = { _mm_set1_pd(toCentre.x), _mm_set1_pd(toCentre.y), _mm_set1_pd(toCentre.z) };
+	const __m128d zero = _mm_setzero_pd();
+
+	double penetrations[16];
+	int skipped = 0;
+	for (unsigned lane = 0; lane < 16; lane += 2)
+	{
+		if (lane == 6) axes.SetCrossedAxes(one, packedTwo);
 
-	// Store the best axis-major, in case we run into almost
-	// parallel edge collisions later
-	unsigned bestSingleAxis = best;
+		int skip;
+		__m128d pair = PackedPenetration(one, packedTwo, centre, axes, lane, &skip);
+		_mm_storeu_pd(&penetrations[lane], pair);
+		if (_mm_movemask_pd(_mm_cmplt_pd(pair, zero)) & ~skip) return false;
+		skipped |= skip << lane;
+	}
 
-	CHECK_OVERLAP(one.GetAxis(0) % two.GetAxis(0), 6);
-	CHECK_OVERLAP(one.GetAxis(0) % two.GetAxis(1), 7);
-	CHECK_OVERLAP(one.GetAxis(0) % two.GetAxis(2), 8);
-	CHECK_OVERLAP(one.GetAxis(1) % two.GetAxis(0), 9);
-	CHECK_OVERLAP(one.GetAxis(1) % two.GetAxis(1), 10);
-	CHECK_OVERLAP(one.GetAxis(1) % two.GetAxis(2), 11);
-	CHECK_OVERLAP(one.GetAxis(2) % two.GetAxis(0), 12);
-	CHECK_OVERLAP(one.GetAxis(2) % two.GetAxis(1), 13);
-	CHECK_OVERLAP(one.GetAxis(2) % two.GetAxis(2), 14);
+	*penetration = INFINITY;
+	*best = 0xffffff;
+	for (unsigned lane = 0; lane < 15; lane++)
+	{
+		// Store the best axis-major, in case we run into almost
+		// parallel edge collisions later
+		if (lane == 6) *bestSingleAxis = *best;
 
+		if (skipped & (1 << lane)) continue;
+		if (penetrations[lane] < *penetration)
+		{
+			*penetration = penetrations[lane];
+			*best = lane;
+		}
+	}
+	return true;
+}
+#endif
+
+/**
+ * Fills in the contact between two boxes, once the separating axis
+ * test has found the axis they overlap least on.
+ */
+static unsigned FillBoxAndBox(const CollisionBox& one, const CollisionBox& two, const Vector3& toCentre,
+	double penetration, unsigned best, unsigned bestSingleAxis, CollisionData* data)
+{
 	// Make sure we've got a result
 	assert(best != 0xffffff);
 
@@ -411,7 +600,7 @@ unsigned CollisionDetector::BoxAndBox(const CollisionBox& one, const CollisionBo
 	if (best < 3)
 	{
 		// We've got a vertex of box two on a face of box one
-		FillPointFaceBoxBox(one, two, toCentre, data, best, penetration);
+		FillPointFaceBoxBox(one, two, toCentre, data, best, penetration, 1);
 		data->AddContacts(1);
 		return 1;
 	}
@@ -423,7 +612,7 @@ unsigned CollisionDetector::BoxAndBox(const CollisionBox& one, const CollisionBo
 		 * one and two (and therefore also the vector between
 		 * their centres).
 		 */
-		FillPointFaceBoxBox(two, one, toCentre * -1.0f, data, best - 3, penetration);
+		FillPointFaceBoxBox(two, one, toCentre * -1.0f, data, best - 3, penetration, 49);
 		data->AddContacts(1);
 		return 1;
 	}
@@ -453,19 +642,22 @@ unsigned CollisionDetector::BoxAndBox(const CollisionBox& one, const CollisionBo
 		Vector3 ptOnOneEdge = one.halfSize;
 		Vector3 ptOnTwoEdge = two.halfSize;
 
+		// Each edge is told apart from the other three by the signs
+		// of its' other two coordinates
+		unsigned edges = 0;
 		for (unsigned i = 0; i < 3; i++)
 		{
 			if (i == oneAxisIndex) ptOnOneEdge[i] = 0;
-			else if (one.GetAxis(i) * axis > 0) ptOnOneEdge[i] = -ptOnOneEdge[i];
+			else if (one.GetAxis(i) * axis > 0) { ptOnOneEdge[i] = -ptOnOneEdge[i]; edges |= 1 << i; }
 
 			if (i == twoAxisIndex) ptOnTwoEdge[i] = 0;
-			else if (two.GetAxis(i) * axis < 0) ptOnTwoEdge[i] = -ptOnTwoEdge[i];
+			else if (two.GetAxis(i) * axis < 0) { ptOnTwoEdge[i] = -ptOnTwoEdge[i]; edges |= 8 << i; }
 		}
 
 		// Move them into world coordinates (they are already oriented correctly
 		// since they have been derived from the axes).
-		ptOnOneEdge = one.transform * ptOnOneEdge;
-		ptOnTwoEdge = two.transform * ptOnTwoEdge;
+		ptOnOneEdge = one.GetTransform() * ptOnOneEdge;
+		ptOnTwoEdge = two.GetTransform() * ptOnTwoEdge;
 
 		// So we have a point and a direction for the colliding edges.
 		// We need to find out the point of closest approach of the 
@@ -481,11 +673,96 @@ unsigned CollisionDetector::BoxAndBox(const CollisionBox& one, const CollisionBo
 		contact->contactNormal = axis;
 		contact->contactPoint = vertex;
 		contact->SetBodyData(one.body, two.body, data->friction, data->restitution);
+		contact->feature = 97 + best * 64 + edges;
 		data->AddContacts(1);
 		return 1;
 	}
 	return 0;
 }
+
+#ifdef PARADOX_SIMD_X86
+// Generates the contact between two boxes with the packed test
+static inline unsigned PackedBoxAndBox(const PackedBox& packedOne, const CollisionBox& one, const CollisionBox& two,
+	CollisionData* data)
+{
+	Vector3 toCentre = two.GetAxis(3) - one.GetAxis(3);
+
+	double penetration;
+	unsigned best, bestSingleAxis;
+	if (!FindBoxAndBoxAxis(packedOne, two, toCentre, &penetration, &best, &bestSingleAxis)) return 0;
+	return FillBoxAndBox(one, two, toCentre, penetration, best, bestSingleAxis, data);
+}
+#endif
+
+unsigned CollisionDetector::BoxAndBox(const CollisionBox& one, const CollisionBox& two, CollisionData* data)
+{
+#ifdef PARADOX_SIMD_X86
+	return PackedBoxAndBox(PackedBox(one), one, two, data);
+#else
+	return BoxAndBoxScalar(one, two, data);
+#endif
+}
+
+unsigned CollisionDetector::BoxAndBoxes(const CollisionBox& one, const CollisionBox* const* others, unsigned count,
+	CollisionData* data)
+{
+#ifdef PARADOX_SIMD_X86
+	PackedBox packedOne(one);
+#endif
+
+	unsigned found = 0;
+	for (unsigned i = 0; i < count && data->contactsLeft > 0; i++)
+	{
+#ifdef PARADOX_SIMD_X86
+		found += PackedBoxAndBox(packedOne, one, *others[i], data);
+#else
+		found += BoxAndBoxScalar(one, *others[i], data);
+#endif
+	}
+	return found;
+}
+
+// This preprocessor definition is only used as a convenience 
+// in the BoxAndBox contact generation method.
+#define CHECK_OVERLAP(axis, index) \
+	if (!TryAxis(one, two, (axis), toCentre, (index), penetration, best)) return 0;
+
+unsigned CollisionDetector::BoxAndBoxScalar(const CollisionBox& one, const CollisionBox& two, CollisionData* data)
+{
+	// Find the vector between the two centres
+	Vector3 toCentre = two.GetAxis(3) - one.GetAxis(3);
+
+	// We start assuming there is no contact
+	double penetration = INFINITY;
+	unsigned best = 0xffffff;
+
+	// Now we check each axes, returning if it gives us
+   // a separating axis, and keeping track of the axis with
+   // the smallest penetration otherwise.
+	CHECK_OVERLAP(one.GetAxis(0), 0);
+	CHECK_OVERLAP(one.GetAxis(1), 1);
+	CHECK_OVERLAP(one.GetAxis(2), 2);
+
+	CHECK_OVERLAP(two.GetAxis(0), 3);
+	CHECK_OVERLAP(two.GetAxis(1), 4);
+	CHECK_OVERLAP(two.GetAxis(2), 5);
+
+	// Store the best axis-major, in case we run into almost
+	// parallel edge collisions later
+	unsigned bestSingleAxis = best;
+
+	CHECK_OVERLAP(one.GetAxis(0) % two.GetAxis(0), 6);
+	CHECK_OVERLAP(one.GetAxis(0) % two.GetAxis(1), 7);
+	CHECK_OVERLAP(one.GetAxis(0) % two.GetAxis(2), 8);
+	CHECK_OVERLAP(one.GetAxis(1) % two.GetAxis(0), 9);
+	CHECK_OVERLAP(one.GetAxis(1) % two.GetAxis(1), 10);
+	CHECK_OVERLAP(one.GetAxis(1) % two.GetAxis(2), 11);
+	CHECK_OVERLAP(one.GetAxis(2) % two.GetAxis(0), 12);
+	CHECK_OVERLAP(one.GetAxis(2) % two.GetAxis(1), 13);
+	CHECK_OVERLAP(one.GetAxis(2) % two.GetAxis(2), 14);
+
+	return FillBoxAndBox(one, two, toCentre, penetration, best, bestSingleAxis, data);
+}
 #undef CHECK_OVERLAP
 
 unsigned CollisionDetector::BoxAndPoint(const CollisionBox& box, const Vector3& point, CollisionData* data)
@@ -530,6 +807,7 @@ unsigned CollisionDetector::BoxAndPoint(const CollisionBox& box, const Vector3&
 	 * NULL. Where this is called this value can be left or filled in.
 	 */
 	contact->SetBodyData(box.body, NULL, data->friction, data->restitution);
+	contact->feature = 1;
 
 	data->AddContacts(1);
 	return 1;
@@ -581,6 +859,7 @@ unsigned CollisionDetector::BoxAndSphere(const CollisionBox& box, const Collisio
 	contact->contactPoint = closestPtWorld;
 	contact->penetration = sphere.radius - sqrt(dist);
 	contact->SetBodyData(box.body, sphere.body, data->friction, data->restitution);
+	contact->feature = 1;
 
 	data->AddContacts(1);
 	return 1;
@@ -638,14 +917,753 @@ unsigned CollisionDetector::BoxAndHalfSpace(const CollisionBox& box, const Colli
 
 			// Write the appropriate data
 			contact->SetBodyData(box.body, NULL, data->friction, data->restitution);
+			contact->feature = 1 + i;
 
 			// Move onto the next contact
 			contact++;
 			contactsUsed++;
-			if (contactsUsed == (unsigned)data->contactsLeft) return contactsUsed;
+			if (contactsUsed == (unsigned)data->contactsLeft) break;
+		}
+	}
+
+	data->AddContacts(contactsUsed);
+	return contactsUsed;
+}
+unsigned CollisionDetector::CapsuleAndHalfSpace(const CollisionCapsule& capsule, const CollisionPlane& plane, CollisionData* data)
+{
+	// Each end of the capsule is tested as a sphere
+	Contact* contact = data->contacts;
+	unsigned contactsUsed = 0;
+	for (unsigned end = 0; end < 2; end++)
+	{
+		if (contactsUsed == (unsigned)data->contactsLeft) break;
+
+		Vector3 position = capsule.GetEnd(end == 1);
+		double ballDistance = plane.direction * position - capsule.radius - plane.offset;
+		if (ballDistance >= 0) continue;
+
+		contact->contactNormal = plane.direction;
+		contact->penetration = -ballDistance;
+		contact->contactPoint = position - plane.direction * (ballDistance + capsule.radius);
+		contact->SetBodyData(capsule.body, NULL, data->friction, data->restitution);
+		contact->feature = 1 + end;
+
+		contact++;
+		contactsUsed++;
+	}
+
+	data->AddContacts(contactsUsed);
+	return contactsUsed;
+}
+
+/**
+ * Writes the contact between two spheres of the given radii at the
+ * given centres, the closest points of the shapes' cores. Returns the
+ * number of contacts written.
+ */
+static unsigned RoundedCoresContact(
+	const Vector3& positionOne, double radiusOne, RigidBody* bodyOne,
+	const Vector3& positionTwo, double radiusTwo, RigidBody* bodyTwo,
+	CollisionData* data
+)
+{
+	if (data->contactsLeft <= 0) return 0;
+
+	Vector3 midline = positionOne - positionTwo;
+	double size = midline.magnitude();
+	if (size <= 0 || size >= radiusOne + radiusTwo) return 0;
+
+	Vector3 normal = midline * (1.0 / size);
+	double penetration = radiusOne + radiusTwo - size;
+
+	// Halfway between the two surfaces
+	Contact* contact = data->contacts;
+	contact->contactNormal = normal;
+	contact->contactPoint = positionOne - normal * (radiusOne - penetration * 0.5);
+	contact->penetration = penetration;
+	contact->SetBodyData(bodyOne, bodyTwo, data->friction, data->restitution);
+	contact->feature = 1;
+
+	data->AddContacts(1);
+	return 1;
+}
+
+unsigned CollisionDetector::CapsuleAndSphere(const CollisionCapsule& capsule, const CollisionSphere& sphere, CollisionData* data)
+{
+	// Find the point of the capsule's segment closest to the sphere
+	Vector3 start = capsule.GetEnd(false);
+	Vector3 segment = capsule.GetEnd(true) - start;
+	Vector3 centre = sphere.GetAxis(3);
+
+	double length = segment.squareMagnitude();
+	double t = length > 0 ? ((centre - start) * segment) / length : 0;
+	if (t < 0) t = 0;
+	if (t > 1) t = 1;
+
+	return RoundedCoresContact(start + segment * t, capsule.radius, capsule.body,
+		centre, sphere.radius, sphere.body, data);
+}
+
+/**
+ * Finds the closest points of two segments, given by their starts and
+ * the vectors along them, as how far along each they are, after
+ * Real-Time Collision Detection 5.1.9.
+ */
+static void ClosestPointsOfSegments(
+	const Vector3& startOne, const Vector3& segmentOne,
+	const Vector3& startTwo, const Vector3& segmentTwo,
+	double* sOut, double* tOut
+)
+{
+	Vector3 between = startOne - startTwo;
+
+	double a = segmentOne * segmentOne;
+	double e = segmentTwo * segmentTwo;
+	double f = segmentTwo * between;
+
+	double s = 0, t = 0;
+	if (a <= 0 && e <= 0)
+	{
+		// Both segments are points
+	}
+	else if (a <= 0)
+	{
+		t = f / e;
+	}
+	else
+	{
+		double c = segmentOne * between;
+		if (e <= 0)
+		{
+			s = -c / a;
+		}
+		else
+		{
+			// Parallel segments meet at the start of the first
+			double b = segmentOne * segmentTwo;
+			double denominator = a * e - b * b;
+			if (denominator > 0) s = (b * f - c * e) / denominator;
+			if (s < 0) s = 0;
+			if (s > 1) s = 1;
+
+			t = (b * s + f) / e;
+			if (t < 0)
+			{
+				t = 0;
+				s = -c / a;
+			}
+			else if (t > 1)
+			{
+				t = 1;
+				s = (b - c) / a;
+			}
 		}
 	}
+	if (s < 0) s = 0;
+	if (s > 1) s = 1;
+	if (t < 0) t = 0;
+	if (t > 1) t = 1;
+
+	*sOut = s;
+	*tOut = t;
+}
+
+unsigned CollisionDetector::CapsuleAndCapsule(const CollisionCapsule& one, const CollisionCapsule& two, CollisionData* data)
+{
+	Vector3 startOne = one.GetEnd(false);
+	Vector3 startTwo = two.GetEnd(false);
+	Vector3 segmentOne = one.GetEnd(true) - startOne;
+	Vector3 segmentTwo = two.GetEnd(true) - startTwo;
+
+	double s, t;
+	ClosestPointsOfSegments(startOne, segmentOne, startTwo, segmentTwo, &s, &t);
+
+	return RoundedCoresContact(startOne + segmentOne * s, one.radius, one.body,
+		startTwo + segmentTwo * t, two.radius, two.body, data);
+}
+
+unsigned CollisionDetector::ConvexHullAndHalfSpace(const CollisionConvexHull& hull, const CollisionPlane& plane, CollisionData* data)
+{
+	// Make sure we have contacts
+	if (data->contactsLeft <= 0) return 0;
+
+	// Check the deepest vertex first
+	const ConvexHull& shape = *hull.hull;
+	unsigned deepest = shape.FindSupportVertex(hull.transform.transformInverseDirection(plane.direction * -1));
+	if (hull.transform.transform(shape.GetVertex(deepest)) * plane.direction > plane.offset)
+	{
+		return 0;
+	}
+
+	// As with boxes, every vertex below the plane is a contact
+	Contact* contact = data->contacts;
+	unsigned contactsUsed = 0;
+	for (unsigned i = 0; i < shape.GetVertexCount(); i++)
+	{
+		Vector3 vertexPos = hull.transform.transform(shape.GetVertex(i));
+		double vertexDistance = vertexPos * plane.direction;
+		if (vertexDistance > plane.offset) continue;
+
+		contact->contactPoint = plane.direction;
+		contact->contactPoint *= (vertexDistance - plane.offset);
+		contact->contactPoint += vertexPos;
+		contact->contactNormal = plane.direction;
+		contact->penetration = plane.offset - vertexDistance;
+		contact->SetBodyData(hull.body, NULL, data->friction, data->restitution);
+		contact->feature = 1 + i;
+
+		contact++;
+		contactsUsed++;
+		if (contactsUsed == (unsigned)data->contactsLeft) break;
+	}
 
 	data->AddContacts(contactsUsed);
 	return contactsUsed;
-}
\ No newline at end of file
+}
+
+unsigned CollisionDetector::CapsuleAndBox(const CollisionCapsule& capsule, const CollisionBox& box, CollisionData* data,
+	GJKCache* cache)
+{
+	return ConvexAndConvex(MakeSupportShape(capsule), MakeSupportShape(box), data, cache);
+}
+
+unsigned CollisionDetector::ConvexHullAndSphere(const CollisionConvexHull& hull, const CollisionSphere& sphere,
+	CollisionData* data, GJKCache* cache)
+{
+	return ConvexAndConvex(MakeSupportShape(hull), MakeSupportShape(sphere), data, cache);
+}
+
+unsigned CollisionDetector::ConvexHullAndBox(const CollisionConvexHull& hull, const CollisionBox& box, CollisionData* data,
+	GJKCache* cache)
+{
+	return ConvexAndConvex(MakeSupportShape(hull), MakeSupportShape(box), data, cache);
+}
+
+unsigned CollisionDetector::ConvexHullAndCapsule(const CollisionConvexHull& hull, const CollisionCapsule& capsule,
+	CollisionData* data, GJKCache* cache)
+{
+	return ConvexAndConvex(MakeSupportShape(hull), MakeSupportShape(capsule), data, cache);
+}
+
+unsigned CollisionDetector::ConvexHullAndConvexHull(const CollisionConvexHull& one, const CollisionConvexHull& two,
+	CollisionData* data, GJKCache* cache)
+{
+	return ConvexAndConvex(MakeSupportShape(one), MakeSupportShape(two), data, cache);
+}
+
+unsigned CollisionDetector::ConvexAndConvex(const SupportShape& one, const SupportShape& two, CollisionData* data,
+	GJKCache* cache)
+{
+	// Make sure we have contacts
+	if (data->contactsLeft <= 0) return 0;
+
+	GJKResult result;
+	GJKSolver::Query(one, two, &result, cache);
+	if (result.distance >= 0) return 0;
+
+	Contact* contact = data->contacts;
+	contact->contactNormal = result.normal;
+	contact->contactPoint = (result.pointOne + result.pointTwo) * 0.5;
+	contact->penetration = -result.distance;
+	contact->SetBodyData(one.body, two.body, data->friction, data->restitution);
+	contact->feature = 1;
+
+	data->AddContacts(1);
+	return 1;
+}
+
+// Returns the feature id of one of the contacts a routine can find
+// with a triangle: the triangle's number, then which contact it is
+static inline unsigned TriangleFeature(unsigned triangle, unsigned slot)
+{
+	return (triangle << 4) + 1 + slot;
+}
+
+// Returns the world box around a box of the given half-sizes
+static BoundingBoxVolume TransformedVolume(const Matrix4& transform, const Vector3& halfSize)
+{
+	Vector3 centre = transform.getAxisVector(3);
+	Vector3 extent;
+	for (unsigned axis = 0; axis < 3; axis++)
+	{
+		const double* row = transform.data + axis * 4;
+		extent[axis] = abs(row[0]) * halfSize.x + abs(row[1]) * halfSize.y + abs(row[2]) * halfSize.z;
+	}
+	return BoundingBoxVolume(centre - extent, centre + extent);
+}
+
+// Returns the point of the triangle closest to the given point, after
+// Real-Time Collision Detection 5.1.5
+static Vector3 ClosestPointOnTriangle(const Vector3& point, const Vector3& a, const Vector3& b, const Vector3& c)
+{
+	Vector3 ab = b - a;
+	Vector3 ac = c - a;
+
+	// In the region beyond a
+	Vector3 ap = point - a;
+	double d1 = ab * ap;
+	double d2 = ac * ap;
+	if (d1 <= 0 && d2 <= 0) return a;
+
+	// Beyond b
+	Vector3 bp = point - b;
+	double d3 = ab * bp;
+	double d4 = ac * bp;
+	if (d3 >= 0 && d4 <= d3) return b;
+
+	// Beyond the edge from a to b
+	double vc = d1 * d4 - d3 * d2;
+	if (vc <= 0 && d1 >= 0 && d3 <= 0) return a + ab * (d1 / (d1 - d3));
+
+	// Beyond c
+	Vector3 cp = point - c;
+	double d5 = ab * cp;
+	double d6 = ac * cp;
+	if (d6 >= 0 && d5 <= d6) return c;
+
+	// Beyond the edge from a to c
+	double vb = d5 * d2 - d1 * d6;
+	if (vb <= 0 && d2 >= 0 && d6 <= 0) return a + ac * (d2 / (d2 - d6));
+
+	// Beyond the edge from b to c
+	double va = d3 * d6 - d5 * d4;
+	if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0)
+	{
+		return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+	}
+
+	// Over the face
+	double denominator = 1.0 / (va + vb + vc);
+	return a + ab * (vb * denominator) + ac * (vc * denominator);
+}
+
+// Returns whether the point is over the triangle, looking along the
+// triangle's normal
+static inline bool IsOverTriangle(const Vector3& point, const Vector3& a, const Vector3& b, const Vector3& c,
+	const Vector3& normal)
+{
+	return ((b - a) % (point - a)) * normal >= 0 &&
+		((c - b) % (point - b)) * normal >= 0 &&
+		((a - c) % (point - c)) * normal >= 0;
+}
+
+// The up direction of heightfields, whose triangles are one sided
+static const Vector3 heightfieldUp(0, 1, 0);
+
+/**
+ * Writes the contact between a sphere of the given radius at the given
+ * centre and a triangle with the given unit normal. The sphere is
+ * pushed away from the closest point of the triangle, or out along the
+ * normal when the triangle is one sided and the centre has sunk behind
+ * it, looking along the given up direction. Returns the number of
+ * contacts written.
+ */
+static unsigned RoundedPointAndTriangle(
+	const Vector3& centre, double radius, RigidBody* body,
+	const Vector3& a, const Vector3& b, const Vector3& c, const Vector3& face, bool oneSided,
+	const Vector3& up, unsigned feature, CollisionData* data
+)
+{
+	if (data->contactsLeft <= 0) return 0;
+
+	double height = face * (centre - a);
+	Vector3 closest;
+	Vector3 normal;
+	double penetration;
+	if (oneSided && height < 0)
+	{
+		// Only the triangle the centre is behind pushes it out
+		if (!IsOverTriangle(centre, a, b, c, up)) return 0;
+
+		closest = centre - face * height;
+		normal = face;
+		penetration = radius - height;
+	}
+	else
+	{
+		closest = ClosestPointOnTriangle(centre, a, b, c);
+		Vector3 midline = centre - closest;
+		double size = midline.magnitude();
+		if (size >= radius) return 0;
+
+		// A centre on the triangle is pushed out of its' front
+		if (size > 0) normal = midline * (1.0 / size);
+		else normal = face;
+		penetration = radius - size;
+	}
+
+	Contact* contact = data->contacts;
+	contact->contactNormal = normal;
+	contact->contactPoint = closest;
+	contact->penetration = penetration;
+	contact->SetBodyData(body, NULL, data->friction, data->restitution);
+	contact->feature = feature;
+
+	data->AddContacts(1);
+	return 1;
+}
+
+/**
+ * Finds the closest points of a segment, given by its' start and the
+ * vector along it, and a triangle with the given normal. Returns the
+ * distance between them, zero where the segment passes through the
+ * triangle, with how far along the segment and where on the triangle
+ * they are.
+ */
+static double ClosestSegmentAndTriangle(
+	const Vector3& start, const Vector3& segment,
+	const Vector3& a, const Vector3& b, const Vector3& c, const Vector3& face,
+	double* s, Vector3* onTriangle
+)
+{
+	double startHeight = face * (start - a);
+	double endHeight = face * (start + segment - a);
+	if ((startHeight < 0) != (endHeight < 0))
+	{
+		double crossing = startHeight / (startHeight - endHeight);
+		Vector3 point = start + segment * crossing;
+		if (IsOverTriangle(point, a, b, c, face))
+		{
+			*s = crossing;
+			*onTriangle = point;
+			return 0;
+		}
+	}
+
+	// Otherwise the closest points are at an end of the segment, or
+	// on an edge of the triangle
+	double best = std::numeric_limits<double>::max();
+	for (unsigned end = 0; end < 2; end++)
+	{
+		Vector3 point = start + segment * (double)end;
+		Vector3 closest = ClosestPointOnTriangle(point, a, b, c);
+		double distance = (point - closest).squareMagnitude();
+		if (distance < best)
+		{
+			best = distance;
+			*s = end;
+			*onTriangle = closest;
+		}
+	}
+
+	const Vector3* corners[3] = { &a, &b, &c };
+	for (unsigned edge = 0; edge < 3; edge++)
+	{
+		const Vector3& from = *corners[edge];
+		Vector3 along = *corners[(edge + 1) % 3] - from;
+
+		double alongSegment, alongEdge;
+		ClosestPointsOfSegments(start, segment, from, along, &alongSegment, &alongEdge);
+		double distance = ((start + segment * alongSegment) - (from + along * alongEdge)).squareMagnitude();
+		if (distance < best)
+		{
+			best = distance;
+			*s = alongSegment;
+			*onTriangle = from + along * alongEdge;
+		}
+	}
+	return sqrt(best);
+}
+
+/**
+ * Finds the axis along which the box can be pushed out of the
+ * triangle least far, of the thirteen that could separate them: the
+ * box's faces, the triangle's normal, and each box axis crossed with
+ * each triangle edge, after Akenine-Moller. The triangle is taken into
+ * the box's coordinates first. Returns false if any of them separates
+ * the two. One sided triangles only push the box out of their front.
+ */
+static bool FindBoxTriangleAxis(const CollisionBox& box, const Vector3& a, const Vector3& b, const Vector3& c,
+	bool oneSided, Vector3* normal, double* penetration)
+{
+	Vector3 v[3] = {
+		box.GetTransform().transformInverse(a),
+		box.GetTransform().transformInverse(b),
+		box.GetTransform().transformInverse(c)
+	};
+	const Vector3& h = box.halfSize;
+	Vector3 edges[3] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+
+	// The triangle's normal, then the box's faces, then the edge pairs
+	Vector3 axes[13];
+	axes[0] = edges[0] % edges[1];
+	for (unsigned axis = 0; axis < 3; axis++) axes[1 + axis][axis] = 1;
+	for (unsigned edge = 0; edge < 3; edge++)
+	{
+		for (unsigned axis = 0; axis < 3; axis++) axes[4 + edge * 3 + axis] = axes[1 + axis] % edges[edge];
+	}
+
+	double best = std::numeric_limits<double>::max();
+	for (unsigned i = 0; i < 13; i++)
+	{
+		const Vector3& axis = axes[i];
+		double length = axis.squareMagnitude();
+
+		// Edges parallel to a box axis give no axis of their own
+		if (i >= 4 && length <= 1e-12 * edges[(i - 4) / 3].squareMagnitude()) continue;
+		length = sqrt(length);
+
+		double p0 = axis * v[0], p1 = axis * v[1], p2 = axis * v[2];
+		double low = std::min(p0, std::min(p1, p2));
+		double high = std::max(p0, std::max(p1, p2));
+		double radius = h.x * abs(axis.x) + h.y * abs(axis.y) + h.z * abs(axis.z);
+		if (low > radius || high < -radius) return false;
+
+		// How far the box must go along the axis, or against it, to
+		// clear the triangle
+		double forward = (high + radius) / length;
+		double backward = (radius - low) / length;
+		if (i == 0 && oneSided) backward = std::numeric_limits<double>::max();
+
+		if (forward < best)
+		{
+			best = forward;
+			*normal = axis * (1.0 / length);
+		}
+		if (backward < best)
+		{
+			best = backward;
+			*normal = axis * (-1.0 / length);
+		}
+	}
+
+	*normal = box.GetTransform().transformDirection(*normal);
+	*penetration = best;
+	return true;
+}
+
+static inline Vector3 TriangleNormal(const Vector3& a, const Vector3& b, const Vector3& c)
+{
+	Vector3 normal = (b - a) % (c - a);
+	normal.normalise();
+	return normal;
+}
+
+unsigned CollisionDetector::SphereAndTriangle(const CollisionSphere& sphere,
+	const Vector3& a, const Vector3& b, const Vector3& c, unsigned triangle, bool oneSided, CollisionData* data,
+	const Vector3* up)
+{
+	Vector3 face = TriangleNormal(a, b, c);
+	return RoundedPointAndTriangle(sphere.GetAxis(3), sphere.radius, sphere.body,
+		a, b, c, face, oneSided, up ? *up : face, TriangleFeature(triangle, 0), data);
+}
+
+unsigned CollisionDetector::CapsuleAndTriangle(const CollisionCapsule& capsule,
+	const Vector3& a, const Vector3& b, const Vector3& c, unsigned triangle, bool oneSided, CollisionData* data,
+	const Vector3* up)
+{
+	Vector3 face = TriangleNormal(a, b, c);
+	Vector3 over = up ? *up : face;
+	Vector3 start = capsule.GetEnd(false);
+	Vector3 end = capsule.GetEnd(true);
+
+	// Each end is tested as a sphere, as against a plane
+	unsigned contactsUsed =
+		RoundedPointAndTriangle(start, capsule.radius, capsule.body, a, b, c, face, oneSided, over,
+			TriangleFeature(triangle, 0), data) +
+		RoundedPointAndTriangle(end, capsule.radius, capsule.body, a, b, c, face, oneSided, over,
+			TriangleFeature(triangle, 1), data);
+
+	// A capsule lying across an edge or a small triangle touches it
+	// between its' ends, somewhere clearly nearer than either end
+	double s = 0;
+	Vector3 onTriangle;
+	Vector3 segment = end - start;
+	double distance = ClosestSegmentAndTriangle(start, segment, a, b, c, face, &s, &onTriangle);
+	if (s <= 0 || s >= 1 || distance >= capsule.radius) return contactsUsed;
+
+	double endDistance = std::min(
+		(start - ClosestPointOnTriangle(start, a, b, c)).magnitude(),
+		(end - ClosestPointOnTriangle(end, a, b, c)).magnitude());
+	if (endDistance - distance < capsule.radius * 0.01) return contactsUsed;
+
+	return contactsUsed + RoundedPointAndTriangle(start + segment * s, capsule.radius, capsule.body,
+		a, b, c, face, oneSided, over, TriangleFeature(triangle, 2), data);
+}
+
+unsigned CollisionDetector::BoxAndTriangle(const CollisionBox& box,
+	const Vector3& a, const Vector3& b, const Vector3& c, unsigned triangle, bool oneSided, CollisionData* data,
+	const Vector3* up)
+{
+	// Make sure we have contacts
+	if (data->contactsLeft <= 0) return 0;
+
+	Vector3 face = TriangleNormal(a, b, c);
+	Vector3 centre = box.GetAxis(3);
+	Vector3 normal = face;
+
+	Vector3 axis;
+	double depth = 0;
+	bool overlaps = FindBoxTriangleAxis(box, a, b, c, oneSided, &axis, &depth);
+	if (oneSided)
+	{
+		// A box that has sunk below a one sided triangle still collides
+		double reach =
+			box.halfSize.x * abs(face * box.GetAxis(0)) +
+			box.halfSize.y * abs(face * box.GetAxis(1)) +
+			box.halfSize.z * abs(face * box.GetAxis(2));
+		if (face * (centre - a) > reach) return 0;
+	}
+	else
+	{
+		if (!overlaps) return 0;
+
+		// Push the box out of the side its' centre is on
+		if (face * (centre - a) < 0) normal *= -1;
+	}
+
+	// As against a plane, each vertex below the triangle is a contact,
+	// as long as it is over the triangle
+	static double mults[8][3] = { {1,1,1},{-1,1,1},{1,-1,1},{-1,-1,1},
+							   {1,1,-1},{-1,1,-1},{1,-1,-1},{-1,-1,-1} };
+
+	// A vertex of a box sunk below a one sided triangle is found by
+	// looking along the up direction, the triangle's normal otherwise
+	Vector3 over = oneSided && up ? *up : face;
+	Contact* contact = data->contacts;
+	unsigned contactsUsed = 0;
+	for (unsigned i = 0; i < 8; i++)
+	{
+		Vector3 vertexPos(mults[i][0], mults[i][1], mults[i][2]);
+		vertexPos.componentProductUpdate(box.halfSize);
+		vertexPos = box.transform.transform(vertexPos);
+
+		double vertexDistance = normal * (vertexPos - a);
+		if (vertexDistance > 0 || !IsOverTriangle(vertexPos, a, b, c, over)) continue;
+
+		contact->contactPoint = vertexPos - normal * vertexDistance;
+		contact->contactNormal = normal;
+		contact->penetration = -vertexDistance;
+		contact->SetBodyData(box.body, NULL, data->friction, data->restitution);
+		contact->feature = TriangleFeature(triangle, i);
+
+		contact++;
+		contactsUsed++;
+		if (contactsUsed == (unsigned)data->contactsLeft) break;
+	}
+
+	if (contactsUsed > 0 || !overlaps)
+	{
+		data->AddContacts(contactsUsed);
+		return contactsUsed;
+	}
+
+	// Otherwise an edge or corner of the triangle is in the box. It is
+	// pushed out along the axis it overlaps least on, from the corner
+	// of the triangle furthest into it, or the middle of the edge when
+	// two corners are as far in
+	const Vector3* corners[3] = { &a, &b, &c };
+	double heights[3] = { axis * a, axis * b, axis * c };
+	unsigned deepest = 0;
+	for (unsigned i = 1; i < 3; i++)
+	{
+		if (heights[i] > heights[deepest]) deepest = i;
+	}
+
+	Vector3 point = *corners[deepest];
+	double scale = abs(heights[0]) + abs(heights[1]) + abs(heights[2]) + 1;
+	for (unsigned i = 0; i < 3; i++)
+	{
+		if (i != deepest && heights[deepest] - heights[i] <= 1e-9 * scale)
+		{
+			point = (point + *corners[i]) * 0.5;
+			break;
+		}
+	}
+
+	contact->contactNormal = axis;
+	contact->contactPoint = point;
+	contact->penetration = depth;
+	contact->SetBodyData(box.body, NULL, data->friction, data->restitution);
+	contact->feature = TriangleFeature(triangle, 8);
+
+	data->AddContacts(1);
+	return 1;
+}
+
+/**
+ * Runs the given test on a primitive against every triangle of the
+ * mesh or heightfield near the given box, returning the number of
+ * contacts written.
+ */
+template <class Collider, class Test>
+static unsigned CollideTriangles(const Collider& collider, const BoundingBoxVolume& volume, Test test)
+{
+	unsigned contactsUsed = 0;
+	collider.Query(volume,
+		[&](unsigned triangle, const Vector3& a, const Vector3& b, const Vector3& c)
+		{
+			contactsUsed += test(a, b, c, triangle);
+		});
+	return contactsUsed;
+}
+
+static BoundingBoxVolume SphereVolume(const CollisionSphere& sphere)
+{
+	Vector3 reach(sphere.radius, sphere.radius, sphere.radius);
+	return BoundingBoxVolume(sphere.GetAxis(3) - reach, sphere.GetAxis(3) + reach);
+}
+
+static BoundingBoxVolume CapsuleVolume(const CollisionCapsule& capsule)
+{
+	return TransformedVolume(capsule.GetTransform(),
+		Vector3(capsule.radius, capsule.halfHeight + capsule.radius, capsule.radius));
+}
+
+unsigned CollisionDetector::SphereAndTriangleMesh(const CollisionSphere& sphere, const TriangleMesh& mesh,
+	CollisionData* data)
+{
+	return CollideTriangles(mesh, SphereVolume(sphere),
+		[&](const Vector3& a, const Vector3& b, const Vector3& c, unsigned triangle)
+		{
+			return SphereAndTriangle(sphere, a, b, c, triangle, false, data);
+		});
+}
+
+unsigned CollisionDetector::BoxAndTriangleMesh(const CollisionBox& box, const TriangleMesh& mesh, CollisionData* data)
+{
+	return CollideTriangles(mesh, TransformedVolume(box.GetTransform(), box.halfSize),
+		[&](const Vector3& a, const Vector3& b, const Vector3& c, unsigned triangle)
+		{
+			return BoxAndTriangle(box, a, b, c, triangle, false, data);
+		});
+}
+
+unsigned CollisionDetector::CapsuleAndTriangleMesh(const CollisionCapsule& capsule, const TriangleMesh& mesh,
+	CollisionData* data)
+{
+	return CollideTriangles(mesh, CapsuleVolume(capsule),
+		[&](const Vector3& a, const Vector3& b, const Vector3& c, unsigned triangle)
+		{
+			return CapsuleAndTriangle(capsule, a, b, c, triangle, false, data);
+		});
+}
+
+unsigned CollisionDetector::SphereAndHeightfield(const CollisionSphere& sphere, const Heightfield& field,
+	CollisionData* data)
+{
+	return CollideTriangles(field, SphereVolume(sphere),
+		[&](const Vector3& a, const Vector3& b, const Vector3& c, unsigned triangle)
+		{
+			return SphereAndTriangle(sphere, a, b, c, triangle, true, data, &heightfieldUp);
+		});
+}
+
+unsigned CollisionDetector::BoxAndHeightfield(const CollisionBox& box, const Heightfield& field, CollisionData* data)
+{
+	return CollideTriangles(field, TransformedVolume(box.GetTransform(), box.halfSize),
+		[&](const Vector3& a, const Vector3& b, const Vector3& c, unsigned triangle)
+		{
+			return BoxAndTriangle(box, a, b, c, triangle, true, data, &heightfieldUp);
+		});
+}
+
+unsigned CollisionDetector::CapsuleAndHeightfield(const CollisionCapsule& capsule, const Heightfield& field,
+	CollisionData* data)
+{
+	return CollideTriangles(field, CapsuleVolume(capsule),
+		[&](const Vector3& a, const Vector3& b, const Vector3& c, unsigned triangle)
+		{
+			return CapsuleAndTriangle(capsule, a, b, c, triangle, true, data, &heightfieldUp);
+		});
+}
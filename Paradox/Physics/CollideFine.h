@@ -13,11 +13,16 @@
  * intersection tests as an early out.
  */
 
-#include "Contacts.h"
+#include "contacts.h"
 
 // Forward declarations of primitive friends
 class IntersectionTests;
 class CollisionDetector;
+struct SupportShape;
+struct GJKCache;
+class ConvexHull;
+class TriangleMesh;
+class Heightfield;
 
 /**
  * Represents a primitive to detect collisions against.
@@ -123,6 +128,51 @@ public:
 	Vector3 halfSize;
 };
 
+/**
+ * Represents a rigid body that can be treated as a capsule for
+ * collision detection: a segment along its' local y axis, grown all
+ * round by the radius.
+ */
+class CollisionCapsule : public CollisionPrimitive
+{
+public:
+	double radius;
+
+	// Half the length of the segment, the capsule is this plus the
+	// radius tall either side of its' centre
+	double halfHeight;
+
+	// Returns the end of the segment on the given side of the centre
+	Vector3 GetEnd(bool top) const
+	{
+		return transform.transform(Vector3(0, top ? halfHeight : -halfHeight, 0));
+	}
+
+	/**
+	 * Returns the half-sizes of a box around the body's origin that
+	 * holds the capsule, for the world's broadphase.
+	 */
+	Vector3 GetBodyHalfSize() const;
+};
+
+/**
+ * Represents a rigid body that can be treated as a convex hull for
+ * collision detection. The hull is given in the primitive's own
+ * coordinates and may be shared by many primitives, it must outlive
+ * them.
+ */
+class CollisionConvexHull : public CollisionPrimitive
+{
+public:
+	const ConvexHull* hull;
+
+	/**
+	 * Returns the half-sizes of a box around the body's origin that
+	 * holds the hull, for the world's broadphase.
+	 */
+	Vector3 GetBodyHalfSize() const;
+};
+
 /**
  * A wrapper class that holds fast intersection tests.
  * These can be used to drive the coarse collision detection system
@@ -243,6 +293,10 @@ struct CollisionData
  * Each of the functions has the same format: it takes the details
  * of two objects, and a pointer to a contact array to fill.
  * It returns the number of contacts it wrote into the array.
+ *
+ * Every contact is given a feature id that tells it apart from the
+ * other contacts the same function could find between the same two
+ * objects, e.g. which vertex of a box touches a plane.
  */
 class CollisionDetector
 {
@@ -277,12 +331,40 @@ public:
 		CollisionData* data
 	);
 
+	/**
+	 * Does a collision test on two boxes, checking all fifteen
+	 * separating axes at once where the processor allows, and giving
+	 * the same contact as BoxAndBoxScalar to the last bit.
+	 */
 	static unsigned BoxAndBox(
 		const CollisionBox& one,
 		const CollisionBox& two,
 		CollisionData* data
 	);
 
+	/**
+	 * Does a collision test on two boxes one separating axis at a
+	 * time. BoxAndBox uses this where it cannot check them at once.
+	 */
+	static unsigned BoxAndBoxScalar(
+		const CollisionBox& one,
+		const CollisionBox& two,
+		CollisionData* data
+	);
+
+	/**
+	 * Does a collision test on one box against each of the given
+	 * number of others in turn, giving the contacts BoxAndBox would,
+	 * in the same order, without setting the first box up again for
+	 * every pair. Stops early if the contacts run out.
+	 */
+	static unsigned BoxAndBoxes(
+		const CollisionBox& one,
+		const CollisionBox* const* others,
+		unsigned count,
+		CollisionData* data
+	);
+
 	static unsigned BoxAndPoint(
 		const CollisionBox& box,
 		const Vector3& point,
@@ -294,4 +376,181 @@ public:
 		const CollisionSphere& sphere,
 		CollisionData* data
 	);
+
+	/**
+	 * Does a collision test on a capsule and a half-space, with a
+	 * contact for each end of the capsule below the plane.
+	 */
+	static unsigned CapsuleAndHalfSpace(
+		const CollisionCapsule& capsule,
+		const CollisionPlane& plane,
+		CollisionData* data
+	);
+
+	static unsigned CapsuleAndSphere(
+		const CollisionCapsule& capsule,
+		const CollisionSphere& sphere,
+		CollisionData* data
+	);
+
+	static unsigned CapsuleAndCapsule(
+		const CollisionCapsule& one,
+		const CollisionCapsule& two,
+		CollisionData* data
+	);
+
+	/**
+	 * Does a collision test on a convex hull and a half-space, with a
+	 * contact for each vertex of the hull below the plane.
+	 */
+	static unsigned ConvexHullAndHalfSpace(
+		const CollisionConvexHull& hull,
+		const CollisionPlane& plane,
+		CollisionData* data
+	);
+
+	/**
+	 * The remaining pairs with a capsule or hull in them go through
+	 * ConvexAndConvex, and take the same cache.
+	 */
+	static unsigned CapsuleAndBox(
+		const CollisionCapsule& capsule,
+		const CollisionBox& box,
+		CollisionData* data,
+		GJKCache* cache = NULL
+	);
+
+	static unsigned ConvexHullAndSphere(
+		const CollisionConvexHull& hull,
+		const CollisionSphere& sphere,
+		CollisionData* data,
+		GJKCache* cache = NULL
+	);
+
+	static unsigned ConvexHullAndBox(
+		const CollisionConvexHull& hull,
+		const CollisionBox& box,
+		CollisionData* data,
+		GJKCache* cache = NULL
+	);
+
+	static unsigned ConvexHullAndCapsule(
+		const CollisionConvexHull& hull,
+		const CollisionCapsule& capsule,
+		CollisionData* data,
+		GJKCache* cache = NULL
+	);
+
+	static unsigned ConvexHullAndConvexHull(
+		const CollisionConvexHull& one,
+		const CollisionConvexHull& two,
+		CollisionData* data,
+		GJKCache* cache = NULL
+	);
+
+	/**
+	 * Does a collision test on a primitive and one triangle, given by
+	 * its' corners in world coordinates and its' number, which the
+	 * contacts' features are made from. Two sided triangles push the
+	 * primitive away from whichever side its' centre is on. One sided
+	 * triangles face the way their corners wind anticlockwise, and push
+	 * a primitive that has sunk behind them back out of their front.
+	 * Only what is behind the triangle looking along the given up
+	 * direction has sunk, or looking along the triangle's normal if no
+	 * direction is given.
+	 */
+	static unsigned SphereAndTriangle(
+		const CollisionSphere& sphere,
+		const Vector3& a, const Vector3& b, const Vector3& c,
+		unsigned triangle,
+		bool oneSided,
+		CollisionData* data,
+		const Vector3* up = NULL
+	);
+
+	/**
+	 * Each end of the capsule is a contact, as against a plane, and so
+	 * is the point between them nearest the triangle if that is clearly
+	 * nearer than the ends.
+	 */
+	static unsigned CapsuleAndTriangle(
+		const CollisionCapsule& capsule,
+		const Vector3& a, const Vector3& b, const Vector3& c,
+		unsigned triangle,
+		bool oneSided,
+		CollisionData* data,
+		const Vector3* up = NULL
+	);
+
+	/**
+	 * Each vertex of the box below the triangle and over it is a
+	 * contact. When none is, but the two overlap, an edge or corner of
+	 * the triangle is in the box, and one contact pushes it out along
+	 * the separating axis it overlaps least on.
+	 */
+	static unsigned BoxAndTriangle(
+		const CollisionBox& box,
+		const Vector3& a, const Vector3& b, const Vector3& c,
+		unsigned triangle,
+		bool oneSided,
+		CollisionData* data,
+		const Vector3* up = NULL
+	);
+
+	/**
+	 * Does a collision test on a primitive and every triangle of a mesh
+	 * near it. Mesh triangles are two sided.
+	 */
+	static unsigned SphereAndTriangleMesh(
+		const CollisionSphere& sphere,
+		const TriangleMesh& mesh,
+		CollisionData* data
+	);
+
+	static unsigned BoxAndTriangleMesh(
+		const CollisionBox& box,
+		const TriangleMesh& mesh,
+		CollisionData* data
+	);
+
+	static unsigned CapsuleAndTriangleMesh(
+		const CollisionCapsule& capsule,
+		const TriangleMesh& mesh,
+		CollisionData* data
+	);
+
+	/**
+	 * Does a collision test on a primitive and the triangles of the
+	 * heightfield under it, which are one sided and face up. What has
+	 * sunk below them is pushed out of the triangle straight above it.
+	 */
+	static unsigned SphereAndHeightfield(
+		const CollisionSphere& sphere,
+		const Heightfield& field,
+		CollisionData* data
+	);
+
+	static unsigned BoxAndHeightfield(
+		const CollisionBox& box,
+		const Heightfield& field,
+		CollisionData* data
+	);
+
+	static unsigned CapsuleAndHeightfield(
+		const CollisionCapsule& capsule,
+		const Heightfield& field,
+		CollisionData* data
+	);
+
+	/**
+	 * Does a collision test on any two convex support shapes with
+	 * GJK and EPA, writing one contact at their deepest points. The
+	 * cache, when given, warm starts GJK and is updated for next time.
+	 */
+	static unsigned ConvexAndConvex(
+		const SupportShape& one,
+		const SupportShape& two,
+		CollisionData* data,
+		GJKCache* cache = NULL
+	);
 };
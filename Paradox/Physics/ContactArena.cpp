@@ -0,0 +1,60 @@
+#include "ContactArena.h"
+#include <algorithm>
+#include <assert.h>
+
+ContactArena::ContactArena(unsigned capacity)
+	:
+	contacts(capacity > 0 ? capacity : 1),
+	count(0),
+	limit(0)
+{
+}
+
+void ContactArena::Commit(unsigned used)
+{
+	assert(used <= GetRoom());
+	count += used;
+}
+
+unsigned ContactArena::Append(const Contact* source, unsigned sourceCount)
+{
+	// Grown at least twofold as Grow does, so appending a part at a
+	// time does not keep reallocating
+	if (GetRoom() < sourceCount)
+	{
+		unsigned needed = count + sourceCount;
+		Reserve(needed > GetCapacity() * 2 ? needed : GetCapacity() * 2);
+	}
+	if (sourceCount > GetRoom()) sourceCount = GetRoom();
+
+	std::copy(source, source + sourceCount, GetNext());
+	count += sourceCount;
+	return sourceCount;
+}
+
+bool ContactArena::Grow()
+{
+	unsigned capacity = GetCapacity();
+	if (limit && capacity >= limit) return false;
+
+	unsigned grown = capacity * 2;
+	if (limit && grown > limit) grown = limit;
+	contacts.resize(grown);
+	return true;
+}
+
+void ContactArena::Reserve(unsigned capacity)
+{
+	if (limit && capacity > limit) capacity = limit;
+	if (capacity > GetCapacity()) contacts.resize(capacity);
+}
+
+void ContactArena::Shrink(unsigned capacity)
+{
+	if (capacity < count) capacity = count;
+	if (capacity < 1) capacity = 1;
+	if (capacity >= GetCapacity()) return;
+
+	contacts.resize(capacity);
+	contacts.shrink_to_fit();
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the arena contacts are generated into each
+ * frame, which grows when the contacts do not fit.
+ */
+
+#include "contacts.h"
+#include <vector>
+
+/**
+ * Holds the contacts generated in a frame one after another. Clearing
+ * it keeps its' storage, so once it has grown to fit the busiest frame
+ * it is not allocated again. It grows by doubling, up to a limit if one
+ * is set.
+ */
+class ContactArena
+{
+public:
+	// Makes room for the given number of contacts, at least one
+	explicit ContactArena(unsigned capacity);
+
+	// Forgets the contacts in the arena, keeping the room for them
+	void Clear()
+	{
+		count = 0;
+	}
+
+	Contact* GetContacts()
+	{
+		return contacts.data();
+	}
+
+	const Contact* GetContacts() const
+	{
+		return contacts.data();
+	}
+
+	// Returns the number of contacts committed to the arena
+	unsigned GetCount() const
+	{
+		return count;
+	}
+
+	unsigned GetCapacity() const
+	{
+		return (unsigned)contacts.size();
+	}
+
+	// Returns the first contact after those committed, where the next
+	// ones are generated
+	Contact* GetNext()
+	{
+		return contacts.data() + count;
+	}
+
+	// Returns the number of contacts that fit after those committed
+	unsigned GetRoom() const
+	{
+		return GetCapacity() - count;
+	}
+
+	// Adds the given number of contacts written from GetNext on
+	void Commit(unsigned used);
+
+	// Copies the given contacts in after those committed, growing to fit
+	// them up to the limit. Returns the number that fit
+	unsigned Append(const Contact* source, unsigned sourceCount);
+
+	/**
+	 * Doubles the room, or grows it to the limit if that is nearer,
+	 * keeping the contacts committed. Returns false if the arena is
+	 * already at its' limit. Pointers into the arena are invalidated.
+	 */
+	bool Grow();
+
+	// Makes room for at least the given number of contacts, up to the limit
+	void Reserve(unsigned capacity);
+
+	// Gives back the room past the given number of contacts, keeping
+	// at least those committed
+	void Shrink(unsigned capacity);
+
+	// Sets the most contacts the arena grows to, zero for no limit.
+	// An arena already past the limit keeps its' room
+	void SetLimit(unsigned limit)
+	{
+		this->limit = limit;
+	}
+
+	unsigned GetLimit() const
+	{
+		return limit;
+	}
+
+private:
+	std::vector<Contact> contacts;
+	unsigned count;
+	unsigned limit;
+};
@@ -0,0 +1,352 @@
+#include "ContactManifold.h"
+#include <algorithm>
+#include <functional>
+
+// Contacts whose normal turns further than this, as a cosine, from
+// the manifold's are taken to be a new configuration of the pair
+static const double normalTolerance = 0.95;
+
+// Returns the squared area spanned by four points, taken as the
+// largest of the three ways of pairing them into diagonals
+static double QuadArea(const Vector3& a, const Vector3& b, const Vector3& c, const Vector3& d)
+{
+	double area = ((a - b) % (c - d)).squareMagnitude();
+	area = std::max(area, ((a - c) % (b - d)).squareMagnitude());
+	return std::max(area, ((a - d) % (b - c)).squareMagnitude());
+}
+
+// Checks whether two transforms are within the tolerance of each other
+static bool TransformsClose(const Matrix4& one, const Matrix4& two, double tolerance)
+{
+	for (unsigned i = 0; i < 12; i++)
+	{
+		if (abs(one.data[i] - two.data[i]) > tolerance) return false;
+	}
+	return true;
+}
+
+void ContactManifold::Reset(RigidBody* one, RigidBody* two)
+{
+	body[0] = one;
+	body[1] = two;
+	normal.clear();
+	pointCount = 0;
+}
+
+void ContactManifold::Refresh(double breakingDistance)
+{
+	unsigned kept = 0;
+	for (unsigned p = 0; p < pointCount; p++)
+	{
+		ManifoldPoint point = points[p];
+
+		Vector3 onOne = body[0]->GetPointInWorldSpace(point.localPoint[0]);
+		Vector3 onTwo = body[1] ? body[1]->GetPointInWorldSpace(point.localPoint[1]) : point.localPoint[1];
+
+		// The anchors were together when the point was found, how far
+		// they have come apart along the normal changes the penetration
+		Vector3 offset = onOne - onTwo;
+		double separation = offset * normal;
+		Vector3 slide = offset - normal * separation;
+
+		point.penetration = point.initialPenetration - separation;
+		if (point.penetration < -breakingDistance) continue;
+		if (slide.squareMagnitude() > breakingDistance * breakingDistance) continue;
+
+		point.contactPoint = (onOne + onTwo) * 0.5;
+		points[kept++] = point;
+	}
+	pointCount = kept;
+}
+
+void ContactManifold::AddContact(const Contact& contact, double mergeDistance)
+{
+	// Detectors may report the pair either way around
+	Vector3 contactNormal = contact.contactNormal;
+	if (contact.body[0] != body[0]) contactNormal *= -1;
+
+	if (pointCount > 0 && contactNormal * normal < normalTolerance) pointCount = 0;
+	normal = contactNormal;
+
+	ManifoldPoint added;
+	added.localPoint[0] = body[0]->GetPointInLocalSpace(contact.contactPoint);
+	added.localPoint[1] = body[1] ? body[1]->GetPointInLocalSpace(contact.contactPoint) : contact.contactPoint;
+	added.initialPenetration = contact.penetration;
+	added.contactPoint = contact.contactPoint;
+	added.penetration = contact.penetration;
+	added.feature = contact.feature;
+
+	// Replace the point with the same feature, or failing that the
+	// nearest one close enough to be the same point
+	unsigned match = pointCount;
+	double nearest = mergeDistance * mergeDistance;
+	for (unsigned p = 0; p < pointCount; p++)
+	{
+		if (added.feature && points[p].feature == added.feature)
+		{
+			match = p;
+			break;
+		}
+
+		double distance = (points[p].contactPoint - added.contactPoint).squareMagnitude();
+		if (distance < nearest)
+		{
+			nearest = distance;
+			match = p;
+		}
+	}
+
+	if (match < pointCount)
+	{
+		points[match] = added;
+		return;
+	}
+
+	if (pointCount < maxPoints)
+	{
+		points[pointCount++] = added;
+		return;
+	}
+
+	unsigned drop = ChoosePointToDrop(added);
+	if (drop < maxPoints) points[drop] = added;
+}
+
+unsigned ContactManifold::ChoosePointToDrop(const ManifoldPoint& added) const
+{
+	const ManifoldPoint* candidates[maxPoints + 1];
+	for (unsigned p = 0; p < maxPoints; p++) candidates[p] = &points[p];
+	candidates[maxPoints] = &added;
+
+	// The deepest point is always kept
+	unsigned deepest = 0;
+	for (unsigned p = 1; p <= maxPoints; p++)
+	{
+		if (candidates[p]->penetration > candidates[deepest]->penetration) deepest = p;
+	}
+
+	// Drop whichever point leaves the other four spanning the most area
+	unsigned drop = maxPoints;
+	double largestArea = -1;
+	for (unsigned p = 0; p <= maxPoints; p++)
+	{
+		if (p == deepest) continue;
+
+		const Vector3* rest[maxPoints];
+		unsigned count = 0;
+		for (unsigned q = 0; q <= maxPoints; q++)
+		{
+			if (q != p) rest[count++] = &candidates[q]->contactPoint;
+		}
+
+		double area = QuadArea(*rest[0], *rest[1], *rest[2], *rest[3]);
+		if (area > largestArea)
+		{
+			largestArea = area;
+			drop = p;
+		}
+	}
+
+	return drop;
+}
+
+unsigned ContactManifold::WriteContacts(CollisionData* data) const
+{
+	unsigned written = 0;
+	for (unsigned p = 0; p < pointCount; p++)
+	{
+		if (!data->HasMoreContacts()) break;
+		if (points[p].penetration < -data->tolerance) continue;
+
+		Contact* contact = data->contacts;
+		contact->contactNormal = normal;
+		contact->contactPoint = points[p].contactPoint;
+		contact->penetration = points[p].penetration;
+		contact->SetBodyData(body[0], body[1], data->friction, data->restitution);
+		contact->feature = points[p].feature;
+
+		data->AddContacts(1);
+		written++;
+	}
+	return written;
+}
+
+size_t ContactPairCache::PairKeyHash::operator()(const PairKey& key) const
+{
+	size_t one = std::hash<const void*>()(key.one);
+	size_t two = std::hash<const void*>()(key.two);
+	return one ^ (two + 0x9e3779b9 + (one << 6) + (one >> 2));
+}
+
+ContactPairCache::ContactPairCache()
+	:
+	skipTolerance(0.001),
+	breakingDistance(0.02),
+	frame(0),
+	skipped(0)
+{
+}
+
+void ContactPairCache::BeginFrame()
+{
+	frame++;
+	skipped = 0;
+}
+
+void ContactPairCache::EndFrame()
+{
+	// Swap the last pair into the place of each dropped one
+	unsigned p = 0;
+	while (p < pairs.size())
+	{
+		if (pairs[p].lastFrame == frame)
+		{
+			p++;
+			continue;
+		}
+
+		pairIndex.erase(pairs[p].key);
+		if (p + 1 < pairs.size())
+		{
+			pairs[p] = pairs.back();
+			pairIndex[pairs[p].key] = p;
+		}
+		pairs.pop_back();
+	}
+}
+
+void ContactPairCache::Clear()
+{
+	pairs.clear();
+	pairIndex.clear();
+}
+
+void ContactPairCache::SetSkipTolerance(double tolerance)
+{
+	skipTolerance = tolerance;
+}
+
+void ContactPairCache::SetBreakingDistance(double distance)
+{
+	breakingDistance = distance;
+}
+
+const ContactManifold* ContactPairCache::Find(const void* one, const void* two) const
+{
+	PairKey key = { one, two };
+	std::unordered_map<PairKey, unsigned, PairKeyHash>::const_iterator entry = pairIndex.find(key);
+	if (entry == pairIndex.end()) return NULL;
+	return &pairs[entry->second].manifold;
+}
+
+ContactPairCache::CachedPair& ContactPairCache::GetPair(const void* one, const void* two,
+	RigidBody* oneBody, RigidBody* twoBody)
+{
+	PairKey key = { one, two };
+	std::unordered_map<PairKey, unsigned, PairKeyHash>::iterator entry = pairIndex.find(key);
+
+	if (entry == pairIndex.end())
+	{
+		CachedPair pair;
+		pair.key = key;
+		pair.manifold.Reset(oneBody, twoBody);
+		pair.tested = false;
+
+		entry = pairIndex.insert(std::make_pair(key, (unsigned)pairs.size())).first;
+		pairs.push_back(pair);
+	}
+
+	CachedPair& pair = pairs[entry->second];
+	pair.lastFrame = frame;
+	return pair;
+}
+
+template <class Test>
+unsigned ContactPairCache::Collide(CachedPair& pair, const CollisionPrimitive& one, const CollisionPrimitive* two,
+	Test test, CollisionData* data)
+{
+	ContactManifold& manifold = pair.manifold;
+	manifold.Refresh(breakingDistance);
+
+	// Against the world only the first primitive can move
+	Matrix4 relative = two ? one.GetTransform().inverse() * two->GetTransform() : one.GetTransform();
+
+	if (pair.tested && skipTolerance > 0 && TransformsClose(relative, pair.relativeTransform, skipTolerance))
+	{
+		skipped++;
+	}
+	else
+	{
+		CollisionData foundData;
+		foundData.contactArray = found;
+		foundData.Reset(maxFound);
+		foundData.friction = data->friction;
+		foundData.restitution = data->restitution;
+		foundData.tolerance = data->tolerance;
+
+		// A pair that has come apart loses its' points
+		unsigned count = test(&foundData);
+		if (count == 0) manifold.pointCount = 0;
+		for (unsigned c = 0; c < count; c++) manifold.AddContact(found[c], breakingDistance);
+
+		pair.relativeTransform = relative;
+		pair.tested = true;
+	}
+
+	return manifold.WriteContacts(data);
+}
+
+unsigned ContactPairCache::BoxAndBox(const CollisionBox& one, const CollisionBox& two, CollisionData* data)
+{
+	if (!data->HasMoreContacts()) return 0;
+
+	CachedPair& pair = GetPair(&one, &two, one.body, two.body);
+	return Collide(pair, one, &two, [&](CollisionData* found)
+	{
+		return CollisionDetector::BoxAndBox(one, two, found);
+	}, data);
+}
+
+unsigned ContactPairCache::BoxAndHalfSpace(const CollisionBox& box, const CollisionPlane& plane, CollisionData* data)
+{
+	if (!data->HasMoreContacts()) return 0;
+
+	CachedPair& pair = GetPair(&box, &plane, box.body, NULL);
+	return Collide(pair, box, NULL, [&](CollisionData* found)
+	{
+		return CollisionDetector::BoxAndHalfSpace(box, plane, found);
+	}, data);
+}
+
+unsigned ContactPairCache::BoxAndSphere(const CollisionBox& box, const CollisionSphere& sphere, CollisionData* data)
+{
+	if (!data->HasMoreContacts()) return 0;
+
+	CachedPair& pair = GetPair(&box, &sphere, box.body, sphere.body);
+	return Collide(pair, box, &sphere, [&](CollisionData* found)
+	{
+		return CollisionDetector::BoxAndSphere(box, sphere, found);
+	}, data);
+}
+
+unsigned ContactPairCache::SphereAndSphere(const CollisionSphere& one, const CollisionSphere& two, CollisionData* data)
+{
+	if (!data->HasMoreContacts()) return 0;
+
+	CachedPair& pair = GetPair(&one, &two, one.body, two.body);
+	return Collide(pair, one, &two, [&](CollisionData* found)
+	{
+		return CollisionDetector::SphereAndSphere(one, two, found);
+	}, data);
+}
+
+unsigned ContactPairCache::SphereAndHalfSpace(const CollisionSphere& sphere, const CollisionPlane& plane, CollisionData* data)
+{
+	if (!data->HasMoreContacts()) return 0;
+
+	CachedPair& pair = GetPair(&sphere, &plane, sphere.body, NULL);
+	return Collide(pair, sphere, NULL, [&](CollisionData* found)
+	{
+		return CollisionDetector::SphereAndHalfSpace(sphere, plane, found);
+	}, data);
+}
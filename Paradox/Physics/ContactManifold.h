@@ -0,0 +1,190 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains persistent contact manifolds, and the pair
+ * cache that keeps one for every pair of primitives in contact.
+ * Manifolds keep their points from frame to frame so that contacts
+ * stay put rather than jittering, and so that solvers can match
+ * them up with last frame's contacts to warm start.
+ */
+
+#include "CollideFine.h"
+#include <unordered_map>
+#include <vector>
+
+/**
+ * A contact point kept between frames. The point is anchored to
+ * both bodies when found, and followed as they move.
+ */
+struct ManifoldPoint
+{
+	// The point in each body's coordinates, or in world coordinates
+	// where there is no body
+	Vector3 localPoint[2];
+
+	// The penetration when the point was found
+	double initialPenetration;
+
+	// The point and penetration as of the last refresh
+	Vector3 contactPoint;
+	double penetration;
+
+	unsigned feature;
+};
+
+/**
+ * Up to four contact points between a pair of primitives, sharing
+ * a normal. New points are merged with the ones already there, by
+ * feature id or by position, and when there are too many the ones
+ * spanning the largest area are kept, along with the deepest.
+ */
+class ContactManifold
+{
+public:
+	static const unsigned maxPoints = 4;
+
+	RigidBody* body[2];
+
+	// Direction the first body is pushed in, in world coordinates
+	Vector3 normal;
+
+	ManifoldPoint points[maxPoints];
+	unsigned pointCount;
+
+	// Clears the manifold for a new pair of bodies
+	void Reset(RigidBody* one, RigidBody* two);
+
+	/**
+	 * Moves the points along with the bodies, dropping those that
+	 * have separated or slid further than the given distance.
+	 */
+	void Refresh(double breakingDistance);
+
+	/**
+	 * Merges a contact found between the bodies into the manifold.
+	 * Points closer than the given distance to the new one are
+	 * taken to be the same point.
+	 */
+	void AddContact(const Contact& contact, double mergeDistance);
+
+	/**
+	 * Writes the points at least as deep as the negative tolerance
+	 * into the collision data. Returns the number of contacts written.
+	 */
+	unsigned WriteContacts(CollisionData* data) const;
+
+private:
+	// Chooses which of the points, and the new one after them, to drop
+	unsigned ChoosePointToDrop(const ManifoldPoint& added) const;
+};
+
+/**
+ * Keeps a manifold for every pair of primitives passed to it, and
+ * refreshes it incrementally each frame. A pair whose relative
+ * transform has barely changed since the last full test skips the
+ * narrowphase and keeps its' points. Pairs that are not seen for a
+ * frame are dropped.
+ *
+ * The functions mirror those in CollisionDetector and write their
+ * contacts into the collision data in the same way.
+ */
+class ContactPairCache
+{
+public:
+	ContactPairCache();
+
+	// Starts a new frame of collision tests
+	void BeginFrame();
+
+	// Drops the pairs that were not tested this frame
+	void EndFrame();
+
+	// Drops every pair
+	void Clear();
+
+	/**
+	 * Sets how far the relative transform of a pair, in matrix terms,
+	 * may move before the narrowphase is run again. Zero always runs it.
+	 */
+	void SetSkipTolerance(double tolerance);
+
+	// Sets how far points may separate or slide before they are dropped
+	void SetBreakingDistance(double distance);
+
+	// Returns the number of pairs with a manifold
+	unsigned GetPairCount() const
+	{
+		return (unsigned)pairs.size();
+	}
+
+	// Returns the number of narrowphase tests skipped this frame
+	unsigned GetSkippedCount() const
+	{
+		return skipped;
+	}
+
+	// Returns the manifold of the given pair, or NULL if it has none
+	const ContactManifold* Find(const void* one, const void* two) const;
+
+	unsigned BoxAndBox(const CollisionBox& one, const CollisionBox& two, CollisionData* data);
+	unsigned BoxAndHalfSpace(const CollisionBox& box, const CollisionPlane& plane, CollisionData* data);
+	unsigned BoxAndSphere(const CollisionBox& box, const CollisionSphere& sphere, CollisionData* data);
+	unsigned SphereAndSphere(const CollisionSphere& one, const CollisionSphere& two, CollisionData* data);
+	unsigned SphereAndHalfSpace(const CollisionSphere& sphere, const CollisionPlane& plane, CollisionData* data);
+
+private:
+	struct PairKey
+	{
+		const void* one;
+		const void* two;
+
+		bool operator==(const PairKey& other) const
+		{
+			return one == other.one && two == other.two;
+		}
+	};
+
+	struct PairKeyHash
+	{
+		size_t operator()(const PairKey& key) const;
+	};
+
+	struct CachedPair
+	{
+		PairKey key;
+		ContactManifold manifold;
+
+		// Transform of the second primitive relative to the first at
+		// the last narrowphase test, or of the first in the world
+		Matrix4 relativeTransform;
+		bool tested;
+
+		unsigned lastFrame;
+	};
+
+	// Returns the entry for the given pair, adding it if needed
+	CachedPair& GetPair(const void* one, const void* two, RigidBody* oneBody, RigidBody* twoBody);
+
+	/**
+	 * Brings the pair's manifold up to date, running the given test
+	 * unless the pair has barely moved, and writes its' contacts.
+	 */
+	template <class Test>
+	unsigned Collide(CachedPair& pair, const CollisionPrimitive& one, const CollisionPrimitive* two,
+		Test test, CollisionData* data);
+
+	// Room for the most contacts a single narrowphase test can find
+	static const unsigned maxFound = 8;
+	Contact found[maxFound];
+
+	std::vector<CachedPair> pairs;
+	std::unordered_map<PairKey, unsigned, PairKeyHash> pairIndex;
+
+	double skipTolerance;
+	double breakingDistance;
+
+	unsigned frame;
+	unsigned skipped;
+};
@@ -1,6 +1,7 @@
-#include "Contacts.h"
+#include "contacts.h"
 #include <memory.h>
 #include <assert.h>
+#include <algorithm>
 
 void Contact::SetBodyData(RigidBody* one, RigidBody* two, double friction, double restitution)
 {
@@ -8,6 +9,7 @@ void Contact::SetBodyData(RigidBody* one, RigidBody* two, double friction, doubl
 	Contact::body[1] = two;
 	Contact::friction = friction;
 	Contact::restitution = restitution;
+	Contact::feature = 0;
 }
 
 void Contact::MatchAwakeState()
@@ -80,7 +82,7 @@ inline void Contact::CalculateContactBasis()
 		contactTangent[1].x = contactNormal.y * contactTangent[0].z -
 							  contactNormal.z * contactTangent[0].y;
 		contactTangent[1].y = -contactNormal.x * contactTangent[0].z;
-		contactTangent[1].z = contactNormal.x * contactTangent[0].z;
+		contactTangent[1].z = contactNormal.x * contactTangent[0].y;
 	}
 
 	// Make a matrix from the three vectors
@@ -129,7 +131,7 @@ void Contact::CalculateDesiredDeltaVelocity(double duration)
 
 	if (body[1] && body[1]->GetAwakeStatus())
 	{
-		velocityFromAcc += body[1]->GetLastFrameAcceleration() * duration * contactNormal;
+		velocityFromAcc -= body[1]->GetLastFrameAcceleration() * duration * contactNormal;
 	}
 
 	// If the velocity is very slow, limit the restitution
@@ -205,7 +207,7 @@ void Contact::ApplyVelocityChange(Vector3 velocityChange[2], Vector3 rotationCha
 
 	// Apply the changes
 	body[0]->AddVelocity(velocityChange[0]);
-	body[0]->AddRotation(velocityChange[0]);
+	body[0]->AddRotation(rotationChange[0]);
 	
 	if (body[1])
 	{
@@ -216,8 +218,8 @@ void Contact::ApplyVelocityChange(Vector3 velocityChange[2], Vector3 rotationCha
 		velocityChange[1].addScaledVector(impulse, -body[1]->GetInverseMass());
 
 		// Apply the changes
-		body[1]->AddVelocity(velocityChange[0]);
-		body[1]->AddRotation(velocityChange[0]);
+		body[1]->AddVelocity(velocityChange[1]);
+		body[1]->AddRotation(rotationChange[1]);
 	}
 }
 
@@ -291,9 +293,9 @@ inline Vector3 Contact::CalculateFrictionImpulse(Matrix3* inverseInertiaTensor)
 		// Calculate the velocity change matrix
 
 		Matrix3 deltaVelWorld2 = impulseToTorque;
-		deltaVelWorld *= inverseInertiaTensor[1];
-		deltaVelWorld *= impulseToTorque;
-		deltaVelWorld *= -1;
+		deltaVelWorld2 *= inverseInertiaTensor[1];
+		deltaVelWorld2 *= impulseToTorque;
+		deltaVelWorld2 *= -1;
 
 		// Add to the total delta velocity
 
@@ -486,11 +488,124 @@ void Contact::ApplyPositionChange(Vector3 linearChange[2], Vector3 angularChange
 	}
 }
 
+void Contact::MatchVelocityChange(const Contact& resolved,
+								  const Vector3 velocityChange[2],
+								  const Vector3 rotationChange[2],
+								  double duration)
+{
+	// Check each body in the contact
+	for (unsigned b = 0; b < 2; b++) if (body[b])
+	{
+		// Check for a match with each body in the newly
+		// resolved contact
+		for (unsigned d = 0; d < 2; d++)
+		{
+			if (body[b] == resolved.body[d])
+			{
+				Vector3 deltaVel = velocityChange[d] +
+					rotationChange[d].vectorProduct(relativeContactPosition[b]);
+
+				// The sign of the change is negative if we're 
+				// dealing with the second body in a contact.
+				contactVelocity += contactToWorld.transformTranspose(deltaVel) * (b ? -1 : 1);
+				CalculateDesiredDeltaVelocity(duration);
+			}
+		}
+	}
+}
+
+void Contact::MatchPositionChange(const Contact& resolved,
+								  const Vector3 linearChange[2],
+								  const Vector3 angularChange[2])
+{
+	// Check each body in the contact
+	for (unsigned b = 0; b < 2; b++) if (body[b])
+	{
+		// Check for a match with each body in the newly resolved contact
+		for (unsigned d = 0; d < 2; d++)
+		{
+			if (body[b] == resolved.body[d])
+			{
+				Vector3 deltaPosition = linearChange[d] +
+					angularChange[d].vectorProduct(relativeContactPosition[b]);
+
+				// The sign of the change is positive if we're dealing with
+				// the second body in a contact and negative otherwise
+				// (because we're subtracting the resolution)..
+				penetration += deltaPosition.scalarProduct(contactNormal) * (b ? 1 : -1);
+			}
+		}
+	}
+}
+
+// Severity heap implementation
+
+void SeverityHeap::Reset(unsigned count)
+{
+	keys.resize(count);
+	heap.resize(count);
+	positions.resize(count);
+	for (unsigned item = 0; item < count; item++) heap[item] = positions[item] = item;
+}
+
+void SeverityHeap::Heapify()
+{
+	for (unsigned position = (unsigned)heap.size() / 2; position-- > 0;) SiftDown(position);
+}
+
+void SeverityHeap::Update(unsigned item, double key)
+{
+	keys[item] = key;
+	SiftUp(positions[item]);
+	SiftDown(positions[item]);
+}
+
+void SeverityHeap::Place(unsigned position, unsigned item)
+{
+	heap[position] = item;
+	positions[item] = position;
+}
+
+void SeverityHeap::SiftUp(unsigned position)
+{
+	unsigned item = heap[position];
+	while (position > 0)
+	{
+		unsigned parent = (position - 1) / 2;
+		if (!Before(item, heap[parent])) break;
+		Place(position, heap[parent]);
+		position = parent;
+	}
+	Place(position, item);
+}
+
+void SeverityHeap::SiftDown(unsigned position)
+{
+	unsigned item = heap[position];
+	unsigned size = (unsigned)heap.size();
+	for (;;)
+	{
+		unsigned child = position * 2 + 1;
+		if (child >= size) break;
+		if (child + 1 < size && Before(heap[child + 1], heap[child])) child++;
+		if (!Before(heap[child], item)) break;
+		Place(position, heap[child]);
+		position = child;
+	}
+	Place(position, item);
+}
+
 // Contact resolver implementation
 
+// Sets of up to this many contacts are scanned in full each iteration,
+// which is quicker than keeping the body index and heap up to date
+static const unsigned maxScannedContacts = 32;
+
 ContactResolver::ContactResolver(unsigned iterations,
 								 double velocityEpsilon,
 								 double positionEpsilon)
+	:
+	stamp(0)
 {
 	SetIterations(iterations, iterations);
 	SetEpsilon(velocityEpsilon, positionEpsilon);
@@ -500,8 +615,10 @@ ContactResolver::ContactResolver(unsigned velocityIterations,
 								 unsigned positionIterations,
 								 double velocityEpsilon,
 								 double positionEpsilon)
+	:
+	stamp(0)
 {
-	SetIterations(velocityIterations);
+	SetIterations(velocityIterations, positionIterations);
 	SetEpsilon(velocityEpsilon, positionEpsilon);
 }
 
@@ -553,6 +670,66 @@ void ContactResolver::PrepareContacts(Contact* contacts,
 		// Calculate the internal contact data (inertia, basis, etc).
 		contact->CalculateInternals(duration);
 	}
+
+	if (numContacts > maxScannedContacts) BuildBodyContacts(contacts, numContacts);
+}
+
+void ContactResolver::BuildBodyContacts(Contact* contacts, unsigned numContacts)
+{
+	bodyContacts.clear();
+	for (unsigned i = 0; i < numContacts; i++)
+	{
+		for (unsigned b = 0; b < 2; b++) if (contacts[i].body[b])
+		{
+			bodyContacts.push_back(std::make_pair((const RigidBody*)contacts[i].body[b], i * 2 + b));
+		}
+	}
+
+	// Group the entries by body, the order within a group is only
+	// used to find neighbours and does not affect the results
+	std::sort(bodyContacts.begin(), bodyContacts.end());
+
+	bodyContactsBegin.resize(numContacts * 2);
+	bodyContactsEnd.resize(numContacts * 2);
+
+	unsigned begin = 0;
+	unsigned numEntries = (unsigned)bodyContacts.size();
+	while (begin < numEntries)
+	{
+		unsigned end = begin + 1;
+		while (end < numEntries && bodyContacts[end].first == bodyContacts[begin].first) end++;
+
+		for (unsigned entry = begin; entry < end; entry++)
+		{
+			bodyContactsBegin[bodyContacts[entry].second] = begin;
+			bodyContactsEnd[bodyContacts[entry].second] = end;
+		}
+		begin = end;
+	}
+
+	gatheredStamp.assign(numContacts, 0);
+	stamp = 0;
+}
+
+unsigned ContactResolver::GatherNeighbours(const Contact* contacts, unsigned index)
+{
+	neighbours.clear();
+	stamp++;
+
+	for (unsigned d = 0; d < 2; d++) if (contacts[index].body[d])
+	{
+		unsigned slot = index * 2 + d;
+		for (unsigned entry = bodyContactsBegin[slot]; entry < bodyContactsEnd[slot]; entry++)
+		{
+			unsigned i = bodyContacts[entry].second / 2;
+			if (gatheredStamp[i] == stamp) continue;
+
+			gatheredStamp[i] = stamp;
+			neighbours.push_back(i);
+		}
+	}
+
+	return (unsigned)neighbours.size();
 }
 
 void ContactResolver::AdjustVelocities(Contact* c,
@@ -560,22 +737,36 @@ void ContactResolver::AdjustVelocities(Contact* c,
 									   double duration)
 {
 	Vector3 velocityChange[2], rotationChange[2];
-	Vector3 deltaVel;
+
+	// Order the contacts by magnitude of probable velocity change
+	bool indexed = numContacts > maxScannedContacts;
+	if (indexed)
+	{
+		severities.Reset(numContacts);
+		for (unsigned i = 0; i < numContacts; i++) severities.SetKey(i, c[i].desiredDeltaVelocity);
+		severities.Heapify();
+	}
 
 	// Iteratively handle impacts in order of severity.
 	velocityIterationsUsed = 0;
 	while (velocityIterationsUsed < velocityIterations)
 	{
 		// Find contact with maximum magnitude of probable velocity change
-		double max = velocityEpsilon;
 		unsigned index = numContacts;
-		
-		for (unsigned i = 0; i < numContacts; i++)
+		if (indexed)
+		{
+			if (severities.GetKey(severities.Top()) > velocityEpsilon) index = severities.Top();
+		}
+		else
 		{
-			if (c[i].desiredDeltaVelocity > max)
+			double max = velocityEpsilon;
+			for (unsigned i = 0; i < numContacts; i++)
 			{
-				max = c[i].desiredDeltaVelocity;
-				index = i;
+				if (c[i].desiredDeltaVelocity > max)
+				{
+					max = c[i].desiredDeltaVelocity;
+					index = i;
+				}
 			}
 		}
 
@@ -589,30 +780,23 @@ void ContactResolver::AdjustVelocities(Contact* c,
 
 		// With the change in velocity of the two bodies, the update
 		// of contact velocities means that some of the relative closing
-		// velocities need recomputing.
-		for (unsigned i = 0; i < numContacts; i++)
+		// velocities need recomputing. Only contacts sharing a body
+		// with the resolved contact can have changed.
+		if (indexed)
 		{
-			// Check each body in the contact
-			for (unsigned b = 0; b < 2; b++) if (c[i].body[b])
+			unsigned numNeighbours = GatherNeighbours(c, index);
+			for (unsigned n = 0; n < numNeighbours; n++)
 			{
-				// Check for a match with each body in the newly
-				// resolved contact
-				for (unsigned d = 0; d < 2; d++)
-				{
-					if (c[i].body[b] == c[index].body[d])
-					{
-						deltaVel = velocityChange[d] +
-							rotationChange[d].vectorProduct(
-								c[i].relativeContactPosition[b]);
-					
-						// The sign of the change is negative if we're 
-						// dealing with the second body in a contact.
-						c[i].contactVelocity +=
-							c[i].contactToWorld.transformTranspose(deltaVel)
-							* (b ? -1 : 1);
-						c[i].CalculateDesiredDeltaVelocity(duration);
-					}
-				}
+				unsigned i = neighbours[n];
+				c[i].MatchVelocityChange(c[index], velocityChange, rotationChange, duration);
+				severities.Update(i, c[i].desiredDeltaVelocity);
+			}
+		}
+		else
+		{
+			for (unsigned i = 0; i < numContacts; i++)
+			{
+				c[i].MatchVelocityChange(c[index], velocityChange, rotationChange, duration);
 			}
 		}
 		velocityIterationsUsed++;
@@ -623,24 +807,41 @@ void ContactResolver::AdjustPositions(Contact* c,
 	unsigned numContacts,
 	double duration)
 {
-	unsigned i, index;
 	Vector3 linearChange[2], angularChange[2];
-	double max;
-	Vector3 deltaPosition;
+
+	// Order the contacts by penetration
+	bool indexed = numContacts > maxScannedContacts;
+	if (indexed)
+	{
+		severities.Reset(numContacts);
+		for (unsigned i = 0; i < numContacts; i++) severities.SetKey(i, c[i].penetration);
+		severities.Heapify();
+	}
 
 	// Iteratively resolve interpenetrations in order of severity.
 	positionIterationsUsed = 0;
 	while (positionIterationsUsed < positionIterations)
 	{
 		// Find the biggest penetration
-		max = positionEpsilon;
-		index = numContacts;
-		for (i = 0; i < numContacts; i++)
+		double max = positionEpsilon;
+		unsigned index = numContacts;
+		if (indexed)
+		{
+			if (severities.GetKey(severities.Top()) > max)
+			{
+				index = severities.Top();
+				max = severities.GetKey(index);
+			}
+		}
+		else
 		{
-			if (c[i].penetration > max)
+			for (unsigned i = 0; i < numContacts; i++)
 			{
-				max = c[i].penetration;
-				index = i;
+				if (c[i].penetration > max)
+				{
+					max = c[i].penetration;
+					index = i;
+				}
 			}
 		}
 
@@ -653,30 +854,24 @@ void ContactResolver::AdjustPositions(Contact* c,
 		c[index].ApplyPositionChange(linearChange, angularChange, max);
 
 		// Again this action may have changed the penetration of other bodies,
-		// so we update contacts
-		for (i = 0; i < numContacts; i++)
+		// so we update the contacts sharing a body with the resolved one
+		if (indexed)
 		{
-			// Check each body in the contact
-			for (unsigned b = 0; b < 2; b++) if (c[i].body[b])
+			unsigned numNeighbours = GatherNeighbours(c, index);
+			for (unsigned n = 0; n < numNeighbours; n++)
 			{
-				// Check for a match with each body in the newly resolved contact
-				for (unsigned d = 0; d < 2; d++)
-				{
-					if (c[i].body[b] == c[index].body[d])
-					{
-						deltaPosition = linearChange[d] +
-							angularChange[d].vectorProduct(
-								c[i].relativeContactPosition[b]);
-
-						// The sign of the change is positive if we're dealing with
-						// the second body in a contact and negative otherwise
-						// (because we're subtracting the resolution)..
-						c[i].penetration += deltaPosition.scalarProduct(c[i].contactNormal)
-							* (b ? 1 : -1);
-					}
-				}
+				unsigned i = neighbours[n];
+				c[i].MatchPositionChange(c[index], linearChange, angularChange);
+				severities.Update(i, c[i].penetration);
+			}
+		}
+		else
+		{
+			for (unsigned i = 0; i < numContacts; i++)
+			{
+				c[i].MatchPositionChange(c[index], linearChange, angularChange);
 			}
 		}
 		positionIterationsUsed++;
 	}
-}
\ No newline at end of file
+}
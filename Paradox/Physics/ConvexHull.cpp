@@ -0,0 +1,376 @@
+#include "ConvexHull.h"
+#include <algorithm>
+#include <math.h>
+
+// Hulls with no more vertices than this are quicker to search by
+// testing every vertex than by climbing
+static const unsigned exhaustiveVertices = 48;
+
+// Points closer than this to a face, relative to the size of the
+// cloud, are taken to lie on it and are left out of the hull
+static const double relativeTolerance = 1e-9;
+
+/**
+ * A triangle of the hull while it is being built. Each face knows the
+ * face across each of its' edges, edge i running from vertex i to
+ * vertex i + 1, and holds the points outside it that are not yet in
+ * the hull.
+ */
+struct BuildFace
+{
+	unsigned vertices[3];
+	unsigned adjacent[3];
+	Vector3 normal;
+	double offset;
+	std::vector<unsigned> outside;
+	bool removed;
+};
+
+// Returns a face with the plane through the given points, wound
+// anticlockwise seen from outside
+static BuildFace MakeFace(const Vector3* points, unsigned a, unsigned b, unsigned c)
+{
+	BuildFace face;
+	face.vertices[0] = a;
+	face.vertices[1] = b;
+	face.vertices[2] = c;
+	face.adjacent[0] = face.adjacent[1] = face.adjacent[2] = 0;
+	face.normal = (points[b] - points[a]) % (points[c] - points[a]);
+	face.normal.normalise();
+	face.offset = face.normal * points[a];
+	face.removed = false;
+	return face;
+}
+
+static double DistanceAbove(const BuildFace& face, const Vector3& point)
+{
+	return face.normal * point - face.offset;
+}
+
+// Returns the slot of the face's edge running from a to b
+static unsigned FindEdge(const BuildFace& face, unsigned a, unsigned b)
+{
+	for (unsigned i = 0; i < 3; i++)
+	{
+		if (face.vertices[i] == a && face.vertices[(i + 1) % 3] == b) return i;
+	}
+	return 3;
+}
+
+/**
+ * Picks four points of the cloud spanning as large a volume as it can
+ * find cheaply: the furthest apart of the extremes along each axis,
+ * the point furthest from the line through them, and the point
+ * furthest from the plane through all three.
+ */
+static bool FindStartingTetrahedron(const Vector3* points, unsigned count, double tolerance, unsigned* start)
+{
+	unsigned lowest[3] = { 0, 0, 0 };
+	unsigned highest[3] = { 0, 0, 0 };
+	for (unsigned i = 1; i < count; i++)
+	{
+		for (unsigned axis = 0; axis < 3; axis++)
+		{
+			if (points[i][axis] < points[lowest[axis]][axis]) lowest[axis] = i;
+			if (points[i][axis] > points[highest[axis]][axis]) highest[axis] = i;
+		}
+	}
+
+	double widest = -1;
+	for (unsigned axis = 0; axis < 3; axis++)
+	{
+		double width = points[highest[axis]][axis] - points[lowest[axis]][axis];
+		if (width > widest)
+		{
+			widest = width;
+			start[0] = lowest[axis];
+			start[1] = highest[axis];
+		}
+	}
+	if (widest <= tolerance) return false;
+
+	Vector3 line = points[start[1]] - points[start[0]];
+	double furthest = 0;
+	for (unsigned i = 0; i < count; i++)
+	{
+		double distance = ((points[i] - points[start[0]]) % line).squareMagnitude();
+		if (distance > furthest)
+		{
+			furthest = distance;
+			start[2] = i;
+		}
+	}
+	if (furthest <= tolerance * tolerance * line.squareMagnitude()) return false;
+
+	Vector3 normal = line % (points[start[2]] - points[start[0]]);
+	normal.normalise();
+	furthest = 0;
+	for (unsigned i = 0; i < count; i++)
+	{
+		double distance = fabs((points[i] - points[start[0]]) * normal);
+		if (distance > furthest)
+		{
+			furthest = distance;
+			start[3] = i;
+		}
+	}
+	return furthest > tolerance;
+}
+
+// Hands each of the given points to the face it is furthest outside,
+// dropping the points inside every face
+static void AssignOutside(const Vector3* points, const std::vector<unsigned>& candidates,
+	std::vector<BuildFace>& faces, unsigned firstFace, double tolerance)
+{
+	for (unsigned point : candidates)
+	{
+		unsigned best = 0;
+		double bestDistance = tolerance;
+		for (unsigned f = firstFace; f < faces.size(); f++)
+		{
+			if (faces[f].removed) continue;
+
+			double distance = DistanceAbove(faces[f], points[point]);
+			if (distance > bestDistance)
+			{
+				bestDistance = distance;
+				best = f;
+			}
+		}
+		if (bestDistance > tolerance) faces[best].outside.push_back(point);
+	}
+}
+
+ConvexHull::ConvexHull()
+{
+}
+
+bool ConvexHull::Build(const Vector3* points, unsigned count)
+{
+	vertices.clear();
+	faces.clear();
+	edges.clear();
+	firstNeighbour.clear();
+	neighbours.clear();
+	halfSize = Vector3();
+
+	if (count < 4) return false;
+
+	double scale = 0;
+	for (unsigned i = 0; i < count; i++)
+	{
+		scale = std::max(scale, fabs(points[i].x) + fabs(points[i].y) + fabs(points[i].z));
+	}
+	double tolerance = relativeTolerance * std::max(scale, 1.0);
+
+	unsigned start[4];
+	if (!FindStartingTetrahedron(points, count, tolerance, start)) return false;
+
+	// Wind each face of the tetrahedron so its' normal points away
+	// from the fourth point
+	std::vector<BuildFace> building;
+	static const unsigned sides[4][4] = { { 0, 1, 2, 3 }, { 0, 3, 1, 2 }, { 0, 2, 3, 1 }, { 1, 3, 2, 0 } };
+	for (unsigned f = 0; f < 4; f++)
+	{
+		unsigned a = start[sides[f][0]], b = start[sides[f][1]], c = start[sides[f][2]];
+		BuildFace face = MakeFace(points, a, b, c);
+		if (DistanceAbove(face, points[start[sides[f][3]]]) > 0) face = MakeFace(points, a, c, b);
+		building.push_back(face);
+	}
+	for (unsigned f = 0; f < 4; f++)
+	{
+		for (unsigned i = 0; i < 3; i++)
+		{
+			unsigned a = building[f].vertices[i], b = building[f].vertices[(i + 1) % 3];
+			for (unsigned g = 0; g < 4; g++)
+			{
+				if (g != f && FindEdge(building[g], b, a) < 3) building[f].adjacent[i] = g;
+			}
+		}
+	}
+
+	std::vector<unsigned> candidates;
+	for (unsigned i = 0; i < count; i++)
+	{
+		if (i != start[0] && i != start[1] && i != start[2] && i != start[3]) candidates.push_back(i);
+	}
+	AssignOutside(points, candidates, building, 0, tolerance);
+
+	// The new face whose horizon edge starts at each point
+	std::vector<unsigned> faceFrom(count);
+
+	std::vector<unsigned> visible;
+	std::vector<std::pair<unsigned, unsigned>> horizon;
+	for (;;)
+	{
+		unsigned current = 0;
+		while (current < building.size() && (building[current].removed || building[current].outside.empty())) current++;
+		if (current == building.size()) break;
+
+		// The point furthest outside the face joins the hull
+		unsigned eye = building[current].outside[0];
+		for (unsigned point : building[current].outside)
+		{
+			if (DistanceAbove(building[current], points[point]) > DistanceAbove(building[current], points[eye])) eye = point;
+		}
+
+		// Every face the point is outside of goes, leaving a hole
+		// bounded by the horizon edges
+		visible.clear();
+		horizon.clear();
+		visible.push_back(current);
+		building[current].removed = true;
+		for (unsigned next = 0; next < visible.size(); next++)
+		{
+			unsigned f = visible[next];
+			for (unsigned i = 0; i < 3; i++)
+			{
+				unsigned across = building[f].adjacent[i];
+				if (building[across].removed) continue;
+
+				if (DistanceAbove(building[across], points[eye]) > tolerance)
+				{
+					building[across].removed = true;
+					visible.push_back(across);
+				}
+				else horizon.push_back(std::make_pair(f, i));
+			}
+		}
+
+		// Fill the hole with a fan of faces from the horizon to the point
+		unsigned firstNew = (unsigned)building.size();
+		for (const std::pair<unsigned, unsigned>& edge : horizon)
+		{
+			const BuildFace& old = building[edge.first];
+			unsigned a = old.vertices[edge.second];
+			unsigned b = old.vertices[(edge.second + 1) % 3];
+			unsigned across = old.adjacent[edge.second];
+
+			unsigned added = (unsigned)building.size();
+			building.push_back(MakeFace(points, a, b, eye));
+			building[added].adjacent[0] = across;
+			building[across].adjacent[FindEdge(building[across], b, a)] = added;
+			faceFrom[a] = added;
+		}
+		for (unsigned f = firstNew; f < building.size(); f++)
+		{
+			unsigned next = faceFrom[building[f].vertices[1]];
+			building[f].adjacent[1] = next;
+			building[next].adjacent[2] = f;
+		}
+
+		// The points outside the faces that went may be outside the new ones
+		candidates.clear();
+		for (unsigned f : visible)
+		{
+			for (unsigned point : building[f].outside)
+			{
+				if (point != eye) candidates.push_back(point);
+			}
+			std::vector<unsigned>().swap(building[f].outside);
+		}
+		AssignOutside(points, candidates, building, firstNew, tolerance);
+	}
+
+	// Number the faces and vertices that are left
+	std::vector<unsigned> faceIndex(building.size());
+	std::vector<unsigned> vertexIndex(count, 0xffffffff);
+	for (unsigned f = 0; f < building.size(); f++)
+	{
+		if (building[f].removed) continue;
+
+		faceIndex[f] = (unsigned)faces.size();
+		HullFace face;
+		face.normal = building[f].normal;
+		face.offset = building[f].offset;
+		face.edge = 3 * faceIndex[f];
+		faces.push_back(face);
+
+		for (unsigned i = 0; i < 3; i++)
+		{
+			unsigned& index = vertexIndex[building[f].vertices[i]];
+			if (index != 0xffffffff) continue;
+
+			index = (unsigned)vertices.size();
+			vertices.push_back(points[building[f].vertices[i]]);
+		}
+	}
+
+	// Three half edges per face, each the twin of one in the face across
+	edges.resize(3 * faces.size());
+	for (unsigned f = 0; f < building.size(); f++)
+	{
+		if (building[f].removed) continue;
+
+		const BuildFace& face = building[f];
+		for (unsigned i = 0; i < 3; i++)
+		{
+			HullHalfEdge& edge = edges[3 * faceIndex[f] + i];
+			const BuildFace& across = building[face.adjacent[i]];
+			unsigned slot = FindEdge(across, face.vertices[(i + 1) % 3], face.vertices[i]);
+
+			edge.vertex = vertexIndex[face.vertices[i]];
+			edge.twin = 3 * faceIndex[face.adjacent[i]] + slot;
+			edge.next = 3 * faceIndex[f] + (i + 1) % 3;
+			edge.face = faceIndex[f];
+		}
+	}
+
+	// Each half edge leaving a vertex leads to one of its' neighbours
+	firstNeighbour.assign(vertices.size() + 1, 0);
+	for (const HullHalfEdge& edge : edges) firstNeighbour[edge.vertex + 1]++;
+	for (unsigned i = 0; i < vertices.size(); i++) firstNeighbour[i + 1] += firstNeighbour[i];
+
+	neighbours.resize(edges.size());
+	std::vector<unsigned> filled(firstNeighbour.begin(), firstNeighbour.end() - 1);
+	for (const HullHalfEdge& edge : edges)
+	{
+		neighbours[filled[edge.vertex]++] = edges[edge.next].vertex;
+	}
+
+	for (const Vector3& vertex : vertices)
+	{
+		halfSize.x = std::max(halfSize.x, fabs(vertex.x));
+		halfSize.y = std::max(halfSize.y, fabs(vertex.y));
+		halfSize.z = std::max(halfSize.z, fabs(vertex.z));
+	}
+	return true;
+}
+
+unsigned ConvexHull::FindSupportVertex(const Vector3& direction, unsigned start) const
+{
+	if (vertices.size() <= exhaustiveVertices)
+	{
+		unsigned best = 0;
+		double bestDistance = vertices[0] * direction;
+		for (unsigned i = 1; i < vertices.size(); i++)
+		{
+			double distance = vertices[i] * direction;
+			if (distance > bestDistance)
+			{
+				bestDistance = distance;
+				best = i;
+			}
+		}
+		return best;
+	}
+
+	unsigned current = start;
+	double best = vertices[current] * direction;
+	for (;;)
+	{
+		unsigned next = current;
+		for (unsigned i = firstNeighbour[current]; i < firstNeighbour[current + 1]; i++)
+		{
+			double distance = vertices[neighbours[i]] * direction;
+			if (distance > best)
+			{
+				best = distance;
+				next = neighbours[i];
+			}
+		}
+
+		if (next == current) return current;
+		current = next;
+	}
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the convex hull shape: the hull of a cloud of
+ * points, built with quickhull and kept with the adjacency of its'
+ * faces, edges and vertices.
+ */
+
+#include "../ParadoxMath.h"
+#include <vector>
+
+/**
+ * One side of an edge of the hull. Each edge is held as two half
+ * edges running opposite ways round the two faces it joins.
+ */
+struct HullHalfEdge
+{
+	// The vertex the half edge starts at
+	unsigned vertex;
+
+	// The half edge running the other way along the same edge
+	unsigned twin;
+
+	// The next half edge anticlockwise round the face
+	unsigned next;
+
+	// The face the half edge goes round
+	unsigned face;
+};
+
+// A triangle of the hull, with its' plane facing outwards
+struct HullFace
+{
+	Vector3 normal;
+	double offset;
+
+	// The first of the face's three half edges
+	unsigned edge;
+};
+
+/**
+ * A convex polyhedron in its' own coordinates, shared between every
+ * primitive of that shape.
+ *
+ * The hull is built from a point cloud with quickhull, dropping the
+ * points that fall inside it or within a small tolerance of its'
+ * faces. Faces are triangles joined by half edges, and each vertex
+ * keeps a list of the vertices it shares an edge with, so the vertex
+ * furthest along a direction of a large hull can be found by climbing
+ * from vertex to neighbouring vertex rather than testing them all.
+ */
+class ConvexHull
+{
+public:
+	ConvexHull();
+
+	/**
+	 * Builds the hull of the given points, replacing any hull built
+	 * before. Returns false, leaving the hull empty, if the points do
+	 * not span a volume.
+	 */
+	bool Build(const Vector3* points, unsigned count);
+
+	unsigned GetVertexCount() const
+	{
+		return (unsigned)vertices.size();
+	}
+
+	const Vector3& GetVertex(unsigned vertex) const
+	{
+		return vertices[vertex];
+	}
+
+	// Gives the vertices as an array, for code that tests them all
+	const Vector3* GetVertices() const
+	{
+		return vertices.data();
+	}
+
+	unsigned GetFaceCount() const
+	{
+		return (unsigned)faces.size();
+	}
+
+	const HullFace& GetFace(unsigned face) const
+	{
+		return faces[face];
+	}
+
+	const HullHalfEdge& GetEdge(unsigned edge) const
+	{
+		return edges[edge];
+	}
+
+	/**
+	 * Returns the vertex furthest along the given direction, found by
+	 * climbing from the given vertex to whichever neighbour is further
+	 * along until none is. Starting from the vertex the last search
+	 * found makes coherent searches take a step or two. Small hulls
+	 * are quicker to search whole, and ignore the starting vertex.
+	 */
+	unsigned FindSupportVertex(const Vector3& direction, unsigned start = 0) const;
+
+	// Returns the half-sizes of the box around the origin holding the hull
+	const Vector3& GetHalfSize() const
+	{
+		return halfSize;
+	}
+
+private:
+	std::vector<Vector3> vertices;
+	std::vector<HullFace> faces;
+	std::vector<HullHalfEdge> edges;
+
+	// The neighbours of vertex i are neighbours[firstNeighbour[i]] up
+	// to neighbours[firstNeighbour[i + 1]]
+	std::vector<unsigned> firstNeighbour;
+	std::vector<unsigned> neighbours;
+
+	Vector3 halfSize;
+};
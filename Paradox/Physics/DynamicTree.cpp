@@ -0,0 +1,470 @@
+#include "DynamicTree.h"
+#include <algorithm>
+
+DynamicAABBTree::DynamicAABBTree(double margin, double predictionFactor)
+	:
+	root(nullNode),
+	freeList(nullNode),
+	proxyCount(0),
+	margin(margin),
+	predictionFactor(predictionFactor)
+{
+}
+
+unsigned DynamicAABBTree::AllocateNode()
+{
+	unsigned node = freeList;
+	if (node == nullNode)
+	{
+		node = (unsigned)nodes.size();
+		nodes.push_back(DynamicTreeNode());
+	}
+	else
+	{
+		freeList = nodes[node].parent;
+	}
+
+	DynamicTreeNode& allocated = nodes[node];
+	allocated.body = NULL;
+	allocated.parent = nullNode;
+	allocated.children[0] = allocated.children[1] = nullNode;
+	allocated.height = 0;
+	return node;
+}
+
+void DynamicAABBTree::FreeNode(unsigned node)
+{
+	nodes[node].parent = freeList;
+	nodes[node].height = -1;
+	freeList = node;
+}
+
+BoundingBoxVolume DynamicAABBTree::Fatten(const BoundingBoxVolume& volume, const Vector3& displacement) const
+{
+	Vector3 fat(margin, margin, margin);
+	BoundingBoxVolume result(volume.min - fat, volume.max + fat);
+
+	// Stretch the box along the way the body is heading
+	Vector3 predicted = displacement * predictionFactor;
+	for (unsigned axis = 0; axis < 3; axis++)
+	{
+		if (predicted[axis] < 0) result.min[axis] += predicted[axis];
+		else result.max[axis] += predicted[axis];
+	}
+	return result;
+}
+
+unsigned DynamicAABBTree::CreateProxy(const BoundingBoxVolume& volume, RigidBody* body)
+{
+	unsigned proxy = AllocateNode();
+	nodes[proxy].volume = Fatten(volume, Vector3());
+	nodes[proxy].body = body;
+
+	InsertLeaf(proxy);
+	proxyCount++;
+	return proxy;
+}
+
+void DynamicAABBTree::DestroyProxy(unsigned proxy)
+{
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	proxyCount--;
+}
+
+bool DynamicAABBTree::MoveProxy(unsigned proxy, const BoundingBoxVolume& volume, const Vector3& displacement)
+{
+	BoundingBoxVolume fat = Fatten(volume, displacement);
+	const BoundingBoxVolume& current = nodes[proxy].volume;
+
+	// Leave the tree alone while the body is still enclosed, unless
+	// its' box has become far larger than it needs to be
+	if (current.Contains(volume))
+	{
+		Vector3 huge(margin * 4, margin * 4, margin * 4);
+		BoundingBoxVolume largest(fat.min - huge, fat.max + huge);
+		if (largest.Contains(current)) return false;
+	}
+
+	RemoveLeaf(proxy);
+	nodes[proxy].volume = fat;
+	InsertLeaf(proxy);
+	return true;
+}
+
+void DynamicAABBTree::InsertLeaf(unsigned leaf)
+{
+	if (root == nullNode)
+	{
+		root = leaf;
+		nodes[leaf].parent = nullNode;
+		return;
+	}
+
+	// Walk down to the sibling that costs least to pair the leaf with,
+	// counting the growth of every branch on the way
+	BoundingBoxVolume leafVolume = nodes[leaf].volume;
+	unsigned index = root;
+	while (!nodes[index].IsLeaf())
+	{
+		const DynamicTreeNode& node = nodes[index];
+		double area = node.volume.GetSurfaceArea();
+		double combinedArea = BoundingBoxVolume(node.volume, leafVolume).GetSurfaceArea();
+
+		// Cost of making a new parent for this node and the leaf
+		double cost = 2.0 * combinedArea;
+
+		// Cost the ancestors pay for descending further
+		double inheritanceCost = 2.0 * (combinedArea - area);
+
+		double childCost[2];
+		for (unsigned c = 0; c < 2; c++)
+		{
+			const DynamicTreeNode& child = nodes[node.children[c]];
+			double grown = BoundingBoxVolume(child.volume, leafVolume).GetSurfaceArea();
+			if (child.IsLeaf()) childCost[c] = grown + inheritanceCost;
+			else childCost[c] = grown - child.volume.GetSurfaceArea() + inheritanceCost;
+		}
+
+		if (cost < childCost[0] && cost < childCost[1]) break;
+		index = childCost[0] < childCost[1] ? node.children[0] : node.children[1];
+	}
+
+	unsigned sibling = index;
+
+	// Put a new branch in the sibling's place, holding both
+	unsigned oldParent = nodes[sibling].parent;
+	unsigned newParent = AllocateNode();
+	DynamicTreeNode& branch = nodes[newParent];
+	branch.parent = oldParent;
+	branch.volume = BoundingBoxVolume(leafVolume, nodes[sibling].volume);
+	branch.height = nodes[sibling].height + 1;
+	branch.children[0] = sibling;
+	branch.children[1] = leaf;
+
+	if (oldParent != nullNode)
+	{
+		DynamicTreeNode& parent = nodes[oldParent];
+		if (parent.children[0] == sibling) parent.children[0] = newParent;
+		else parent.children[1] = newParent;
+	}
+	else
+	{
+		root = newParent;
+	}
+
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	Refit(newParent);
+}
+
+void DynamicAABBTree::RemoveLeaf(unsigned leaf)
+{
+	if (leaf == root)
+	{
+		root = nullNode;
+		return;
+	}
+
+	unsigned parent = nodes[leaf].parent;
+	unsigned grandParent = nodes[parent].parent;
+	unsigned sibling = nodes[parent].children[0] == leaf ? nodes[parent].children[1] : nodes[parent].children[0];
+
+	// The sibling takes the parent's place
+	if (grandParent != nullNode)
+	{
+		DynamicTreeNode& node = nodes[grandParent];
+		if (node.children[0] == parent) node.children[0] = sibling;
+		else node.children[1] = sibling;
+		nodes[sibling].parent = grandParent;
+		FreeNode(parent);
+
+		Refit(grandParent);
+	}
+	else
+	{
+		root = sibling;
+		nodes[sibling].parent = nullNode;
+		FreeNode(parent);
+	}
+}
+
+void DynamicAABBTree::Refit(unsigned index)
+{
+	while (index != nullNode)
+	{
+		index = Balance(index);
+
+		DynamicTreeNode& node = nodes[index];
+		const DynamicTreeNode& one = nodes[node.children[0]];
+		const DynamicTreeNode& two = nodes[node.children[1]];
+
+		node.height = 1 + std::max(one.height, two.height);
+		node.volume = BoundingBoxVolume(one.volume, two.volume);
+
+		index = node.parent;
+	}
+}
+
+unsigned DynamicAABBTree::Balance(unsigned iA)
+{
+	DynamicTreeNode& A = nodes[iA];
+	if (A.IsLeaf() || A.height < 2) return iA;
+
+	unsigned iB = A.children[0];
+	unsigned iC = A.children[1];
+	DynamicTreeNode& B = nodes[iB];
+	DynamicTreeNode& C = nodes[iC];
+
+	int balance = C.height - B.height;
+
+	// Rotate C up, A becomes its' first child and keeps the lower of
+	// C's children
+	if (balance > 1)
+	{
+		unsigned iF = C.children[0];
+		unsigned iG = C.children[1];
+		DynamicTreeNode& F = nodes[iF];
+		DynamicTreeNode& G = nodes[iG];
+
+		C.children[0] = iA;
+		C.parent = A.parent;
+		A.parent = iC;
+
+		if (C.parent != nullNode)
+		{
+			DynamicTreeNode& parent = nodes[C.parent];
+			if (parent.children[0] == iA) parent.children[0] = iC;
+			else parent.children[1] = iC;
+		}
+		else
+		{
+			root = iC;
+		}
+
+		if (F.height > G.height)
+		{
+			C.children[1] = iF;
+			A.children[1] = iG;
+			G.parent = iA;
+			A.volume = BoundingBoxVolume(B.volume, G.volume);
+			C.volume = BoundingBoxVolume(A.volume, F.volume);
+			A.height = 1 + std::max(B.height, G.height);
+			C.height = 1 + std::max(A.height, F.height);
+		}
+		else
+		{
+			C.children[1] = iG;
+			A.children[1] = iF;
+			F.parent = iA;
+			A.volume = BoundingBoxVolume(B.volume, F.volume);
+			C.volume = BoundingBoxVolume(A.volume, G.volume);
+			A.height = 1 + std::max(B.height, F.height);
+			C.height = 1 + std::max(A.height, G.height);
+		}
+
+		return iC;
+	}
+
+	// Rotate B up in the same way
+	if (balance < -1)
+	{
+		unsigned iD = B.children[0];
+		unsigned iE = B.children[1];
+		DynamicTreeNode& D = nodes[iD];
+		DynamicTreeNode& E = nodes[iE];
+
+		B.children[0] = iA;
+		B.parent = A.parent;
+		A.parent = iB;
+
+		if (B.parent != nullNode)
+		{
+			DynamicTreeNode& parent = nodes[B.parent];
+			if (parent.children[0] == iA) parent.children[0] = iB;
+			else parent.children[1] = iB;
+		}
+		else
+		{
+			root = iB;
+		}
+
+		if (D.height > E.height)
+		{
+			B.children[1] = iD;
+			A.children[0] = iE;
+			E.parent = iA;
+			A.volume = BoundingBoxVolume(C.volume, E.volume);
+			B.volume = BoundingBoxVolume(A.volume, D.volume);
+			A.height = 1 + std::max(C.height, E.height);
+			B.height = 1 + std::max(A.height, D.height);
+		}
+		else
+		{
+			B.children[1] = iE;
+			A.children[0] = iD;
+			D.parent = iA;
+			A.volume = BoundingBoxVolume(C.volume, D.volume);
+			B.volume = BoundingBoxVolume(A.volume, E.volume);
+			A.height = 1 + std::max(C.height, D.height);
+			B.height = 1 + std::max(A.height, E.height);
+		}
+
+		return iB;
+	}
+
+	return iA;
+}
+
+unsigned DynamicAABBTree::GetPotentialContacts(std::vector<PotentialContact>& contacts) const
+{
+	if (root == nullNode) return 0;
+
+	size_t first = contacts.size();
+	CollidePair(NodePair(root, root), contacts, pairStack);
+	return (unsigned)(contacts.size() - first);
+}
+
+void DynamicAABBTree::CollidePair(NodePair top, std::vector<PotentialContact>& contacts, std::vector<NodePair>& stack) const
+{
+	stack.clear();
+	stack.push_back(top);
+	while (!stack.empty())
+	{
+		NodePair pair = stack.back();
+		stack.pop_back();
+
+		const DynamicTreeNode& one = nodes[pair.first];
+		const DynamicTreeNode& two = nodes[pair.second];
+
+		if (pair.first == pair.second)
+		{
+			if (one.IsLeaf()) continue;
+
+			stack.push_back(NodePair(one.children[0], one.children[1]));
+			stack.push_back(NodePair(one.children[1], one.children[1]));
+			stack.push_back(NodePair(one.children[0], one.children[0]));
+			continue;
+		}
+
+		if (!one.volume.Overlaps(&two.volume)) continue;
+
+		if (one.IsLeaf() && two.IsLeaf())
+		{
+			PotentialContact contact;
+			contact.body[0] = one.body;
+			contact.body[1] = two.body;
+			contacts.push_back(contact);
+			continue;
+		}
+
+		// Descend into the larger of the two, as BVHNode does
+		if (two.IsLeaf() || (!one.IsLeaf() && one.volume.GetSurfaceArea() >= two.volume.GetSurfaceArea()))
+		{
+			stack.push_back(NodePair(one.children[1], pair.second));
+			stack.push_back(NodePair(one.children[0], pair.second));
+		}
+		else
+		{
+			stack.push_back(NodePair(pair.first, two.children[1]));
+			stack.push_back(NodePair(pair.first, two.children[0]));
+		}
+	}
+}
+
+void DynamicAABBTree::SplitPairs(unsigned target) const
+{
+	std::vector<NodePair>& items = pairTask.items;
+	items.clear();
+	items.push_back(NodePair(root, root));
+
+	// Each pair is replaced by the pairs the search would pop after
+	// it, in the same order, so the items keep the serial order
+	bool unrolled = true;
+	while (unrolled && items.size() < target)
+	{
+		unrolled = false;
+		nextPairs.clear();
+
+		for (const NodePair& pair : items)
+		{
+			const DynamicTreeNode& one = nodes[pair.first];
+			const DynamicTreeNode& two = nodes[pair.second];
+
+			if (pair.first == pair.second)
+			{
+				if (one.IsLeaf()) continue;
+
+				nextPairs.push_back(NodePair(one.children[0], one.children[0]));
+				nextPairs.push_back(NodePair(one.children[1], one.children[1]));
+				nextPairs.push_back(NodePair(one.children[0], one.children[1]));
+				unrolled = true;
+				continue;
+			}
+
+			if (!one.volume.Overlaps(&two.volume)) continue;
+
+			if (one.IsLeaf() && two.IsLeaf())
+			{
+				nextPairs.push_back(pair);
+				continue;
+			}
+
+			if (two.IsLeaf() || (!one.IsLeaf() && one.volume.GetSurfaceArea() >= two.volume.GetSurfaceArea()))
+			{
+				nextPairs.push_back(NodePair(one.children[0], pair.second));
+				nextPairs.push_back(NodePair(one.children[1], pair.second));
+			}
+			else
+			{
+				nextPairs.push_back(NodePair(pair.first, two.children[0]));
+				nextPairs.push_back(NodePair(pair.first, two.children[1]));
+			}
+			unrolled = true;
+		}
+
+		items.swap(nextPairs);
+	}
+}
+
+unsigned DynamicAABBTree::GetPotentialContacts(std::vector<PotentialContact>& contacts, WorkerPool& pool) const
+{
+	if (root == nullNode) return 0;
+
+	// Enough items that threads finishing early find more to take
+	unsigned threads = pool.GetThreadCount();
+	SplitPairs(threads * 16);
+
+	pairTask.tree = this;
+	pairTask.buffers.resize(threads);
+	pairTask.stacks.resize(threads);
+	for (std::vector<PotentialContact>& buffer : pairTask.buffers) buffer.clear();
+	pairTask.outputs.resize(pairTask.items.size());
+
+	pool.Run(&pairTask, (unsigned)pairTask.items.size());
+
+	size_t first = contacts.size();
+	size_t total = 0;
+	for (const PairTask::Output& output : pairTask.outputs) total += output.end - output.begin;
+	contacts.reserve(first + total);
+
+	for (const PairTask::Output& output : pairTask.outputs)
+	{
+		const std::vector<PotentialContact>& buffer = pairTask.buffers[output.worker];
+		contacts.insert(contacts.end(), buffer.begin() + output.begin, buffer.begin() + output.end);
+	}
+
+	return (unsigned)(contacts.size() - first);
+}
+
+void DynamicAABBTree::PairTask::Execute(unsigned item, unsigned worker)
+{
+	std::vector<PotentialContact>& buffer = buffers[worker];
+
+	Output& output = outputs[item];
+	output.worker = worker;
+	output.begin = buffer.size();
+	tree->CollidePair(items[item], buffer, stacks[worker]);
+	output.end = buffer.size();
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the dynamic bounding box tree the world uses
+ * as its' broadphase, to find the pairs of bodies that may touch.
+ */
+
+#include "CollideCoarse.h"
+#include "WorkerPool.h"
+#include <vector>
+
+/**
+ * A node of the dynamic tree. Leaves hold a body, branches always
+ * have two children. Unused nodes are chained into a free list
+ * through their parent index.
+ */
+struct DynamicTreeNode
+{
+	// Encloses the node's subtree, for leaves it is the fattened box
+	BoundingBoxVolume volume;
+
+	RigidBody* body;
+
+	unsigned parent;
+	unsigned children[2];
+
+	// Leaves are at height zero, free nodes at -1
+	int height;
+
+	bool IsLeaf() const
+	{
+		return height == 0;
+	}
+};
+
+/**
+ * A bounding volume hierarchy of axis aligned boxes that can be
+ * changed as bodies move, after the dynamic tree in Box2D.
+ *
+ * Each body's box is fattened by a margin, and stretched in the
+ * direction it is moving, so that most frames a body stays inside
+ * its' box and the tree does not change at all. Bodies that leave
+ * are removed and reinserted. Nodes are rotated on the way back up
+ * from every insertion and removal to keep the tree balanced.
+ *
+ * Nodes live in a single pool and are referred to by index, so
+ * proxies stay valid as the pool grows.
+ */
+class DynamicAABBTree
+{
+public:
+	static const unsigned nullNode = 0xffffffff;
+
+	/**
+	 * Creates an empty tree. Boxes are fattened by the margin on
+	 * every side, and stretched by the displacement of a body times
+	 * the prediction factor.
+	 */
+	DynamicAABBTree(double margin = 0.1, double predictionFactor = 2.0);
+
+	// Adds a body with the given tight box, returning its' proxy
+	unsigned CreateProxy(const BoundingBoxVolume& volume, RigidBody* body);
+
+	// Removes the body with the given proxy
+	void DestroyProxy(unsigned proxy);
+
+	/**
+	 * Updates the box of a body that has moved by the given
+	 * displacement. Returns true if the body had to be reinserted,
+	 * false if its' fattened box still encloses the new one.
+	 */
+	bool MoveProxy(unsigned proxy, const BoundingBoxVolume& volume, const Vector3& displacement);
+
+	// Returns the fattened box of the given proxy
+	const BoundingBoxVolume& GetFatVolume(unsigned proxy) const
+	{
+		return nodes[proxy].volume;
+	}
+
+	RigidBody* GetBody(unsigned proxy) const
+	{
+		return nodes[proxy].body;
+	}
+
+	/**
+	 * Finds every pair of bodies whose fattened boxes overlap and
+	 * appends them to the given list. Returns the number found.
+	 */
+	unsigned GetPotentialContacts(std::vector<PotentialContact>& contacts) const;
+
+	/**
+	 * Finds the same pairs as above, in the same order, spreading the
+	 * search over the threads of the given pool. The top of the tree
+	 * is unrolled into many more subtree pairs than threads, each
+	 * thread searches the pairs it takes into a list of its' own, and
+	 * the lists are joined in order at the end.
+	 */
+	unsigned GetPotentialContacts(std::vector<PotentialContact>& contacts, WorkerPool& pool) const;
+
+	/**
+	 * Calls the given function with the body of every proxy whose
+	 * fattened box overlaps the given one.
+	 */
+	template <class Callback>
+	void Query(const BoundingBoxVolume& volume, Callback callback) const;
+
+	// Returns the height of the tree, zero when empty or a single leaf
+	int GetHeight() const
+	{
+		return root == nullNode ? 0 : nodes[root].height;
+	}
+
+	unsigned GetProxyCount() const
+	{
+		return proxyCount;
+	}
+
+	// Gives read access to the nodes, for searches that keep their own
+	// stacks. Proxies are the indices of leaves
+	const std::vector<DynamicTreeNode>& GetNodes() const
+	{
+		return nodes;
+	}
+
+	// Returns the index of the root node, nullNode when empty
+	unsigned GetRoot() const
+	{
+		return root;
+	}
+
+private:
+	unsigned AllocateNode();
+	void FreeNode(unsigned node);
+
+	void InsertLeaf(unsigned leaf);
+	void RemoveLeaf(unsigned leaf);
+
+	// Walks up from the given node, rebalancing and refitting each ancestor
+	void Refit(unsigned node);
+
+	// Rotates the given node's subtree if it is out of balance, returning its' new root
+	unsigned Balance(unsigned node);
+
+	typedef std::pair<unsigned, unsigned> NodePair;
+
+	/**
+	 * Appends every pair of leaves with overlapping boxes under the
+	 * given pair of nodes. A pair of the same node stands for the
+	 * pairs within its' subtree.
+	 */
+	void CollidePair(NodePair top, std::vector<PotentialContact>& contacts, std::vector<NodePair>& stack) const;
+
+	// Unrolls the search from the root until there are at least the
+	// given number of subtree pairs, or nothing left to unroll
+	void SplitPairs(unsigned target) const;
+
+	// Searches the unrolled subtree pairs on the worker threads
+	class PairTask : public WorkerTask
+	{
+	public:
+		const DynamicAABBTree* tree;
+
+		// Where in its' worker's list an item put the pairs it found
+		struct Output
+		{
+			unsigned worker;
+			size_t begin;
+			size_t end;
+		};
+
+		std::vector<NodePair> items;
+		std::vector<Output> outputs;
+
+		// A list of pairs and a stack for each worker
+		std::vector<std::vector<PotentialContact>> buffers;
+		std::vector<std::vector<NodePair>> stacks;
+
+		virtual void Execute(unsigned item, unsigned worker);
+	};
+
+	// Returns the fattened version of the given box
+	BoundingBoxVolume Fatten(const BoundingBoxVolume& volume, const Vector3& displacement) const;
+
+	std::vector<DynamicTreeNode> nodes;
+	unsigned root;
+	unsigned freeList;
+	unsigned proxyCount;
+
+	double margin;
+	double predictionFactor;
+
+	// Traversal stacks, kept to avoid allocating every query
+	mutable std::vector<unsigned> stack;
+	mutable std::vector<NodePair> pairStack;
+
+	mutable PairTask pairTask;
+	mutable std::vector<NodePair> nextPairs;
+};
+
+template <class Callback>
+void DynamicAABBTree::Query(const BoundingBoxVolume& volume, Callback callback) const
+{
+	if (root == nullNode) return;
+
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		const DynamicTreeNode& node = nodes[stack.back()];
+		stack.pop_back();
+
+		if (!node.volume.Overlaps(&volume)) continue;
+
+		if (node.IsLeaf())
+		{
+			callback(node.body);
+		}
+		else
+		{
+			stack.push_back(node.children[1]);
+			stack.push_back(node.children[0]);
+		}
+	}
+}
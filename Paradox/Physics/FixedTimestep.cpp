@@ -0,0 +1,125 @@
+#include "FixedTimestep.h"
+#include "body.h"
+#include <assert.h>
+
+FixedTimestep::FixedTimestep(double stepDuration, unsigned maxStepsPerFrame)
+	:
+	stepDuration(stepDuration),
+	maxStepsPerFrame(maxStepsPerFrame)
+{
+	assert(stepDuration > 0 && maxStepsPerFrame > 0);
+	Reset();
+}
+
+void FixedTimestep::Reset()
+{
+	accumulator = 0;
+	stepCount = 0;
+	droppedTime = 0;
+}
+
+void FixedTimestep::SetStepDuration(double duration)
+{
+	assert(duration > 0);
+
+	// Keep the alpha the same, so the drawn state does not jump
+	accumulator = GetAlpha() * duration;
+	stepDuration = duration;
+}
+
+void FixedTimestep::SetMaxStepsPerFrame(unsigned steps)
+{
+	assert(steps > 0);
+	maxStepsPerFrame = steps;
+}
+
+unsigned FixedTimestep::Advance(double frameDuration)
+{
+	// Timers can step backwards, which is no time at all
+	if (frameDuration > 0) accumulator += frameDuration;
+
+	unsigned steps = 0;
+	while (accumulator >= stepDuration && steps < maxStepsPerFrame)
+	{
+		accumulator -= stepDuration;
+		steps++;
+	}
+
+	// Anything still owed is more than the frame can run, drop it but
+	// keep the part of a step, so the drawn state carries on smoothly
+	if (accumulator >= stepDuration)
+	{
+		double owed = floor(accumulator / stepDuration) * stepDuration;
+		droppedTime += owed;
+		accumulator -= owed;
+
+		// Rounding can leave a whole step behind
+		if (accumulator >= stepDuration) accumulator = 0;
+	}
+
+	stepCount += steps;
+	return steps;
+}
+
+TransformInterpolator::TransformInterpolator()
+	:
+	store(NULL)
+{
+}
+
+void TransformInterpolator::Capture(const BodyStore& store)
+{
+	this->store = &store;
+
+	unsigned count = store.Size();
+	handles.resize(count);
+	for (unsigned index = 0; index < count; index++) handles[index] = store.GetHandle(index);
+
+	previousPosition.x.assign(store.position.x.begin(), store.position.x.begin() + count);
+	previousPosition.y.assign(store.position.y.begin(), store.position.y.begin() + count);
+	previousPosition.z.assign(store.position.z.begin(), store.position.z.begin() + count);
+	previousOrientation.r.assign(store.orientation.r.begin(), store.orientation.r.begin() + count);
+	previousOrientation.i.assign(store.orientation.i.begin(), store.orientation.i.begin() + count);
+	previousOrientation.j.assign(store.orientation.j.begin(), store.orientation.j.begin() + count);
+	previousOrientation.k.assign(store.orientation.k.begin(), store.orientation.k.begin() + count);
+}
+
+void TransformInterpolator::Clear()
+{
+	store = NULL;
+	handles.clear();
+	previousPosition.Resize(0);
+	previousOrientation.Resize(0);
+}
+
+Matrix4 TransformInterpolator::GetTransform(const RigidBody& body, double alpha) const
+{
+	// Removing bodies moves others, so the index is only trusted if
+	// the same body was there at the capture
+	unsigned index = body.GetStoreIndex();
+	if (body.GetStore() != store || index >= handles.size() || handles[index] != body.GetHandle())
+	{
+		return body.GetTransform();
+	}
+
+	Vector3 previous = previousPosition.Get(index);
+	Vector3 position = previous + (body.GetPosition() - previous) * alpha;
+
+	// Blend along the shorter arc, q and -q being the same turn
+	Quaternion from = previousOrientation.Get(index);
+	Quaternion to = body.GetOrientation();
+	double dot = from.r * to.r + from.i * to.i + from.j * to.j + from.k * to.k;
+	double toScale = dot < 0 ? -alpha : alpha;
+	double fromScale = 1 - alpha;
+
+	Quaternion orientation(
+		from.r * fromScale + to.r * toScale,
+		from.i * fromScale + to.i * toScale,
+		from.j * fromScale + to.j * toScale,
+		from.k * fromScale + to.k * toScale);
+	orientation.Normalize();
+
+	Matrix4 transform;
+	transform.setOrientationAndPos(orientation, position);
+	return transform;
+}
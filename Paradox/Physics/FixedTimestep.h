@@ -0,0 +1,127 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the fixed timestep scheduler, which turns the
+ * real time between rendered frames into whole physics steps, and the
+ * interpolation of body transforms between the last two steps so that
+ * frames can be drawn at any rate.
+ */
+
+#include "BodyStore.h"
+
+class RigidBody;
+
+/**
+ * Runs a simulation at a fixed step duration whatever the frame rate.
+ *
+ * The real time of each frame is added to an accumulator, and every
+ * whole step in it is run. The time left over, less than one step, is
+ * carried on to the next frame and gives how far between the last two
+ * states the frame should be drawn.
+ *
+ * When a frame is slow, running every step it owes would make the next
+ * frame slower still. So no more than the given number of steps are run
+ * in one frame, and the time past that is dropped: the simulation runs
+ * slower than real time rather than stalling.
+ */
+class FixedTimestep
+{
+public:
+	FixedTimestep(double stepDuration = 1.0 / 60.0, unsigned maxStepsPerFrame = 4);
+
+	/**
+	 * Adds the real time the last frame took, in seconds, and returns
+	 * the number of steps to run for it, no more than the cap.
+	 */
+	unsigned Advance(double frameDuration);
+
+	// Forgets any time carried over, dropped or stepped
+	void Reset();
+
+	void SetStepDuration(double duration);
+
+	double GetStepDuration() const
+	{
+		return stepDuration;
+	}
+
+	void SetMaxStepsPerFrame(unsigned steps);
+
+	unsigned GetMaxStepsPerFrame() const
+	{
+		return maxStepsPerFrame;
+	}
+
+	/**
+	 * Returns how far past the last step the real time is, as a
+	 * fraction of a step from zero up to but not including one. Frames
+	 * are drawn this far from the state before the last step to the
+	 * state after it.
+	 */
+	double GetAlpha() const
+	{
+		return accumulator / stepDuration;
+	}
+
+	// Returns the steps run since the last reset
+	unsigned long long GetStepCount() const
+	{
+		return stepCount;
+	}
+
+	// Returns the seconds dropped by the cap since the last reset
+	double GetDroppedTime() const
+	{
+		return droppedTime;
+	}
+
+private:
+	double stepDuration;
+	unsigned maxStepsPerFrame;
+
+	// Real time not yet stepped, always less than one step
+	double accumulator;
+
+	unsigned long long stepCount;
+	double droppedTime;
+};
+
+/**
+ * Keeps where the bodies of a store were before the last step, so
+ * that their transforms can be drawn part way between that state and
+ * the one after it.
+ *
+ * Capture is called just before the last step of a frame. Positions
+ * are blended in a straight line and orientations by the normalised
+ * blend of the two quaternions along the shorter arc, which is close
+ * enough to a slerp over the small turn of one step.
+ */
+class TransformInterpolator
+{
+public:
+	TransformInterpolator();
+
+	// Records the position and orientation of every body of the store
+	void Capture(const BodyStore& store);
+
+	/**
+	 * Returns the body's transform the given fraction of the way from
+	 * its' captured state to its' current one. Bodies that were not in
+	 * the store at the capture get their current transform.
+	 */
+	Matrix4 GetTransform(const RigidBody& body, double alpha) const;
+
+	// Forgets the captured state, so every body gets its' current transform
+	void Clear();
+
+private:
+	const BodyStore* store;
+
+	// The handle of the body at each index when it was captured
+	std::vector<BodyHandle> handles;
+
+	Vector3Field previousPosition;
+	QuaternionField previousOrientation;
+};
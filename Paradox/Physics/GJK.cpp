@@ -0,0 +1,743 @@
+#include "GJK.h"
+#include <algorithm>
+#include <math.h>
+
+// Most GJK iterations run before taking the best simplex so far
+static const unsigned maxIterations = 64;
+
+// GJK stops once a new point brings the closest point this little
+// closer, relative to its' squared distance
+static const double relativeTolerance = 1e-10;
+
+// Cores closer than this are taken to overlap, and need EPA
+static const double coreEpsilon = 1e-7;
+
+// EPA stops once the polytope grows by less than this towards the shape
+static const double epaTolerance = 1e-8;
+
+// Room for the polytope EPA builds
+static const unsigned maxEPAVertices = 64;
+static const unsigned maxEPAFaces = 128;
+static const unsigned maxEPAIterations = 60;
+
+Vector3 SupportShape::GetLocalSupport(const Vector3& direction) const
+{
+	switch (type)
+	{
+	case SupportShapeType::Point:
+		return Vector3();
+
+	case SupportShapeType::Segment:
+		return Vector3(0, direction.y < 0 ? -halfSize.y : halfSize.y, 0);
+
+	case SupportShapeType::Box:
+		return Vector3(
+			direction.x < 0 ? -halfSize.x : halfSize.x,
+			direction.y < 0 ? -halfSize.y : halfSize.y,
+			direction.z < 0 ? -halfSize.z : halfSize.z);
+
+	case SupportShapeType::Cylinder:
+	{
+		double across = sqrt(direction.x * direction.x + direction.z * direction.z);
+		double y = direction.y < 0 ? -halfSize.y : halfSize.y;
+		if (across <= 0) return Vector3(0, y, 0);
+		return Vector3(direction.x * radius / across, y, direction.z * radius / across);
+	}
+
+	case SupportShapeType::Hull:
+		hullVertex = hull->FindSupportVertex(direction, hullVertex);
+		return hull->GetVertex(hullVertex);
+
+	case SupportShapeType::Points:
+	default:
+	{
+		unsigned best = 0;
+		double bestDistance = points[0] * direction;
+		for (unsigned i = 1; i < pointCount; i++)
+		{
+			double distance = points[i] * direction;
+			if (distance > bestDistance)
+			{
+				bestDistance = distance;
+				best = i;
+			}
+		}
+		return points[best];
+	}
+	}
+}
+
+// Fills in the parts every kind of shape has
+static SupportShape MakeShape(SupportShapeType type, RigidBody* body, const Matrix4& transform)
+{
+	SupportShape shape;
+	shape.type = type;
+	shape.body = body;
+	shape.transform = transform;
+	shape.radius = 0;
+	shape.margin = 0;
+	shape.points = NULL;
+	shape.pointCount = 0;
+	shape.hull = NULL;
+	shape.hullVertex = 0;
+	return shape;
+}
+
+SupportShape MakeSupportShape(const CollisionSphere& sphere)
+{
+	SupportShape shape = MakeShape(SupportShapeType::Point, sphere.body, sphere.GetTransform());
+	shape.margin = sphere.radius;
+	return shape;
+}
+
+SupportShape MakeSupportShape(const CollisionBox& box)
+{
+	return MakeBoxShape(box.body, box.GetTransform(), box.halfSize);
+}
+
+SupportShape MakeSupportShape(const CollisionCapsule& capsule)
+{
+	return MakeCapsuleShape(capsule.body, capsule.GetTransform(), capsule.radius, capsule.halfHeight);
+}
+
+SupportShape MakeSupportShape(const CollisionConvexHull& hull)
+{
+	return MakeHullShape(hull.body, hull.GetTransform(), hull.hull);
+}
+
+SupportShape MakeBoxShape(RigidBody* body, const Matrix4& transform, const Vector3& halfSize)
+{
+	SupportShape shape = MakeShape(SupportShapeType::Box, body, transform);
+	shape.halfSize = halfSize;
+	return shape;
+}
+
+SupportShape MakeCapsuleShape(RigidBody* body, const Matrix4& transform, double radius, double halfHeight)
+{
+	SupportShape shape = MakeShape(SupportShapeType::Segment, body, transform);
+	shape.halfSize = Vector3(0, halfHeight, 0);
+	shape.margin = radius;
+	return shape;
+}
+
+SupportShape MakeCylinderShape(RigidBody* body, const Matrix4& transform, double radius, double halfHeight)
+{
+	SupportShape shape = MakeShape(SupportShapeType::Cylinder, body, transform);
+	shape.halfSize = Vector3(0, halfHeight, 0);
+	shape.radius = radius;
+	return shape;
+}
+
+SupportShape MakePointsShape(RigidBody* body, const Matrix4& transform, const Vector3* points, unsigned pointCount)
+{
+	SupportShape shape = MakeShape(SupportShapeType::Points, body, transform);
+	shape.points = points;
+	shape.pointCount = pointCount;
+	return shape;
+}
+
+SupportShape MakeHullShape(RigidBody* body, const Matrix4& transform, const ConvexHull* hull)
+{
+	SupportShape shape = MakeShape(SupportShapeType::Hull, body, transform);
+	shape.hull = hull;
+	return shape;
+}
+
+/**
+ * A point of the Minkowski difference of the two shapes, with the
+ * points on each shape it came from and the direction it was found in.
+ */
+struct SimplexVertex
+{
+	Vector3 point;
+	Vector3 pointOne;
+	Vector3 pointTwo;
+	Vector3 direction;
+};
+
+// Up to four vertices, with the weights giving the closest point to
+// the origin after Solve
+struct Simplex
+{
+	SimplexVertex vertices[4];
+	double weights[4];
+	unsigned count;
+};
+
+// Finds the point of the difference furthest along the given
+// direction, with or without the margins
+static SimplexVertex FindSupport(const SupportShape& one, const SupportShape& two,
+	const Vector3& direction, bool margins)
+{
+	SimplexVertex vertex;
+	vertex.direction = direction;
+	vertex.pointOne = one.GetSupport(direction);
+	vertex.pointTwo = two.GetSupport(direction * -1);
+	if (margins)
+	{
+		Vector3 unit = direction.unit();
+		vertex.pointOne += unit * one.margin;
+		vertex.pointTwo -= unit * two.margin;
+	}
+	vertex.point = vertex.pointOne - vertex.pointTwo;
+	return vertex;
+}
+
+// Sets the simplex to the given vertices with the given weights
+static void Keep(Simplex* simplex, const SimplexVertex* a, double wa,
+	const SimplexVertex* b = NULL, double wb = 0, const SimplexVertex* c = NULL, double wc = 0)
+{
+	// Copy first, the vertices may be the simplex's own
+	SimplexVertex kept[3];
+	double weights[3] = { wa, wb, wc };
+	unsigned count = 0;
+	kept[count++] = *a;
+	if (b) kept[count++] = *b;
+	if (c) kept[count++] = *c;
+
+	for (unsigned i = 0; i < count; i++)
+	{
+		simplex->vertices[i] = kept[i];
+		simplex->weights[i] = weights[i];
+	}
+	simplex->count = count;
+}
+
+// Reduces the simplex to the part of the triangle closest to the
+// origin, after Real-Time Collision Detection 5.1.5
+static void SolveTriangle(Simplex* simplex, const SimplexVertex& va, const SimplexVertex& vb,
+	const SimplexVertex& vc)
+{
+	const Vector3& a = va.point;
+	const Vector3& b = vb.point;
+	const Vector3& c = vc.point;
+	Vector3 ab = b - a;
+	Vector3 ac = c - a;
+
+	Vector3 ap = a * -1;
+	double d1 = ab * ap;
+	double d2 = ac * ap;
+	if (d1 <= 0 && d2 <= 0) return Keep(simplex, &va, 1);
+
+	Vector3 bp = b * -1;
+	double d3 = ab * bp;
+	double d4 = ac * bp;
+	if (d3 >= 0 && d4 <= d3) return Keep(simplex, &vb, 1);
+
+	double vcArea = d1 * d4 - d3 * d2;
+	if (vcArea <= 0 && d1 >= 0 && d3 <= 0)
+	{
+		double v = d1 / (d1 - d3);
+		return Keep(simplex, &va, 1 - v, &vb, v);
+	}
+
+	Vector3 cp = c * -1;
+	double d5 = ab * cp;
+	double d6 = ac * cp;
+	if (d6 >= 0 && d5 <= d6) return Keep(simplex, &vc, 1);
+
+	double vbArea = d5 * d2 - d1 * d6;
+	if (vbArea <= 0 && d2 >= 0 && d6 <= 0)
+	{
+		double w = d2 / (d2 - d6);
+		return Keep(simplex, &va, 1 - w, &vc, w);
+	}
+
+	double vaArea = d3 * d6 - d5 * d4;
+	if (vaArea <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0)
+	{
+		double w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		return Keep(simplex, &vb, 1 - w, &vc, w);
+	}
+
+	double denominator = 1.0 / (vaArea + vbArea + vcArea);
+	double v = vbArea * denominator;
+	double w = vcArea * denominator;
+	Keep(simplex, &va, 1 - v - w, &vb, v, &vc, w);
+}
+
+/**
+ * Reduces the simplex to its' part closest to the origin and sets the
+ * weights of what is left. Returns true if the simplex is a
+ * tetrahedron with the origin inside it.
+ */
+static bool Solve(Simplex* simplex)
+{
+	SimplexVertex* v = simplex->vertices;
+
+	switch (simplex->count)
+	{
+	case 1:
+		simplex->weights[0] = 1;
+		return false;
+
+	case 2:
+	{
+		Vector3 ab = v[1].point - v[0].point;
+		double length = ab * ab;
+		double t = length > 0 ? -(v[0].point * ab) / length : 0;
+		if (t <= 0) Keep(simplex, &v[0], 1);
+		else if (t >= 1) Keep(simplex, &v[1], 1);
+		else Keep(simplex, &v[0], 1 - t, &v[1], t);
+		return false;
+	}
+
+	case 3:
+		SolveTriangle(simplex, v[0], v[1], v[2]);
+		return false;
+
+	default:
+	{
+		// Test each face the origin is outside of, keeping the closest
+		static const unsigned faces[4][4] = { { 0, 1, 2, 3 }, { 0, 3, 1, 2 }, { 0, 2, 3, 1 }, { 1, 3, 2, 0 } };
+
+		Simplex best;
+		double bestDistance = 0;
+		bool outside = false;
+		for (unsigned f = 0; f < 4; f++)
+		{
+			const Vector3& a = v[faces[f][0]].point;
+			Vector3 normal = (v[faces[f][1]].point - a) % (v[faces[f][2]].point - a);
+			double origin = (a * -1) * normal;
+			double opposite = (v[faces[f][3]].point - a) * normal;
+			if (opposite != 0 && origin * opposite >= 0) continue;
+
+			Simplex face;
+			SolveTriangle(&face, v[faces[f][0]], v[faces[f][1]], v[faces[f][2]]);
+
+			Vector3 closest;
+			for (unsigned i = 0; i < face.count; i++) closest += face.vertices[i].point * face.weights[i];
+			double distance = closest.squareMagnitude();
+			if (!outside || distance < bestDistance)
+			{
+				best = face;
+				bestDistance = distance;
+				outside = true;
+			}
+		}
+
+		if (!outside)
+		{
+			simplex->weights[0] = simplex->weights[1] = simplex->weights[2] = simplex->weights[3] = 0.25;
+			return true;
+		}
+
+		*simplex = best;
+		return false;
+	}
+	}
+}
+
+// Returns the point of the simplex its' weights give
+static Vector3 ClosestPoint(const Simplex& simplex)
+{
+	Vector3 closest;
+	for (unsigned i = 0; i < simplex.count; i++) closest += simplex.vertices[i].point * simplex.weights[i];
+	return closest;
+}
+
+// Adds the vertex unless the simplex already has the same point
+static bool AddVertex(Simplex* simplex, const SimplexVertex& vertex)
+{
+	for (unsigned i = 0; i < simplex->count; i++)
+	{
+		if (simplex->vertices[i].point == vertex.point) return false;
+	}
+	simplex->vertices[simplex->count++] = vertex;
+	return true;
+}
+
+/**
+ * Runs GJK from the given simplex until it finds the closest point of
+ * the difference to the origin, or the origin inside it. Returns true
+ * if the shapes overlap, closer than the epsilon.
+ */
+static bool RunGJK(const SupportShape& one, const SupportShape& two, bool margins, Simplex* simplex,
+	unsigned* iterations)
+{
+	if (simplex->count == 0)
+	{
+		Vector3 direction = two.transform.getAxisVector(3) - one.transform.getAxisVector(3);
+		if (direction.squareMagnitude() == 0) direction = Vector3(1, 0, 0);
+		AddVertex(simplex, FindSupport(one, two, direction, margins));
+	}
+
+	if (Solve(simplex)) return true;
+	Vector3 closest = ClosestPoint(*simplex);
+
+	for (unsigned i = 0; i < maxIterations; i++)
+	{
+		double distance = closest * closest;
+		if (distance <= coreEpsilon * coreEpsilon) return true;
+
+		(*iterations)++;
+		SimplexVertex vertex = FindSupport(one, two, closest * -1, margins);
+
+		// No point of the difference is much nearer the origin
+		if (distance - closest * vertex.point <= relativeTolerance * distance) return false;
+		if (!AddVertex(simplex, vertex)) return false;
+
+		if (Solve(simplex)) return true;
+		closest = ClosestPoint(*simplex);
+
+		if (closest * closest >= distance) return false;
+	}
+
+	return false;
+}
+
+// A face of the EPA polytope, wound anticlockwise seen from outside
+struct EPAFace
+{
+	unsigned vertices[3];
+	Vector3 normal;
+	double distance;
+	bool removed;
+};
+
+// An edge of the hole left by the faces a new point can see
+struct EPAEdge
+{
+	unsigned from;
+	unsigned to;
+};
+
+// The room EPA builds its' polytope in
+struct EPAPolytope
+{
+	SimplexVertex vertices[maxEPAVertices];
+	EPAFace faces[maxEPAFaces];
+	EPAEdge horizon[maxEPAFaces];
+};
+
+// Sets up a face, returning false if it has no area
+static bool MakeFace(EPAFace* face, const SimplexVertex* vertices, unsigned a, unsigned b, unsigned c)
+{
+	face->vertices[0] = a;
+	face->vertices[1] = b;
+	face->vertices[2] = c;
+	face->removed = false;
+
+	Vector3 normal = (vertices[b].point - vertices[a].point) % (vertices[c].point - vertices[a].point);
+	double length = normal.magnitude();
+	if (length <= 0) return false;
+
+	face->normal = normal * (1.0 / length);
+	face->distance = face->normal * vertices[a].point;
+	return true;
+}
+
+/**
+ * Grows a simplex around the origin into a tetrahedron, adding points
+ * in directions away from what it already spans. Returns false if the
+ * difference is too flat to hold one.
+ */
+static bool BuildTetrahedron(const SupportShape& one, const SupportShape& two, Simplex* simplex)
+{
+	static const Vector3 axes[6] = {
+		Vector3(1, 0, 0), Vector3(-1, 0, 0), Vector3(0, 1, 0),
+		Vector3(0, -1, 0), Vector3(0, 0, 1), Vector3(0, 0, -1) };
+
+	if (simplex->count == 1)
+	{
+		for (unsigned i = 0; i < 6 && simplex->count == 1; i++)
+		{
+			SimplexVertex vertex = FindSupport(one, two, axes[i], true);
+			if ((vertex.point - simplex->vertices[0].point).squareMagnitude() > coreEpsilon * coreEpsilon)
+			{
+				AddVertex(simplex, vertex);
+			}
+		}
+	}
+
+	if (simplex->count == 2)
+	{
+		Vector3 line = simplex->vertices[1].point - simplex->vertices[0].point;
+		for (unsigned i = 0; i < 6 && simplex->count == 2; i++)
+		{
+			Vector3 across = line % axes[i];
+			if (across.squareMagnitude() <= 0) continue;
+
+			SimplexVertex vertex = FindSupport(one, two, across, true);
+			Vector3 offset = (vertex.point - simplex->vertices[0].point) % line;
+			if (offset.squareMagnitude() > coreEpsilon * coreEpsilon * (line * line)) AddVertex(simplex, vertex);
+		}
+	}
+
+	if (simplex->count == 3)
+	{
+		const Vector3& a = simplex->vertices[0].point;
+		Vector3 normal = (simplex->vertices[1].point - a) % (simplex->vertices[2].point - a);
+		for (unsigned side = 0; side < 2 && simplex->count == 3; side++)
+		{
+			SimplexVertex vertex = FindSupport(one, two, side ? normal * -1 : normal, true);
+			if (fabs((vertex.point - a) * normal) > coreEpsilon * normal.magnitude()) AddVertex(simplex, vertex);
+		}
+	}
+
+	return simplex->count == 4;
+}
+
+/**
+ * Expands the tetrahedron GJK ended with towards the surface of the
+ * difference until it finds the face nearest the origin, giving the
+ * penetration. Returns false if the polytope could not be built.
+ */
+static bool RunEPA(const SupportShape& one, const SupportShape& two, Simplex* simplex, GJKResult* result)
+{
+	if (simplex->count < 4 && !BuildTetrahedron(one, two, simplex)) return false;
+
+	// The polytope is kept per thread, as clearing arrays this size on
+	// every call costs more than the expansion itself
+	static thread_local EPAPolytope polytope;
+	SimplexVertex* vertices = polytope.vertices;
+	EPAFace* faces = polytope.faces;
+	EPAEdge* horizon = polytope.horizon;
+
+	unsigned vertexCount = 4;
+	for (unsigned i = 0; i < 4; i++) vertices[i] = simplex->vertices[i];
+
+	// Wind each face so its' normal points away from the fourth vertex
+	unsigned faceCount = 0;
+	static const unsigned tetrahedron[4][4] = { { 0, 1, 2, 3 }, { 0, 3, 1, 2 }, { 0, 2, 3, 1 }, { 1, 3, 2, 0 } };
+	for (unsigned f = 0; f < 4; f++)
+	{
+		unsigned a = tetrahedron[f][0], b = tetrahedron[f][1], c = tetrahedron[f][2];
+		Vector3 normal = (vertices[b].point - vertices[a].point) % (vertices[c].point - vertices[a].point);
+		if (normal * (vertices[tetrahedron[f][3]].point - vertices[a].point) > 0) std::swap(b, c);
+		if (!MakeFace(&faces[faceCount], vertices, a, b, c)) return false;
+		faceCount++;
+	}
+
+	unsigned closest = 0;
+	for (unsigned iteration = 0; iteration < maxEPAIterations; iteration++)
+	{
+		result->epaIterations++;
+
+		closest = faceCount;
+		for (unsigned f = 0; f < faceCount; f++)
+		{
+			if (faces[f].removed) continue;
+			if (closest == faceCount || faces[f].distance < faces[closest].distance) closest = f;
+		}
+		if (closest == faceCount) return false;
+
+		const EPAFace& nearest = faces[closest];
+		SimplexVertex vertex = FindSupport(one, two, nearest.normal, true);
+		if (vertex.point * nearest.normal - nearest.distance <= epaTolerance) break;
+		if (vertexCount == maxEPAVertices) break;
+
+		// Remove every face the new point can see, keeping the edges
+		// around the hole they leave
+		unsigned horizonCount = 0;
+		for (unsigned f = 0; f < faceCount; f++)
+		{
+			EPAFace& face = faces[f];
+			if (face.removed) continue;
+			if (face.normal * (vertex.point - vertices[face.vertices[0]].point) <= 0) continue;
+
+			face.removed = true;
+			for (unsigned e = 0; e < 3; e++)
+			{
+				EPAEdge edge = { face.vertices[e], face.vertices[(e + 1) % 3] };
+
+				// An edge shared with another removed face is not on the horizon
+				bool shared = false;
+				for (unsigned h = 0; h < horizonCount; h++)
+				{
+					if (horizon[h].from == edge.to && horizon[h].to == edge.from)
+					{
+						horizon[h] = horizon[--horizonCount];
+						shared = true;
+						break;
+					}
+				}
+				if (!shared && horizonCount < maxEPAFaces) horizon[horizonCount++] = edge;
+			}
+		}
+
+		// Pack the faces left together, then fill the hole
+		unsigned kept = 0;
+		for (unsigned f = 0; f < faceCount; f++)
+		{
+			if (!faces[f].removed) faces[kept++] = faces[f];
+		}
+		faceCount = kept;
+		if (faceCount + horizonCount > maxEPAFaces) break;
+
+		unsigned added = vertexCount++;
+		vertices[added] = vertex;
+		for (unsigned h = 0; h < horizonCount; h++)
+		{
+			if (MakeFace(&faces[faceCount], vertices, horizon[h].from, horizon[h].to, added)) faceCount++;
+		}
+
+		closest = faceCount;
+	}
+
+	if (closest >= faceCount)
+	{
+		closest = 0;
+		for (unsigned f = 1; f < faceCount; f++)
+		{
+			if (!faces[f].removed && faces[f].distance < faces[closest].distance) closest = f;
+		}
+	}
+
+	// The origin projected onto the nearest face, in the face's
+	// barycentric coordinates, gives the deepest points
+	const EPAFace& face = faces[closest];
+	const SimplexVertex& va = vertices[face.vertices[0]];
+	const SimplexVertex& vb = vertices[face.vertices[1]];
+	const SimplexVertex& vc = vertices[face.vertices[2]];
+
+	Vector3 projected = face.normal * face.distance;
+	Vector3 v0 = vb.point - va.point;
+	Vector3 v1 = vc.point - va.point;
+	Vector3 v2 = projected - va.point;
+	double d00 = v0 * v0, d01 = v0 * v1, d11 = v1 * v1, d20 = v2 * v0, d21 = v2 * v1;
+	double denominator = d00 * d11 - d01 * d01;
+	double v = denominator != 0 ? (d11 * d20 - d01 * d21) / denominator : 0;
+	double w = denominator != 0 ? (d00 * d21 - d01 * d20) / denominator : 0;
+	double u = 1 - v - w;
+
+	result->distance = -face.distance;
+	result->normal = face.normal * -1;
+	result->pointOne = va.pointOne * u + vb.pointOne * v + vc.pointOne * w;
+	result->pointTwo = va.pointTwo * u + vb.pointTwo * v + vc.pointTwo * w;
+	return true;
+}
+
+// Keeps the directions the simplex's points were found in for next
+// time, and where the hull searches ended
+static void StoreCache(const SupportShape& one, const SupportShape& two, const Simplex& simplex, GJKCache* cache)
+{
+	if (!cache) return;
+
+	cache->count = simplex.count;
+	for (unsigned i = 0; i < simplex.count; i++)
+	{
+		cache->directions[i] = one.transform.transformInverseDirection(simplex.vertices[i].direction);
+	}
+	cache->hullVertices[0] = one.hullVertex;
+	cache->hullVertices[1] = two.hullVertex;
+}
+
+void GJKSolver::Query(const SupportShape& one, const SupportShape& two, GJKResult* result, GJKCache* cache)
+{
+	result->iterations = 0;
+	result->epaIterations = 0;
+
+	// Rebuild last time's simplex from the shapes as they are now,
+	// searching hulls from where they were left
+	Simplex simplex;
+	simplex.count = 0;
+	if (cache)
+	{
+		if (one.type == SupportShapeType::Hull && cache->hullVertices[0] < one.hull->GetVertexCount())
+		{
+			one.hullVertex = cache->hullVertices[0];
+		}
+		if (two.type == SupportShapeType::Hull && cache->hullVertices[1] < two.hull->GetVertexCount())
+		{
+			two.hullVertex = cache->hullVertices[1];
+		}
+
+		for (unsigned i = 0; i < cache->count; i++)
+		{
+			Vector3 direction = one.transform.transformDirection(cache->directions[i]);
+			AddVertex(&simplex, FindSupport(one, two, direction, false));
+		}
+	}
+
+	bool overlapping = RunGJK(one, two, false, &simplex, &result->iterations);
+	StoreCache(one, two, simplex, cache);
+
+	double margins = one.margin + two.margin;
+	if (!overlapping)
+	{
+		Vector3 pointOne, pointTwo;
+		for (unsigned i = 0; i < simplex.count; i++)
+		{
+			pointOne += simplex.vertices[i].pointOne * simplex.weights[i];
+			pointTwo += simplex.vertices[i].pointTwo * simplex.weights[i];
+		}
+
+		Vector3 apart = pointOne - pointTwo;
+		double distance = apart.magnitude();
+		result->normal = apart * (1.0 / distance);
+		result->distance = distance - margins;
+		result->pointOne = pointOne - result->normal * one.margin;
+		result->pointTwo = pointTwo + result->normal * two.margin;
+		return;
+	}
+
+	// The cores overlap, so the full shapes overlap at least as deep
+	// as their margins. Shapes without margins go straight to EPA with
+	// the simplex they have
+	if (margins > 0)
+	{
+		RunGJK(one, two, true, &simplex, &result->iterations);
+	}
+
+	if (!RunEPA(one, two, &simplex, result))
+	{
+		// Too flat to expand, the shapes only just touch
+		Vector3 apart = one.transform.getAxisVector(3) - two.transform.getAxisVector(3);
+		result->distance = 0;
+		result->normal = apart.squareMagnitude() > 0 ? apart.unit() : Vector3(0, 1, 0);
+		result->pointOne = result->pointTwo = ClosestPoint(simplex);
+	}
+}
+
+size_t GJKPairCache::PairKeyHash::operator()(const PairKey& key) const
+{
+	size_t one = std::hash<const void*>()(key.one);
+	size_t two = std::hash<const void*>()(key.two);
+	return one ^ (two + 0x9e3779b9 + (one << 6) + (one >> 2));
+}
+
+GJKPairCache::GJKPairCache()
+	:
+	frame(0)
+{
+}
+
+void GJKPairCache::BeginFrame()
+{
+	frame++;
+}
+
+void GJKPairCache::EndFrame()
+{
+	for (auto entry = pairs.begin(); entry != pairs.end();)
+	{
+		if (entry->second.lastFrame != frame) entry = pairs.erase(entry);
+		else ++entry;
+	}
+}
+
+void GJKPairCache::RestartFrame()
+{
+	for (auto& entry : pairs)
+	{
+		if (entry.second.lastFrame == frame) entry.second.cache = entry.second.frameStart;
+	}
+}
+
+void GJKPairCache::Clear()
+{
+	pairs.clear();
+}
+
+GJKCache& GJKPairCache::Get(const void* one, const void* two)
+{
+	PairKey key = { one, two };
+	CachedPair& pair = pairs[key];
+	if (pair.lastFrame != frame)
+	{
+		pair.frameStart = pair.cache;
+		pair.lastFrame = frame;
+	}
+	return pair.cache;
+}
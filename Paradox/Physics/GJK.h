@@ -0,0 +1,225 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the general convex narrowphase: GJK for the
+ * distance between two convex shapes and EPA for their penetration,
+ * both working only through the shapes' support functions.
+ */
+
+#include "CollideFine.h"
+#include "ConvexHull.h"
+#include <unordered_map>
+
+// The kinds of core a support shape can have
+enum class SupportShapeType
+{
+	// A single point, a sphere once given a margin
+	Point,
+
+	// A segment along the local y axis, a capsule once given a margin
+	Segment,
+
+	Box,
+
+	// A cylinder around the local y axis
+	Cylinder,
+
+	// The convex hull of a set of points, found by testing every point
+	Points,
+
+	// A built convex hull, searched by climbing from vertex to vertex
+	Hull
+};
+
+/**
+ * A convex shape as GJK and EPA see it: a core shape, given by the
+ * point of it furthest along any direction, grown all round by a
+ * margin. Spheres and capsules are a point and a segment with their
+ * radius as margin, which GJK handles exactly and far faster than
+ * their rounded surfaces.
+ */
+struct SupportShape
+{
+	SupportShapeType type;
+
+	// The body the shape belongs to, for the contacts it generates
+	RigidBody* body;
+
+	// Where the shape is in the world
+	Matrix4 transform;
+
+	// The half-sizes of a box. Segments and cylinders use y as their
+	// half-height
+	Vector3 halfSize;
+
+	// The radius of a cylinder
+	double radius;
+
+	// How far the surface is from the core all round
+	double margin;
+
+	// The points of a point set, in the shape's own coordinates
+	const Vector3* points;
+	unsigned pointCount;
+
+	// The hull of a hull shape, and the vertex the last search of it
+	// ended at, where the next one starts
+	const ConvexHull* hull;
+	mutable unsigned hullVertex;
+
+	// Returns the point of the core furthest along the given direction,
+	// both in the shape's own coordinates
+	Vector3 GetLocalSupport(const Vector3& direction) const;
+
+	// Returns the point of the core furthest along the given world direction
+	Vector3 GetSupport(const Vector3& direction) const
+	{
+		return transform.transform(GetLocalSupport(transform.transformInverseDirection(direction)));
+	}
+};
+
+// Returns the support shape of a primitive, whose transform must be
+// up to date
+SupportShape MakeSupportShape(const CollisionSphere& sphere);
+SupportShape MakeSupportShape(const CollisionBox& box);
+SupportShape MakeSupportShape(const CollisionCapsule& capsule);
+SupportShape MakeSupportShape(const CollisionConvexHull& hull);
+
+// Returns a box with the given half-sizes
+SupportShape MakeBoxShape(RigidBody* body, const Matrix4& transform, const Vector3& halfSize);
+
+// Returns a capsule or cylinder running along the local y axis
+SupportShape MakeCapsuleShape(RigidBody* body, const Matrix4& transform, double radius, double halfHeight);
+SupportShape MakeCylinderShape(RigidBody* body, const Matrix4& transform, double radius, double halfHeight);
+
+// Returns the convex hull of the given points, which must outlive it
+SupportShape MakePointsShape(RigidBody* body, const Matrix4& transform, const Vector3* points, unsigned pointCount);
+
+// Returns the given built hull, which must outlive the shape
+SupportShape MakeHullShape(RigidBody* body, const Matrix4& transform, const ConvexHull* hull);
+
+/**
+ * The simplex a GJK query between a pair of shapes finished with,
+ * kept so that the next query on the pair can start from it. Each
+ * point is kept as the direction it was found in, in the first
+ * shape's coordinates, so the simplex follows the pair as it turns
+ * and is rebuilt from the shapes as they are now.
+ */
+struct GJKCache
+{
+	Vector3 directions[4];
+	unsigned count;
+
+	// Where the searches of each hull shape ended, if either is one
+	unsigned hullVertices[2];
+
+	GJKCache()
+		:
+		count(0)
+	{
+		hullVertices[0] = hullVertices[1] = 0;
+	}
+};
+
+// What a GJK query found between two shapes
+struct GJKResult
+{
+	// The gap between the surfaces, negative for the penetration depth
+	double distance;
+
+	// The direction to move the first shape to part them, or move them
+	// further apart when separate, the same way round as contact normals
+	Vector3 normal;
+
+	// The closest, or deepest, points on each shape's surface
+	Vector3 pointOne;
+	Vector3 pointTwo;
+
+	// GJK iterations taken, and EPA iterations if it was needed
+	unsigned iterations;
+	unsigned epaIterations;
+};
+
+/**
+ * Finds the distance or penetration between convex support shapes.
+ *
+ * GJK runs on the cores alone. While they are apart, their closest
+ * points, moved out by the margins, give the result: this covers
+ * spheres and capsules that touch without their cores touching, with
+ * no EPA at all. When the cores overlap, GJK is run again on the full
+ * shapes and EPA expands the simplex it ends with to find the depth.
+ */
+class GJKSolver
+{
+public:
+	/**
+	 * Fills in the result for the given shapes. When a cache is given
+	 * GJK starts from the simplex in it, and leaves its' final simplex
+	 * there for next time.
+	 */
+	static void Query(const SupportShape& one, const SupportShape& two, GJKResult* result,
+		GJKCache* cache = NULL);
+};
+
+/**
+ * Keeps a GJK cache for every pair of primitives passed to it, so
+ * that coherent scenes start each query where the last frame left
+ * off. Pairs that are not seen for a frame are dropped.
+ */
+class GJKPairCache
+{
+public:
+	GJKPairCache();
+
+	// Starts a new frame of queries
+	void BeginFrame();
+
+	// Drops the pairs that were not queried this frame
+	void EndFrame();
+
+	// Puts the caches queried this frame back to how they were at its'
+	// start, so that the frame's queries can be run again
+	void RestartFrame();
+
+	// Drops every pair
+	void Clear();
+
+	// Returns the cache of the given pair, adding an empty one if needed
+	GJKCache& Get(const void* one, const void* two);
+
+	unsigned GetPairCount() const
+	{
+		return (unsigned)pairs.size();
+	}
+
+private:
+	struct PairKey
+	{
+		const void* one;
+		const void* two;
+
+		bool operator==(const PairKey& other) const
+		{
+			return one == other.one && two == other.two;
+		}
+	};
+
+	struct PairKeyHash
+	{
+		size_t operator()(const PairKey& key) const;
+	};
+
+	struct CachedPair
+	{
+		GJKCache cache;
+		unsigned lastFrame;
+
+		// The cache as it was before the pair's first query this frame
+		GJKCache frameStart;
+	};
+
+	std::unordered_map<PairKey, CachedPair, PairKeyHash> pairs;
+	unsigned frame;
+};
@@ -0,0 +1,176 @@
+#include "Heightfield.h"
+#include <algorithm>
+#include <limits>
+#include <math.h>
+
+Heightfield::Heightfield()
+	:
+	columns(0),
+	rows(0),
+	spacingX(1),
+	spacingZ(1),
+	volume(Vector3(), Vector3())
+{
+}
+
+void Heightfield::Build(const double* heights, unsigned columns, unsigned rows,
+	double spacingX, double spacingZ, const Vector3& origin)
+{
+	this->columns = columns;
+	this->rows = rows;
+	this->spacingX = spacingX;
+	this->spacingZ = spacingZ;
+	this->origin = origin;
+	this->heights.assign(heights, heights + columns * rows);
+
+	double low = 0, high = 0;
+	if (columns * rows > 0)
+	{
+		low = high = heights[0];
+		for (unsigned i = 1; i < columns * rows; i++)
+		{
+			low = std::min(low, heights[i]);
+			high = std::max(high, heights[i]);
+		}
+	}
+
+	volume.min = Vector3(origin.x, origin.y + low, origin.z);
+	volume.max = Vector3(
+		origin.x + (columns > 0 ? columns - 1 : 0) * spacingX,
+		origin.y + high,
+		origin.z + (rows > 0 ? rows - 1 : 0) * spacingZ);
+}
+
+void Heightfield::GetTriangle(unsigned triangle, Vector3* corners) const
+{
+	unsigned cell = triangle / 2;
+	unsigned column = cell % (columns - 1);
+	unsigned row = cell / (columns - 1);
+
+	corners[0] = GetPoint(column, row);
+	if (triangle % 2 == 0)
+	{
+		corners[1] = GetPoint(column + 1, row + 1);
+		corners[2] = GetPoint(column + 1, row);
+	}
+	else
+	{
+		corners[1] = GetPoint(column, row + 1);
+		corners[2] = GetPoint(column + 1, row + 1);
+	}
+}
+
+bool Heightfield::FindCells(double low, double high, double start, double spacing, unsigned cells,
+	unsigned* first, unsigned* last) const
+{
+	double lowCell = floor((low - start) / spacing);
+	double highCell = floor((high - start) / spacing);
+	if (highCell < 0 || lowCell >= cells) return false;
+
+	*first = lowCell < 0 ? 0 : (unsigned)lowCell;
+	*last = highCell >= cells ? cells - 1 : (unsigned)highCell;
+	return true;
+}
+
+void Heightfield::RayCastCell(unsigned column, unsigned row, const Vector3& origin, const Vector3& direction,
+	double* nearest, unsigned* found) const
+{
+	Vector3 corners[3];
+	unsigned triangle = 2 * (row * (columns - 1) + column);
+	for (unsigned i = 0; i < 2; i++)
+	{
+		GetTriangle(triangle + i, corners);
+
+		double distance;
+		if (RayHitsTriangle(origin, direction, *nearest, corners[0], corners[1], corners[2], &distance))
+		{
+			*nearest = distance;
+			*found = triangle + i;
+		}
+	}
+}
+
+bool Heightfield::RayCast(const Vector3& origin, const Vector3& direction, double length, TriangleRayHit* hit) const
+{
+	if (GetTriangleCount() == 0) return false;
+
+	// Clip the ray to the box around the heightfield
+	double enter = 0, leave = length;
+	for (unsigned axis = 0; axis < 3; axis++)
+	{
+		if (direction[axis] == 0)
+		{
+			if (origin[axis] < volume.min[axis] || origin[axis] > volume.max[axis]) return false;
+			continue;
+		}
+
+		double near = (volume.min[axis] - origin[axis]) / direction[axis];
+		double far = (volume.max[axis] - origin[axis]) / direction[axis];
+		if (near > far) std::swap(near, far);
+		enter = std::max(enter, near);
+		leave = std::min(leave, far);
+	}
+	if (enter > leave) return false;
+
+	// Step through the cells under the ray from where it enters, after
+	// Amanatides and Woo
+	Vector3 start = origin + direction * enter;
+	int column = std::min((int)columns - 2, std::max(0, (int)floor((start.x - this->origin.x) / spacingX)));
+	int row = std::min((int)rows - 2, std::max(0, (int)floor((start.z - this->origin.z) / spacingZ)));
+
+	double infinity = std::numeric_limits<double>::infinity();
+	int stepColumn = direction.x > 0 ? 1 : -1;
+	int stepRow = direction.z > 0 ? 1 : -1;
+	double nextColumn = infinity, nextRow = infinity;
+	double columnStep = infinity, rowStep = infinity;
+	if (direction.x != 0)
+	{
+		double boundary = this->origin.x + (column + (stepColumn > 0 ? 1 : 0)) * spacingX;
+		nextColumn = (boundary - origin.x) / direction.x;
+		columnStep = spacingX / fabs(direction.x);
+	}
+	if (direction.z != 0)
+	{
+		double boundary = this->origin.z + (row + (stepRow > 0 ? 1 : 0)) * spacingZ;
+		nextRow = (boundary - origin.z) / direction.z;
+		rowStep = spacingZ / fabs(direction.z);
+	}
+
+	double nearest = length;
+	unsigned found = 0xffffffff;
+	for (;;)
+	{
+		RayCastCell((unsigned)column, (unsigned)row, origin, direction, &nearest, &found);
+
+		// A hit before the ray leaves the cell is the first
+		double exit = std::min(nextColumn, nextRow);
+		if (found != 0xffffffff && nearest <= exit) break;
+		if (exit > leave) break;
+
+		if (nextColumn < nextRow)
+		{
+			column += stepColumn;
+			if (column < 0 || column > (int)columns - 2) break;
+			nextColumn += columnStep;
+		}
+		else
+		{
+			row += stepRow;
+			if (row < 0 || row > (int)rows - 2) break;
+			nextRow += rowStep;
+		}
+	}
+
+	if (found == 0xffffffff) return false;
+
+	Vector3 corners[3];
+	GetTriangle(found, corners);
+
+	hit->triangle = found;
+	hit->distance = nearest;
+	hit->point = origin + direction * nearest;
+	hit->normal = (corners[1] - corners[0]) % (corners[2] - corners[0]);
+	hit->normal.normalise();
+	if (hit->normal * direction > 0) hit->normal *= -1;
+	return true;
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the heightfield collider: ground given as a
+ * height at each point of a regular grid.
+ */
+
+#include "TriangleMesh.h"
+
+/**
+ * Immovable ground whose height is sampled on a regular grid in the
+ * x-z plane, in world coordinates.
+ *
+ * Each cell of the grid is two triangles, split along the diagonal
+ * from its' lowest corner in x and z to its' highest, and numbered
+ * twice the cell's index and one more, with cells counted along x
+ * and then along z. A body's box picks out the cells under it with no
+ * tree to search, and rays step from cell to cell along their path.
+ *
+ * Unlike a mesh, a heightfield knows which way is up: its' triangles
+ * push bodies that have sunk below the surface back up through it.
+ */
+class Heightfield
+{
+public:
+	Heightfield();
+
+	/**
+	 * Builds the heightfield from the given heights, a row of the
+	 * given number of columns at a time, from the least z to the most.
+	 * Samples are the given distances apart along x and z, and the
+	 * first is at the given origin, to which every height is added.
+	 */
+	void Build(const double* heights, unsigned columns, unsigned rows,
+		double spacingX, double spacingZ, const Vector3& origin);
+
+	/**
+	 * Calls the given function with the number of every triangle in the
+	 * cells the given box is over, unless the whole cell is below the
+	 * box, and the triangle's three corners.
+	 */
+	template <class Callback>
+	void Query(const BoundingBoxVolume& volume, Callback callback) const;
+
+	/**
+	 * Finds the first triangle the ray from the origin along the unit
+	 * direction meets, no further than the given length. Returns false
+	 * if it meets none.
+	 */
+	bool RayCast(const Vector3& origin, const Vector3& direction, double length, TriangleRayHit* hit) const;
+
+	// Returns the point of the grid at the given column and row
+	Vector3 GetPoint(unsigned column, unsigned row) const
+	{
+		return Vector3(
+			origin.x + column * spacingX,
+			origin.y + heights[row * columns + column],
+			origin.z + row * spacingZ);
+	}
+
+	// Fills in the three corners of the given triangle
+	void GetTriangle(unsigned triangle, Vector3* corners) const;
+
+	unsigned GetColumns() const
+	{
+		return columns;
+	}
+
+	unsigned GetRows() const
+	{
+		return rows;
+	}
+
+	unsigned GetTriangleCount() const
+	{
+		return columns > 1 && rows > 1 ? 2 * (columns - 1) * (rows - 1) : 0;
+	}
+
+	// Returns the box around the whole heightfield
+	const BoundingBoxVolume& GetVolume() const
+	{
+		return volume;
+	}
+
+private:
+	/**
+	 * Finds the range of cells the given box is over along one axis,
+	 * clamped to the grid. Returns false if it is over none.
+	 */
+	bool FindCells(double low, double high, double start, double spacing, unsigned cells,
+		unsigned* first, unsigned* last) const;
+
+	// Tests the ray against the two triangles of the given cell, keeping
+	// the nearest hit so far
+	void RayCastCell(unsigned column, unsigned row, const Vector3& origin, const Vector3& direction,
+		double* nearest, unsigned* found) const;
+
+	unsigned columns;
+	unsigned rows;
+	double spacingX;
+	double spacingZ;
+	Vector3 origin;
+
+	std::vector<double> heights;
+	BoundingBoxVolume volume;
+};
+
+template <class Callback>
+void Heightfield::Query(const BoundingBoxVolume& volume, Callback callback) const
+{
+	if (GetTriangleCount() == 0 || volume.min.y > this->volume.max.y) return;
+
+	unsigned firstColumn, lastColumn, firstRow, lastRow;
+	if (!FindCells(volume.min.x, volume.max.x, origin.x, spacingX, columns - 1, &firstColumn, &lastColumn)) return;
+	if (!FindCells(volume.min.z, volume.max.z, origin.z, spacingZ, rows - 1, &firstRow, &lastRow)) return;
+
+	Vector3 corners[4];
+	for (unsigned row = firstRow; row <= lastRow; row++)
+	{
+		for (unsigned column = firstColumn; column <= lastColumn; column++)
+		{
+			corners[0] = GetPoint(column, row);
+			corners[1] = GetPoint(column + 1, row);
+			corners[2] = GetPoint(column, row + 1);
+			corners[3] = GetPoint(column + 1, row + 1);
+
+			// Skip cells wholly below the box. Cells above it are kept,
+			// the box has sunk through them
+			double high = corners[0].y;
+			for (unsigned i = 1; i < 4; i++)
+			{
+				if (corners[i].y > high) high = corners[i].y;
+			}
+			if (high < volume.min.y) continue;
+
+			unsigned triangle = 2 * (row * (columns - 1) + column);
+			callback(triangle, corners[0], corners[3], corners[1]);
+			callback(triangle + 1, corners[0], corners[2], corners[3]);
+		}
+	}
+}
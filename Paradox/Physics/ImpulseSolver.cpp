@@ -0,0 +1,318 @@
+#include "ImpulseSolver.h"
+#include <algorithm>
+
+// Marks a contact end that is the world or a body the solver cannot move
+static const unsigned noBody = 0xffffffff;
+
+// Contacts closing faster than this wake up sleeping bodies they touch
+static const double wakeVelocity = 0.01;
+
+// How far, in the first body's coordinates, a contact may move between
+// frames and still be warm started from its' last impulse
+static const double warmStartDistance = 0.05;
+
+static bool CachedBefore(const CachedImpulse& one, const CachedImpulse& two)
+{
+	if (one.body[0] != two.body[0]) return one.body[0] < two.body[0];
+	if (one.body[1] != two.body[1]) return one.body[1] < two.body[1];
+	return one.order < two.order;
+}
+
+// Returns the handle the cache keeps for the given contact body
+static BodyHandle GetCachedHandle(const RigidBody* body)
+{
+	return body ? body->GetHandle() : invalidBodyHandle;
+}
+
+void ImpulseCache::BeginFrame(unsigned numContacts)
+{
+	current.resize(numContacts);
+}
+
+void ImpulseCache::EndFrame()
+{
+	previous.swap(current);
+	std::sort(previous.begin(), previous.end(), CachedBefore);
+}
+
+void ImpulseCache::Clear()
+{
+	previous.clear();
+	current.clear();
+}
+
+void ImpulseCache::SetPrevious(const CachedImpulse* impulses, unsigned count)
+{
+	previous.assign(impulses, impulses + count);
+}
+
+const CachedImpulse* ImpulseCache::Find(const RigidBody* one, const RigidBody* two, unsigned feature,
+	const Vector3& localPoint, double maxDistance) const
+{
+	CachedImpulse key;
+	key.body[0] = GetCachedHandle(one);
+	key.body[1] = GetCachedHandle(two);
+	key.order = 0;
+
+	std::vector<CachedImpulse>::const_iterator entry =
+		std::lower_bound(previous.begin(), previous.end(), key, CachedBefore);
+
+	// Take the same feature if it is there, otherwise the nearest point
+	// between the same bodies. Ties go to the contact generated first
+	// as entries are in generation order
+	const CachedImpulse* nearest = NULL;
+	double nearestDistance = maxDistance * maxDistance;
+	for (; entry != previous.end() && entry->body[0] == key.body[0] && entry->body[1] == key.body[1]; ++entry)
+	{
+		if (feature && entry->feature == feature) return &*entry;
+
+		double distance = (entry->localPoint - localPoint).squareMagnitude();
+		if (distance <= nearestDistance)
+		{
+			if (nearest && distance == nearestDistance) continue;
+			nearest = &*entry;
+			nearestDistance = distance;
+		}
+	}
+
+	return nearest;
+}
+
+ImpulseSolver::ImpulseSolver(unsigned iterations)
+	:
+	iterationsUsed(0),
+	iterations(iterations),
+	baumgarte(0.2),
+	slop(0.01),
+	warmStarting(true)
+{
+}
+
+void ImpulseSolver::SetIterations(unsigned iterations)
+{
+	this->iterations = iterations;
+}
+
+void ImpulseSolver::SetPositionCorrection(double baumgarte, double slop)
+{
+	this->baumgarte = baumgarte;
+	this->slop = slop;
+}
+
+void ImpulseSolver::SetWarmStarting(bool warmStarting)
+{
+	this->warmStarting = warmStarting;
+}
+
+void ImpulseSolver::CopySettings(const ImpulseSolver& other)
+{
+	iterations = other.iterations;
+	baumgarte = other.baumgarte;
+	slop = other.slop;
+	warmStarting = other.warmStarting;
+}
+
+void ImpulseSolver::GatherBodies(Contact* contacts, unsigned numContacts)
+{
+	// Pair every movable body end with its' slot, then sort so that
+	// each body's slots are next to each other
+	bodyContacts.clear();
+	contactBodies.assign(numContacts * 2, noBody);
+	for (unsigned c = 0; c < numContacts; c++)
+	{
+		for (unsigned b = 0; b < 2; b++)
+		{
+			RigidBody* body = contacts[c].body[b];
+			if (!body || !body->GetAwakeStatus() || !body->HasFiniteMass()) continue;
+			bodyContacts.push_back(std::make_pair((const RigidBody*)body, c * 2 + b));
+		}
+	}
+	std::sort(bodyContacts.begin(), bodyContacts.end());
+
+	bodies.clear();
+	for (unsigned i = 0; i < bodyContacts.size(); i++)
+	{
+		unsigned slot = bodyContacts[i].second;
+		if (i == 0 || bodyContacts[i].first != bodyContacts[i - 1].first)
+		{
+			RigidBody* body = contacts[slot / 2].body[slot % 2];
+
+			SolverBody solverBody;
+			solverBody.body = body;
+			solverBody.velocity = body->GetVelocity();
+			solverBody.rotation = body->GetRotation();
+			solverBody.inverseMass = body->GetInverseMass();
+			body->GetInverseInertiaTensorWorld(&solverBody.inverseInertiaTensor);
+			bodies.push_back(solverBody);
+		}
+		contactBodies[slot] = (unsigned)bodies.size() - 1;
+	}
+}
+
+double ImpulseSolver::EffectiveMass(const Constraint& constraint, const Vector3& axis) const
+{
+	double inverseMass = 0;
+	for (unsigned b = 0; b < 2; b++)
+	{
+		if (constraint.body[b] == noBody) continue;
+		const SolverBody& body = bodies[constraint.body[b]];
+
+		// Velocity at the contact along the axis per unit impulse
+		Vector3 angular = body.inverseInertiaTensor.transform(constraint.relativeContactPosition[b] % axis);
+		inverseMass += body.inverseMass + (angular % constraint.relativeContactPosition[b]) * axis;
+	}
+	return inverseMass;
+}
+
+double ImpulseSolver::RelativeVelocity(const Constraint& constraint, const Vector3& axis) const
+{
+	double velocity = 0;
+	if (constraint.body[0] != noBody)
+	{
+		const SolverBody& body = bodies[constraint.body[0]];
+		velocity += (body.velocity + body.rotation % constraint.relativeContactPosition[0]) * axis;
+	}
+	if (constraint.body[1] != noBody)
+	{
+		const SolverBody& body = bodies[constraint.body[1]];
+		velocity -= (body.velocity + body.rotation % constraint.relativeContactPosition[1]) * axis;
+	}
+	return velocity;
+}
+
+void ImpulseSolver::ApplyImpulse(const Constraint& constraint, const Vector3& impulse)
+{
+	// The first body is pushed along the impulse, the second against it
+	if (constraint.body[0] != noBody)
+	{
+		SolverBody& body = bodies[constraint.body[0]];
+		body.velocity.addScaledVector(impulse, body.inverseMass);
+		body.rotation += body.inverseInertiaTensor.transform(constraint.relativeContactPosition[0] % impulse);
+	}
+	if (constraint.body[1] != noBody)
+	{
+		SolverBody& body = bodies[constraint.body[1]];
+		body.velocity.addScaledVector(impulse, -body.inverseMass);
+		body.rotation -= body.inverseInertiaTensor.transform(constraint.relativeContactPosition[1] % impulse);
+	}
+}
+
+void ImpulseSolver::PrepareConstraint(Contact& contact, Constraint& constraint, double duration,
+	const ImpulseCache* cache)
+{
+	constraint.relativeContactPosition[0] = contact.relativeContactPosition[0];
+	constraint.relativeContactPosition[1] = contact.relativeContactPosition[1];
+	constraint.contactToWorld = contact.contactToWorld;
+	constraint.friction = contact.friction;
+	constraint.impulse.clear();
+
+	for (unsigned axis = 0; axis < 3; axis++)
+	{
+		double inverseMass = EffectiveMass(constraint, contact.contactToWorld.getAxisVector(axis));
+		constraint.axisMass[axis] = inverseMass > 0 ? 1.0 / inverseMass : 0;
+	}
+
+	// Aim for the velocity the resolver would, and push out any
+	// penetration past the slop over the next few frames
+	double bias = 0;
+	if (contact.penetration > slop) bias = baumgarte * (contact.penetration - slop) / duration;
+	constraint.targetVelocity = contact.contactVelocity.x + contact.desiredDeltaVelocity + bias;
+
+	if (!cache || !warmStarting) return;
+
+	const CachedImpulse* cached = cache->Find(contact.body[0], contact.body[1], contact.feature,
+		contact.body[0]->GetPointInLocalSpace(contact.contactPoint), warmStartDistance);
+	if (!cached) return;
+
+	constraint.impulse = cached->impulse;
+	ApplyImpulse(constraint, constraint.contactToWorld.transform(constraint.impulse));
+}
+
+void ImpulseSolver::SolveContacts(Contact* contacts, unsigned numContacts, double duration,
+	ImpulseCache* cache, unsigned firstSlot)
+{
+	if (numContacts == 0) return;
+
+	// Work out the contact basis and desired velocity the same way
+	// the resolver does, waking bodies that are being hit
+	for (unsigned c = 0; c < numContacts; c++)
+	{
+		contacts[c].CalculateInternals(duration);
+		if (contacts[c].desiredDeltaVelocity > wakeVelocity)
+		{
+			contacts[c].MatchAwakeState();
+			contacts[c].CalculateDesiredDeltaVelocity(duration);
+		}
+	}
+
+	GatherBodies(contacts, numContacts);
+
+	constraints.resize(numContacts);
+	for (unsigned c = 0; c < numContacts; c++)
+	{
+		Constraint& constraint = constraints[c];
+		constraint.body[0] = contactBodies[c * 2];
+		constraint.body[1] = contactBodies[c * 2 + 1];
+		if (constraint.body[0] == noBody && constraint.body[1] == noBody) continue;
+
+		PrepareConstraint(contacts[c], constraint, duration, cache);
+	}
+
+	for (unsigned iteration = 0; iteration < iterations; iteration++)
+	{
+		for (unsigned c = 0; c < numContacts; c++)
+		{
+			Constraint& constraint = constraints[c];
+			if (constraint.body[0] == noBody && constraint.body[1] == noBody) continue;
+
+			// Friction first, limited by the normal impulse so far, so
+			// that the normal impulse has the last word
+			if (constraint.friction != 0)
+			{
+				double limit = constraint.friction * constraint.impulse.x;
+				for (unsigned axis = 1; axis < 3; axis++)
+				{
+					Vector3 tangent = constraint.contactToWorld.getAxisVector(axis);
+					double lambda = -RelativeVelocity(constraint, tangent) * constraint.axisMass[axis];
+
+					double& total = axis == 1 ? constraint.impulse.y : constraint.impulse.z;
+					double previous = total;
+					total = std::max(-limit, std::min(limit, previous + lambda));
+					ApplyImpulse(constraint, tangent * (total - previous));
+				}
+			}
+
+			// Contacts can only push, so the total normal impulse stays positive
+			Vector3 normal = constraint.contactToWorld.getAxisVector(0);
+			double lambda = (constraint.targetVelocity - RelativeVelocity(constraint, normal)) * constraint.axisMass[0];
+
+			double previous = constraint.impulse.x;
+			constraint.impulse.x = std::max(0.0, previous + lambda);
+			ApplyImpulse(constraint, normal * (constraint.impulse.x - previous));
+		}
+	}
+	iterationsUsed += iterations;
+
+	for (unsigned b = 0; b < bodies.size(); b++)
+	{
+		bodies[b].body->SetVelocity(bodies[b].velocity);
+		bodies[b].body->SetRotation(bodies[b].rotation);
+	}
+
+	if (!cache) return;
+
+	// Keep the totals for the next frame
+	for (unsigned c = 0; c < numContacts; c++)
+	{
+		CachedImpulse& cached = cache->GetSlot(firstSlot + c);
+		cached.body[0] = GetCachedHandle(contacts[c].body[0]);
+		cached.body[1] = GetCachedHandle(contacts[c].body[1]);
+		cached.localPoint = contacts[c].body[0]->GetPointInLocalSpace(contacts[c].contactPoint);
+		cached.feature = contacts[c].feature;
+		cached.order = firstSlot + c;
+
+		const Constraint& constraint = constraints[c];
+		if (constraint.body[0] == noBody && constraint.body[1] == noBody) cached.impulse.clear();
+		else cached.impulse = constraint.impulse;
+	}
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the sequential impulse solver, an alternative
+ * to ContactResolver that can be selected on the world.
+ */
+
+#include "contacts.h"
+#include <vector>
+
+/**
+ * The impulse accumulated at a contact in the last frame, kept so
+ * that the next frame can start from it.
+ */
+struct CachedImpulse
+{
+	// The handles of the bodies, invalidBodyHandle for none, so that a
+	// body made where a destroyed one was does not take its' impulses
+	BodyHandle body[2];
+
+	// The contact point in the first body's coordinates
+	Vector3 localPoint;
+
+	// The feature id of the contact, zero if it had none
+	unsigned feature;
+
+	// Accumulated impulse in contact coordinates, x along the normal
+	Vector3 impulse;
+
+	// The position the contact was generated in, breaks ties when sorting
+	unsigned order;
+};
+
+/**
+ * Holds the impulses of the last frame and collects those of the
+ * current one. Each contact of the current frame writes only its'
+ * own slot, so islands can be solved on different threads.
+ */
+class ImpulseCache
+{
+public:
+	// Makes room for the given number of contacts this frame
+	void BeginFrame(unsigned numContacts);
+
+	// Makes the impulses collected this frame the ones to warm start from
+	void EndFrame();
+
+	// Forgets every cached impulse
+	void Clear();
+
+	/**
+	 * Finds the impulse last frame between the same bodies with the
+	 * same feature id or, failing that, at the point nearest the given
+	 * one within the given distance. Returns NULL if there is none.
+	 * Bodies are told apart by handle, so they must share a store.
+	 */
+	const CachedImpulse* Find(const RigidBody* one, const RigidBody* two, unsigned feature,
+		const Vector3& localPoint, double maxDistance) const;
+
+	// Returns the slot the given contact of this frame writes to
+	CachedImpulse& GetSlot(unsigned contact)
+	{
+		return current[contact];
+	}
+
+	// Returns the impulses the next frame warm starts from, in cache order
+	const std::vector<CachedImpulse>& GetPrevious() const
+	{
+		return previous;
+	}
+
+	/**
+	 * Makes the given impulses, which must be in the order GetPrevious
+	 * gives them in, the ones the next frame warm starts from. Used to
+	 * put back the cache of a snapshot.
+	 */
+	void SetPrevious(const CachedImpulse* impulses, unsigned count);
+
+private:
+	// Sorted by body pair so that pairs can be found by binary search
+	std::vector<CachedImpulse> previous;
+	std::vector<CachedImpulse> current;
+};
+
+/**
+ * Resolves contacts with sequential impulses, also known as projected
+ * Gauss-Seidel. Every iteration visits every contact and applies the
+ * impulse that corrects its' relative velocity, clamping the total
+ * impulse so contacts only push and friction stays inside its' cone.
+ *
+ * Totals are cached per contact between frames and applied up front
+ * the next frame (warm starting), so that resting stacks converge
+ * over several frames instead of within one. Penetration is removed
+ * by biasing the target velocity rather than by moving bodies.
+ *
+ * The solver works from the same contact data as ContactResolver:
+ * the contact basis, relative positions, friction, restitution and
+ * desired change in velocity.
+ */
+class ImpulseSolver
+{
+public:
+	ImpulseSolver(unsigned iterations = 10);
+
+	// Sets the number of passes over all contacts per solve
+	void SetIterations(unsigned iterations);
+
+	/**
+	 * Sets the fraction of penetration removed per second, over the
+	 * duration of one frame, and the penetration allowed before any
+	 * is removed.
+	 */
+	void SetPositionCorrection(double baumgarte, double slop);
+
+	// Turns reuse of last frame's impulses on or off
+	void SetWarmStarting(bool warmStarting);
+
+	// Copies the settings, but not the working data, of another solver
+	void CopySettings(const ImpulseSolver& other);
+
+	/**
+	 * Solves the given contacts. The impulses are warm started from,
+	 * and stored back to, slots [firstSlot, firstSlot + numContacts)
+	 * of the given cache.
+	 */
+	void SolveContacts(Contact* contacts, unsigned numContacts, double duration,
+		ImpulseCache* cache, unsigned firstSlot);
+
+	unsigned iterationsUsed;
+
+protected:
+	// A body as seen by the solver, velocities are written back at the end
+	struct SolverBody
+	{
+		RigidBody* body;
+		Vector3 velocity;
+		Vector3 rotation;
+		double inverseMass;
+		Matrix3 inverseInertiaTensor;
+	};
+
+	// The per contact data that stays fixed over the iterations
+	struct Constraint
+	{
+		// Solver bodies, or noBody for the world and sleeping bodies
+		unsigned body[2];
+
+		Vector3 relativeContactPosition[2];
+		Matrix3 contactToWorld;
+
+		// Inverse of the effective mass along each contact axis
+		double axisMass[3];
+
+		// Relative normal velocity to reach, including position correction
+		double targetVelocity;
+
+		double friction;
+
+		// Accumulated impulse in contact coordinates
+		Vector3 impulse;
+	};
+
+	// Collects the distinct bodies of the contacts as solver bodies
+	void GatherBodies(Contact* contacts, unsigned numContacts);
+
+	// Builds the constraint of one contact and warm starts it
+	void PrepareConstraint(Contact& contact, Constraint& constraint, double duration,
+		const ImpulseCache* cache);
+
+	// Returns the velocity of body zero relative to body one along the given axis
+	double RelativeVelocity(const Constraint& constraint, const Vector3& axis) const;
+
+	// Applies an impulse in world coordinates at the contact
+	void ApplyImpulse(const Constraint& constraint, const Vector3& impulse);
+
+	// Returns the inverse of the effective mass along the given axis
+	double EffectiveMass(const Constraint& constraint, const Vector3& axis) const;
+
+	unsigned iterations;
+	double baumgarte;
+	double slop;
+	bool warmStarting;
+
+	std::vector<SolverBody> bodies;
+	std::vector<Constraint> constraints;
+
+	// Every (body, contact * 2 + slot) pair, grouped by body
+	std::vector<std::pair<const RigidBody*, unsigned>> bodyContacts;
+	std::vector<unsigned> contactBodies;
+};
@@ -0,0 +1,132 @@
+#include "IntegratorLanes.h"
+
+#if defined(PARADOX_SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/**
+ * Holds what the running processor supports, found once on first
+ * use.
+ */
+struct CpuFeatures
+{
+	bool avx2;
+	bool fma;
+
+	CpuFeatures()
+		:
+		avx2(false),
+		fma(false)
+	{
+#if defined(PARADOX_SIMD_X86) && defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+
+		// The OS must also save the upper halves of the registers
+		if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return;
+
+		fma = (info[2] & (1 << 12)) != 0;
+
+		if (maxLeaf >= 7)
+		{
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] & (1 << 5)) != 0;
+		}
+#elif defined(PARADOX_SIMD_X86)
+		__builtin_cpu_init();
+		avx2 = __builtin_cpu_supports("avx2") != 0;
+		fma = __builtin_cpu_supports("fma") != 0;
+#endif
+	}
+};
+
+static const CpuFeatures& GetCpuFeatures()
+{
+	static CpuFeatures features;
+	return features;
+}
+
+IntegratorPath GetBestIntegratorPath()
+{
+	if (IsIntegratorPathSupported(IntegratorPath::AVX2)) return IntegratorPath::AVX2;
+	if (IsIntegratorPathSupported(IntegratorPath::SSE)) return IntegratorPath::SSE;
+	return IntegratorPath::Scalar;
+}
+
+bool IsIntegratorPathSupported(IntegratorPath path)
+{
+	switch (path)
+	{
+#ifdef PARADOX_SIMD_X86
+	case IntegratorPath::AVX2:
+		return GetCpuFeatures().avx2;
+	case IntegratorPath::SSE:
+		return true;
+#endif
+	case IntegratorPath::Scalar:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool IsFusedMultiplyAddSupported()
+{
+	return GetCpuFeatures().avx2 && GetCpuFeatures().fma;
+}
+
+const char* GetIntegratorPathName(IntegratorPath path)
+{
+	switch (path)
+	{
+	case IntegratorPath::AVX2:
+		return "avx2";
+	case IntegratorPath::SSE:
+		return "sse";
+	default:
+		return "scalar";
+	}
+}
+
+void IntegrateBodies(IntegratorPath path, const IntegratorArrays& arrays,
+	unsigned begin, unsigned end, double duration, bool fused)
+{
+	switch (path)
+	{
+#ifdef PARADOX_SIMD_X86
+	case IntegratorPath::AVX2:
+		IntegrateBodiesAVX2(arrays, begin, end, duration, fused && IsFusedMultiplyAddSupported());
+		break;
+	case IntegratorPath::SSE:
+		IntegrateBodiesSSE(arrays, begin, end, duration);
+		break;
+#endif
+	default:
+		IntegrateRange<ScalarLane>(arrays, begin, end, duration);
+		break;
+	}
+}
+
+void CalculateDerivedData(IntegratorPath path, const IntegratorArrays& arrays,
+	unsigned begin, unsigned end)
+{
+	switch (path)
+	{
+#ifdef PARADOX_SIMD_X86
+	case IntegratorPath::AVX2:
+		CalculateDerivedDataAVX2(arrays, begin, end);
+		break;
+	case IntegratorPath::SSE:
+		CalculateDerivedDataSSE(arrays, begin, end);
+		break;
+#endif
+	default:
+		DerivedRange<ScalarLane>(arrays, begin, end);
+		break;
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the batched integrator that BodyStore uses to
+ * step its bodies. The same kernel is compiled for scalar, SSE2 and
+ * AVX2 code, and the widest path the processor supports is picked at
+ * runtime. All paths perform the same operations in the same order,
+ * so unless fused multiply-add is enabled they produce bit-identical
+ * results.
+ */
+
+// The vector paths are only built for x86 processors
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PARADOX_SIMD_X86 1
+#endif
+
+/**
+ * The instruction sets the integrator can be run with. SSE handles
+ * two bodies per instruction and AVX2 four.
+ */
+enum class IntegratorPath
+{
+	Scalar,
+	SSE,
+	AVX2
+};
+
+/**
+ * Raw pointers to the arrays of a BodyStore, offset so that index 0
+ * is the first body. Matrices are stored one after the other, so
+ * each element is strided by the size of the matrix.
+ */
+struct IntegratorArrays
+{
+	double* positionX; double* positionY; double* positionZ;
+	double* velocityX; double* velocityY; double* velocityZ;
+	double* rotationX; double* rotationY; double* rotationZ;
+	double* orientationR; double* orientationI; double* orientationJ; double* orientationK;
+	double* inverseMass;
+	double* forceAccumX; double* forceAccumY; double* forceAccumZ;
+	double* torqueAccumX; double* torqueAccumY; double* torqueAccumZ;
+	double* accelerationX; double* accelerationY; double* accelerationZ;
+	double* linearDampingFactor;
+	double* angularDampingFactor;
+	double* lastFrameAccelerationX; double* lastFrameAccelerationY; double* lastFrameAccelerationZ;
+	const unsigned char* isAwake;
+
+	// 9 doubles per body
+	double* inverseInertiaTensor;
+	double* inverseInertiaTensorWorld;
+
+	// 12 doubles per body
+	double* transformationMatrix;
+};
+
+// Returns the widest path the running processor supports
+IntegratorPath GetBestIntegratorPath();
+
+// Checks whether the running processor can use the given path
+bool IsIntegratorPathSupported(IntegratorPath path);
+
+// Checks whether the running processor has fused multiply-add
+bool IsFusedMultiplyAddSupported();
+
+// Returns a short lower case name for the given path
+const char* GetIntegratorPathName(IntegratorPath path);
+
+/**
+ * Integrates the awake bodies in [begin, end) by the given duration
+ * and rebuilds their derived data, using the given path. The
+ * damping factors must already be raised to the power of the
+ * duration. When fused is set and supported, multiply-adds are
+ * fused, which is faster but no longer matches the other paths.
+ */
+void IntegrateBodies(IntegratorPath path, const IntegratorArrays& arrays,
+	unsigned begin, unsigned end, double duration, bool fused);
+
+// Rebuilds the derived data of every body in [begin, end), using the given path
+void CalculateDerivedData(IntegratorPath path, const IntegratorArrays& arrays,
+	unsigned begin, unsigned end);
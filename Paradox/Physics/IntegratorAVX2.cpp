@@ -0,0 +1,90 @@
+#include "IntegratorLanes.h"
+
+#ifdef PARADOX_SIMD_X86
+
+// This file is built with AVX2 and FMA code generation enabled, and
+// must only be called into once the processor has been checked
+#include <immintrin.h>
+#include <string.h>
+
+namespace
+{
+
+/**
+ * Four bodies at a time with AVX2. When Fused is set multiply-adds
+ * are done with a single rounding, which no longer matches the
+ * other paths bit for bit.
+ */
+template <bool Fused>
+struct Avx2Lane
+{
+	static const unsigned width = 4;
+
+	typedef __m256d Value;
+	typedef __m256d Mask;
+
+	static Value Load(const double* p) { return _mm256_loadu_pd(p); }
+	static Value Set1(double value) { return _mm256_set1_pd(value); }
+	static Value Add(Value a, Value b) { return _mm256_add_pd(a, b); }
+	static Value Sub(Value a, Value b) { return _mm256_sub_pd(a, b); }
+	static Value Mul(Value a, Value b) { return _mm256_mul_pd(a, b); }
+	static Value Div(Value a, Value b) { return _mm256_div_pd(a, b); }
+	static Value Sqrt(Value a) { return _mm256_sqrt_pd(a); }
+	static Mask Less(Value a, Value b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+	static Value Select(Mask mask, Value a, Value b) { return _mm256_blendv_pd(b, a, mask); }
+	static Mask All() { return _mm256_castsi256_pd(_mm256_set1_epi64x(-1)); }
+	static bool None(Mask mask) { return _mm256_movemask_pd(mask) == 0; }
+
+	static Value MulAdd(Value a, Value b, Value c)
+	{
+		if (Fused) return _mm256_fmadd_pd(a, b, c);
+		return _mm256_add_pd(_mm256_mul_pd(a, b), c);
+	}
+
+	static Mask LoadAwake(const unsigned char* p)
+	{
+		int flags;
+		memcpy(&flags, p, sizeof(flags));
+
+		__m256i wide = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(flags));
+		return _mm256_castsi256_pd(_mm256_cmpgt_epi64(wide, _mm256_setzero_si256()));
+	}
+
+	static void Store(double* p, Mask mask, Value value)
+	{
+		_mm256_storeu_pd(p, Select(mask, value, _mm256_loadu_pd(p)));
+	}
+
+	static Value LoadStrided(const double* p, unsigned stride)
+	{
+		__m256i offsets = _mm256_set_epi64x(3 * stride, 2 * stride, stride, 0);
+		return _mm256_i64gather_pd(p, offsets, sizeof(double));
+	}
+
+	static void StoreStrided(double* p, unsigned stride, Mask mask, Value value)
+	{
+		double lanes[4];
+		_mm256_storeu_pd(lanes, value);
+
+		int bits = _mm256_movemask_pd(mask);
+		if (bits & 1) p[0] = lanes[0];
+		if (bits & 2) p[stride] = lanes[1];
+		if (bits & 4) p[2 * stride] = lanes[2];
+		if (bits & 8) p[3 * stride] = lanes[3];
+	}
+};
+
+}
+
+void IntegrateBodiesAVX2(const IntegratorArrays& arrays, unsigned begin, unsigned end, double duration, bool fused)
+{
+	if (fused) IntegrateRange<Avx2Lane<true> >(arrays, begin, end, duration);
+	else IntegrateRange<Avx2Lane<false> >(arrays, begin, end, duration);
+}
+
+void CalculateDerivedDataAVX2(const IntegratorArrays& arrays, unsigned begin, unsigned end)
+{
+	DerivedRange<Avx2Lane<false> >(arrays, begin, end);
+}
+
+#endif
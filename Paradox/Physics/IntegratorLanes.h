@@ -0,0 +1,290 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * The integrator kernel, written once against a lane type and
+ * included by each instruction set's translation unit. A lane type
+ * wraps a register of Lane::width bodies and provides:
+ *
+ * Value, Mask, Load, Store, Set1, Add, Sub, Mul, Div, Sqrt,
+ * MulAdd(a, b, c) = a * b + c, Less, Select, All, None,
+ * LoadAwake, LoadStrided and StoreStrided.
+ *
+ * Every expression below mirrors the grouping of the scalar math in
+ * ParadoxMath.h, so that each lane type rounds the same way.
+ */
+
+#include "Integrator.h"
+#include <math.h>
+
+#ifdef PARADOX_SIMD_X86
+// Entry points of the vector paths, each built in its own file
+void IntegrateBodiesSSE(const IntegratorArrays& arrays, unsigned begin, unsigned end, double duration);
+void CalculateDerivedDataSSE(const IntegratorArrays& arrays, unsigned begin, unsigned end);
+void IntegrateBodiesAVX2(const IntegratorArrays& arrays, unsigned begin, unsigned end, double duration, bool fused);
+void CalculateDerivedDataAVX2(const IntegratorArrays& arrays, unsigned begin, unsigned end);
+#endif
+
+// Lanes are kept to the file that includes them, as the vector paths
+// are built with their own instruction sets and must not share code
+namespace
+{
+
+/**
+ * One body at a time, used on its own and for the bodies left over
+ * at the end of a vector pass.
+ */
+struct ScalarLane
+{
+	static const unsigned width = 1;
+
+	typedef double Value;
+	typedef bool Mask;
+
+	static Value Load(const double* p) { return *p; }
+	static Value Set1(double value) { return value; }
+	static Value Add(Value a, Value b) { return a + b; }
+	static Value Sub(Value a, Value b) { return a - b; }
+	static Value Mul(Value a, Value b) { return a * b; }
+	static Value Div(Value a, Value b) { return a / b; }
+	static Value Sqrt(Value a) { return sqrt(a); }
+	static Value MulAdd(Value a, Value b, Value c) { return a * b + c; }
+	static Mask Less(Value a, Value b) { return a < b; }
+	static Value Select(Mask mask, Value a, Value b) { return mask ? a : b; }
+	static Mask All() { return true; }
+	static bool None(Mask mask) { return !mask; }
+	static Mask LoadAwake(const unsigned char* p) { return *p != 0; }
+
+	static void Store(double* p, Mask mask, Value value)
+	{
+		if (mask) *p = value;
+	}
+
+	static Value LoadStrided(const double* p, unsigned) { return *p; }
+
+	static void StoreStrided(double* p, unsigned, Mask mask, Value value)
+	{
+		if (mask) *p = value;
+	}
+};
+
+}
+
+// Returns a0 * b0 + a1 * b1 + a2 * b2, summed left to right
+template <class Lane>
+static inline typename Lane::Value Dot3(
+	typename Lane::Value a0, typename Lane::Value b0,
+	typename Lane::Value a1, typename Lane::Value b1,
+	typename Lane::Value a2, typename Lane::Value b2)
+{
+	return Lane::MulAdd(a2, b2, Lane::MulAdd(a1, b1, Lane::Mul(a0, b0)));
+}
+
+/**
+ * Normalises the orientation and rebuilds the transform matrix and
+ * world inverse inertia tensor of the bodies starting at b. Only
+ * lanes set in mask are written.
+ */
+template <class Lane>
+static inline void DerivedLanes(const IntegratorArrays& a, unsigned b, typename Lane::Mask mask,
+	typename Lane::Value px, typename Lane::Value py, typename Lane::Value pz,
+	typename Lane::Value r, typename Lane::Value i, typename Lane::Value j, typename Lane::Value k)
+{
+	typedef typename Lane::Value Value;
+
+	// Normalise, falling back to no rotation for a zero length quaternion
+	Value length = Lane::Add(Lane::Add(Lane::Add(Lane::Mul(r, r), Lane::Mul(i, i)), Lane::Mul(j, j)), Lane::Mul(k, k));
+	typename Lane::Mask degenerate = Lane::Less(length, Lane::Set1((double)0.001f));
+	Value scale = Lane::Div(Lane::Set1(1.0), Lane::Sqrt(length));
+
+	r = Lane::Select(degenerate, Lane::Set1(1.0), Lane::Mul(r, scale));
+	i = Lane::Select(degenerate, i, Lane::Mul(i, scale));
+	j = Lane::Select(degenerate, j, Lane::Mul(j, scale));
+	k = Lane::Select(degenerate, k, Lane::Mul(k, scale));
+
+	Lane::Store(a.orientationR + b, mask, r);
+	Lane::Store(a.orientationI + b, mask, i);
+	Lane::Store(a.orientationJ + b, mask, j);
+	Lane::Store(a.orientationK + b, mask, k);
+
+	// Calculate transform matrix for the body
+	Value one = Lane::Set1(1.0);
+	Value two = Lane::Set1(2.0);
+	Value i2 = Lane::Mul(two, i);
+	Value j2 = Lane::Mul(two, j);
+	Value k2 = Lane::Mul(two, k);
+	Value r2 = Lane::Mul(two, r);
+
+	Value m[12];
+	m[0] = Lane::Sub(Lane::Sub(one, Lane::Mul(j2, j)), Lane::Mul(k2, k));
+	m[1] = Lane::Sub(Lane::Mul(i2, j), Lane::Mul(r2, k));
+	m[2] = Lane::Add(Lane::Mul(i2, k), Lane::Mul(r2, j));
+	m[3] = px;
+	m[4] = Lane::Add(Lane::Mul(i2, j), Lane::Mul(r2, k));
+	m[5] = Lane::Sub(Lane::Sub(one, Lane::Mul(i2, i)), Lane::Mul(k2, k));
+	m[6] = Lane::Sub(Lane::Mul(j2, k), Lane::Mul(r2, i));
+	m[7] = py;
+	m[8] = Lane::Sub(Lane::Mul(i2, k), Lane::Mul(r2, j));
+	m[9] = Lane::Add(Lane::Mul(j2, k), Lane::Mul(r2, i));
+	m[10] = Lane::Sub(Lane::Sub(one, Lane::Mul(i2, i)), Lane::Mul(j2, j));
+	m[11] = pz;
+
+	double* transform = a.transformationMatrix + b * 12;
+	for (unsigned e = 0; e < 12; e++) Lane::StoreStrided(transform + e, 12, mask, m[e]);
+
+	// Calculate inertia tensor in world space, iitWorld = R * iitBody * R^T
+	const double* body = a.inverseInertiaTensor + b * 9;
+	Value t[9];
+	for (unsigned e = 0; e < 9; e++) t[e] = Lane::LoadStrided(body + e, 9);
+
+	Value rt[9];
+	for (unsigned row = 0; row < 3; row++)
+	{
+		for (unsigned column = 0; column < 3; column++)
+		{
+			rt[row * 3 + column] = Dot3<Lane>(
+				m[row * 4 + 0], t[column],
+				m[row * 4 + 1], t[column + 3],
+				m[row * 4 + 2], t[column + 6]);
+		}
+	}
+
+	double* world = a.inverseInertiaTensorWorld + b * 9;
+	for (unsigned row = 0; row < 3; row++)
+	{
+		for (unsigned column = 0; column < 3; column++)
+		{
+			Value value = Dot3<Lane>(
+				rt[row * 3 + 0], m[column * 4 + 0],
+				rt[row * 3 + 1], m[column * 4 + 1],
+				rt[row * 3 + 2], m[column * 4 + 2]);
+			Lane::StoreStrided(world + row * 3 + column, 9, mask, value);
+		}
+	}
+}
+
+/**
+ * Integrates the bodies starting at b by the given duration and
+ * rebuilds their derived data. Bodies that are asleep are left
+ * untouched.
+ */
+template <class Lane>
+static inline void IntegrateLanes(const IntegratorArrays& a, unsigned b, typename Lane::Value duration)
+{
+	typedef typename Lane::Value Value;
+
+	typename Lane::Mask awake = Lane::LoadAwake(a.isAwake + b);
+	if (Lane::None(awake)) return;
+
+	// Calculate linear acceleration from force inputs
+	Value inverseMass = Lane::Load(a.inverseMass + b);
+	Value ax = Lane::MulAdd(Lane::Load(a.forceAccumX + b), inverseMass, Lane::Load(a.accelerationX + b));
+	Value ay = Lane::MulAdd(Lane::Load(a.forceAccumY + b), inverseMass, Lane::Load(a.accelerationY + b));
+	Value az = Lane::MulAdd(Lane::Load(a.forceAccumZ + b), inverseMass, Lane::Load(a.accelerationZ + b));
+	Lane::Store(a.lastFrameAccelerationX + b, awake, ax);
+	Lane::Store(a.lastFrameAccelerationY + b, awake, ay);
+	Lane::Store(a.lastFrameAccelerationZ + b, awake, az);
+
+	// Calculate angular acceleration from torque inputs
+	const double* iitWorld = a.inverseInertiaTensorWorld + b * 9;
+	Value tx = Lane::Load(a.torqueAccumX + b);
+	Value ty = Lane::Load(a.torqueAccumY + b);
+	Value tz = Lane::Load(a.torqueAccumZ + b);
+	Value aax = Dot3<Lane>(tx, Lane::LoadStrided(iitWorld + 0, 9), ty, Lane::LoadStrided(iitWorld + 1, 9), tz, Lane::LoadStrided(iitWorld + 2, 9));
+	Value aay = Dot3<Lane>(tx, Lane::LoadStrided(iitWorld + 3, 9), ty, Lane::LoadStrided(iitWorld + 4, 9), tz, Lane::LoadStrided(iitWorld + 5, 9));
+	Value aaz = Dot3<Lane>(tx, Lane::LoadStrided(iitWorld + 6, 9), ty, Lane::LoadStrided(iitWorld + 7, 9), tz, Lane::LoadStrided(iitWorld + 8, 9));
+
+	// Update velocities and impose drag, the damping factors are
+	// already raised to the power of the duration
+	Value linearDamping = Lane::Load(a.linearDampingFactor + b);
+	Value vx = Lane::Mul(Lane::MulAdd(ax, duration, Lane::Load(a.velocityX + b)), linearDamping);
+	Value vy = Lane::Mul(Lane::MulAdd(ay, duration, Lane::Load(a.velocityY + b)), linearDamping);
+	Value vz = Lane::Mul(Lane::MulAdd(az, duration, Lane::Load(a.velocityZ + b)), linearDamping);
+
+	Value angularDamping = Lane::Load(a.angularDampingFactor + b);
+	Value wx = Lane::Mul(Lane::MulAdd(aax, duration, Lane::Load(a.rotationX + b)), angularDamping);
+	Value wy = Lane::Mul(Lane::MulAdd(aay, duration, Lane::Load(a.rotationY + b)), angularDamping);
+	Value wz = Lane::Mul(Lane::MulAdd(aaz, duration, Lane::Load(a.rotationZ + b)), angularDamping);
+
+	Lane::Store(a.velocityX + b, awake, vx);
+	Lane::Store(a.velocityY + b, awake, vy);
+	Lane::Store(a.velocityZ + b, awake, vz);
+	Lane::Store(a.rotationX + b, awake, wx);
+	Lane::Store(a.rotationY + b, awake, wy);
+	Lane::Store(a.rotationZ + b, awake, wz);
+
+	// Update linear position
+	Value px = Lane::MulAdd(vx, duration, Lane::Load(a.positionX + b));
+	Value py = Lane::MulAdd(vy, duration, Lane::Load(a.positionY + b));
+	Value pz = Lane::MulAdd(vz, duration, Lane::Load(a.positionZ + b));
+	Lane::Store(a.positionX + b, awake, px);
+	Lane::Store(a.positionY + b, awake, py);
+	Lane::Store(a.positionZ + b, awake, pz);
+
+	// Update angular position, q += 0.5 * (0, w * duration) * q
+	Value r = Lane::Load(a.orientationR + b);
+	Value i = Lane::Load(a.orientationI + b);
+	Value j = Lane::Load(a.orientationJ + b);
+	Value k = Lane::Load(a.orientationK + b);
+
+	Value si = Lane::Mul(wx, duration);
+	Value sj = Lane::Mul(wy, duration);
+	Value sk = Lane::Mul(wz, duration);
+
+	Value dr = Lane::Sub(Lane::Sub(Lane::Sub(Lane::Set1(0.0), Lane::Mul(si, i)), Lane::Mul(sj, j)), Lane::Mul(sk, k));
+	Value di = Lane::Sub(Lane::Add(Lane::Mul(si, r), Lane::Mul(sj, k)), Lane::Mul(sk, j));
+	Value dj = Lane::Sub(Lane::Add(Lane::Mul(sj, r), Lane::Mul(sk, i)), Lane::Mul(si, k));
+	Value dk = Lane::Sub(Lane::Add(Lane::Mul(sk, r), Lane::Mul(si, j)), Lane::Mul(sj, i));
+
+	Value half = Lane::Set1(0.5);
+	r = Lane::Add(r, Lane::Mul(dr, half));
+	i = Lane::Add(i, Lane::Mul(di, half));
+	j = Lane::Add(j, Lane::Mul(dj, half));
+	k = Lane::Add(k, Lane::Mul(dk, half));
+
+	// Normalize orientation and update matrices with
+	// new position and orientation
+	DerivedLanes<Lane>(a, b, awake, px, py, pz, r, i, j, k);
+
+	// Clear accumulators
+	Value zero = Lane::Set1(0.0);
+	Lane::Store(a.forceAccumX + b, awake, zero);
+	Lane::Store(a.forceAccumY + b, awake, zero);
+	Lane::Store(a.forceAccumZ + b, awake, zero);
+	Lane::Store(a.torqueAccumX + b, awake, zero);
+	Lane::Store(a.torqueAccumY + b, awake, zero);
+	Lane::Store(a.torqueAccumZ + b, awake, zero);
+}
+
+// Integrates [begin, end) a register at a time, finishing with single bodies
+template <class Lane>
+static void IntegrateRange(const IntegratorArrays& a, unsigned begin, unsigned end, double duration)
+{
+	typename Lane::Value laneDuration = Lane::Set1(duration);
+
+	unsigned b = begin;
+	for (; b + Lane::width <= end; b += Lane::width) IntegrateLanes<Lane>(a, b, laneDuration);
+	for (; b < end; b++) IntegrateLanes<ScalarLane>(a, b, duration);
+}
+
+// Rebuilds the derived data of [begin, end) a register at a time
+template <class Lane>
+static void DerivedRange(const IntegratorArrays& a, unsigned begin, unsigned end)
+{
+	unsigned b = begin;
+	for (; b + Lane::width <= end; b += Lane::width)
+	{
+		DerivedLanes<Lane>(a, b, Lane::All(),
+			Lane::Load(a.positionX + b), Lane::Load(a.positionY + b), Lane::Load(a.positionZ + b),
+			Lane::Load(a.orientationR + b), Lane::Load(a.orientationI + b),
+			Lane::Load(a.orientationJ + b), Lane::Load(a.orientationK + b));
+	}
+
+	for (; b < end; b++)
+	{
+		DerivedLanes<ScalarLane>(a, b, true,
+			a.positionX[b], a.positionY[b], a.positionZ[b],
+			a.orientationR[b], a.orientationI[b], a.orientationJ[b], a.orientationK[b]);
+	}
+}
@@ -0,0 +1,75 @@
+#include "IntegratorLanes.h"
+
+#ifdef PARADOX_SIMD_X86
+
+#include <emmintrin.h>
+
+namespace
+{
+
+/**
+ * Two bodies at a time with SSE2, which every x86-64 processor has.
+ */
+struct SseLane
+{
+	static const unsigned width = 2;
+
+	typedef __m128d Value;
+	typedef __m128d Mask;
+
+	static Value Load(const double* p) { return _mm_loadu_pd(p); }
+	static Value Set1(double value) { return _mm_set1_pd(value); }
+	static Value Add(Value a, Value b) { return _mm_add_pd(a, b); }
+	static Value Sub(Value a, Value b) { return _mm_sub_pd(a, b); }
+	static Value Mul(Value a, Value b) { return _mm_mul_pd(a, b); }
+	static Value Div(Value a, Value b) { return _mm_div_pd(a, b); }
+	static Value Sqrt(Value a) { return _mm_sqrt_pd(a); }
+	static Value MulAdd(Value a, Value b, Value c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+	static Mask Less(Value a, Value b) { return _mm_cmplt_pd(a, b); }
+	static Mask All() { return _mm_castsi128_pd(_mm_set1_epi32(-1)); }
+	static bool None(Mask mask) { return _mm_movemask_pd(mask) == 0; }
+
+	static Value Select(Mask mask, Value a, Value b)
+	{
+		return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+	}
+
+	static Mask LoadAwake(const unsigned char* p)
+	{
+		return _mm_cmpneq_pd(_mm_set_pd(p[1], p[0]), _mm_setzero_pd());
+	}
+
+	static void Store(double* p, Mask mask, Value value)
+	{
+		_mm_storeu_pd(p, Select(mask, value, _mm_loadu_pd(p)));
+	}
+
+	static Value LoadStrided(const double* p, unsigned stride)
+	{
+		return _mm_set_pd(p[stride], p[0]);
+	}
+
+	static void StoreStrided(double* p, unsigned stride, Mask mask, Value value)
+	{
+		double lanes[2];
+		_mm_storeu_pd(lanes, value);
+
+		int bits = _mm_movemask_pd(mask);
+		if (bits & 1) p[0] = lanes[0];
+		if (bits & 2) p[stride] = lanes[1];
+	}
+};
+
+}
+
+void IntegrateBodiesSSE(const IntegratorArrays& arrays, unsigned begin, unsigned end, double duration)
+{
+	IntegrateRange<SseLane>(arrays, begin, end, duration);
+}
+
+void CalculateDerivedDataSSE(const IntegratorArrays& arrays, unsigned begin, unsigned end)
+{
+	DerivedRange<SseLane>(arrays, begin, end);
+}
+
+#endif
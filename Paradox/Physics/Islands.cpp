@@ -0,0 +1,126 @@
+#include "Islands.h"
+#include <algorithm>
+
+// Marks a node that has not been given an island yet
+static const unsigned noIsland = 0xffffffff;
+
+void ContactIslands::Reserve(unsigned maxContacts)
+{
+	// There can be no more islands than contacts
+	contactIsland.reserve(maxContacts);
+	islands.reserve(maxContacts);
+	nextSlot.reserve(maxContacts);
+	schedule.reserve(maxContacts);
+}
+
+unsigned ContactIslands::GetNode(const RigidBody* body, const BodyStore& store)
+{
+	if (body->GetStore() == &store) return body->GetStoreIndex();
+
+	unsigned foreign = 0;
+	while (foreign < foreignBodies.size() && foreignBodies[foreign] != body) foreign++;
+
+	if (foreign == foreignBodies.size())
+	{
+		foreignBodies.push_back(body);
+		parent.push_back((unsigned)parent.size());
+		rank.push_back(0);
+	}
+
+	return store.Size() + foreign;
+}
+
+unsigned ContactIslands::Find(unsigned node)
+{
+	// Path halving, every other node is pointed at its' grandparent
+	while (parent[node] != node)
+	{
+		parent[node] = parent[parent[node]];
+		node = parent[node];
+	}
+	return node;
+}
+
+void ContactIslands::Union(unsigned one, unsigned two)
+{
+	one = Find(one);
+	two = Find(two);
+	if (one == two) return;
+
+	if (rank[one] < rank[two]) std::swap(one, two);
+	parent[two] = one;
+	if (rank[one] == rank[two]) rank[one]++;
+}
+
+void ContactIslands::Build(const Contact* contacts, unsigned numContacts, const BodyStore& store, Contact* output)
+{
+	unsigned numBodies = store.Size();
+
+	// Every body starts in a set of its' own
+	parent.resize(numBodies);
+	rank.assign(numBodies, 0);
+	for (unsigned node = 0; node < numBodies; node++) parent[node] = node;
+	foreignBodies.clear();
+
+	// Join the bodies at either end of each contact, contacts with
+	// the world only touch one body
+	for (unsigned c = 0; c < numContacts; c++)
+	{
+		const Contact& contact = contacts[c];
+		if (contact.body[0] && contact.body[1])
+		{
+			Union(GetNode(contact.body[0], store), GetNode(contact.body[1], store));
+		}
+	}
+
+	// Number the islands in the order their first contact appears
+	nodeIsland.assign(parent.size(), noIsland);
+	contactIsland.resize(numContacts);
+	islands.clear();
+
+	for (unsigned c = 0; c < numContacts; c++)
+	{
+		// The resolver swaps contacts with no first body, so either
+		// body may be the one touching the world
+		const RigidBody* body = contacts[c].body[0] ? contacts[c].body[0] : contacts[c].body[1];
+		unsigned root = Find(GetNode(body, store));
+		if (nodeIsland[root] == noIsland)
+		{
+			nodeIsland[root] = (unsigned)islands.size();
+			ContactIsland island = { 0, 0 };
+			islands.push_back(island);
+		}
+
+		contactIsland[c] = nodeIsland[root];
+		islands[nodeIsland[root]].contactCount++;
+	}
+
+	// Lay the islands out one after the other, keeping each island's
+	// contacts in the order they were generated
+	unsigned first = 0;
+	nextSlot.resize(islands.size());
+	for (unsigned island = 0; island < islands.size(); island++)
+	{
+		islands[island].firstContact = first;
+		nextSlot[island] = first;
+		first += islands[island].contactCount;
+	}
+
+	for (unsigned c = 0; c < numContacts; c++)
+	{
+		output[nextSlot[contactIsland[c]]++] = contacts[c];
+	}
+
+	// Hand out the largest islands first, ties go to the lower island
+	schedule.resize(islands.size());
+	for (unsigned island = 0; island < islands.size(); island++) schedule[island] = island;
+
+	std::sort(schedule.begin(), schedule.end(), [this](unsigned one, unsigned two)
+	{
+		if (islands[one].contactCount != islands[two].contactCount)
+		{
+			return islands[one].contactCount > islands[two].contactCount;
+		}
+		return one < two;
+	});
+}
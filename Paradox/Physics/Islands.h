@@ -0,0 +1,81 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the island builder used by the world to split
+ * its contacts into groups that can be resolved independently.
+ */
+
+#include "contacts.h"
+#include <vector>
+
+/**
+ * A run of contacts that share bodies with each other, but with no
+ * contact outside the run.
+ */
+struct ContactIsland
+{
+	unsigned firstContact;
+	unsigned contactCount;
+};
+
+/**
+ * Partitions contacts into islands with a union-find over the bodies
+ * they touch. The result only depends on the order the contacts were
+ * generated in: islands are numbered by their first contact, and
+ * keep their contacts in generation order.
+ */
+class ContactIslands
+{
+public:
+	// Makes room for the given number of contacts up front
+	void Reserve(unsigned maxContacts);
+
+	/**
+	 * Sorts the contacts into islands, copying them island by island
+	 * into output, which must have room for numContacts contacts.
+	 * Bodies in the given store are looked up by index, any others
+	 * with a linear search as they are expected to be rare.
+	 */
+	void Build(const Contact* contacts, unsigned numContacts, const BodyStore& store, Contact* output);
+
+	unsigned GetIslandCount() const
+	{
+		return (unsigned)islands.size();
+	}
+
+	const ContactIsland& GetIsland(unsigned island) const
+	{
+		return islands[island];
+	}
+
+	/**
+	 * Returns the island to hand out in the given position, largest
+	 * first so that workers finish at about the same time.
+	 */
+	unsigned GetScheduledIsland(unsigned position) const
+	{
+		return schedule[position];
+	}
+
+private:
+	// Returns the union-find node of the given body
+	unsigned GetNode(const RigidBody* body, const BodyStore& store);
+
+	unsigned Find(unsigned node);
+	void Union(unsigned one, unsigned two);
+
+	std::vector<unsigned> parent;
+	std::vector<unsigned> rank;
+
+	// Bodies outside the store, their nodes follow the store's bodies
+	std::vector<const RigidBody*> foreignBodies;
+
+	std::vector<unsigned> nodeIsland;
+	std::vector<unsigned> contactIsland;
+	std::vector<unsigned> nextSlot;
+
+	std::vector<ContactIsland> islands;
+	std::vector<unsigned> schedule;
+};
@@ -1,7 +1,10 @@
 #include "Joints.h"
 
-unsigned Joint::addContact(Contact* contact, unsigned limit) const
+unsigned Joint::AddContact(Contact* contact, unsigned limit)
 {
+	// There is no room for the contact
+	if (limit == 0) return 0;
+
 	// Calculate the position of each connection point in world coordinates
 	Vector3 a_pos_world = body[0]->GetPointInWorldSpace(position[0]);
 	Vector3 b_pos_world = body[1]->GetPointInWorldSpace(position[1]);
@@ -22,6 +25,7 @@ unsigned Joint::addContact(Contact* contact, unsigned limit) const
 		contact->penetration = length - error;
 		contact->friction = 1.0f;
 		contact->restitution = 0;
+		contact->feature = 0;
 		return 1;
 	}
 
@@ -55,5 +55,5 @@ public:
 	 * Generates the contacts required to restore the joint if it has
 	 * been violated.
 	 */
-	unsigned addContact(Contact* contact, unsigned limit) const;
+	virtual unsigned AddContact(Contact* contact, unsigned limit);
 };
\ No newline at end of file
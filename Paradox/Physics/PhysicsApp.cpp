@@ -3,23 +3,21 @@
 
 RigidBodyApplication::RigidBodyApplication()
 	:
+	contacts(maxContacts),
+	resolver(maxContacts * 8),
 	theta(0.0f),
 	phi(15.0f),
-	resolver(maxContacts * 8),
 	renderDebugInfo(false),
 	pauseSimulation(true),
 	autoPauseSimulation(false)
 {
-	cData.contactArray = contacts;
+	cData.contactArray = contacts.GetContacts();
 }
 
 void RigidBodyApplication::Update()
 {
 	// Find the duration of the last frame in seconds
-//	float duration = (float)TimingData::get().lastFrameDuration * 0.001f;
-	float duration = 0.03f;
-	if (duration < 0.0f) return;
-	else if (duration > 0.05f) duration = 0.05f;
+	double frameDuration = TimingData::get().lastFrameDuration * 0.001;
 
 	// Exit immediately if we aren't running the simulation
 	if (pauseSimulation)
@@ -32,16 +30,33 @@ void RigidBodyApplication::Update()
 		pauseSimulation = true;
 		autoPauseSimulation = false;
 	}
-/**
- * 
-	// Update the objects
-	updateObjects(duration);
 
-	// Perform the contact generation
-	generateContacts();
+	// Run the fixed steps the frame's real time calls for
+	unsigned steps = physicsClock.Advance(frameDuration);
+	double duration = physicsClock.GetStepDuration();
+	for (unsigned step = 0; step < steps; step++)
+	{
+		// Update the objects
+		updateObjects(duration);
+
+		// Perform the contact generation, again with more room if the
+		// contacts filled it so none of them are lost
+		generateContacts();
+		while (!cData.HasMoreContacts() && contacts.Grow()) generateContacts();
+
+		// Resolve the detected contacts
+		resolver.ResolveContacts(cData.contactArray, cData.contactCount, duration);
+	}
+}
 
-	// Resolve the detected contacts
-	resolver.ResolveContacts(cData.contactArray, cData.contactCount, duration);
- */
+void RigidBodyApplication::generateContacts()
+{
+	// Start with no contacts, applications with objects to collide
+	// add theirs after this
+	cData.contactArray = contacts.GetContacts();
+	cData.Reset(contacts.GetCapacity());
 }
 
+void RigidBodyApplication::updateObjects(double /*duration*/)
+{
+}
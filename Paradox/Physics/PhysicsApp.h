@@ -1,19 +1,21 @@
 #pragma once
 
 #include "contacts.h"
+#include "ContactArena.h"
 #include "CollideFine.h"
 #include "CollideCoarse.h"
+#include "FixedTimestep.h"
 
 class RigidBodyApplication
 {
 
 protected:
 
-	// Holds the maximum number of contacts
+	// Holds the number of contacts there is room for to start with
 	const static unsigned maxContacts = 256;
 
-	// Holds the array of contacts
-	Contact contacts[maxContacts];
+	// Holds the contacts, given more room when they do not fit
+	ContactArena contacts;
 
 	// Holds the collision data structure for collision detection
 	CollisionData cData;
@@ -21,6 +23,9 @@ protected:
 	// Holds the contact resolver
 	ContactResolver resolver;
 
+	// Turns the real frame time into fixed physics steps
+	FixedTimestep physicsClock;
+
 	// Holds the camera angle
 	float theta;
 
@@ -41,10 +46,10 @@ protected:
 	bool autoPauseSimulation;
 
 	// Processes the contact generation code
-//	virtual void generateContacts() = 0;
+	virtual void generateContacts();
 
 	// Processes the objects in the simulation forward in time
-//	virtual void updateObjects(double duration) = 0;
+	virtual void updateObjects(double duration);
 
 	// Finishes drawing the frame, adding debug information
 	// as needed
@@ -0,0 +1,308 @@
+#include "PooledBVH.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+// Returns the nearest float at or below the given value
+static float RoundDown(double value)
+{
+	float rounded = (float)value;
+	if (rounded > value) rounded = nextafterf(rounded, -INFINITY);
+	return rounded;
+}
+
+// Returns the nearest float at or above the given value
+static float RoundUp(double value)
+{
+	float rounded = (float)value;
+	if (rounded < value) rounded = nextafterf(rounded, INFINITY);
+	return rounded;
+}
+
+PooledBVH::PooledBVH()
+	:
+	freeNodes(nullIndex),
+	freeLeaves(nullIndex),
+	leafCount(0),
+	root(nullIndex)
+{
+}
+
+PooledBVH::Bounds PooledBVH::MakeBounds(const BoundingBoxVolume& volume)
+{
+	Bounds bounds;
+	for (unsigned axis = 0; axis < 3; axis++)
+	{
+		bounds.min[axis] = RoundDown(volume.min[axis]);
+		bounds.max[axis] = RoundUp(volume.max[axis]);
+	}
+	return bounds;
+}
+
+PooledBVH::Bounds PooledBVH::Merge(const Bounds& one, const Bounds& two)
+{
+	Bounds bounds;
+	for (unsigned axis = 0; axis < 3; axis++)
+	{
+		bounds.min[axis] = std::min(one.min[axis], two.min[axis]);
+		bounds.max[axis] = std::max(one.max[axis], two.max[axis]);
+	}
+	return bounds;
+}
+
+unsigned PooledBVH::AllocateNode()
+{
+	if (freeNodes == nullIndex)
+	{
+		nodes.push_back(PooledBVHNode());
+		return (unsigned)nodes.size() - 1;
+	}
+
+	unsigned node = freeNodes;
+	freeNodes = nodes[node].parent;
+	return node;
+}
+
+unsigned PooledBVH::AllocateLeaf()
+{
+	if (freeLeaves == nullIndex)
+	{
+		leaves.push_back(PooledBVHLeaf());
+		return (unsigned)leaves.size() - 1;
+	}
+
+	unsigned leaf = freeLeaves;
+	freeLeaves = leaves[leaf].parent;
+	return leaf;
+}
+
+void PooledBVH::Clear()
+{
+	nodes.clear();
+	leaves.clear();
+	freeNodes = freeLeaves = nullIndex;
+	leafCount = 0;
+	root = nullIndex;
+}
+
+void PooledBVH::SetChild(unsigned node, unsigned slot, unsigned child, const Bounds& bounds)
+{
+	nodes[node].children[slot] = child;
+	SetChildBounds(nodes[node], slot, bounds);
+
+	if (child & leafBit)
+	{
+		leaves[child & ~leafBit].parent = node;
+		leaves[child & ~leafBit].slot = slot;
+	}
+	else
+	{
+		nodes[child].parent = node;
+		nodes[child].slot = slot;
+	}
+}
+
+void PooledBVH::Refit(unsigned node)
+{
+	while (node != nullIndex)
+	{
+		const PooledBVHNode& current = nodes[node];
+		Bounds bounds = Merge(GetChildBounds(current, 0), GetChildBounds(current, 1));
+
+		if (current.parent == nullIndex)
+		{
+			rootBounds = bounds;
+			return;
+		}
+
+		// Nothing further up changes once a box stays the same
+		PooledBVHNode& parent = nodes[current.parent];
+		Bounds previous = GetChildBounds(parent, current.slot);
+		if (!memcmp(&previous, &bounds, sizeof(Bounds))) return;
+
+		SetChildBounds(parent, current.slot, bounds);
+		node = current.parent;
+	}
+}
+
+unsigned PooledBVH::Insert(RigidBody* body, const BoundingBoxVolume& volume)
+{
+	unsigned leaf = AllocateLeaf();
+	leaves[leaf].volume = volume;
+	leaves[leaf].body = body;
+	leaves[leaf].parent = nullIndex;
+	leaves[leaf].slot = 0;
+	leafCount++;
+
+	Bounds bounds = MakeBounds(volume);
+	if (root == nullIndex)
+	{
+		root = leaf | leafBit;
+		rootBounds = bounds;
+		return leaf;
+	}
+
+	// Walk down to a leaf, giving the body to whichever child would
+	// grow the least to take it, as BVHNode::Insert does
+	unsigned sibling = root;
+	Bounds siblingBounds = rootBounds;
+	unsigned parent = nullIndex;
+	unsigned slot = 0;
+	while (!(sibling & leafBit))
+	{
+		const PooledBVHNode& node = nodes[sibling];
+		Bounds childBounds[2] = { GetChildBounds(node, 0), GetChildBounds(node, 1) };
+
+		float growth[2];
+		for (unsigned c = 0; c < 2; c++)
+		{
+			growth[c] = Merge(childBounds[c], bounds).GetSurfaceArea() - childBounds[c].GetSurfaceArea();
+		}
+
+		parent = sibling;
+		slot = growth[0] < growth[1] ? 0 : 1;
+		sibling = node.children[slot];
+		siblingBounds = childBounds[slot];
+	}
+
+	// A new branch takes the leaf's place, holding it and the body
+	unsigned branch = AllocateNode();
+	SetChild(branch, 0, sibling, siblingBounds);
+	SetChild(branch, 1, leaf | leafBit, bounds);
+
+	Bounds branchBounds = Merge(siblingBounds, bounds);
+	if (parent == nullIndex)
+	{
+		nodes[branch].parent = nullIndex;
+		nodes[branch].slot = 0;
+		root = branch;
+		rootBounds = branchBounds;
+	}
+	else
+	{
+		SetChild(parent, slot, branch, branchBounds);
+		Refit(parent);
+	}
+
+	return leaf;
+}
+
+void PooledBVH::Remove(unsigned leaf)
+{
+	unsigned parent = leaves[leaf].parent;
+	unsigned slot = leaves[leaf].slot;
+
+	leaves[leaf].body = NULL;
+	leaves[leaf].parent = freeLeaves;
+	freeLeaves = leaf;
+	leafCount--;
+
+	if (parent == nullIndex)
+	{
+		root = nullIndex;
+		return;
+	}
+
+	// The sibling takes the parent's place
+	const PooledBVHNode& node = nodes[parent];
+	unsigned sibling = node.children[1 - slot];
+	Bounds siblingBounds = GetChildBounds(node, 1 - slot);
+	unsigned grandParent = node.parent;
+	unsigned parentSlot = node.slot;
+
+	nodes[parent].parent = freeNodes;
+	freeNodes = parent;
+
+	if (grandParent == nullIndex)
+	{
+		root = sibling;
+		rootBounds = siblingBounds;
+		if (sibling & leafBit) leaves[sibling & ~leafBit].parent = nullIndex;
+		else nodes[sibling].parent = nullIndex;
+		return;
+	}
+
+	SetChild(grandParent, parentSlot, sibling, siblingBounds);
+	Refit(grandParent);
+}
+
+unsigned PooledBVH::GetPotentialContacts(std::vector<PotentialContact>& contacts) const
+{
+	if (root == nullIndex || (root & leafBit)) return 0;
+
+	size_t first = contacts.size();
+
+	SearchPair top = { root, root, rootBounds, rootBounds };
+	pairStack.clear();
+	pairStack.push_back(top);
+	while (!pairStack.empty())
+	{
+		SearchPair pair = pairStack.back();
+		pairStack.pop_back();
+
+		if (pair.one == pair.two)
+		{
+			// The pairs across the two children, then within each
+			const PooledBVHNode& node = nodes[pair.one];
+			Bounds childBounds[2] = { GetChildBounds(node, 0), GetChildBounds(node, 1) };
+
+			if (childBounds[0].Overlaps(childBounds[1]))
+			{
+				SearchPair across = { node.children[0], node.children[1], childBounds[0], childBounds[1] };
+				pairStack.push_back(across);
+			}
+			for (unsigned slot = 2; slot-- > 0;)
+			{
+				if (node.children[slot] & leafBit) continue;
+				SearchPair within = { node.children[slot], node.children[slot], childBounds[slot], childBounds[slot] };
+				pairStack.push_back(within);
+			}
+			continue;
+		}
+
+		bool oneLeaf = (pair.one & leafBit) != 0;
+		bool twoLeaf = (pair.two & leafBit) != 0;
+
+		if (oneLeaf && twoLeaf)
+		{
+			const PooledBVHLeaf& one = leaves[pair.one & ~leafBit];
+			const PooledBVHLeaf& two = leaves[pair.two & ~leafBit];
+			if (!one.volume.Overlaps(&two.volume)) continue;
+
+			PotentialContact contact;
+			contact.body[0] = one.body;
+			contact.body[1] = two.body;
+			contacts.push_back(contact);
+			continue;
+		}
+
+		// Descend into the larger of the two, keeping only the children
+		// whose boxes overlap the other side
+		if (twoLeaf || (!oneLeaf && pair.oneBounds.GetSurfaceArea() >= pair.twoBounds.GetSurfaceArea()))
+		{
+			const PooledBVHNode& node = nodes[pair.one];
+			for (unsigned slot = 2; slot-- > 0;)
+			{
+				Bounds childBounds = GetChildBounds(node, slot);
+				if (!childBounds.Overlaps(pair.twoBounds)) continue;
+
+				SearchPair next = { node.children[slot], pair.two, childBounds, pair.twoBounds };
+				pairStack.push_back(next);
+			}
+		}
+		else
+		{
+			const PooledBVHNode& node = nodes[pair.two];
+			for (unsigned slot = 2; slot-- > 0;)
+			{
+				Bounds childBounds = GetChildBounds(node, slot);
+				if (!childBounds.Overlaps(pair.oneBounds)) continue;
+
+				SearchPair next = { pair.one, node.children[slot], pair.oneBounds, childBounds };
+				pairStack.push_back(next);
+			}
+		}
+	}
+
+	return (unsigned)(contacts.size() - first);
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains a bounding volume hierarchy whose nodes live in
+ * a pool and refer to each other by index rather than by pointer.
+ */
+
+#include "CollideCoarse.h"
+#include <vector>
+
+/**
+ * A branch of the pooled hierarchy. The boxes of both children are
+ * held here rather than in the children, so deciding where to go next
+ * only needs this node. Boxes are rounded outwards to floats to fit
+ * the whole node in 64 bytes, one cache line.
+ */
+struct alignas(64) PooledBVHNode
+{
+	float childMin[2][3];
+	float childMax[2][3];
+
+	// Each child is a branch, or a leaf when PooledBVH::leafBit is set
+	unsigned children[2];
+
+	// The branch above, or nullIndex at the root. Free branches are
+	// chained into a list through it
+	unsigned parent;
+
+	// Which of the parent's children this branch is
+	unsigned slot;
+};
+
+/**
+ * A leaf of the pooled hierarchy, holding one body and its' exact box.
+ */
+struct PooledBVHLeaf
+{
+	BoundingBoxVolume volume;
+	RigidBody* body;
+
+	// The branch above, or nullIndex if the leaf is the root. Free
+	// leaves are chained into a list through it
+	unsigned parent;
+
+	// Which of the parent's children this leaf is
+	unsigned slot;
+};
+
+/**
+ * A bounding volume hierarchy of axis aligned boxes built the same
+ * way as BVHNode, by putting each new body on the side that grows
+ * least, but with no heap allocation per node.
+ *
+ * Branches and leaves each live in a single array and refer to each
+ * other by 32-bit index. Removed branches and leaves go on free lists
+ * and are reused by the next insertion, so once the arrays have grown
+ * to fit, inserting and removing bodies does not touch the allocator.
+ */
+class PooledBVH
+{
+public:
+	static const unsigned nullIndex = 0xffffffff;
+
+	// Marks a child index as referring to a leaf
+	static const unsigned leafBit = 0x80000000;
+
+	PooledBVH();
+
+	// Adds a body with the given box, returning its' leaf
+	unsigned Insert(RigidBody* body, const BoundingBoxVolume& volume);
+
+	// Removes the body with the given leaf, its' sibling takes the
+	// place of their parent
+	void Remove(unsigned leaf);
+
+	// Removes every body
+	void Clear();
+
+	const BoundingBoxVolume& GetVolume(unsigned leaf) const
+	{
+		return leaves[leaf].volume;
+	}
+
+	RigidBody* GetBody(unsigned leaf) const
+	{
+		return leaves[leaf].body;
+	}
+
+	unsigned GetLeafCount() const
+	{
+		return leafCount;
+	}
+
+	/**
+	 * Calls the given function with the body of every leaf whose box
+	 * overlaps the given one.
+	 */
+	template <class Callback>
+	void Query(const BoundingBoxVolume& volume, Callback callback) const;
+
+	/**
+	 * Finds every pair of bodies whose boxes overlap and appends them
+	 * to the given list. Returns the number found.
+	 */
+	unsigned GetPotentialContacts(std::vector<PotentialContact>& contacts) const;
+
+private:
+	// A box rounded outwards to floats, as branches keep them
+	struct Bounds
+	{
+		float min[3];
+		float max[3];
+
+		bool Overlaps(const Bounds& other) const
+		{
+			return min[0] <= other.max[0] && other.min[0] <= max[0] &&
+				   min[1] <= other.max[1] && other.min[1] <= max[1] &&
+				   min[2] <= other.max[2] && other.min[2] <= max[2];
+		}
+
+		float GetSurfaceArea() const
+		{
+			float x = max[0] - min[0], y = max[1] - min[1], z = max[2] - min[2];
+			return 2.0f * (x * y + y * z + z * x);
+		}
+	};
+
+	static Bounds MakeBounds(const BoundingBoxVolume& volume);
+	static Bounds Merge(const Bounds& one, const Bounds& two);
+
+	static Bounds GetChildBounds(const PooledBVHNode& node, unsigned slot)
+	{
+		Bounds bounds;
+		for (unsigned axis = 0; axis < 3; axis++)
+		{
+			bounds.min[axis] = node.childMin[slot][axis];
+			bounds.max[axis] = node.childMax[slot][axis];
+		}
+		return bounds;
+	}
+
+	static void SetChildBounds(PooledBVHNode& node, unsigned slot, const Bounds& bounds)
+	{
+		for (unsigned axis = 0; axis < 3; axis++)
+		{
+			node.childMin[slot][axis] = bounds.min[axis];
+			node.childMax[slot][axis] = bounds.max[axis];
+		}
+	}
+
+	// Puts the given child, branch or leaf, in the given slot of a branch
+	void SetChild(unsigned node, unsigned slot, unsigned child, const Bounds& bounds);
+
+	// Walks up from the given branch, making each parent's box of it
+	// enclose its' two children again
+	void Refit(unsigned node);
+
+	unsigned AllocateNode();
+	unsigned AllocateLeaf();
+
+	std::vector<PooledBVHNode> nodes;
+	std::vector<PooledBVHLeaf> leaves;
+	unsigned freeNodes;
+	unsigned freeLeaves;
+	unsigned leafCount;
+
+	// The top of the hierarchy, a branch or a leaf, and its' box
+	unsigned root;
+	Bounds rootBounds;
+
+	// A pair of children still to be searched for contacts, with their
+	// boxes. A pair of the same branch stands for the pairs within it
+	struct SearchPair
+	{
+		unsigned one;
+		unsigned two;
+		Bounds oneBounds;
+		Bounds twoBounds;
+	};
+
+	mutable std::vector<SearchPair> pairStack;
+	mutable std::vector<unsigned> stack;
+};
+
+template <class Callback>
+void PooledBVH::Query(const BoundingBoxVolume& volume, Callback callback) const
+{
+	if (root == nullIndex) return;
+
+	Bounds bounds = MakeBounds(volume);
+	if (!rootBounds.Overlaps(bounds)) return;
+
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		unsigned index = stack.back();
+		stack.pop_back();
+
+		if (index & leafBit)
+		{
+			const PooledBVHLeaf& leaf = leaves[index & ~leafBit];
+			if (leaf.volume.Overlaps(&volume)) callback(leaf.body);
+			continue;
+		}
+
+		// Only children whose boxes overlap are visited at all
+		const PooledBVHNode& node = nodes[index];
+		for (unsigned slot = 2; slot-- > 0;)
+		{
+			if (GetChildBounds(node, slot).Overlaps(bounds)) stack.push_back(node.children[slot]);
+		}
+	}
+}
@@ -4,7 +4,7 @@
 
 Random::Random()
 {
-	seed(0);
+	seed((unsigned)clock());
 }
 
 Random::Random(unsigned seed)
@@ -14,10 +14,6 @@ Random::Random(unsigned seed)
 
 void Random::seed(unsigned s)
 {
-	if (s == 0) {
-		s = (unsigned)clock();
-	}
-
 	// Fill the buffer with some basic random numbers
 	for (unsigned i = 0; i < 17; i++)
 	{
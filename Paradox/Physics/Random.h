@@ -33,7 +33,8 @@ public:
     Random(unsigned seed);
 
     /**
-     * Sets the seed value for the random stream.
+     * Sets the seed value for the random stream. Every seed, zero
+     * included, gives the same stream each time it is used.
      */
     void seed(unsigned seed);
 
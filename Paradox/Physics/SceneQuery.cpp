@@ -0,0 +1,851 @@
+#include "SceneQuery.h"
+#include "Integrator.h" // For PARADOX_SIMD_X86
+#include <algorithm>
+#include <math.h>
+
+#ifdef PARADOX_SIMD_X86
+#include <emmintrin.h>
+#endif
+
+const unsigned SceneQuery::nullShape;
+
+// Rays and sweeps go down the tree this many at a time
+static const unsigned packetSize = 4;
+
+// Direction components are kept at least this large, so that their
+// inverses stay finite and boxes are never tested with 0 * infinity
+static const double minDirection = 1e-200;
+
+// Below this length a box sweep's direction is taken to be parallel
+// to the box's face along that axis
+static const double parallelEpsilon = 1e-12;
+
+static double SafeInverse(double value)
+{
+	if (fabs(value) < minDirection) value = value < 0 ? -minDirection : minDirection;
+	return 1.0 / value;
+}
+
+// Returns the point of the box with the given half-sizes, centred on
+// the origin, that is closest to the given point
+static Vector3 ClampToBox(const Vector3& point, const Vector3& halfSize)
+{
+	Vector3 clamped;
+	for (unsigned axis = 0; axis < 3; axis++)
+	{
+		clamped[axis] = std::max(-halfSize[axis], std::min(halfSize[axis], point[axis]));
+	}
+	return clamped;
+}
+
+/**
+ * Moves a point along a unit direction until it meets a sphere, no
+ * further than the limit. Points that start inside meet it at once.
+ */
+static bool SweepPointSphere(const Vector3& origin, const Vector3& direction, double limit,
+	const Vector3& centre, double radius, double* distance)
+{
+	Vector3 offset = origin - centre;
+	double along = offset * direction;
+	double outside = offset * offset - radius * radius;
+	if (outside <= 0)
+	{
+		*distance = 0;
+		return true;
+	}
+
+	// Moving away, or passing the sphere by
+	if (along > 0) return false;
+	double discriminant = along * along - outside;
+	if (discriminant < 0) return false;
+
+	double t = -along - sqrt(discriminant);
+	if (t > limit) return false;
+
+	*distance = std::max(t, 0.0);
+	return true;
+}
+
+/**
+ * Moves a point from outside a capsule along a unit direction until
+ * it meets the capsule, no further than the limit.
+ */
+static bool SweepPointCapsule(const Vector3& origin, const Vector3& direction, double limit,
+	const Vector3& start, const Vector3& end, double radius, double* distance)
+{
+	bool found = false;
+	double t;
+
+	// The rounded ends
+	if (SweepPointSphere(origin, direction, limit, start, radius, &t))
+	{
+		limit = t;
+		found = true;
+	}
+	if (SweepPointSphere(origin, direction, limit, end, radius, &t))
+	{
+		limit = t;
+		found = true;
+	}
+
+	// The side, with everything along the axis taken out
+	Vector3 axis = end - start;
+	double length = axis.magnitude();
+	axis *= 1.0 / length;
+
+	Vector3 offset = origin - start;
+	Vector3 across = direction - axis * (axis * direction);
+	Vector3 apart = offset - axis * (axis * offset);
+
+	double a = across * across;
+	if (a > parallelEpsilon)
+	{
+		double b = apart * across;
+		double c = apart * apart - radius * radius;
+		double discriminant = b * b - a * c;
+		if (discriminant >= 0)
+		{
+			t = (-b - sqrt(discriminant)) / a;
+			double along = axis * (offset + direction * t);
+			if (t >= 0 && t <= limit && along >= 0 && along <= length)
+			{
+				limit = t;
+				found = true;
+			}
+		}
+	}
+
+	*distance = limit;
+	return found;
+}
+
+/**
+ * Sweeps a sphere of the given radius against a box with the given
+ * half-sizes centred on the origin, all in the box's space. This is
+ * a ray against the box grown by the radius with rounded edges and
+ * corners: the ray is cast at the grown box, and where it enters past
+ * more than one face of the real box, at the edge or corner capsules
+ * there instead. Fills in the local point and normal of the hit.
+ */
+static bool SweepSphereBox(const Vector3& origin, const Vector3& direction, double radius, double limit,
+	const Vector3& halfSize, double* distance, Vector3* point, Vector3* normal)
+{
+	Vector3 closest = ClampToBox(origin, halfSize);
+	if ((origin - closest).squareMagnitude() <= radius * radius)
+	{
+		*distance = 0;
+		*point = origin;
+		*normal = direction * -1;
+		return true;
+	}
+
+	double nearT = 0;
+	double farT = limit;
+	unsigned nearAxis = 3;
+	for (unsigned axis = 0; axis < 3; axis++)
+	{
+		double grown = halfSize[axis] + radius;
+		if (fabs(direction[axis]) < parallelEpsilon)
+		{
+			if (fabs(origin[axis]) > grown) return false;
+			continue;
+		}
+
+		double inverse = 1.0 / direction[axis];
+		double t1 = (-grown - origin[axis]) * inverse;
+		double t2 = (grown - origin[axis]) * inverse;
+		if (t1 > t2) std::swap(t1, t2);
+
+		if (t1 > nearT)
+		{
+			nearT = t1;
+			nearAxis = axis;
+		}
+		farT = std::min(farT, t2);
+		if (nearT > farT) return false;
+	}
+
+	// Which faces of the real box the centre is past where it enters
+	Vector3 centre = origin + direction * nearT;
+	unsigned pastFaces = 0;
+	for (unsigned axis = 0; axis < 3; axis++)
+	{
+		if (fabs(centre[axis]) > halfSize[axis]) pastFaces++;
+	}
+
+	if (nearAxis < 3 && (radius == 0 || pastFaces <= 1))
+	{
+		*distance = nearT;
+		*normal = Vector3();
+		(*normal)[nearAxis] = direction[nearAxis] < 0 ? 1 : -1;
+		*point = ClampToBox(centre, halfSize);
+		return true;
+	}
+
+	// The corner nearest the entry point, and the edges leaving it
+	// along the axes the entry point is past the box on
+	Vector3 corner;
+	for (unsigned axis = 0; axis < 3; axis++)
+	{
+		corner[axis] = centre[axis] < 0 ? -halfSize[axis] : halfSize[axis];
+	}
+
+	bool found = false;
+	double t = limit;
+	for (unsigned axis = 0; axis < 3; axis++)
+	{
+		// A corner is met through its' three edges, an edge only
+		// through itself
+		bool edgeAlong = pastFaces == 3 || fabs(centre[axis]) <= halfSize[axis];
+		if (!edgeAlong) continue;
+
+		Vector3 start = corner;
+		Vector3 end = corner;
+		start[axis] = -halfSize[axis];
+		end[axis] = halfSize[axis];
+
+		double edgeT;
+		if (SweepPointCapsule(origin, direction, t, start, end, radius, &edgeT))
+		{
+			t = edgeT;
+			found = true;
+		}
+	}
+	if (!found) return false;
+
+	centre = origin + direction * t;
+	*distance = t;
+	*point = ClampToBox(centre, halfSize);
+	*normal = (centre - *point).unit();
+	return true;
+}
+
+// Walks the tree, calling the test with the proxy of every leaf whose
+// box overlaps the given one
+template <class Test>
+static void QueryTree(const DynamicAABBTree& tree, const BoundingBoxVolume& volume,
+	std::vector<unsigned>& stack, Test test)
+{
+	unsigned root = tree.GetRoot();
+	if (root == DynamicAABBTree::nullNode) return;
+
+	const std::vector<DynamicTreeNode>& nodes = tree.GetNodes();
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		unsigned index = stack.back();
+		stack.pop_back();
+
+		const DynamicTreeNode& node = nodes[index];
+		if (!node.volume.Overlaps(&volume)) continue;
+
+		if (node.IsLeaf())
+		{
+			test(index);
+		}
+		else
+		{
+			stack.push_back(node.children[1]);
+			stack.push_back(node.children[0]);
+		}
+	}
+}
+
+SceneQuery::SceneQuery(unsigned queriesPerItem)
+	:
+	queriesPerItem((std::max(queriesPerItem, 1u) + packetSize - 1) / packetSize * packetSize),
+	freeShapes(nullShape),
+	shapeCount(0)
+{
+	task.scene = this;
+}
+
+unsigned SceneQuery::AllocateShape(QueryShapeType type)
+{
+	unsigned shape;
+	if (freeShapes == nullShape)
+	{
+		shape = (unsigned)shapes.size();
+		shapes.push_back(Shape());
+	}
+	else
+	{
+		shape = freeShapes;
+		freeShapes = shapes[shape].freeNext;
+	}
+
+	Shape& entry = shapes[shape];
+	entry.type = type;
+	entry.primitive = NULL;
+	entry.plane = NULL;
+	entry.proxy = DynamicAABBTree::nullNode;
+	entry.freeNext = nullShape;
+	shapeCount++;
+	return shape;
+}
+
+unsigned SceneQuery::AddSphere(CollisionSphere* sphere)
+{
+	unsigned shape = AllocateShape(QueryShapeType::Sphere);
+	shapes[shape].primitive = sphere;
+	RefreshShape(shape);
+	return shape;
+}
+
+unsigned SceneQuery::AddBox(CollisionBox* box)
+{
+	unsigned shape = AllocateShape(QueryShapeType::Box);
+	shapes[shape].primitive = box;
+	RefreshShape(shape);
+	return shape;
+}
+
+unsigned SceneQuery::AddPlane(const CollisionPlane* plane)
+{
+	unsigned shape = AllocateShape(QueryShapeType::Plane);
+	shapes[shape].plane = plane;
+
+	planes.insert(std::lower_bound(planes.begin(), planes.end(), shape), shape);
+	return shape;
+}
+
+void SceneQuery::RemoveShape(unsigned shape)
+{
+	Shape& entry = shapes[shape];
+	if (entry.type == QueryShapeType::Plane)
+	{
+		planes.erase(std::lower_bound(planes.begin(), planes.end(), shape));
+	}
+	else if (entry.proxy != DynamicAABBTree::nullNode)
+	{
+		tree.DestroyProxy(entry.proxy);
+	}
+
+	entry.primitive = NULL;
+	entry.plane = NULL;
+	entry.proxy = DynamicAABBTree::nullNode;
+	entry.freeNext = freeShapes;
+	freeShapes = shape;
+	shapeCount--;
+}
+
+void SceneQuery::Clear()
+{
+	for (unsigned shape = 0; shape < shapes.size(); shape++)
+	{
+		if (shapes[shape].proxy != DynamicAABBTree::nullNode) tree.DestroyProxy(shapes[shape].proxy);
+	}
+	shapes.clear();
+	planes.clear();
+	freeShapes = nullShape;
+	shapeCount = 0;
+}
+
+void SceneQuery::RefreshShape(unsigned shape)
+{
+	Shape& entry = shapes[shape];
+	entry.primitive->CalculateInternals();
+
+	const Matrix4& transform = entry.primitive->GetTransform();
+	Vector3 centre = transform.getAxisVector(3);
+	Vector3 extent;
+	if (entry.type == QueryShapeType::Sphere)
+	{
+		double radius = static_cast<CollisionSphere*>(entry.primitive)->radius;
+		extent = Vector3(radius, radius, radius);
+	}
+	else
+	{
+		// The reach of the box along each world axis
+		const Vector3& halfSize = static_cast<CollisionBox*>(entry.primitive)->halfSize;
+		for (unsigned axis = 0; axis < 3; axis++)
+		{
+			extent[axis] = fabs(transform.data[axis * 4]) * halfSize.x +
+				fabs(transform.data[axis * 4 + 1]) * halfSize.y +
+				fabs(transform.data[axis * 4 + 2]) * halfSize.z;
+		}
+	}
+
+	BoundingBoxVolume volume(centre - extent, centre + extent);
+	if (entry.proxy == DynamicAABBTree::nullNode)
+	{
+		entry.proxy = tree.CreateProxy(volume, entry.primitive->body);
+		if (proxyShapes.size() <= entry.proxy) proxyShapes.resize(entry.proxy + 1, nullShape);
+		proxyShapes[entry.proxy] = shape;
+	}
+	else
+	{
+		tree.MoveProxy(entry.proxy, volume, Vector3());
+	}
+}
+
+void SceneQuery::Update()
+{
+	for (unsigned shape = 0; shape < shapes.size(); shape++)
+	{
+		if (shapes[shape].primitive) RefreshShape(shape);
+	}
+}
+
+unsigned SceneQuery::PacketHitsBox(const Packet& packet, const BoundingBoxVolume& volume)
+{
+	unsigned mask = 0;
+
+#ifdef PARADOX_SIMD_X86
+	// Two lanes per register, each a slab test against the box grown
+	// by the lane's radius
+	for (unsigned lane = 0; lane < packetSize; lane += 2)
+	{
+		__m128d radius = _mm_loadu_pd(packet.radius + lane);
+		__m128d nearT = _mm_setzero_pd();
+		__m128d farT = _mm_loadu_pd(packet.limit + lane);
+
+		const double* origins[3] = { packet.originX, packet.originY, packet.originZ };
+		const double* inverses[3] = { packet.inverseX, packet.inverseY, packet.inverseZ };
+		for (unsigned axis = 0; axis < 3; axis++)
+		{
+			__m128d origin = _mm_loadu_pd(origins[axis] + lane);
+			__m128d inverse = _mm_loadu_pd(inverses[axis] + lane);
+			__m128d low = _mm_sub_pd(_mm_set1_pd(volume.min[axis]), radius);
+			__m128d high = _mm_add_pd(_mm_set1_pd(volume.max[axis]), radius);
+
+			__m128d t1 = _mm_mul_pd(_mm_sub_pd(low, origin), inverse);
+			__m128d t2 = _mm_mul_pd(_mm_sub_pd(high, origin), inverse);
+			nearT = _mm_max_pd(nearT, _mm_min_pd(t1, t2));
+			farT = _mm_min_pd(farT, _mm_max_pd(t1, t2));
+		}
+
+		mask |= (unsigned)_mm_movemask_pd(_mm_cmple_pd(nearT, farT)) << lane;
+	}
+#else
+	for (unsigned lane = 0; lane < packetSize; lane++)
+	{
+		double nearT = 0;
+		double farT = packet.limit[lane];
+
+		const double origins[3] = { packet.originX[lane], packet.originY[lane], packet.originZ[lane] };
+		const double inverses[3] = { packet.inverseX[lane], packet.inverseY[lane], packet.inverseZ[lane] };
+		for (unsigned axis = 0; axis < 3; axis++)
+		{
+			double t1 = (volume.min[axis] - packet.radius[lane] - origins[axis]) * inverses[axis];
+			double t2 = (volume.max[axis] + packet.radius[lane] - origins[axis]) * inverses[axis];
+			nearT = std::max(nearT, std::min(t1, t2));
+			farT = std::min(farT, std::max(t1, t2));
+		}
+
+		if (nearT <= farT) mask |= 1u << lane;
+	}
+#endif
+
+	return mask;
+}
+
+void SceneQuery::SweepShape(const SphereSweepQuery& sweep, unsigned shape, QueryHit* hit) const
+{
+	const Shape& entry = shapes[shape];
+	if (entry.primitive && entry.primitive->body == sweep.ignoreBody) return;
+
+	double limit = hit->distance;
+	double distance;
+	Vector3 point;
+	Vector3 normal;
+
+	if (entry.type == QueryShapeType::Plane)
+	{
+		const CollisionPlane& plane = *entry.plane;
+		double start = plane.direction * sweep.origin - sweep.radius - plane.offset;
+		if (start <= 0)
+		{
+			distance = 0;
+			point = sweep.origin;
+			normal = sweep.direction * -1;
+		}
+		else
+		{
+			double approach = plane.direction * sweep.direction;
+			if (approach >= 0) return;
+
+			distance = -start / approach;
+			if (distance > limit) return;
+
+			normal = plane.direction;
+			point = sweep.origin + sweep.direction * distance - normal * sweep.radius;
+		}
+	}
+	else if (entry.type == QueryShapeType::Sphere)
+	{
+		const CollisionSphere& sphere = *static_cast<const CollisionSphere*>(entry.primitive);
+		Vector3 centre = sphere.GetAxis(3);
+		double reach = sphere.radius + sweep.radius;
+		if (!SweepPointSphere(sweep.origin, sweep.direction, limit, centre, reach, &distance)) return;
+
+		if ((sweep.origin - centre).squareMagnitude() <= reach * reach)
+		{
+			point = sweep.origin;
+			normal = sweep.direction * -1;
+		}
+		else
+		{
+			normal = (sweep.origin + sweep.direction * distance - centre) * (1.0 / reach);
+			point = centre + normal * sphere.radius;
+		}
+	}
+	else
+	{
+		const CollisionBox& box = *static_cast<const CollisionBox*>(entry.primitive);
+		const Matrix4& transform = box.GetTransform();
+		Vector3 origin = transform.transformInverse(sweep.origin);
+		Vector3 direction = transform.transformInverseDirection(sweep.direction);
+		if (!SweepSphereBox(origin, direction, sweep.radius, limit, box.halfSize, &distance, &point, &normal)) return;
+
+		point = transform.transform(point);
+		normal = transform.transformDirection(normal);
+	}
+
+	// Equally near shapes go to the lowest handle, so the result does
+	// not depend on the order the tree is walked in
+	if (hit->shape != nullShape && (distance > hit->distance || (distance == hit->distance && shape > hit->shape)))
+	{
+		return;
+	}
+
+	hit->shape = shape;
+	hit->body = entry.primitive ? entry.primitive->body : NULL;
+	hit->distance = distance;
+	hit->point = point;
+	hit->normal = normal;
+}
+
+void SceneQuery::SweepPacket(const SphereSweepQuery* sweeps, const unsigned* indices, unsigned count,
+	QueryHit* hits, std::vector<unsigned>& stack) const
+{
+	Packet packet;
+	for (unsigned lane = 0; lane < packetSize; lane++)
+	{
+		if (lane >= count)
+		{
+			packet.originX[lane] = packet.originY[lane] = packet.originZ[lane] = 0;
+			packet.inverseX[lane] = packet.inverseY[lane] = packet.inverseZ[lane] = 1;
+			packet.radius[lane] = 0;
+			packet.limit[lane] = -1;
+			continue;
+		}
+
+		const SphereSweepQuery& sweep = sweeps[indices[lane]];
+		packet.originX[lane] = sweep.origin.x;
+		packet.originY[lane] = sweep.origin.y;
+		packet.originZ[lane] = sweep.origin.z;
+		packet.inverseX[lane] = SafeInverse(sweep.direction.x);
+		packet.inverseY[lane] = SafeInverse(sweep.direction.y);
+		packet.inverseZ[lane] = SafeInverse(sweep.direction.z);
+		packet.radius[lane] = sweep.radius;
+
+		QueryHit& hit = hits[indices[lane]];
+		hit.shape = nullShape;
+		hit.body = NULL;
+		hit.distance = sweep.length;
+
+		for (unsigned plane : planes) SweepShape(sweep, plane, &hit);
+		packet.limit[lane] = hit.distance;
+	}
+
+	unsigned root = tree.GetRoot();
+	if (root == DynamicAABBTree::nullNode) return;
+
+	// The first sweep leads the packet, the rest head roughly its' way
+	const Vector3& lead = sweeps[indices[0]].direction;
+
+	const std::vector<DynamicTreeNode>& nodes = tree.GetNodes();
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		unsigned index = stack.back();
+		stack.pop_back();
+
+		const DynamicTreeNode& node = nodes[index];
+		unsigned mask = PacketHitsBox(packet, node.volume);
+		if (!mask) continue;
+
+		if (!node.IsLeaf())
+		{
+			// Visit the child nearer along the lead direction first, so
+			// that hits found in it cut the sweeps short before the
+			// other is tested
+			const BoundingBoxVolume& first = nodes[node.children[0]].volume;
+			const BoundingBoxVolume& second = nodes[node.children[1]].volume;
+			double ahead = (first.min + first.max - second.min - second.max) * lead;
+
+			unsigned nearer = ahead > 0 ? 1 : 0;
+			stack.push_back(node.children[1 - nearer]);
+			stack.push_back(node.children[nearer]);
+			continue;
+		}
+
+		// Only the lanes that reached the leaf are tested exactly, and
+		// a lane that hits stops looking past its' new hit
+		unsigned shape = proxyShapes[index];
+		for (unsigned lane = 0; lane < count; lane++)
+		{
+			if (!(mask & (1u << lane))) continue;
+
+			QueryHit& hit = hits[indices[lane]];
+			SweepShape(sweeps[indices[lane]], shape, &hit);
+			packet.limit[lane] = hit.distance;
+		}
+	}
+}
+
+void SceneQuery::OverlapSphere(const SphereOverlapQuery& sphere, unsigned query,
+	std::vector<QueryOverlap>& overlaps, std::vector<unsigned>& stack) const
+{
+	size_t first = overlaps.size();
+
+	for (unsigned shape : planes)
+	{
+		const CollisionPlane& plane = *shapes[shape].plane;
+		if (plane.direction * sphere.centre - sphere.radius > plane.offset) continue;
+
+		QueryOverlap overlap = { query, shape };
+		overlaps.push_back(overlap);
+	}
+
+	Vector3 extent(sphere.radius, sphere.radius, sphere.radius);
+	BoundingBoxVolume volume(sphere.centre - extent, sphere.centre + extent);
+	QueryTree(tree, volume, stack, [&](unsigned proxy)
+	{
+		unsigned shape = proxyShapes[proxy];
+		const Shape& entry = shapes[shape];
+		if (entry.type == QueryShapeType::Sphere)
+		{
+			const CollisionSphere& other = *static_cast<const CollisionSphere*>(entry.primitive);
+			double reach = sphere.radius + other.radius;
+			if ((sphere.centre - other.GetAxis(3)).squareMagnitude() >= reach * reach) return;
+		}
+		else
+		{
+			const CollisionBox& box = *static_cast<const CollisionBox*>(entry.primitive);
+			Vector3 centre = box.GetTransform().transformInverse(sphere.centre);
+			if ((centre - ClampToBox(centre, box.halfSize)).squareMagnitude() >= sphere.radius * sphere.radius) return;
+		}
+
+		QueryOverlap overlap = { query, shape };
+		overlaps.push_back(overlap);
+	});
+
+	std::sort(overlaps.begin() + first, overlaps.end(),
+		[](const QueryOverlap& one, const QueryOverlap& two) { return one.shape < two.shape; });
+}
+
+void SceneQuery::OverlapBox(const BoxOverlapQuery& box, unsigned query,
+	std::vector<QueryOverlap>& overlaps, std::vector<unsigned>& stack) const
+{
+	size_t first = overlaps.size();
+
+	Vector3 centre = box.transform.getAxisVector(3);
+	for (unsigned shape : planes)
+	{
+		// As IntersectionTests::BoxAndHalfSpace
+		const CollisionPlane& plane = *shapes[shape].plane;
+		double projectedRadius = 0;
+		for (unsigned axis = 0; axis < 3; axis++)
+		{
+			projectedRadius += box.halfSize[axis] * fabs(plane.direction * box.transform.getAxisVector(axis));
+		}
+		if (plane.direction * centre - projectedRadius > plane.offset) continue;
+
+		QueryOverlap overlap = { query, shape };
+		overlaps.push_back(overlap);
+	}
+
+	Vector3 extent;
+	for (unsigned axis = 0; axis < 3; axis++)
+	{
+		extent[axis] = fabs(box.transform.data[axis * 4]) * box.halfSize.x +
+			fabs(box.transform.data[axis * 4 + 1]) * box.halfSize.y +
+			fabs(box.transform.data[axis * 4 + 2]) * box.halfSize.z;
+	}
+
+	BoundingOrientedBoxVolume oriented(box.transform, box.halfSize);
+	BoundingBoxVolume volume(centre - extent, centre + extent);
+	QueryTree(tree, volume, stack, [&](unsigned proxy)
+	{
+		unsigned shape = proxyShapes[proxy];
+		const Shape& entry = shapes[shape];
+		if (entry.type == QueryShapeType::Sphere)
+		{
+			const CollisionSphere& sphere = *static_cast<const CollisionSphere*>(entry.primitive);
+			Vector3 local = box.transform.transformInverse(sphere.GetAxis(3));
+			if ((local - ClampToBox(local, box.halfSize)).squareMagnitude() >= sphere.radius * sphere.radius) return;
+		}
+		else
+		{
+			const CollisionBox& other = *static_cast<const CollisionBox*>(entry.primitive);
+			BoundingOrientedBoxVolume otherOriented(other.GetTransform(), other.halfSize);
+			if (!oriented.Overlaps(&otherOriented)) return;
+		}
+
+		QueryOverlap overlap = { query, shape };
+		overlaps.push_back(overlap);
+	});
+
+	std::sort(overlaps.begin() + first, overlaps.end(),
+		[](const QueryOverlap& one, const QueryOverlap& two) { return one.shape < two.shape; });
+}
+
+void SceneQuery::QueryTask::Execute(unsigned item, unsigned worker)
+{
+	unsigned begin = item * scene->queriesPerItem;
+	unsigned end = std::min(begin + scene->queriesPerItem, count);
+	std::vector<unsigned>& stack = stacks[worker];
+
+	if (type == BatchType::Sweep)
+	{
+		for (unsigned i = begin; i < end; i += packetSize)
+		{
+			scene->SweepPacket(sweeps, order + i, std::min(packetSize, end - i), hits, stack);
+		}
+		return;
+	}
+
+	std::vector<QueryOverlap>& buffer = buffers[worker];
+	Output& output = outputs[item];
+	output.worker = worker;
+	output.begin = buffer.size();
+	for (unsigned i = begin; i < end; i++)
+	{
+		if (type == BatchType::SphereOverlap) scene->OverlapSphere(spheres[i], i, buffer, stack);
+		else scene->OverlapBox(boxes[i], i, buffer, stack);
+	}
+	output.end = buffer.size();
+}
+
+void SceneQuery::RunBatch(WorkerPool* pool, std::vector<QueryOverlap>* overlaps)
+{
+	unsigned threads = pool ? pool->GetThreadCount() : 1;
+	unsigned items = (task.count + queriesPerItem - 1) / queriesPerItem;
+
+	task.stacks.resize(threads);
+	task.buffers.resize(threads);
+	for (std::vector<QueryOverlap>& buffer : task.buffers) buffer.clear();
+	task.outputs.resize(items);
+
+	if (threads > 1)
+	{
+		pool->Run(&task, items);
+	}
+	else
+	{
+		for (unsigned item = 0; item < items; item++) task.Execute(item, 0);
+	}
+
+	if (!overlaps) return;
+
+	// Join the runs back together in query order
+	for (const QueryTask::Output& output : task.outputs)
+	{
+		const std::vector<QueryOverlap>& buffer = task.buffers[output.worker];
+		overlaps->insert(overlaps->end(), buffer.begin() + output.begin, buffer.begin() + output.end);
+	}
+}
+
+void SceneQuery::CastRays(const RayQuery* rays, unsigned count, QueryHit* hits, WorkerPool* pool)
+{
+	raySweeps.resize(count);
+	for (unsigned i = 0; i < count; i++)
+	{
+		raySweeps[i].origin = rays[i].origin;
+		raySweeps[i].direction = rays[i].direction;
+		raySweeps[i].length = rays[i].length;
+		raySweeps[i].radius = 0;
+		raySweeps[i].ignoreBody = NULL;
+	}
+
+	SweepSpheres(raySweeps.data(), count, hits, pool);
+}
+
+void SceneQuery::SortSweeps(const SphereSweepQuery* sweeps, unsigned count)
+{
+	sweepOrder.resize(count);
+	if (count <= packetSize)
+	{
+		for (unsigned i = 0; i < count; i++) sweepOrder[i] = i;
+		return;
+	}
+
+	Vector3 low = sweeps[0].origin;
+	Vector3 high = sweeps[0].origin;
+	for (unsigned i = 1; i < count; i++)
+	{
+		for (unsigned axis = 0; axis < 3; axis++)
+		{
+			low[axis] = std::min(low[axis], sweeps[i].origin[axis]);
+			high[axis] = std::max(high[axis], sweeps[i].origin[axis]);
+		}
+	}
+
+	// Origins to 10 bits an axis, interleaved below the octant
+	sweepKeys.resize(count);
+	for (unsigned i = 0; i < count; i++)
+	{
+		unsigned long long key = 0;
+		for (unsigned axis = 0; axis < 3; axis++)
+		{
+			if (sweeps[i].direction[axis] < 0) key |= 1ull << (30 + axis);
+		}
+
+		for (unsigned axis = 0; axis < 3; axis++)
+		{
+			double span = high[axis] - low[axis];
+			unsigned cell = span > 0 ? (unsigned)((sweeps[i].origin[axis] - low[axis]) / span * 1023.0) : 0;
+			for (unsigned bit = 0; bit < 10; bit++)
+			{
+				key |= (unsigned long long)((cell >> bit) & 1) << (bit * 3 + axis);
+			}
+		}
+
+		sweepKeys[i] = std::make_pair(key, i);
+	}
+
+	std::sort(sweepKeys.begin(), sweepKeys.end());
+	for (unsigned i = 0; i < count; i++) sweepOrder[i] = sweepKeys[i].second;
+}
+
+void SceneQuery::SweepSpheres(const SphereSweepQuery* sweeps, unsigned count, QueryHit* hits, WorkerPool* pool)
+{
+	SortSweeps(sweeps, count);
+
+	task.type = BatchType::Sweep;
+	task.count = count;
+	task.sweeps = sweeps;
+	task.order = sweepOrder.data();
+	task.hits = hits;
+	RunBatch(pool, NULL);
+}
+
+unsigned SceneQuery::OverlapSpheres(const SphereOverlapQuery* spheres, unsigned count,
+	std::vector<QueryOverlap>& overlaps, WorkerPool* pool)
+{
+	size_t first = overlaps.size();
+
+	task.type = BatchType::SphereOverlap;
+	task.count = count;
+	task.spheres = spheres;
+	RunBatch(pool, &overlaps);
+
+	return (unsigned)(overlaps.size() - first);
+}
+
+unsigned SceneQuery::OverlapBoxes(const BoxOverlapQuery* boxes, unsigned count,
+	std::vector<QueryOverlap>& overlaps, WorkerPool* pool)
+{
+	size_t first = overlaps.size();
+
+	task.type = BatchType::BoxOverlap;
+	task.count = count;
+	task.boxes = boxes;
+	RunBatch(pool, &overlaps);
+
+	return (unsigned)(overlaps.size() - first);
+}
@@ -0,0 +1,307 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the scene queries: rays, sphere sweeps and
+ * overlap tests run against the collision shapes registered with
+ * them, in batches.
+ */
+
+#include "CollideFine.h"
+#include "DynamicTree.h"
+#include "WorkerPool.h"
+#include <vector>
+
+// The kinds of shape a scene query can be run against
+enum class QueryShapeType
+{
+	Sphere,
+	Box,
+	Plane
+};
+
+/**
+ * A ray to cast into the scene. The direction must be unit length,
+ * and only hits no further than the given length along it count.
+ */
+struct RayQuery
+{
+	Vector3 origin;
+	Vector3 direction;
+	double length;
+};
+
+// Returns the query for a ray that runs from the start to the end
+inline RayQuery MakeSegmentQuery(const Vector3& start, const Vector3& end)
+{
+	RayQuery query;
+	query.origin = start;
+	query.direction = end - start;
+	query.length = query.direction.magnitude();
+	query.direction.normalise();
+	return query;
+}
+
+/**
+ * A sphere to move through the scene along a unit direction, for
+ * as far as the given length, stopping at the first shape it meets.
+ */
+struct SphereSweepQuery
+{
+	Vector3 origin;
+	Vector3 direction;
+	double length;
+	double radius;
+
+	// The sweep passes through the shapes of this body, if it is not NULL
+	const RigidBody* ignoreBody;
+};
+
+// A sphere to find the overlapping shapes of
+struct SphereOverlapQuery
+{
+	Vector3 centre;
+	double radius;
+};
+
+// An oriented box to find the overlapping shapes of
+struct BoxOverlapQuery
+{
+	Matrix4 transform;
+	Vector3 halfSize;
+};
+
+/**
+ * The first shape a ray or sweep met. The shape is
+ * SceneQuery::nullShape when nothing was met, and the body is NULL
+ * for planes. Queries that start out touching or inside a shape hit
+ * it at distance zero, at their origin, with a normal facing back
+ * along the direction.
+ */
+struct QueryHit
+{
+	unsigned shape;
+	RigidBody* body;
+
+	// How far along the direction the hit is
+	double distance;
+
+	// Where the shape was met, on its' surface
+	Vector3 point;
+
+	// The surface normal of the shape at that point
+	Vector3 normal;
+};
+
+// A shape that overlaps one of a batch of overlap queries
+struct QueryOverlap
+{
+	unsigned query;
+	unsigned shape;
+};
+
+/**
+ * Runs queries against a set of collision spheres, boxes and planes.
+ *
+ * Spheres and boxes are kept in a dynamic bounding box tree of their
+ * own, the same structure the world's broadphase uses, which is
+ * brought up to date with the bodies by Update. Planes are few and
+ * tested against every query.
+ *
+ * Queries are made in batches. Rays and sweeps are sorted so that
+ * ones heading the same way from nearby go together, then go down the
+ * tree in packets of four, testing each box against the whole packet
+ * at once with SSE where it is there. Only the rays that pass go on
+ * to the exact test against a shape. Given a worker pool, the batch is
+ * split into runs of queries for the threads to take. Results are the
+ * same whatever the number of threads: hits are written by query, and
+ * overlaps are joined in query order with each query's shapes in
+ * handle order.
+ */
+class SceneQuery
+{
+public:
+	static const unsigned nullShape = 0xffffffff;
+
+	// Creates an empty scene that gives threads runs of the given
+	// number of queries, rounded up to whole packets
+	SceneQuery(unsigned queriesPerItem = 64);
+
+	/**
+	 * Adds a shape to the scene, returning its' handle. Spheres and
+	 * boxes must have a body, which must outlive the shape's time in
+	 * the scene. The shape is read again by every Update.
+	 */
+	unsigned AddSphere(CollisionSphere* sphere);
+	unsigned AddBox(CollisionBox* box);
+	unsigned AddPlane(const CollisionPlane* plane);
+
+	// Removes the shape with the given handle, the handle may be reused
+	void RemoveShape(unsigned shape);
+
+	// Removes every shape
+	void Clear();
+
+	/**
+	 * Recalculates the transform of every sphere and box from its'
+	 * body and moves its' box in the tree to match.
+	 */
+	void Update();
+
+	QueryShapeType GetShapeType(unsigned shape) const
+	{
+		return shapes[shape].type;
+	}
+
+	unsigned GetShapeCount() const
+	{
+		return shapeCount;
+	}
+
+	/**
+	 * Casts each of the given rays, writing the first hit of each into
+	 * the matching element of the hits array. Spread over the given
+	 * pool when there is one.
+	 */
+	void CastRays(const RayQuery* rays, unsigned count, QueryHit* hits, WorkerPool* pool = NULL);
+
+	// Sweeps each of the given spheres, as CastRays does rays
+	void SweepSpheres(const SphereSweepQuery* sweeps, unsigned count, QueryHit* hits, WorkerPool* pool = NULL);
+
+	/**
+	 * Finds the shapes overlapping each of the given spheres or boxes
+	 * and appends them to the given list, in query order. Returns the
+	 * number found.
+	 */
+	unsigned OverlapSpheres(const SphereOverlapQuery* spheres, unsigned count,
+		std::vector<QueryOverlap>& overlaps, WorkerPool* pool = NULL);
+	unsigned OverlapBoxes(const BoxOverlapQuery* boxes, unsigned count,
+		std::vector<QueryOverlap>& overlaps, WorkerPool* pool = NULL);
+
+private:
+	struct Shape
+	{
+		QueryShapeType type;
+
+		// The sphere or box, NULL for planes and removed shapes
+		CollisionPrimitive* primitive;
+		const CollisionPlane* plane;
+
+		// The shape's leaf in the tree, spheres and boxes only
+		unsigned proxy;
+
+		// Removed shapes are chained into a free list through here
+		unsigned freeNext;
+	};
+
+	/**
+	 * Up to four sweeps going down the tree together, one lane each,
+	 * laid out so that two lanes fit in an SSE register. The limit of
+	 * a lane shrinks to its' nearest hit as hits are found, and is
+	 * negative for lanes with no sweep in them.
+	 */
+	struct Packet
+	{
+		double originX[4], originY[4], originZ[4];
+		double inverseX[4], inverseY[4], inverseZ[4];
+		double radius[4];
+		double limit[4];
+	};
+
+	// Returns a bit for each lane of the packet whose sweep meets the box
+	static unsigned PacketHitsBox(const Packet& packet, const BoundingBoxVolume& volume);
+
+	// Sweeps up to four spheres, picked out of the batch by the given
+	// indices, against the scene
+	void SweepPacket(const SphereSweepQuery* sweeps, const unsigned* indices, unsigned count,
+		QueryHit* hits, std::vector<unsigned>& stack) const;
+
+	/**
+	 * Orders the sweeps of a batch into the sweep order, by the octant
+	 * their direction points into and then along a Morton curve
+	 * through their origins, so that packets hold similar rays.
+	 */
+	void SortSweeps(const SphereSweepQuery* sweeps, unsigned count);
+
+	// Sweeps one sphere against one shape, replacing the hit if it is
+	// nearer than the hit so far
+	void SweepShape(const SphereSweepQuery& sweep, unsigned shape, QueryHit* hit) const;
+
+	// Appends the shapes overlapping the given sphere or box, in handle order
+	void OverlapSphere(const SphereOverlapQuery& sphere, unsigned query,
+		std::vector<QueryOverlap>& overlaps, std::vector<unsigned>& stack) const;
+	void OverlapBox(const BoxOverlapQuery& box, unsigned query,
+		std::vector<QueryOverlap>& overlaps, std::vector<unsigned>& stack) const;
+
+	// Brings the given sphere or box's transform and tree box up to date
+	void RefreshShape(unsigned shape);
+
+	unsigned AllocateShape(QueryShapeType type);
+
+	// The kinds of batch the query task can run
+	enum class BatchType
+	{
+		Sweep,
+		SphereOverlap,
+		BoxOverlap
+	};
+
+	// Runs a batch of queries, one run of them per item
+	class QueryTask : public WorkerTask
+	{
+	public:
+		const SceneQuery* scene;
+		BatchType type;
+		unsigned count;
+
+		const SphereSweepQuery* sweeps;
+		const unsigned* order;
+		QueryHit* hits;
+		const SphereOverlapQuery* spheres;
+		const BoxOverlapQuery* boxes;
+
+		// Where in its' worker's list an item put the overlaps it found
+		struct Output
+		{
+			unsigned worker;
+			size_t begin;
+			size_t end;
+		};
+
+		std::vector<Output> outputs;
+
+		// A list of overlaps and a stack for each worker
+		std::vector<std::vector<QueryOverlap>> buffers;
+		std::vector<std::vector<unsigned>> stacks;
+
+		virtual void Execute(unsigned item, unsigned worker);
+	};
+
+	// Runs the task's batch on the pool, or here if there is none, and
+	// joins any overlaps onto the given list
+	void RunBatch(WorkerPool* pool, std::vector<QueryOverlap>* overlaps);
+
+	unsigned queriesPerItem;
+
+	std::vector<Shape> shapes;
+	unsigned freeShapes;
+	unsigned shapeCount;
+
+	// The handles of the live planes, in handle order
+	std::vector<unsigned> planes;
+
+	DynamicAABBTree tree;
+
+	// The shape each proxy of the tree belongs to
+	std::vector<unsigned> proxyShapes;
+
+	QueryTask task;
+
+	// Rays turned into sweeps of no radius
+	std::vector<SphereSweepQuery> raySweeps;
+
+	// The order the sweeps of a batch are packed in, and their sort keys
+	std::vector<unsigned> sweepOrder;
+	std::vector<std::pair<unsigned long long, unsigned>> sweepKeys;
+};
@@ -0,0 +1,343 @@
+#include "StaticTree.h"
+#include <algorithm>
+#include <limits>
+
+// Planes tried along the chosen axis when splitting a range
+static const unsigned splitBins = 16;
+
+// Cost of visiting a branch, against testing one body at a leaf
+static const double traversalCost = 1.0;
+
+// Below this many bodies the tree is built on the calling thread
+static const unsigned minParallelBodies = 4096;
+
+// Marks a leaf standing in for a subtree a worker builds
+static const unsigned taskPlaceholder = 0xffffffff;
+
+// Returns a box that encloses nothing, to be grown by merging
+static BoundingBoxVolume EmptyVolume()
+{
+	double huge = std::numeric_limits<double>::max();
+	return BoundingBoxVolume(Vector3(huge, huge, huge), Vector3(-huge, -huge, -huge));
+}
+
+// Grows the first box to take in the second
+static inline void Grow(BoundingBoxVolume& volume, const BoundingBoxVolume& other)
+{
+	for (unsigned axis = 0; axis < 3; axis++)
+	{
+		volume.min[axis] = std::min(volume.min[axis], other.min[axis]);
+		volume.max[axis] = std::max(volume.max[axis], other.max[axis]);
+	}
+}
+
+// Grows the box to take in the given point
+static inline void Grow(BoundingBoxVolume& volume, const Vector3& point)
+{
+	for (unsigned axis = 0; axis < 3; axis++)
+	{
+		volume.min[axis] = std::min(volume.min[axis], point[axis]);
+		volume.max[axis] = std::max(volume.max[axis], point[axis]);
+	}
+}
+
+StaticAABBTree::StaticAABBTree(unsigned maxLeafBodies)
+	:
+	maxLeafBodies(maxLeafBodies)
+{
+	buildTask.tree = this;
+}
+
+void StaticAABBTree::Clear()
+{
+	nodes.clear();
+	bodies.clear();
+	volumes.clear();
+}
+
+void StaticAABBTree::Build(RigidBody* const* bodies, const BoundingBoxVolume* volumes, unsigned count,
+	WorkerPool* pool)
+{
+	Clear();
+	if (count == 0) return;
+
+	entries.resize(count);
+	for (unsigned i = 0; i < count; i++)
+	{
+		entries[i].volume = volumes[i];
+		entries[i].centre = (volumes[i].min + volumes[i].max) * 0.5;
+		entries[i].body = i;
+	}
+
+	unsigned threads = pool ? pool->GetThreadCount() : 1;
+	nodes.reserve(count * 2);
+	if (threads == 1 || count < minParallelBodies)
+	{
+		BuildRange(0, count, nodes, 0, NULL);
+	}
+	else
+	{
+		// Build the top serially, leaving ranges small enough that
+		// there are several for each thread, then build those on the
+		// pool and stitch them in
+		std::vector<StaticTreeNode> top;
+		buildTask.ranges.clear();
+		BuildRange(0, count, top, count / (threads * 8), &buildTask.ranges);
+
+		buildTask.subtrees.resize(buildTask.ranges.size());
+		pool->Run(&buildTask, (unsigned)buildTask.ranges.size());
+
+		Join(top, 0);
+	}
+
+	// Leaves refer to the bodies in the order they were sorted into
+	this->bodies.resize(count);
+	this->volumes.resize(count);
+	for (unsigned i = 0; i < count; i++)
+	{
+		this->bodies[i] = bodies[entries[i].body];
+		this->volumes[i] = entries[i].volume;
+	}
+}
+
+void StaticAABBTree::BuildTask::Execute(unsigned item, unsigned /*worker*/)
+{
+	subtrees[item].clear();
+	tree->BuildRange(ranges[item].first, ranges[item].second, subtrees[item], 0, NULL);
+}
+
+void StaticAABBTree::BuildRange(unsigned begin, unsigned end, std::vector<StaticTreeNode>& out,
+	unsigned splitSize, std::vector<std::pair<unsigned, unsigned>>* tasks)
+{
+	// The box around the bodies, and the one around their centres
+	BoundingBoxVolume volume = entries[begin].volume;
+	BoundingBoxVolume centres(entries[begin].centre, entries[begin].centre);
+	for (unsigned i = begin + 1; i < end; i++)
+	{
+		Grow(volume, entries[i].volume);
+		Grow(centres, entries[i].centre);
+	}
+
+	unsigned index = (unsigned)out.size();
+	StaticTreeNode node;
+	node.volume = volume;
+	node.secondChild = 0;
+	node.firstBody = begin;
+	node.bodyCount = end - begin;
+	out.push_back(node);
+
+	if (tasks && end - begin <= splitSize)
+	{
+		out[index].secondChild = (unsigned)tasks->size();
+		out[index].bodyCount = taskPlaceholder;
+		tasks->push_back(std::make_pair(begin, end));
+		return;
+	}
+
+	unsigned middle;
+	if (!Split(begin, end, volume, centres, &middle)) return;
+
+	out[index].firstBody = 0;
+	out[index].bodyCount = 0;
+
+	BuildRange(begin, middle, out, splitSize, tasks);
+	out[index].secondChild = (unsigned)out.size();
+	BuildRange(middle, end, out, splitSize, tasks);
+}
+
+bool StaticAABBTree::Split(unsigned begin, unsigned end, const BoundingBoxVolume& volume,
+	const BoundingBoxVolume& centres, unsigned* middle)
+{
+	unsigned count = end - begin;
+	if (count == 1) return false;
+
+	// Split along the axis the centres are most spread on
+	const Vector3& low = centres.min;
+	unsigned axis = 0;
+	Vector3 spread = centres.max - centres.min;
+	if (spread.y > spread[axis]) axis = 1;
+	if (spread.z > spread[axis]) axis = 2;
+
+	// All the centres in one place, there is no plane between them
+	if (spread[axis] <= 0)
+	{
+		if (count <= maxLeafBodies) return false;
+		*middle = begin + count / 2;
+		return true;
+	}
+
+	// Drop every body into a bin by its' centre
+	BoundingBoxVolume binVolumes[splitBins];
+	unsigned binCounts[splitBins];
+	for (unsigned bin = 0; bin < splitBins; bin++)
+	{
+		binVolumes[bin] = EmptyVolume();
+		binCounts[bin] = 0;
+	}
+
+	double scale = splitBins / spread[axis];
+	for (unsigned i = begin; i < end; i++)
+	{
+		unsigned bin = std::min(splitBins - 1, (unsigned)((entries[i].centre[axis] - low[axis]) * scale));
+		Grow(binVolumes[bin], entries[i].volume);
+		binCounts[bin]++;
+	}
+
+	// Sweep from the right to find the cost of everything past each
+	// plane, then from the left to find the best plane
+	double rightCosts[splitBins];
+	BoundingBoxVolume right = EmptyVolume();
+	unsigned rightCount = 0;
+	for (unsigned plane = splitBins - 1; plane > 0; plane--)
+	{
+		Grow(right, binVolumes[plane]);
+		rightCount += binCounts[plane];
+		rightCosts[plane] = rightCount > 0 ? right.GetSurfaceArea() * rightCount : 0;
+	}
+
+	unsigned bestPlane = 0;
+	double bestCost = std::numeric_limits<double>::max();
+	BoundingBoxVolume left = EmptyVolume();
+	unsigned leftCount = 0;
+	for (unsigned plane = 1; plane < splitBins; plane++)
+	{
+		Grow(left, binVolumes[plane - 1]);
+		leftCount += binCounts[plane - 1];
+		if (leftCount == 0 || leftCount == count) continue;
+
+		double cost = left.GetSurfaceArea() * leftCount + rightCosts[plane];
+		if (cost < bestCost)
+		{
+			bestCost = cost;
+			bestPlane = plane;
+		}
+	}
+
+	// Keep small ranges whole when testing every body is cheaper
+	double area = volume.GetSurfaceArea();
+	if (count <= maxLeafBodies && count * area <= traversalCost * area + bestCost) return false;
+
+	BuildEntry* first = entries.data() + begin;
+	BuildEntry* split = std::partition(first, entries.data() + end,
+		[&](const BuildEntry& entry)
+		{
+			unsigned bin = std::min(splitBins - 1, (unsigned)((entry.centre[axis] - low[axis]) * scale));
+			return bin < bestPlane;
+		});
+
+	*middle = begin + (unsigned)(split - first);
+	return true;
+}
+
+void StaticAABBTree::Join(const std::vector<StaticTreeNode>& top, unsigned node)
+{
+	const StaticTreeNode& source = top[node];
+
+	if (source.bodyCount == taskPlaceholder)
+	{
+		unsigned offset = (unsigned)nodes.size();
+		for (StaticTreeNode subtreeNode : buildTask.subtrees[source.secondChild])
+		{
+			if (!subtreeNode.IsLeaf()) subtreeNode.secondChild += offset;
+			nodes.push_back(subtreeNode);
+		}
+		return;
+	}
+
+	unsigned index = (unsigned)nodes.size();
+	nodes.push_back(source);
+	if (source.IsLeaf()) return;
+
+	Join(top, node + 1);
+	nodes[index].secondChild = (unsigned)nodes.size();
+	Join(top, source.secondChild);
+}
+
+double StaticAABBTree::GetCost() const
+{
+	if (nodes.empty()) return 0;
+
+	double cost = 0;
+	for (const StaticTreeNode& node : nodes)
+	{
+		double area = node.volume.GetSurfaceArea();
+		cost += node.IsLeaf() ? area * node.bodyCount : area * traversalCost;
+	}
+	return cost / nodes[0].volume.GetSurfaceArea();
+}
+
+unsigned StaticAABBTree::GetPotentialContacts(std::vector<PotentialContact>& contacts) const
+{
+	if (nodes.empty()) return 0;
+
+	size_t first = contacts.size();
+	CollideNodes(0, 0, contacts);
+	return (unsigned)(contacts.size() - first);
+}
+
+void StaticAABBTree::CollideLeaves(const StaticTreeNode& one, const StaticTreeNode& two,
+	std::vector<PotentialContact>& contacts) const
+{
+	bool same = &one == &two;
+	for (unsigned i = one.firstBody; i < one.firstBody + one.bodyCount; i++)
+	{
+		for (unsigned j = same ? i + 1 : two.firstBody; j < two.firstBody + two.bodyCount; j++)
+		{
+			if (!volumes[i].Overlaps(&volumes[j])) continue;
+
+			PotentialContact contact;
+			contact.body[0] = bodies[i];
+			contact.body[1] = bodies[j];
+			contacts.push_back(contact);
+		}
+	}
+}
+
+void StaticAABBTree::CollideNodes(unsigned one, unsigned two, std::vector<PotentialContact>& contacts) const
+{
+	// A pair of the same node stands for the pairs within its' subtree
+	pairStack.clear();
+	pairStack.push_back(std::make_pair(one, two));
+	while (!pairStack.empty())
+	{
+		std::pair<unsigned, unsigned> top = pairStack.back();
+		pairStack.pop_back();
+
+		const StaticTreeNode& first = nodes[top.first];
+		const StaticTreeNode& second = nodes[top.second];
+
+		if (top.first == top.second)
+		{
+			if (first.IsLeaf())
+			{
+				CollideLeaves(first, first, contacts);
+				continue;
+			}
+
+			pairStack.push_back(std::make_pair(top.first + 1, first.secondChild));
+			pairStack.push_back(std::make_pair(first.secondChild, first.secondChild));
+			pairStack.push_back(std::make_pair(top.first + 1, top.first + 1));
+			continue;
+		}
+
+		if (!first.volume.Overlaps(&second.volume)) continue;
+
+		if (first.IsLeaf() && second.IsLeaf())
+		{
+			CollideLeaves(first, second, contacts);
+			continue;
+		}
+
+		// Descend into the larger of the two
+		if (second.IsLeaf() || (!first.IsLeaf() && first.volume.GetSurfaceArea() >= second.volume.GetSurfaceArea()))
+		{
+			pairStack.push_back(std::make_pair(first.secondChild, top.second));
+			pairStack.push_back(std::make_pair(top.first + 1, top.second));
+		}
+		else
+		{
+			pairStack.push_back(std::make_pair(top.first, second.secondChild));
+			pairStack.push_back(std::make_pair(top.first, top.second + 1));
+		}
+	}
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the static bounding box tree, built in one go
+ * over bodies that do not move, such as level geometry.
+ */
+
+#include "CollideCoarse.h"
+#include "WorkerPool.h"
+#include <vector>
+
+/**
+ * A node of the static tree. Nodes are stored depth first, so the
+ * first child of a branch is always the node straight after it and
+ * only the second child's index is kept.
+ */
+struct StaticTreeNode
+{
+	// Encloses every body under the node
+	BoundingBoxVolume volume;
+
+	// Branches only, the index of the second child
+	unsigned secondChild;
+
+	// Leaves only, where the leaf's bodies start in the tree's list
+	// of bodies, and how many there are. Zero for branches
+	unsigned firstBody;
+	unsigned bodyCount;
+
+	bool IsLeaf() const
+	{
+		return bodyCount > 0;
+	}
+};
+
+/**
+ * A bounding volume hierarchy of axis aligned boxes, built top down
+ * over a whole set of bodies at once with the binned surface area
+ * heuristic. Each range of bodies is split where the summed surface
+ * area of the two halves, weighted by their body counts, is least,
+ * trying a fixed number of planes along the axis the body centres
+ * are most spread on. This gives far better trees than inserting
+ * bodies one at a time, at the cost of rebuilding whenever anything
+ * changes, so it suits geometry that never moves.
+ *
+ * Given a worker pool the subtrees below the first few levels are
+ * built in parallel, then joined into one array in depth first
+ * order. The tree is the same whatever the number of threads.
+ */
+class StaticAABBTree
+{
+public:
+	/**
+	 * Creates an empty tree. Ranges of at most the given number of
+	 * bodies may be kept as a single leaf, if the heuristic finds that
+	 * cheaper than splitting them.
+	 */
+	StaticAABBTree(unsigned maxLeafBodies = 4);
+
+	/**
+	 * Builds the tree over the given bodies and their boxes, replacing
+	 * whatever it held before. Subtrees are built on the given pool
+	 * when there is one.
+	 */
+	void Build(RigidBody* const* bodies, const BoundingBoxVolume* volumes, unsigned count,
+		WorkerPool* pool = NULL);
+
+	// Removes every body from the tree
+	void Clear();
+
+	/**
+	 * Calls the given function with every body whose box overlaps the
+	 * given one.
+	 */
+	template <class Callback>
+	void Query(const BoundingBoxVolume& volume, Callback callback) const;
+
+	/**
+	 * Finds every pair of bodies in the tree whose boxes overlap and
+	 * appends them to the given list. Returns the number found.
+	 */
+	unsigned GetPotentialContacts(std::vector<PotentialContact>& contacts) const;
+
+	/**
+	 * Returns the surface area heuristic cost of the tree: the summed
+	 * surface area of the branches plus that of the leaves times their
+	 * body counts, relative to the root. Lower is better.
+	 */
+	double GetCost() const;
+
+	const std::vector<StaticTreeNode>& GetNodes() const
+	{
+		return nodes;
+	}
+
+	unsigned GetBodyCount() const
+	{
+		return (unsigned)bodies.size();
+	}
+
+private:
+	// A body being sorted into the tree
+	struct BuildEntry
+	{
+		BoundingBoxVolume volume;
+		Vector3 centre;
+		unsigned body;
+	};
+
+	/**
+	 * Builds the subtree over the given entries onto the end of the
+	 * given list, depth first. Ranges of no more than the split size
+	 * are not built but left as a placeholder leaf for a task, with
+	 * the task's index in secondChild.
+	 */
+	void BuildRange(unsigned begin, unsigned end, std::vector<StaticTreeNode>& out,
+		unsigned splitSize, std::vector<std::pair<unsigned, unsigned>>* tasks);
+
+	/**
+	 * Finds the best place to split the given entries, given the box
+	 * around them and the box around their centres. Returns false if
+	 * keeping them in one leaf is cheaper, otherwise sorts the entries
+	 * so that the first half ends at the returned middle.
+	 */
+	bool Split(unsigned begin, unsigned end, const BoundingBoxVolume& volume,
+		const BoundingBoxVolume& centres, unsigned* middle);
+
+	// Copies the top of the tree into the node list, putting each
+	// task's subtree in place of its' placeholder
+	void Join(const std::vector<StaticTreeNode>& top, unsigned node);
+
+	// Builds the subtrees left for workers
+	class BuildTask : public WorkerTask
+	{
+	public:
+		StaticAABBTree* tree;
+		std::vector<std::pair<unsigned, unsigned>> ranges;
+		std::vector<std::vector<StaticTreeNode>> subtrees;
+
+		virtual void Execute(unsigned item, unsigned worker);
+	};
+
+	// Appends the pairs of overlapping bodies under the two nodes, or
+	// within the one node when both are the same
+	void CollideNodes(unsigned one, unsigned two, std::vector<PotentialContact>& contacts) const;
+
+	// Appends the pairs of overlapping bodies between two leaves
+	void CollideLeaves(const StaticTreeNode& one, const StaticTreeNode& two, std::vector<PotentialContact>& contacts) const;
+
+	unsigned maxLeafBodies;
+
+	std::vector<StaticTreeNode> nodes;
+
+	// The bodies and their boxes in the order the leaves refer to them
+	std::vector<RigidBody*> bodies;
+	std::vector<BoundingBoxVolume> volumes;
+
+	// Working storage for the build
+	std::vector<BuildEntry> entries;
+	BuildTask buildTask;
+
+	mutable std::vector<unsigned> stack;
+	mutable std::vector<std::pair<unsigned, unsigned>> pairStack;
+};
+
+template <class Callback>
+void StaticAABBTree::Query(const BoundingBoxVolume& volume, Callback callback) const
+{
+	if (nodes.empty()) return;
+
+	stack.clear();
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		unsigned index = stack.back();
+		stack.pop_back();
+
+		const StaticTreeNode& node = nodes[index];
+		if (!node.volume.Overlaps(&volume)) continue;
+
+		if (node.IsLeaf())
+		{
+			for (unsigned i = node.firstBody; i < node.firstBody + node.bodyCount; i++)
+			{
+				if (volumes[i].Overlaps(&volume)) callback(bodies[i]);
+			}
+		}
+		else
+		{
+			stack.push_back(node.secondChild);
+			stack.push_back(index + 1);
+		}
+	}
+}
@@ -0,0 +1,239 @@
+#include "SweepAndPrune.h"
+#include "Integrator.h" // For PARADOX_SIMD_X86
+#include <algorithm>
+#include <math.h>
+
+#ifdef PARADOX_SIMD_X86
+#include <xmmintrin.h>
+#endif
+
+// Returns the nearest float at or below the given value
+static float RoundDown(double value)
+{
+	float rounded = (float)value;
+	if (rounded > value) rounded = nextafterf(rounded, -INFINITY);
+	return rounded;
+}
+
+// Returns the nearest float at or above the given value
+static float RoundUp(double value)
+{
+	float rounded = (float)value;
+	if (rounded < value) rounded = nextafterf(rounded, INFINITY);
+	return rounded;
+}
+
+SweepAndPrune::SweepAndPrune()
+	:
+	freeList(nullProxy),
+	proxyCount(0),
+	addedEndpoints(0),
+	swapCount(0)
+{
+}
+
+unsigned SweepAndPrune::CreateProxy(const BoundingBoxVolume& volume, RigidBody* body)
+{
+	unsigned proxy = freeList;
+	if (proxy == nullProxy)
+	{
+		proxy = (unsigned)proxies.size();
+		proxies.push_back(Proxy());
+	}
+	else
+	{
+		freeList = proxies[proxy].freeNext;
+	}
+
+	proxies[proxy].volume = volume;
+	proxies[proxy].body = body;
+	proxies[proxy].freeNext = nullProxy;
+
+	// The ends go on the back, to be put in order at the next search
+	Endpoint endpoint;
+	endpoint.value = volume.min.x;
+	endpoint.data = proxy << 1;
+	endpoints.push_back(endpoint);
+	endpoint.value = volume.max.x;
+	endpoint.data = (proxy << 1) | 1;
+	endpoints.push_back(endpoint);
+	addedEndpoints += 2;
+
+	proxyCount++;
+	return proxy;
+}
+
+void SweepAndPrune::DestroyProxy(unsigned proxy)
+{
+	// Take the ends out straight away, so the proxy can be reused
+	unsigned firstAdded = (unsigned)endpoints.size() - addedEndpoints;
+	unsigned kept = 0;
+	for (unsigned i = 0; i < endpoints.size(); i++)
+	{
+		if ((endpoints[i].data >> 1) == proxy)
+		{
+			if (i >= firstAdded) addedEndpoints--;
+			continue;
+		}
+		endpoints[kept++] = endpoints[i];
+	}
+	endpoints.resize(kept);
+
+	proxies[proxy].body = NULL;
+	proxies[proxy].freeNext = freeList;
+	freeList = proxy;
+	proxyCount--;
+}
+
+void SweepAndPrune::SortEndpoints()
+{
+	for (Endpoint& endpoint : endpoints)
+	{
+		const BoundingBoxVolume& volume = proxies[endpoint.data >> 1].volume;
+		endpoint.value = (endpoint.data & 1) ? volume.max.x : volume.min.x;
+	}
+
+	// The ends were in order last time, and bodies move little
+	// between frames, so each only has a short way to go
+	unsigned sorted = (unsigned)endpoints.size() - addedEndpoints;
+	swapCount = 0;
+	for (unsigned i = 1; i < sorted; i++)
+	{
+		Endpoint endpoint = endpoints[i];
+		unsigned j = i;
+		while (j > 0 && endpoint < endpoints[j - 1])
+		{
+			endpoints[j] = endpoints[j - 1];
+			j--;
+		}
+		endpoints[j] = endpoint;
+		swapCount += i - j;
+	}
+
+	if (addedEndpoints > 0)
+	{
+		std::sort(endpoints.begin() + sorted, endpoints.end());
+		std::inplace_merge(endpoints.begin(), endpoints.begin() + sorted, endpoints.end());
+		addedEndpoints = 0;
+	}
+}
+
+void SweepAndPrune::AddActive(unsigned proxy)
+{
+	const BoundingBoxVolume& volume = proxies[proxy].volume;
+
+	activeSlots[proxy] = (unsigned)activeProxies.size();
+	activeMinY.push_back(RoundDown(volume.min.y));
+	activeMaxY.push_back(RoundUp(volume.max.y));
+	activeMinZ.push_back(RoundDown(volume.min.z));
+	activeMaxZ.push_back(RoundUp(volume.max.z));
+	activeProxies.push_back(proxy);
+}
+
+void SweepAndPrune::RemoveActive(unsigned proxy)
+{
+	// Move the last active box into the gap
+	unsigned slot = activeSlots[proxy];
+	unsigned last = (unsigned)activeProxies.size() - 1;
+
+	activeMinY[slot] = activeMinY[last];
+	activeMaxY[slot] = activeMaxY[last];
+	activeMinZ[slot] = activeMinZ[last];
+	activeMaxZ[slot] = activeMaxZ[last];
+	activeProxies[slot] = activeProxies[last];
+	activeSlots[activeProxies[slot]] = slot;
+
+	activeMinY.pop_back();
+	activeMaxY.pop_back();
+	activeMinZ.pop_back();
+	activeMaxZ.pop_back();
+	activeProxies.pop_back();
+}
+
+void SweepAndPrune::TestActive(unsigned proxy, std::vector<PotentialContact>& contacts) const
+{
+	const Proxy& box = proxies[proxy];
+	unsigned count = (unsigned)activeProxies.size();
+	unsigned i = 0;
+
+	PotentialContact contact;
+	contact.body[1] = box.body;
+
+	// The rounded boxes can only overlap where the exact ones might,
+	// so the exact test is only needed for the few that pass
+	float minY = RoundDown(box.volume.min.y);
+	float maxY = RoundUp(box.volume.max.y);
+	float minZ = RoundDown(box.volume.min.z);
+	float maxZ = RoundUp(box.volume.max.z);
+
+#ifdef PARADOX_SIMD_X86
+	__m128 wideMinY = _mm_set1_ps(minY);
+	__m128 wideMaxY = _mm_set1_ps(maxY);
+	__m128 wideMinZ = _mm_set1_ps(minZ);
+	__m128 wideMaxZ = _mm_set1_ps(maxZ);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 overlapY = _mm_and_ps(
+			_mm_cmple_ps(_mm_loadu_ps(&activeMinY[i]), wideMaxY),
+			_mm_cmple_ps(wideMinY, _mm_loadu_ps(&activeMaxY[i])));
+		__m128 overlapZ = _mm_and_ps(
+			_mm_cmple_ps(_mm_loadu_ps(&activeMinZ[i]), wideMaxZ),
+			_mm_cmple_ps(wideMinZ, _mm_loadu_ps(&activeMaxZ[i])));
+
+		int bits = _mm_movemask_ps(_mm_and_ps(overlapY, overlapZ));
+		for (unsigned lane = 0; bits; lane++, bits >>= 1)
+		{
+			if (!(bits & 1)) continue;
+
+			const Proxy& other = proxies[activeProxies[i + lane]];
+			if (!other.volume.Overlaps(&box.volume)) continue;
+
+			contact.body[0] = other.body;
+			contacts.push_back(contact);
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		if (activeMinY[i] > maxY || minY > activeMaxY[i] || activeMinZ[i] > maxZ || minZ > activeMaxZ[i]) continue;
+
+		const Proxy& other = proxies[activeProxies[i]];
+		if (!other.volume.Overlaps(&box.volume)) continue;
+
+		contact.body[0] = other.body;
+		contacts.push_back(contact);
+	}
+}
+
+unsigned SweepAndPrune::GetPotentialContacts(std::vector<PotentialContact>& contacts)
+{
+	size_t first = contacts.size();
+
+	SortEndpoints();
+
+	activeMinY.clear();
+	activeMaxY.clear();
+	activeMinZ.clear();
+	activeMaxZ.clear();
+	activeProxies.clear();
+	activeSlots.resize(proxies.size());
+
+	// Every box that starts while another is open overlaps it on x
+	for (const Endpoint& endpoint : endpoints)
+	{
+		unsigned proxy = endpoint.data >> 1;
+		if (endpoint.data & 1)
+		{
+			RemoveActive(proxy);
+		}
+		else
+		{
+			TestActive(proxy, contacts);
+			AddActive(proxy);
+		}
+	}
+
+	return (unsigned)(contacts.size() - first);
+}
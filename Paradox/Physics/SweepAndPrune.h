@@ -0,0 +1,141 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the sweep and prune broadphase, which finds the
+ * pairs of bodies that may touch by sorting their boxes along an axis.
+ */
+
+#include "CollideCoarse.h"
+#include <vector>
+
+/**
+ * Finds overlapping boxes by keeping the ends of every box sorted
+ * along the x axis, then sweeping along it with a list of the boxes
+ * the sweep is inside. Each box that starts is tested against the
+ * list on y and z, four boxes at a time with SSE where it is there.
+ *
+ * Bodies that move a little each frame only swap with their
+ * neighbours, so the ends are kept in order with an insertion sort
+ * that does almost no work when a scene is mostly at rest. Newly
+ * added boxes are sorted on their own and merged in, so filling the
+ * broadphase with many bodies at once does not go quadratic.
+ *
+ * Boxes are used as given, without any margin, so the pairs found
+ * are exactly the boxes that overlap, touching ones included.
+ */
+class SweepAndPrune
+{
+public:
+	static const unsigned nullProxy = 0xffffffff;
+
+	SweepAndPrune();
+
+	// Adds a body with the given box, returning its' proxy
+	unsigned CreateProxy(const BoundingBoxVolume& volume, RigidBody* body);
+
+	// Removes the body with the given proxy
+	void DestroyProxy(unsigned proxy);
+
+	// Updates the box of a body, ends are resorted at the next search
+	void MoveProxy(unsigned proxy, const BoundingBoxVolume& volume)
+	{
+		proxies[proxy].volume = volume;
+	}
+
+	const BoundingBoxVolume& GetVolume(unsigned proxy) const
+	{
+		return proxies[proxy].volume;
+	}
+
+	RigidBody* GetBody(unsigned proxy) const
+	{
+		return proxies[proxy].body;
+	}
+
+	/**
+	 * Sorts the box ends and finds every pair of bodies whose boxes
+	 * overlap, appending them to the given list. Returns the number
+	 * found.
+	 */
+	unsigned GetPotentialContacts(std::vector<PotentialContact>& contacts);
+
+	unsigned GetProxyCount() const
+	{
+		return proxyCount;
+	}
+
+	// Returns how many swaps the insertion sort made at the last search
+	unsigned GetSwapCount() const
+	{
+		return swapCount;
+	}
+
+private:
+	struct Proxy
+	{
+		BoundingBoxVolume volume;
+
+		// NULL once the proxy is destroyed, then the next free proxy
+		// is held in freeNext
+		RigidBody* body;
+		unsigned freeNext;
+	};
+
+	/**
+	 * One end of a box along the sweep axis. The proxy is held in the
+	 * upper bits and whether it is the far end in the lowest bit, so
+	 * that at equal positions the near ends come first and touching
+	 * boxes are found.
+	 */
+	struct Endpoint
+	{
+		double value;
+		unsigned data;
+
+		bool operator<(const Endpoint& other) const
+		{
+			if (value != other.value) return value < other.value;
+			return (data & 1) < (other.data & 1);
+		}
+	};
+
+	// Brings every end up to date with its' box and puts them in order
+	void SortEndpoints();
+
+	// Tests the box of the given proxy against the active boxes on y
+	// and z, appending a pair for every overlap
+	void TestActive(unsigned proxy, std::vector<PotentialContact>& contacts) const;
+
+	void AddActive(unsigned proxy);
+	void RemoveActive(unsigned proxy);
+
+	std::vector<Proxy> proxies;
+	unsigned freeList;
+	unsigned proxyCount;
+
+	// The ends of every live box, sorted along x after the last search
+	std::vector<Endpoint> endpoints;
+
+	// How many of the ends at the back of the list were added since
+	// the last search and are not yet in order
+	unsigned addedEndpoints;
+
+	unsigned swapCount;
+
+	/**
+	 * The boxes the sweep is inside, with their y and z extents kept
+	 * in arrays of their own so they can be tested in a batch. They
+	 * are held as floats rounded outwards, so four can be tested at
+	 * once, and any overlap found is checked again with the exact box.
+	 */
+	std::vector<float> activeMinY;
+	std::vector<float> activeMaxY;
+	std::vector<float> activeMinZ;
+	std::vector<float> activeMaxZ;
+	std::vector<unsigned> activeProxies;
+
+	// Where each proxy sits in the active arrays
+	std::vector<unsigned> activeSlots;
+};
@@ -1,37 +1,45 @@
 #include "Timing.h"
+#include <chrono>
+#include <ctime>
 
 // Hold internal timing data for the performance counter
 static bool qpcFlag;
 
+#ifdef _WIN32
 #define TIMING_WINDOWS 1
-// assume windows
 
 // Import the high performance timer (c. 4ms)
 #include <windows.h>
 #include <mmsystem.h>
-#include <chrono>
-#include <ctime>
+#include <intrin.h>
 
 static double qpcFrequency;
+#else
+#define TIMING_WINDOWS 0
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif
 
 // Internal time and clock access functions
 unsigned systemTime()
 {
+#if TIMING_WINDOWS
 	if (qpcFlag)
 	{
 		static LONGLONG qpcMillisPerTick;
 		QueryPerformanceCounter((LARGE_INTEGER*)&qpcMillisPerTick);
 		return (unsigned)(qpcMillisPerTick * qpcFrequency);
 	}
-	else
-	{
-		using std::chrono::duration_cast;
-		using std::chrono::milliseconds;
-		using std::chrono::seconds;
-		using std::chrono::system_clock;
+#endif
 
-		auto millisec_since_epoch = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
-	}
+	// Fall back to a monotonic clock when there is no performance counter
+	using std::chrono::duration_cast;
+	using std::chrono::milliseconds;
+	using std::chrono::steady_clock;
+
+	return (unsigned)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
 }
 
 unsigned TimingData::getTime()
@@ -41,7 +49,11 @@ unsigned TimingData::getTime()
 
 unsigned long systemClock()
 {
-	return __rdtsc();
+#if TIMING_WINDOWS || defined(__x86_64__) || defined(__i386__)
+	return (unsigned long)__rdtsc();
+#else
+	return (unsigned long)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
 }
 
 unsigned long TimingData::getClock()
@@ -52,12 +64,16 @@ unsigned long TimingData::getClock()
 // Sets up the timing system and registers the performance timer
 void initTime()
 {
+#if TIMING_WINDOWS
 	LONGLONG time;
-	qpcFlag = (QueryPerformanceCounter((LARGE_INTEGER*)&time) > 0);
+	qpcFlag = (QueryPerformanceFrequency((LARGE_INTEGER*)&time) > 0);
 
 	// Check if we have access to the performance counter at this
 	// resolution.
 	if (qpcFlag) qpcFrequency = 1000.0 / time;
+#else
+	qpcFlag = false;
+#endif
 }
 
 // Holds the global frame time that is passed around
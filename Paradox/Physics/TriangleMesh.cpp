@@ -0,0 +1,350 @@
+#include "TriangleMesh.h"
+#include <algorithm>
+#include <limits>
+#include <math.h>
+
+// Planes tried along the chosen axis when splitting a range
+static const unsigned splitBins = 16;
+
+// Cost of visiting a branch, against testing one triangle at a leaf
+static const double traversalCost = 1.0;
+
+// Returns a box that encloses nothing, to be grown by merging
+static BoundingBoxVolume EmptyVolume()
+{
+	double huge = std::numeric_limits<double>::max();
+	return BoundingBoxVolume(Vector3(huge, huge, huge), Vector3(-huge, -huge, -huge));
+}
+
+// Grows the first box to take in the second
+static inline void Grow(BoundingBoxVolume& volume, const BoundingBoxVolume& other)
+{
+	for (unsigned axis = 0; axis < 3; axis++)
+	{
+		volume.min[axis] = std::min(volume.min[axis], other.min[axis]);
+		volume.max[axis] = std::max(volume.max[axis], other.max[axis]);
+	}
+}
+
+// Grows the box to take in the given point
+static inline void Grow(BoundingBoxVolume& volume, const Vector3& point)
+{
+	for (unsigned axis = 0; axis < 3; axis++)
+	{
+		volume.min[axis] = std::min(volume.min[axis], point[axis]);
+		volume.max[axis] = std::max(volume.max[axis], point[axis]);
+	}
+}
+
+/**
+ * Returns how far along the ray it enters the box, given the inverse
+ * of its' direction, or a negative value if it misses the box or only
+ * meets it past the limit.
+ */
+static inline double RayEntersBox(const Vector3& origin, const Vector3& inverse, double limit,
+	const BoundingBoxVolume& volume)
+{
+	double enter = 0, leave = limit;
+	for (unsigned axis = 0; axis < 3; axis++)
+	{
+		double near = (volume.min[axis] - origin[axis]) * inverse[axis];
+		double far = (volume.max[axis] - origin[axis]) * inverse[axis];
+		if (near > far) std::swap(near, far);
+
+		// A ray lying in the plane of a face gives NaN, which keeps
+		// the limits as they were
+		if (near > enter) enter = near;
+		if (far < leave) leave = far;
+	}
+	return enter <= leave ? enter : -1;
+}
+
+bool RayHitsTriangle(const Vector3& origin, const Vector3& direction, double length,
+	const Vector3& a, const Vector3& b, const Vector3& c, double* distance)
+{
+	Vector3 edgeOne = b - a;
+	Vector3 edgeTwo = c - a;
+	Vector3 p = direction % edgeTwo;
+	double determinant = edgeOne * p;
+
+	// Parallel to the triangle
+	if (determinant == 0) return false;
+	double inverse = 1.0 / determinant;
+
+	Vector3 fromA = origin - a;
+	double u = (fromA * p) * inverse;
+	if (u < 0 || u > 1) return false;
+
+	Vector3 q = fromA % edgeOne;
+	double v = (direction * q) * inverse;
+	if (v < 0 || u + v > 1) return false;
+
+	double t = (edgeTwo * q) * inverse;
+	if (t < 0 || t > length) return false;
+
+	*distance = t;
+	return true;
+}
+
+TriangleMesh::TriangleMesh(unsigned maxLeafTriangles)
+	:
+	maxLeafTriangles(maxLeafTriangles)
+{
+}
+
+void TriangleMesh::Clear()
+{
+	vertices.clear();
+	nodes.clear();
+	corners.clear();
+	triangleIds.clear();
+}
+
+void TriangleMesh::Build(const float* positions, unsigned stride, unsigned vertexCount,
+	const uint32_t* indices, unsigned indexCount)
+{
+	Clear();
+
+	vertices.resize(vertexCount);
+	const char* position = (const char*)positions;
+	for (unsigned i = 0; i < vertexCount; i++, position += stride)
+	{
+		const float* xyz = (const float*)position;
+		vertices[i] = Vector3(xyz[0], xyz[1], xyz[2]);
+	}
+
+	BuildTree(indices, indexCount);
+}
+
+void TriangleMesh::Build(const Vector3* vertices, unsigned vertexCount, const uint32_t* indices, unsigned indexCount)
+{
+	Clear();
+
+	this->vertices.assign(vertices, vertices + vertexCount);
+	BuildTree(indices, indexCount);
+}
+
+void TriangleMesh::BuildTree(const uint32_t* indices, unsigned indexCount)
+{
+	unsigned vertexCount = (unsigned)vertices.size();
+
+	entries.clear();
+	entries.reserve(indexCount / 3);
+	for (unsigned triangle = 0; triangle < indexCount / 3; triangle++)
+	{
+		const uint32_t* corner = indices + 3 * triangle;
+		if (corner[0] >= vertexCount || corner[1] >= vertexCount || corner[2] >= vertexCount) continue;
+
+		const Vector3& a = vertices[corner[0]];
+		const Vector3& b = vertices[corner[1]];
+		const Vector3& c = vertices[corner[2]];
+		if (((b - a) % (c - a)).squareMagnitude() <= 0) continue;
+
+		BuildEntry entry;
+		entry.volume = BoundingBoxVolume(a, a);
+		Grow(entry.volume, b);
+		Grow(entry.volume, c);
+		entry.centre = (entry.volume.min + entry.volume.max) * 0.5;
+		entry.triangle = triangle;
+		entries.push_back(entry);
+	}
+
+	unsigned count = (unsigned)entries.size();
+	if (count == 0)
+	{
+		vertices.clear();
+		return;
+	}
+
+	nodes.reserve(count * 2);
+	BuildRange(0, count);
+
+	// Leaves refer to the triangles in the order they were sorted into
+	corners.resize(3 * count);
+	triangleIds.resize(count);
+	for (unsigned i = 0; i < count; i++)
+	{
+		const uint32_t* corner = indices + 3 * entries[i].triangle;
+		corners[3 * i] = corner[0];
+		corners[3 * i + 1] = corner[1];
+		corners[3 * i + 2] = corner[2];
+		triangleIds[i] = entries[i].triangle;
+	}
+
+	std::vector<BuildEntry>().swap(entries);
+}
+
+void TriangleMesh::BuildRange(unsigned begin, unsigned end)
+{
+	// The box around the triangles, and the one around their centres
+	BoundingBoxVolume volume = entries[begin].volume;
+	BoundingBoxVolume centres(entries[begin].centre, entries[begin].centre);
+	for (unsigned i = begin + 1; i < end; i++)
+	{
+		Grow(volume, entries[i].volume);
+		Grow(centres, entries[i].centre);
+	}
+
+	unsigned index = (unsigned)nodes.size();
+	TriangleMeshNode node;
+	node.volume = volume;
+	node.secondChild = 0;
+	node.firstTriangle = begin;
+	node.triangleCount = end - begin;
+	nodes.push_back(node);
+
+	unsigned middle;
+	if (!Split(begin, end, volume, centres, &middle)) return;
+
+	nodes[index].firstTriangle = 0;
+	nodes[index].triangleCount = 0;
+
+	BuildRange(begin, middle);
+	nodes[index].secondChild = (unsigned)nodes.size();
+	BuildRange(middle, end);
+}
+
+bool TriangleMesh::Split(unsigned begin, unsigned end, const BoundingBoxVolume& volume,
+	const BoundingBoxVolume& centres, unsigned* middle)
+{
+	unsigned count = end - begin;
+	if (count == 1) return false;
+
+	// Split along the axis the centres are most spread on
+	const Vector3& low = centres.min;
+	unsigned axis = 0;
+	Vector3 spread = centres.max - centres.min;
+	if (spread.y > spread[axis]) axis = 1;
+	if (spread.z > spread[axis]) axis = 2;
+
+	// All the centres in one place, there is no plane between them
+	if (spread[axis] <= 0)
+	{
+		if (count <= maxLeafTriangles) return false;
+		*middle = begin + count / 2;
+		return true;
+	}
+
+	// Drop every triangle into a bin by its' centre
+	BoundingBoxVolume binVolumes[splitBins];
+	unsigned binCounts[splitBins];
+	for (unsigned bin = 0; bin < splitBins; bin++)
+	{
+		binVolumes[bin] = EmptyVolume();
+		binCounts[bin] = 0;
+	}
+
+	double scale = splitBins / spread[axis];
+	for (unsigned i = begin; i < end; i++)
+	{
+		unsigned bin = std::min(splitBins - 1, (unsigned)((entries[i].centre[axis] - low[axis]) * scale));
+		Grow(binVolumes[bin], entries[i].volume);
+		binCounts[bin]++;
+	}
+
+	// Sweep from the right to find the cost of everything past each
+	// plane, then from the left to find the best plane
+	double rightCosts[splitBins];
+	BoundingBoxVolume right = EmptyVolume();
+	unsigned rightCount = 0;
+	for (unsigned plane = splitBins - 1; plane > 0; plane--)
+	{
+		Grow(right, binVolumes[plane]);
+		rightCount += binCounts[plane];
+		rightCosts[plane] = rightCount > 0 ? right.GetSurfaceArea() * rightCount : 0;
+	}
+
+	unsigned bestPlane = 0;
+	double bestCost = std::numeric_limits<double>::max();
+	BoundingBoxVolume left = EmptyVolume();
+	unsigned leftCount = 0;
+	for (unsigned plane = 1; plane < splitBins; plane++)
+	{
+		Grow(left, binVolumes[plane - 1]);
+		leftCount += binCounts[plane - 1];
+		if (leftCount == 0 || leftCount == count) continue;
+
+		double cost = left.GetSurfaceArea() * leftCount + rightCosts[plane];
+		if (cost < bestCost)
+		{
+			bestCost = cost;
+			bestPlane = plane;
+		}
+	}
+
+	// Keep small ranges whole when testing every triangle is cheaper
+	double area = volume.GetSurfaceArea();
+	if (count <= maxLeafTriangles && count * area <= traversalCost * area + bestCost) return false;
+
+	BuildEntry* first = entries.data() + begin;
+	BuildEntry* split = std::partition(first, entries.data() + end,
+		[&](const BuildEntry& entry)
+		{
+			unsigned bin = std::min(splitBins - 1, (unsigned)((entry.centre[axis] - low[axis]) * scale));
+			return bin < bestPlane;
+		});
+
+	*middle = begin + (unsigned)(split - first);
+	return true;
+}
+
+bool TriangleMesh::RayCast(const Vector3& origin, const Vector3& direction, double length, TriangleRayHit* hit) const
+{
+	if (nodes.empty()) return false;
+
+	Vector3 inverse(1.0 / direction.x, 1.0 / direction.y, 1.0 / direction.z);
+
+	double nearest = length;
+	unsigned found = 0xffffffff;
+
+	stack.clear();
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		unsigned index = stack.back();
+		stack.pop_back();
+
+		const TriangleMeshNode& node = nodes[index];
+		if (node.IsLeaf())
+		{
+			for (unsigned i = node.firstTriangle; i < node.firstTriangle + node.triangleCount; i++)
+			{
+				double distance;
+				if (RayHitsTriangle(origin, direction, nearest,
+					vertices[corners[3 * i]], vertices[corners[3 * i + 1]], vertices[corners[3 * i + 2]], &distance))
+				{
+					nearest = distance;
+					found = i;
+				}
+			}
+			continue;
+		}
+
+		// Visit the nearer child first, so that its' hits cut the
+		// search of the further one short
+		unsigned first = index + 1, second = node.secondChild;
+		double firstEnter = RayEntersBox(origin, inverse, nearest, nodes[first].volume);
+		double secondEnter = RayEntersBox(origin, inverse, nearest, nodes[second].volume);
+		if (firstEnter >= 0 && secondEnter >= 0 && secondEnter < firstEnter)
+		{
+			std::swap(first, second);
+			std::swap(firstEnter, secondEnter);
+		}
+		if (secondEnter >= 0) stack.push_back(second);
+		if (firstEnter >= 0) stack.push_back(first);
+	}
+
+	if (found == 0xffffffff) return false;
+
+	const Vector3& a = vertices[corners[3 * found]];
+	const Vector3& b = vertices[corners[3 * found + 1]];
+	const Vector3& c = vertices[corners[3 * found + 2]];
+
+	hit->triangle = triangleIds[found];
+	hit->distance = nearest;
+	hit->point = origin + direction * nearest;
+	hit->normal = (b - a) % (c - a);
+	hit->normal.normalise();
+	if (hit->normal * direction > 0) hit->normal *= -1;
+	return true;
+}
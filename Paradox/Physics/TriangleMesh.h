@@ -0,0 +1,214 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the static triangle mesh collider, built from
+ * loaded geometry such as a Model's vertices and indices, with a
+ * bounding box tree over its' triangles for contacts and ray casts.
+ */
+
+#include "CollideCoarse.h"
+#include <cstdint>
+#include <vector>
+
+// Where a ray met a triangle of a mesh or heightfield
+struct TriangleRayHit
+{
+	// The triangle met, numbered as it was given to the collider
+	unsigned triangle;
+
+	// How far along the direction the hit is
+	double distance;
+
+	Vector3 point;
+
+	// The triangle's normal, facing back against the ray
+	Vector3 normal;
+};
+
+/**
+ * Finds where the ray from the origin along the direction meets the
+ * triangle, from either side, after Moller and Trumbore. Returns false
+ * if it misses, or meets it further than the given length away.
+ */
+bool RayHitsTriangle(const Vector3& origin, const Vector3& direction, double length,
+	const Vector3& a, const Vector3& b, const Vector3& c, double* distance);
+
+/**
+ * A node of the mesh's tree, stored depth first as the static tree's
+ * nodes are: the first child of a branch is the node after it.
+ */
+struct TriangleMeshNode
+{
+	// Encloses every triangle under the node
+	BoundingBoxVolume volume;
+
+	// Branches only, the index of the second child
+	unsigned secondChild;
+
+	// Leaves only, where the leaf's triangles start in the mesh's
+	// sorted list, and how many there are. Zero for branches
+	unsigned firstTriangle;
+	unsigned triangleCount;
+
+	bool IsLeaf() const
+	{
+		return triangleCount > 0;
+	}
+};
+
+/**
+ * Immovable world geometry made of triangles, in world coordinates.
+ *
+ * The triangles are sorted into a bounding box tree built top down
+ * with the binned surface area heuristic, as the static tree is, so
+ * that a body only meets the few triangles near it and a ray only the
+ * few along it. Triangles with no area, or with an index past the end
+ * of the vertices, are left out. Every triangle keeps the number it
+ * had in the index list, which contacts and hits report.
+ *
+ * The mesh has no inside: its' triangles collide from both sides.
+ */
+class TriangleMesh
+{
+public:
+	/**
+	 * Creates an empty mesh. Ranges of at most the given number of
+	 * triangles may be kept as a single leaf.
+	 */
+	TriangleMesh(unsigned maxLeafTriangles = 4);
+
+	/**
+	 * Builds the mesh from the given vertex positions, three floats
+	 * each, the given number of bytes apart, and three indices per
+	 * triangle. The positions may point into an interleaved vertex
+	 * array: a Model is built from &model.vertices[0].position.x with
+	 * a stride of sizeof(Vertex).
+	 */
+	void Build(const float* positions, unsigned stride, unsigned vertexCount,
+		const uint32_t* indices, unsigned indexCount);
+
+	// Builds the mesh from the given vertices and three indices per triangle
+	void Build(const Vector3* vertices, unsigned vertexCount, const uint32_t* indices, unsigned indexCount);
+
+	// Removes every triangle from the mesh
+	void Clear();
+
+	/**
+	 * Calls the given function with the number of every triangle whose
+	 * box overlaps the given one, and the triangle's three corners.
+	 */
+	template <class Callback>
+	void Query(const BoundingBoxVolume& volume, Callback callback) const;
+
+	/**
+	 * Finds the first triangle the ray from the origin along the unit
+	 * direction meets, no further than the given length. Returns false
+	 * if it meets none.
+	 */
+	bool RayCast(const Vector3& origin, const Vector3& direction, double length, TriangleRayHit* hit) const;
+
+	unsigned GetTriangleCount() const
+	{
+		return (unsigned)triangleIds.size();
+	}
+
+	unsigned GetVertexCount() const
+	{
+		return (unsigned)vertices.size();
+	}
+
+	// Returns the box around the whole mesh
+	BoundingBoxVolume GetVolume() const
+	{
+		return nodes.empty() ? BoundingBoxVolume(Vector3(), Vector3()) : nodes[0].volume;
+	}
+
+	const std::vector<TriangleMeshNode>& GetNodes() const
+	{
+		return nodes;
+	}
+
+private:
+	// A triangle being sorted into the tree
+	struct BuildEntry
+	{
+		BoundingBoxVolume volume;
+		Vector3 centre;
+		unsigned triangle;
+	};
+
+	// Sorts the triangles given in the index list into the tree
+	void BuildTree(const uint32_t* indices, unsigned indexCount);
+
+	// Builds the subtree over the given entries onto the end of the
+	// node list, depth first
+	void BuildRange(unsigned begin, unsigned end);
+
+	/**
+	 * Finds the best place to split the given entries, as the static
+	 * tree does. Returns false if keeping them in one leaf is cheaper,
+	 * otherwise sorts the entries so that the first half ends at the
+	 * returned middle.
+	 */
+	bool Split(unsigned begin, unsigned end, const BoundingBoxVolume& volume,
+		const BoundingBoxVolume& centres, unsigned* middle);
+
+	unsigned maxLeafTriangles;
+
+	std::vector<Vector3> vertices;
+	std::vector<TriangleMeshNode> nodes;
+
+	// The corners of each triangle, three to a triangle, and the
+	// number it was given, in the order the leaves refer to them
+	std::vector<uint32_t> corners;
+	std::vector<unsigned> triangleIds;
+
+	// Working storage for the build
+	std::vector<BuildEntry> entries;
+
+	mutable std::vector<unsigned> stack;
+};
+
+template <class Callback>
+void TriangleMesh::Query(const BoundingBoxVolume& volume, Callback callback) const
+{
+	if (nodes.empty()) return;
+
+	stack.clear();
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		unsigned index = stack.back();
+		stack.pop_back();
+
+		const TriangleMeshNode& node = nodes[index];
+		if (!node.volume.Overlaps(&volume)) continue;
+
+		if (node.IsLeaf())
+		{
+			for (unsigned i = node.firstTriangle; i < node.firstTriangle + node.triangleCount; i++)
+			{
+				const Vector3& a = vertices[corners[3 * i]];
+				const Vector3& b = vertices[corners[3 * i + 1]];
+				const Vector3& c = vertices[corners[3 * i + 2]];
+
+				// The leaf's box may be far larger than the triangle
+				bool outside = false;
+				for (unsigned axis = 0; axis < 3 && !outside; axis++)
+				{
+					outside =
+						(a[axis] < volume.min[axis] && b[axis] < volume.min[axis] && c[axis] < volume.min[axis]) ||
+						(a[axis] > volume.max[axis] && b[axis] > volume.max[axis] && c[axis] > volume.max[axis]);
+				}
+				if (!outside) callback(triangleIds[i], a, b, c);
+			}
+		}
+		else
+		{
+			stack.push_back(node.secondChild);
+			stack.push_back(index + 1);
+		}
+	}
+}
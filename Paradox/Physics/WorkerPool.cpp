@@ -0,0 +1,108 @@
+#include "WorkerPool.h"
+
+WorkerPool::WorkerPool(unsigned threadCount)
+	:
+	task(NULL),
+	itemCount(0),
+	nextItem(0),
+	batch(0),
+	workersBusy(0),
+	stopping(false)
+{
+	Start(threadCount);
+}
+
+WorkerPool::~WorkerPool()
+{
+	Stop();
+}
+
+void WorkerPool::SetThreadCount(unsigned threadCount)
+{
+	Stop();
+	Start(threadCount);
+}
+
+void WorkerPool::Start(unsigned threadCount)
+{
+	if (threadCount == 0) threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0) threadCount = 1;
+
+	stopping = false;
+
+	// The calling thread is always one of the workers
+	for (unsigned worker = 1; worker < threadCount; worker++)
+	{
+		threads.push_back(std::thread(&WorkerPool::WorkerMain, this, worker, batch));
+	}
+}
+
+void WorkerPool::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	workReady.notify_all();
+
+	for (std::thread& thread : threads) thread.join();
+	threads.clear();
+}
+
+void WorkerPool::Run(WorkerTask* task, unsigned itemCount)
+{
+	if (itemCount == 0) return;
+
+	// Not worth waking anybody up for
+	if (threads.empty() || itemCount == 1)
+	{
+		for (unsigned item = 0; item < itemCount; item++) task->Execute(item, 0);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->task = task;
+		this->itemCount = itemCount;
+		nextItem = 0;
+		workersBusy = (unsigned)threads.size();
+		batch++;
+	}
+	workReady.notify_all();
+
+	RunItems(0);
+
+	// Wait for the other workers to finish their last items
+	std::unique_lock<std::mutex> lock(mutex);
+	workDone.wait(lock, [this] { return workersBusy == 0; });
+	this->task = NULL;
+}
+
+void WorkerPool::RunItems(unsigned worker)
+{
+	for (;;)
+	{
+		unsigned item = nextItem.fetch_add(1);
+		if (item >= itemCount) break;
+
+		task->Execute(item, worker);
+	}
+}
+
+void WorkerPool::WorkerMain(unsigned worker, unsigned long long lastBatch)
+{
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			workReady.wait(lock, [&] { return stopping || batch != lastBatch; });
+			if (stopping) return;
+			lastBatch = batch;
+		}
+
+		RunItems(worker);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--workersBusy == 0) workDone.notify_one();
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains a small pool of persistent worker threads used
+ * by the world to run independent pieces of work concurrently.
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A batch of independent items of work. Items may run in any order
+ * and on any thread, so they must not write to shared state.
+ */
+class WorkerTask
+{
+public:
+	// Runs the item with the given index on the given worker, worker
+	// 0 is the thread that called WorkerPool::Run
+	virtual void Execute(unsigned item, unsigned worker) = 0;
+};
+
+class WorkerPool
+{
+public:
+	// Creates a pool that runs work on the given number of threads,
+	// including the calling thread. Zero uses one per hardware thread.
+	WorkerPool(unsigned threadCount = 0);
+	~WorkerPool();
+
+	// Returns the number of threads work is spread over
+	unsigned GetThreadCount() const
+	{
+		return (unsigned)threads.size() + 1;
+	}
+
+	// Stops the current threads and starts the given number, zero
+	// uses one per hardware thread
+	void SetThreadCount(unsigned threadCount);
+
+	/**
+	 * Runs items [0, itemCount) of the task, returning once all of
+	 * them are done. The calling thread works on items too.
+	 */
+	void Run(WorkerTask* task, unsigned itemCount);
+
+private:
+	// Runs each batch started after the given one, until stopped
+	void WorkerMain(unsigned worker, unsigned long long lastBatch);
+
+	// Takes items until there are none left
+	void RunItems(unsigned worker);
+
+	void Start(unsigned threadCount);
+	void Stop();
+
+	std::vector<std::thread> threads;
+
+	std::mutex mutex;
+	std::condition_variable workReady;
+	std::condition_variable workDone;
+
+	// The batch being run, and how far through it the workers are
+	WorkerTask* task;
+	unsigned itemCount;
+	std::atomic<unsigned> nextItem;
+
+	// Bumped for every batch so that workers wake exactly once per batch
+	unsigned long long batch;
+	unsigned workersBusy;
+	bool stopping;
+
+	WorkerPool(const WorkerPool&);
+	WorkerPool& operator=(const WorkerPool&);
+};
@@ -0,0 +1,30 @@
+#include "WorldSnapshot.h"
+#include <assert.h>
+#include <string.h>
+
+SnapshotRing::SnapshotRing(void* memory, size_t slotSize, unsigned slotCount)
+	:
+	memory((unsigned char*)memory),
+	slotSize(slotSize),
+	slotCount(slotCount)
+{
+	assert(memory && slotCount > 0 && slotSize >= sizeof(SnapshotHeader));
+	assert(slotSize % sizeof(double) == 0);
+	Clear();
+}
+
+void SnapshotRing::Clear()
+{
+	SnapshotHeader empty = { emptySnapshot, 0, 0, 0 };
+	for (unsigned slot = 0; slot < slotCount; slot++)
+	{
+		memcpy(memory + slot * slotSize, &empty, sizeof(empty));
+	}
+}
+
+bool SnapshotRing::HasFrame(unsigned frame) const
+{
+	SnapshotHeader header;
+	memcpy(&header, GetSlot(frame), sizeof(header));
+	return frame != emptySnapshot && header.frame == frame;
+}
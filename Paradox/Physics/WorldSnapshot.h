@@ -0,0 +1,80 @@
+#pragma once
+
+/**
+ * @file
+ *
+ * This file contains the ring of fixed size slots that World saves
+ * snapshots of its' state into, for rolling the simulation back and
+ * running it forward again.
+ */
+
+#include <cstddef>
+
+/**
+ * Comes first in every slot of a snapshot ring. The rest of the slot
+ * holds each saved field of every body as a column, then the impulses
+ * the solver warm starts from.
+ */
+struct SnapshotHeader
+{
+	// The frame whose start the slot holds, emptySnapshot if none
+	unsigned frame;
+
+	unsigned bodyCount;
+	unsigned impulseCount;
+
+	// Bytes of the slot the snapshot uses, the header included
+	unsigned size;
+};
+
+/**
+ * Holds the snapshots of the last few frames in memory the caller
+ * gives it, one slot per frame, so that saving a snapshot every frame
+ * never allocates. The slot of a frame is its' number modulo the slot
+ * count, so a snapshot stays until the frame that many later is saved.
+ */
+class SnapshotRing
+{
+public:
+	static const unsigned emptySnapshot = 0xffffffff;
+
+	/**
+	 * Splits the given memory, which must outlive the ring, be aligned
+	 * for doubles and be at least slotSize times slotCount bytes, into
+	 * empty slots. World::GetSnapshotSize gives the slot size its'
+	 * snapshots need, which is a whole number of doubles.
+	 */
+	SnapshotRing(void* memory, size_t slotSize, unsigned slotCount);
+
+	// Empties every slot
+	void Clear();
+
+	size_t GetSlotSize() const
+	{
+		return slotSize;
+	}
+
+	unsigned GetSlotCount() const
+	{
+		return slotCount;
+	}
+
+	// Returns the slot the given frame is saved in
+	unsigned char* GetSlot(unsigned frame)
+	{
+		return memory + (frame % slotCount) * slotSize;
+	}
+
+	const unsigned char* GetSlot(unsigned frame) const
+	{
+		return memory + (frame % slotCount) * slotSize;
+	}
+
+	// Returns true if the ring still holds the snapshot of the given frame
+	bool HasFrame(unsigned frame) const;
+
+private:
+	unsigned char* memory;
+	size_t slotSize;
+	unsigned slotCount;
+};
@@ -1,177 +1,53 @@
-#include "Body.h"
+#include "body.h"
 #include <memory.h>
 #include <assert.h>
 
-/* Helper functions from Cyclone Physics System part of the book How To Build a Robust Game Engine
-/**
- * Internal function to do an intertia tensor transform by a quaternion.
- * Note that the implementation of this function was created by an
- * automated code-generator and optimizer.
- */
-static inline void _transformInertiaTensor(Matrix3& iitWorld,
-    const Quaternion& q,
-    const Matrix3& iitBody,
-    const Matrix4& rotmat)
-{
-    double t4 = rotmat.data[0] * iitBody.data[0] +
-        rotmat.data[1] * iitBody.data[3] +
-        rotmat.data[2] * iitBody.data[6];
-    double t9 = rotmat.data[0] * iitBody.data[1] +
-        rotmat.data[1] * iitBody.data[4] +
-        rotmat.data[2] * iitBody.data[7];
-    double t14 = rotmat.data[0] * iitBody.data[2] +
-        rotmat.data[1] * iitBody.data[5] +
-        rotmat.data[2] * iitBody.data[8];
-    double t28 = rotmat.data[4] * iitBody.data[0] +
-        rotmat.data[5] * iitBody.data[3] +
-        rotmat.data[6] * iitBody.data[6];
-    double t33 = rotmat.data[4] * iitBody.data[1] +
-        rotmat.data[5] * iitBody.data[4] +
-        rotmat.data[6] * iitBody.data[7];
-    double t38 = rotmat.data[4] * iitBody.data[2] +
-        rotmat.data[5] * iitBody.data[5] +
-        rotmat.data[6] * iitBody.data[8];
-    double t52 = rotmat.data[8] * iitBody.data[0] +
-        rotmat.data[9] * iitBody.data[3] +
-        rotmat.data[10] * iitBody.data[6];
-    double t57 = rotmat.data[8] * iitBody.data[1] +
-        rotmat.data[9] * iitBody.data[4] +
-        rotmat.data[10] * iitBody.data[7];
-    double t62 = rotmat.data[8] * iitBody.data[2] +
-        rotmat.data[9] * iitBody.data[5] +
-        rotmat.data[10] * iitBody.data[8];
-
-    iitWorld.data[0] = t4 * rotmat.data[0] +
-        t9 * rotmat.data[1] +
-        t14 * rotmat.data[2];
-    iitWorld.data[1] = t4 * rotmat.data[4] +
-        t9 * rotmat.data[5] +
-        t14 * rotmat.data[6];
-    iitWorld.data[2] = t4 * rotmat.data[8] +
-        t9 * rotmat.data[9] +
-        t14 * rotmat.data[10];
-    iitWorld.data[3] = t28 * rotmat.data[0] +
-        t33 * rotmat.data[1] +
-        t38 * rotmat.data[2];
-    iitWorld.data[4] = t28 * rotmat.data[4] +
-        t33 * rotmat.data[5] +
-        t38 * rotmat.data[6];
-    iitWorld.data[5] = t28 * rotmat.data[8] +
-        t33 * rotmat.data[9] +
-        t38 * rotmat.data[10];
-    iitWorld.data[6] = t52 * rotmat.data[0] +
-        t57 * rotmat.data[1] +
-        t62 * rotmat.data[2];
-    iitWorld.data[7] = t52 * rotmat.data[4] +
-        t57 * rotmat.data[5] +
-        t62 * rotmat.data[6];
-    iitWorld.data[8] = t52 * rotmat.data[8] +
-        t57 * rotmat.data[9] +
-        t62 * rotmat.data[10];
+RigidBody::RigidBody()
+{
+    BodyStore::GetDefault().Allocate(this);
 }
 
-/**
- * Inline function that creates a transform matrix from a
- * position and orientation.
- */
-static inline void _calculateTransformMatrix(Matrix4& transformMatrix,
-    const Vector3& position,
-    const Quaternion& orientation)
-{
-    transformMatrix.data[0] = 1 - 2 * orientation.j * orientation.j -
-        2 * orientation.k * orientation.k;
-    transformMatrix.data[1] = 2 * orientation.i * orientation.j -
-        2 * orientation.r * orientation.k;
-    transformMatrix.data[2] = 2 * orientation.i * orientation.k +
-        2 * orientation.r * orientation.j;
-    transformMatrix.data[3] = position.x;
-
-    transformMatrix.data[4] = 2 * orientation.i * orientation.j +
-        2 * orientation.r * orientation.k;
-    transformMatrix.data[5] = 1 - 2 * orientation.i * orientation.i -
-        2 * orientation.k * orientation.k;
-    transformMatrix.data[6] = 2 * orientation.j * orientation.k -
-        2 * orientation.r * orientation.i;
-    transformMatrix.data[7] = position.y;
-
-    transformMatrix.data[8] = 2 * orientation.i * orientation.k -
-        2 * orientation.r * orientation.j;
-    transformMatrix.data[9] = 2 * orientation.j * orientation.k +
-        2 * orientation.r * orientation.i;
-    transformMatrix.data[10] = 1 - 2 * orientation.i * orientation.i -
-        2 * orientation.j * orientation.j;
-    transformMatrix.data[11] = position.z;
+RigidBody::RigidBody(BodyStore* store)
+{
+    store->Allocate(this);
 }
 
-void RigidBody::CalculateDerivedData()
+RigidBody::RigidBody(const RigidBody& other)
 {
-    orientation.Normalize();
+    BodyStore::GetDefault().Allocate(this);
+    store->CopyBody(index, *other.store, other.index);
+}
 
-    // Calculate transform matrix for the body
-    _calculateTransformMatrix(transformationMatrix, position, orientation);
+RigidBody& RigidBody::operator=(const RigidBody& other)
+{
+    if (this != &other) store->CopyBody(index, *other.store, other.index);
+    return *this;
+}
+
+RigidBody::~RigidBody()
+{
+    store->Release(index);
+}
 
-    // Calculate inertia tensor in world space
-    _transformInertiaTensor(inverseInertiaTensorWorld, orientation, inverseInertiaTensor, transformationMatrix);
+void RigidBody::CalculateDerivedData()
+{
+    store->CalculateDerivedData(index, index + 1);
 };
 
 void RigidBody::Integrate(double duration)
 {
-    if (!isAwake) return;
-
-    // Calculate linear acceleration from force inputs
-    lastFrameAcceleration = acceleration;
-    lastFrameAcceleration.addScaledVector(forceAccum, inverseMass);
-
-    // Calculate angular acceleration from torque inputs
-    Vector3 angularAcceleration = inverseInertiaTensorWorld.transform(torqueAccum);
-
-    // Adjust velocities
-    // Update linear velocity from both acceleration and impulse
-    velocity.addScaledVector(lastFrameAcceleration, duration);
-
-    // Update angular velocity from angular acceleration and impulse
-    rotation.addScaledVector(angularAcceleration, duration);
-
-    // Impose drag
-    velocity *= pow(linearDamping, duration);
-    rotation *= pow(angularDamping, duration);
-
-    // Adjust positions
-    // Update linear position
-    position.addScaledVector(velocity, duration);
-
-    // Update angular position
-    orientation.AddScaledVector(rotation, duration);
-
-    // Normalize orientation and update matrices with 
-    // new position and orientation
-
-    CalculateDerivedData();
-
-    ClearAccumulators();
-
-    // Update the kinetic energy store, and possibly
-    // put the body to sleep
-    if (canSleep)
-    {
-        double currentMotion = velocity.scalarProduct(velocity) + rotation.scalarProduct(rotation);
-
-        double bias = pow(0.5, duration);
-        motion = bias * motion + (1 - bias) * currentMotion;
-
-        if (motion < sleepEpsilon) SetAwakeStatus(false);
-        else if (motion > 10 * sleepEpsilon) motion = 10 * sleepEpsilon;
-    }
+    store->Integrate(index, index + 1, duration);
 };
 
 void RigidBody::SetMass(const double mass)
 {
     assert(mass != 0);
-    RigidBody::inverseMass = ((double)1.0 / inverseMass);
+    store->inverseMass[index] = ((double)1.0 / mass);
 };
 
 double RigidBody::GetMass() const
 {
+    double inverseMass = store->inverseMass[index];
     if (inverseMass == 0)
     {
         return INFINITY;
@@ -184,27 +60,27 @@ double RigidBody::GetMass() const
 
 void RigidBody::SetInverseMass(const double inverseMass)
 {
-    RigidBody::inverseMass = inverseMass;
+    store->inverseMass[index] = inverseMass;
 };
 
 double RigidBody::GetInverseMass() const
 {
-    return inverseMass;
+    return store->inverseMass[index];
 };
 
 bool RigidBody::HasFiniteMass() const
 {
-    return inverseMass >= 0.0f;
+    return store->inverseMass[index] >= 0.0f;
 };
 
 void RigidBody::SetInertiaTensor(const Matrix3& inertiaTensor)
 {
-    inverseInertiaTensor.setInverse(inertiaTensor);
+    store->inverseInertiaTensor[index].setInverse(inertiaTensor);
 };
 
 void RigidBody::GetInertiaTensor(Matrix3* inertiaTensor) const
 {
-    inertiaTensor->setInverse(inverseInertiaTensor);
+    inertiaTensor->setInverse(store->inverseInertiaTensor[index]);
 };
 
 Matrix3 RigidBody::GetInertiaTensor() const
@@ -216,7 +92,7 @@ Matrix3 RigidBody::GetInertiaTensor() const
 
 void RigidBody::GetInertiaTensorWorld(Matrix3* inertiaTensor) const
 {
-    inertiaTensor->setInverse(inverseInertiaTensorWorld);
+    inertiaTensor->setInverse(store->inverseInertiaTensorWorld[index]);
 };
 
 Matrix3 RigidBody::GetInertiaTensorWorld() const
@@ -228,101 +104,95 @@ Matrix3 RigidBody::GetInertiaTensorWorld() const
 
 void RigidBody::SetInverseInertiaTensor(const Matrix3& inverseInertiaTensor)
 {
-    RigidBody::inverseInertiaTensor = inverseInertiaTensor;
+    store->inverseInertiaTensor[index] = inverseInertiaTensor;
 };
 
 void RigidBody::GetInverseInertiaTensor(Matrix3* inverseInertiaTensor) const
 {
-    *inverseInertiaTensor = RigidBody::inverseInertiaTensor;
+    *inverseInertiaTensor = store->inverseInertiaTensor[index];
 };
 
 Matrix3 RigidBody::GetInverseInertiaTensor() const
 {
-    return inverseInertiaTensor;
+    return store->inverseInertiaTensor[index];
 };
 
 void RigidBody::GetInverseInertiaTensorWorld(Matrix3* inverseInertiaTensor) const
 {
-    *inverseInertiaTensor = inverseInertiaTensorWorld;
+    *inverseInertiaTensor = store->inverseInertiaTensorWorld[index];
 };
 
 Matrix3 RigidBody::GetInverseInertiaTensorWorld() const
 {
-    return inverseInertiaTensorWorld;
+    return store->inverseInertiaTensorWorld[index];
 };
 
 
 void RigidBody::SetDamping(const double linearDamping, const double angularDamping)
 {
-    RigidBody::linearDamping = linearDamping;
-    RigidBody::angularDamping = angularDamping;
+    store->SetDamping(index, linearDamping, angularDamping);
 };
 
 void RigidBody::SetLinearDamping(const double linearDamping)
 {
-    RigidBody::linearDamping = linearDamping;
+    store->SetDamping(index, linearDamping, store->angularDamping[index]);
 };
 
 double RigidBody::GetLinearDamping() const
 {
-    return linearDamping;
+    return store->linearDamping[index];
 };
 
 void RigidBody::SetAngularDamping(const double angularDamping)
 {
-    RigidBody::angularDamping = angularDamping;
+    store->SetDamping(index, store->linearDamping[index], angularDamping);
 };
 
 double RigidBody::GetAngularDamping() const
 {
-    return angularDamping;
+    return store->angularDamping[index];
 };
 
 void RigidBody::SetPosition(const Vector3& position)
 {
-    RigidBody::position = position;
+    store->position.Set(index, position);
 };
 
 void RigidBody::SetPosition(const double x, const double y, const double z)
 {
-    position.x = x;
-    position.y = y;
-    position.z = z;
+    store->position.Set(index, Vector3(x, y, z));
 };
 
 void RigidBody::GetPosition(Vector3* position) const
 {
-    *position = RigidBody::position;
+    *position = store->position.Get(index);
 };
 
 Vector3 RigidBody::GetPosition() const
 {
-    return position;
+    return store->position.Get(index);
 };
 
 void RigidBody::SetOrientation(const Quaternion& orientation)
 {
-    RigidBody::orientation = orientation;
-    RigidBody::orientation.Normalize();
+    Quaternion q = orientation;
+    q.Normalize();
+    store->orientation.Set(index, q);
 };
 
 void RigidBody::SetOrientation(const double r, const double i, const double j, const double k)
 {
-    orientation.r = r;
-    orientation.i = i;
-    orientation.j = j;
-    orientation.k = k;
-    orientation.Normalize();
+    SetOrientation(Quaternion(r, i, j, k));
 };
 
 void RigidBody::GetOrientation(Quaternion* orientation) const
 {
-    *orientation = RigidBody::orientation;
+    *orientation = store->orientation.Get(index);
 };
 
 Quaternion RigidBody::GetOrientation() const
 {
-    return orientation;
+    return store->orientation.Get(index);
 };
 
 void RigidBody::GetOrientation(Matrix3* matrix) const
@@ -332,6 +202,8 @@ void RigidBody::GetOrientation(Matrix3* matrix) const
 
 void RigidBody::GetOrientation(double matrix[9]) const
 {
+    const Matrix4& transformationMatrix = store->transformationMatrix[index];
+
     matrix[0] = transformationMatrix.data[0];
     matrix[1] = transformationMatrix.data[1];
     matrix[2] = transformationMatrix.data[2];
@@ -347,183 +219,183 @@ void RigidBody::GetOrientation(double matrix[9]) const
 
 void RigidBody::GetTransform(Matrix4* transform) const
 {
-    memcpy(transform, &transformationMatrix.data, sizeof(Matrix4));
+    *transform = store->transformationMatrix[index];
 };
 
 void RigidBody::GetTransform(double matrix[16]) const
 {
-    memcpy(matrix, &transformationMatrix.data, sizeof(double) * 12);
+    memcpy(matrix, store->transformationMatrix[index].data, sizeof(double) * 12);
     matrix[12] = matrix[13] = matrix[14] = 0;
     matrix[15] = 1;
 };
 
 Matrix4 RigidBody::GetTransform() const
 {
-    return transformationMatrix;
+    return store->transformationMatrix[index];
 };
 
 Vector3 RigidBody::GetPointInLocalSpace(const Vector3& point) const
 {
-    return transformationMatrix.transformInverse(point);
+    return store->transformationMatrix[index].transformInverse(point);
 };
 
 Vector3 RigidBody::GetPointInWorldSpace(const Vector3& point) const
 {
-    return transformationMatrix.transform(point);
+    return store->transformationMatrix[index].transform(point);
 };
 
 Vector3 RigidBody::GetDirectionInLocalSpace(const Vector3& direction) const
 {
-    return transformationMatrix.transformInverseDirection(direction);
+    return store->transformationMatrix[index].transformInverseDirection(direction);
 };
 
 Vector3 RigidBody::GetDirectionInWorldSpace(const Vector3& direction) const
 {
-    return transformationMatrix.transformDirection(direction);
+    return store->transformationMatrix[index].transformDirection(direction);
 };
 
 void RigidBody::SetVelocity(const Vector3& velocity)
 {
-    RigidBody::velocity = velocity;
+    store->velocity.Set(index, velocity);
 };
 
 void RigidBody::SetVelocity(const double x, const double y, const double z)
 {
-    velocity.x = x;
-    velocity.y = y;
-    velocity.z = z;
+    store->velocity.Set(index, Vector3(x, y, z));
 };
 
 void RigidBody::GetVelocity(Vector3* velocity) const
 {
-    *velocity = RigidBody::velocity;
+    *velocity = store->velocity.Get(index);
 };
 
 Vector3 RigidBody::GetVelocity() const
 {
-    return velocity;
+    return store->velocity.Get(index);
 };
 
 void RigidBody::AddVelocity(const Vector3& deltaVelocity)
 {
-    velocity += deltaVelocity;
+    store->velocity.x[index] += deltaVelocity.x;
+    store->velocity.y[index] += deltaVelocity.y;
+    store->velocity.z[index] += deltaVelocity.z;
 };
 void RigidBody::SetRotation(const Vector3& rotation)
 {
-    RigidBody::rotation = rotation;
+    store->rotation.Set(index, rotation);
 };
 
 void RigidBody::SetRotation(const double x, const double y, const double z)
 {
-    rotation.x = x;
-    rotation.y = y;
-    rotation.z = z;
+    store->rotation.Set(index, Vector3(x, y, z));
 };
 
 void RigidBody::GetRotation(Vector3* rotation)
 {
-    *rotation = RigidBody::rotation;
+    *rotation = store->rotation.Get(index);
 };
 
 Vector3 RigidBody::GetRotation() const
 {
-    return rotation;
+    return store->rotation.Get(index);
 };
 
 void RigidBody::AddRotation(const Vector3& deltaRotation)
 {
-    rotation += deltaRotation;
+    store->rotation.x[index] += deltaRotation.x;
+    store->rotation.y[index] += deltaRotation.y;
+    store->rotation.z[index] += deltaRotation.z;
 };
 
 void RigidBody::SetAwakeStatus(const bool awake)
 {
-    if (awake)
-    {
-        isAwake = true;
-
-        // Add some motion to stop RB falling asleep immediately
-        motion = sleepEpsilon * 2.0f;
-    }
-    else
-    {
-        isAwake = false;
-        velocity.clear();
-        rotation.clear();
-    }
+    store->SetAwake(index, awake);
 };
 
 void RigidBody::SetCanSleep(const bool canSleep)
 {
-    RigidBody::canSleep = canSleep;
+    store->canSleep[index] = canSleep;
+
+    if (!canSleep && !GetAwakeStatus()) SetAwakeStatus();
+}
 
-    if (!canSleep && !isAwake) SetAwakeStatus();
+void RigidBody::SetContinuousRadius(const double radius)
+{
+    store->SetContinuousRadius(index, radius);
 }
 
 void RigidBody::GetLastFrameAcceleration(Vector3* acceleration) const
 {
-    *acceleration = lastFrameAcceleration;
+    *acceleration = store->lastFrameAcceleration.Get(index);
 }
 
 Vector3 RigidBody::GetLastFrameAcceleration() const
 {
-    return acceleration;
+    return store->lastFrameAcceleration.Get(index);
 }
 
 void RigidBody::ClearAccumulators()
 {
-    forceAccum.clear();
-    torqueAccum.clear();
+    store->forceAccum.Clear(index);
+    store->torqueAccum.Clear(index);
 }
 
 void RigidBody::AddForce(const Vector3& force)
 {
-    forceAccum += force;
-    isAwake = true;
+    store->forceAccum.x[index] += force.x;
+    store->forceAccum.y[index] += force.y;
+    store->forceAccum.z[index] += force.z;
+    store->isAwake[index] = true;
 }
 
 void RigidBody::AddForceAtBodyPoint(const Vector3& force, const Vector3& point)
 {
     // Convert to coordinates to world space
     Vector3 wsPoint = GetPointInWorldSpace(point);
-    AddForceAtPoint(force, point);
+    AddForceAtPoint(force, wsPoint);
 }
 
 void RigidBody::AddForceAtPoint(const Vector3& force, const Vector3& point)
 {
     // Convert to coordinates relative to center of mass
     Vector3 pt = point;
-    pt -= position;
+    pt -= GetPosition();
 
-    forceAccum += force;
-    torqueAccum += pt % force;
+    Vector3 torque = pt % force;
+    store->forceAccum.x[index] += force.x;
+    store->forceAccum.y[index] += force.y;
+    store->forceAccum.z[index] += force.z;
+    store->torqueAccum.x[index] += torque.x;
+    store->torqueAccum.y[index] += torque.y;
+    store->torqueAccum.z[index] += torque.z;
 
-    isAwake = true;
+    store->isAwake[index] = true;
 }
 
 void RigidBody::AddTorque(const Vector3& torque)
 {
-    torqueAccum += torque;
-    isAwake = true;
+    store->torqueAccum.x[index] += torque.x;
+    store->torqueAccum.y[index] += torque.y;
+    store->torqueAccum.z[index] += torque.z;
+    store->isAwake[index] = true;
 }
 
 void RigidBody::SetAcceleration(const Vector3& acceleration)
 {
-    RigidBody::acceleration = acceleration;
+    store->acceleration.Set(index, acceleration);
 }
 
 void RigidBody::SetAcceleration(const double x, const double y, const double z)
 {
-    acceleration.x = x;
-    acceleration.y = y;
-    acceleration.z = z;
+    store->acceleration.Set(index, Vector3(x, y, z));
 }
 
 void RigidBody::GetAcceleration(Vector3* acceleration) const
 {
-    *acceleration = RigidBody::acceleration;
+    *acceleration = store->acceleration.Get(index);
 }
 
 Vector3 RigidBody::GetAcceleration() const
 {
-    return acceleration;
+    return store->acceleration.Get(index);
 }
\ No newline at end of file
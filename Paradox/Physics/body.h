@@ -1,35 +1,53 @@
 #pragma once
 
 #include "../ParadoxMath.h"
-
-using namespace DirectX;
+#include "BodyStore.h"
 
 class RigidBody
 {
+	friend class BodyStore;
+
 protected:
-	double inverseMass;
-	Matrix3 inverseInertiaTensor;
-	double linearDamping;
-	double angularDamping;
-	Vector3 position;
-	Quaternion orientation;
-	Vector3 velocity;
-	Vector3 rotation;
-	
-	// Derived Data:
-	Matrix3 inverseInertiaTensorWorld;
-	double motion;
-	bool isAwake;
-	bool canSleep;
-	Matrix4 transformationMatrix;
-
-	// Force and Torque Accumulators:
-	Vector3 forceAccum;
-	Vector3 torqueAccum;
-	Vector3 acceleration;
-	Vector3 lastFrameAcceleration;
+	// The state of the body lives in a BodyStore, the rigid body is
+	// a view onto one index of it. Bodies are held by the default
+	// store until they are added to a world.
+	BodyStore* store;
+	unsigned index;
 
 public:
+	// Creates a body in the default store
+	RigidBody();
+
+	// Creates a body in the given store
+	explicit RigidBody(BodyStore* store);
+
+	// Creates a body in the default store with a copy of the given bodys' state
+	RigidBody(const RigidBody& other);
+
+	// Copies the state of the given body, this body stays in its' own store
+	RigidBody& operator=(const RigidBody& other);
+
+	// Removes the body from its' store
+	~RigidBody();
+
+	BodyStore* GetStore() const
+	{
+		return store;
+	}
+
+	// Returns the handle of this body within its' store
+	BodyHandle GetHandle() const
+	{
+		return store->GetHandle(index);
+	}
+
+	// Returns the dense index of this body within its' store, this
+	// changes when other bodies are removed from the store
+	unsigned GetStoreIndex() const
+	{
+		return index;
+	}
+
 	void CalculateDerivedData();
 
 	// Integrates the rigidbody forward by the given amount
@@ -124,7 +142,7 @@ public:
 
 	bool GetAwakeStatus() const
 	{
-		return isAwake;
+		return store->isAwake[index] != 0;
 	}
 
 	// Sets the awake state of the body
@@ -135,7 +153,7 @@ public:
 
 	bool GetCanSleepProperty() const
 	{
-		return canSleep;
+		return store->canSleep[index] != 0;
 	}
 
 	// Sets CanSleep property.
@@ -144,6 +162,20 @@ public:
 	// predictable should be kept awake
 	void SetCanSleep(const bool canSleep = true);
 
+	double GetContinuousRadius() const
+	{
+		return store->continuousRadius[index];
+	}
+
+	// Turns on continuous collision detection for the body, so that a
+	// fast body cannot pass through thin shapes between two steps.
+	// Each step the world sweeps a sphere of the given radius about the
+	// body's centre along its' path, and stops the body where the sphere
+	// first meets a query shape. The sphere should fit inside the body's
+	// own shapes, so that it does not meet what the body rests on.
+	// Zero turns it off.
+	void SetContinuousRadius(const double radius);
+
 	/////////////////////////////////////////////
 	// Retrieval functions for Dynamic Quantities
 	/////////////////////////////////////////////
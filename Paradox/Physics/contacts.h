@@ -1,33 +1,55 @@
 #pragma once
-#include "Body.h"
+#include "body.h"
+#include <vector>
 
 //Forward declaration
 class ContactResolver;
+class ImpulseSolver;
+class ContactArena;
 
 // The contact has no callable functions, it just holds the contact details
 // To resolve a set of contacts, use the contact resolver class
-class Contact
+//
+// The fields are laid out hottest first. The resolver looks through
+// every contact of a set for the worst one, and then at the bodies of
+// each to see if it shares one with the contact just resolved, so the
+// bodies, penetration and desired velocity change share the first 32
+// bytes, which the alignment keeps within one cache line. The fields
+// only the generators and the pair caches use come last.
+class alignas(32) Contact
 {
 	friend class ContactResolver;
+	friend class ImpulseSolver;
 
 public:
 	
 	RigidBody* body[2];
-	double friction;
-	double restitution;
-	Vector3 contactPoint;
-	// Direction of the normal in world coordinates
-	Vector3 contactNormal;
 	double penetration;
 
-	void SetBodyData(RigidBody* one, RigidBody* two, double friction, double restitution);
+protected:
+	double desiredDeltaVelocity;
+	Vector3 contactVelocity;
+
+public:
+	// Direction of the normal in world coordinates
+	Vector3 contactNormal;
+	double friction;
+	double restitution;
 
 protected:
 	Matrix3 contactToWorld;
-	Vector3 contactVelocity;
-	double desiredDeltaVelocity;
 	Vector3 relativeContactPosition[2];
 
+public:
+	Vector3 contactPoint;
+
+	// Identifies the features of the two bodies that touch, so that the
+	// contact can be matched with the same one in the next frame. Zero
+	// if the generator does not know, SetBodyData resets it to zero.
+	unsigned feature;
+
+	void SetBodyData(RigidBody* one, RigidBody* two, double friction, double restitution);
+
 protected:
 	// Called before the resolution algorithm tries to do any resolution
 	// should never need to be called manually
@@ -58,6 +80,16 @@ protected:
 	// in the given variable
 	void ApplyImpulse(const Vector3& impulse, RigidBody* body, Vector3* velocityChange, Vector3* rotationChange);
 
+	// Updates the closing velocity after the given contact was resolved
+	// with the given changes to the velocities of its' bodies
+	void MatchVelocityChange(const Contact& resolved, const Vector3 velocityChange[2],
+							 const Vector3 rotationChange[2], double duration);
+
+	// Updates the penetration after the given contact was resolved
+	// with the given movements of its' bodies
+	void MatchPositionChange(const Contact& resolved, const Vector3 linearChange[2],
+							 const Vector3 angularChange[2]);
+
 	// Performs an inertia-weighted impulse based resolution of this contact alone
 	void ApplyVelocityChange(Vector3 velocityChange[2], Vector3 rotationChange[2]);
 
@@ -75,6 +107,54 @@ protected:
 	Vector3 CalculateFrictionImpulse(Matrix3* inverseInertiaTensor);
 };
 
+/**
+ * An indexed max-heap of contact severities. The top is the item with
+ * the largest key, with ties going to the lowest item, and any item's
+ * key can be changed in place.
+ */
+class SeverityHeap
+{
+public:
+	// Fills the heap with items [0, count) whose keys are then set with SetKey
+	void Reset(unsigned count);
+
+	void SetKey(unsigned item, double key)
+	{
+		keys[item] = key;
+	}
+
+	// Orders the heap once every key has been set
+	void Heapify();
+
+	// Changes the key of an item and restores the heap order
+	void Update(unsigned item, double key);
+
+	unsigned Top() const
+	{
+		return heap[0];
+	}
+
+	double GetKey(unsigned item) const
+	{
+		return keys[item];
+	}
+
+private:
+	// Checks whether item one belongs above item two
+	bool Before(unsigned one, unsigned two) const
+	{
+		return keys[one] > keys[two] || (keys[one] == keys[two] && one < two);
+	}
+
+	void SiftUp(unsigned position);
+	void SiftDown(unsigned position);
+	void Place(unsigned position, unsigned item);
+
+	std::vector<double> keys;
+	std::vector<unsigned> heap;
+	std::vector<unsigned> positions;
+};
+
 class ContactResolver
 {
 public:
@@ -120,6 +200,14 @@ protected:
 						 unsigned numContacts,
 						 double duration);
 
+	// Builds the lists of contacts touching each body, so that resolving
+	// a contact only updates the contacts that share a body with it
+	void BuildBodyContacts(Contact* contacts, unsigned numContacts);
+
+	// Fills neighbours with the contacts sharing a body with the given
+	// one, including itself, and returns how many there are
+	unsigned GatherNeighbours(const Contact* contacts, unsigned index);
+
 protected:
 	unsigned velocityIterations;
 	unsigned positionIterations;
@@ -138,7 +226,20 @@ public:
 	unsigned positionIterationsUsed;
 
 private:
-	bool validSettings;
+	// Every (body, contact * 2 + slot) pair, grouped by body
+	std::vector<std::pair<const RigidBody*, unsigned>> bodyContacts;
+
+	// The range of bodyContacts holding the body in each contact slot
+	std::vector<unsigned> bodyContactsBegin;
+	std::vector<unsigned> bodyContactsEnd;
+
+	// Scratch space for GatherNeighbours, contacts already gathered
+	// are stamped with the current pass
+	std::vector<unsigned> neighbours;
+	std::vector<unsigned> gatheredStamp;
+	unsigned stamp;
+
+	SeverityHeap severities;
 };
 
 class ContactGenerator
@@ -148,4 +249,35 @@ public:
 	// The contact pointer should point to the first available contact
 	// in a contact array
 	virtual unsigned AddContact(Contact* nextContact, unsigned limit) = 0;
+
+	// Called before the generator is run again in the same step, as the
+	// contacts it found filled the room it was given. A generator that
+	// keeps caches from step to step puts them back to how they were
+	// at the start of the step, so that it finds the same contacts
+	virtual void RestartContacts() {}
+
+	/**
+	 * A generator whose work splits into parts that can run at the same
+	 * time, such as ranges of the broadphase's pairs, returns how many
+	 * parts it has this step, and the world runs them on its' workers
+	 * in place of AddContact. Zero, the default, has AddContact called
+	 * instead. Called on the world's thread.
+	 */
+	virtual unsigned BeginContactParts()
+	{
+		return 0;
+	}
+
+	/**
+	 * Generates the contacts of one part, appending them to the given
+	 * arena and growing it as they need. Parts run on any thread, at
+	 * the same time as each other and the parts of other generators,
+	 * so they must only read state they share. The contacts of each
+	 * part are put after those of the part before, so the contacts
+	 * do not depend on the number of threads.
+	 */
+	virtual void AddContactPart(unsigned /*part*/, ContactArena& /*output*/) {}
+
+	// Called on the world's thread once every part has run
+	virtual void EndContactParts() {}
 };
\ No newline at end of file
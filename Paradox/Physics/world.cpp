@@ -1,74 +1,740 @@
+#include <algorithm>
 #include <cstdlib>
-#include "World.h"
+#include <chrono>
+#include <string.h>
+#include "world.h"
+
+// Returns the seconds elapsed since the given time point
+static double SecondsSince(const std::chrono::steady_clock::time_point& start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Below this many bodies in the tree its' pairs are found on one thread
+static const unsigned minParallelProxies = 1024;
+
+// Below this many queries in a batch they are run on one thread
+static const unsigned minParallelQueries = 256;
+
+// The room each contact generator part starts with, they grow from there
+static const unsigned minPartContacts = 64;
+
+// Marks a handle slot whose body the broadphase does not track
+static const unsigned noBroadphaseEntry = 0xffffffff;
 
 World::World(unsigned maxContacts, unsigned iterations)
 	:
-	firstBody(NULL),
 	resolver(iterations),
+	solverType(ContactSolverType::Resolver),
 	firstContactGenerator(NULL),
-	maxContacts(maxContacts)
+	contacts(maxContacts),
+	overflowContacts(minPartContacts),
+	broadphaseType(BroadphaseType::None)
 {
-	contacts = new Contact[maxContacts];
+	islandContacts.resize(contacts.GetCapacity());
+	islands.Reserve(maxContacts);
+	resolveIslands.world = this;
 	calculateResolverIterations = (iterations == 0);
+	stats = WorldStats();
 }
 
 World::~World()
 {
-	delete[] contacts;
+	// Bodies we made are destroyed with the pool, but must be out of
+	// the store before it is
+	for (unsigned index = bodies.Size(); index > 0; index--)
+	{
+		RigidBody* body = bodies.GetView(index - 1);
+		if (bodyPool.Owns(body)) bodyPool.Destroy(body);
+	}
+
+	// Hand any bodies that outlive us back to the default store
+	BodyStore& defaultStore = BodyStore::GetDefault();
+	while (bodies.Size() > 0)
+	{
+		defaultStore.Adopt(bodies.GetView(bodies.Size() - 1));
+	}
+
+	ContactGenRegistration* currentContactGenReg = firstContactGenerator;
+	while (currentContactGenReg)
+	{
+		ContactGenRegistration* next = currentContactGenReg->next;
+		delete currentContactGenReg;
+		currentContactGenReg = next;
+	}
+}
+
+BodyHandle World::AddBody(RigidBody* body)
+{
+	return bodies.Adopt(body);
+}
+
+void World::RemoveBody(RigidBody* body)
+{
+	if (body->GetStore() != &bodies) return;
+	ClearBroadphaseBounds(body);
+	BodyStore::GetDefault().Adopt(body);
+}
+
+BodyHandle World::CreateBody()
+{
+	return bodyPool.Create(&bodies)->GetHandle();
+}
+
+bool World::DestroyBody(BodyHandle handle)
+{
+	RigidBody* body = GetBody(handle);
+	if (!body || !bodyPool.Owns(body)) return false;
+
+	ClearBroadphaseBounds(body);
+	bodyPool.Destroy(body);
+	return true;
+}
+
+void World::ReserveBodies(unsigned capacity)
+{
+	bodies.Reserve(capacity);
+	bodyPool.Reserve(capacity);
+}
+
+void World::SetBroadphase(BroadphaseType type)
+{
+	if (type == broadphaseType) return;
+
+	// Proxies are made again at the next step if they are needed
+	for (BroadphaseBody& entry : broadphaseBodies) DestroyBroadphaseProxy(entry);
+	broadphaseType = type;
+	potentialContacts.clear();
+}
+
+void World::DestroyBroadphaseProxy(BroadphaseBody& entry)
+{
+	if (entry.proxy == DynamicAABBTree::nullNode) return;
+
+	if (broadphaseType == BroadphaseType::DynamicTree) broadphaseTree.DestroyProxy(entry.proxy);
+	else if (broadphaseType == BroadphaseType::SweepAndPrune) broadphaseSweep.DestroyProxy(entry.proxy);
+	entry.proxy = DynamicAABBTree::nullNode;
+}
+
+unsigned World::FindBroadphaseEntry(const RigidBody* body) const
+{
+	if (body->GetStore() != &bodies) return noBroadphaseEntry;
+
+	unsigned slot = body->GetHandle() & bodyHandleSlotMask;
+	if (slot >= broadphaseEntries.size()) return noBroadphaseEntry;
+
+	// The slot may have been handed to another body since
+	unsigned entry = broadphaseEntries[slot];
+	if (entry >= broadphaseBodies.size() || broadphaseBodies[entry].body != body) return noBroadphaseEntry;
+	return entry;
+}
+
+void World::SetBroadphaseBounds(RigidBody* body, const Vector3& halfSize)
+{
+	if (body->GetStore() != &bodies) return;
+
+	unsigned entry = FindBroadphaseEntry(body);
+	if (entry != noBroadphaseEntry)
+	{
+		broadphaseBodies[entry].halfSize = halfSize;
+		return;
+	}
+
+	unsigned slot = body->GetHandle() & bodyHandleSlotMask;
+	if (slot >= broadphaseEntries.size()) broadphaseEntries.resize(slot + 1, noBroadphaseEntry);
+	broadphaseEntries[slot] = (unsigned)broadphaseBodies.size();
+
+	BroadphaseBody added = { body, halfSize, DynamicAABBTree::nullNode };
+	broadphaseBodies.push_back(added);
+}
+
+void World::ClearBroadphaseBounds(RigidBody* body)
+{
+	unsigned entry = FindBroadphaseEntry(body);
+	if (entry == noBroadphaseEntry) return;
+
+	DestroyBroadphaseProxy(broadphaseBodies[entry]);
+	broadphaseEntries[body->GetHandle() & bodyHandleSlotMask] = noBroadphaseEntry;
+
+	// The last entry takes the place of the cleared one
+	if (entry + 1 < broadphaseBodies.size())
+	{
+		broadphaseBodies[entry] = broadphaseBodies.back();
+		broadphaseEntries[broadphaseBodies[entry].body->GetHandle() & bodyHandleSlotMask] = entry;
+	}
+	broadphaseBodies.pop_back();
+}
+
+void World::SetThreadCount(unsigned threadCount)
+{
+	workers.SetThreadCount(threadCount);
+}
+
+void World::SetContactSolver(ContactSolverType type)
+{
+	solverType = type;
+	impulseCache.Clear();
+}
+
+void World::AddContactGenerator(ContactGenerator* generator)
+{
+	ContactGenRegistration* registration = new ContactGenRegistration;
+	registration->generator = generator;
+	registration->next = NULL;
+	registration->stats = ContactGeneratorStats();
+	registration->partCount = registration->firstPart = 0;
+
+	ContactGenRegistration** tail = &firstContactGenerator;
+	while (*tail) tail = &(*tail)->next;
+	*tail = registration;
 }
 
 void World::StartFrame()
 {
-	BodyRegistration* currentBodyReg = firstBody;
+	bodies.ClearAccumulators(0, bodies.Size());
+	bodies.CalculateDerivedData(0, bodies.Size());
+}
+
+const ContactGeneratorStats* World::GetContactGeneratorStats(const ContactGenerator* generator) const
+{
+	for (ContactGenRegistration* registration = firstContactGenerator; registration; registration = registration->next)
+	{
+		if (registration->generator == generator) return &registration->stats;
+	}
+	return NULL;
+}
+
+void World::ShrinkContacts(unsigned capacity)
+{
+	contacts.Shrink(capacity);
+	islandContacts.resize(contacts.GetCapacity());
+	islandContacts.shrink_to_fit();
+}
 
-	while (currentBodyReg)
+void World::GeneratePartsTask::Execute(unsigned item, unsigned /*worker*/)
+{
+	ContactArena& output = partContacts[item];
+	output.Clear();
+	parts[item].generator->AddContactPart(parts[item].part, output);
+}
+
+unsigned World::RegenerateUnlimited(ContactGenerator* generator, bool ran)
+{
+	overflowContacts.Clear();
+	for (;;)
 	{
-		currentBodyReg->body->ClearAccumulators();
-		currentBodyReg->body->CalculateDerivedData();
+		if (ran) generator->RestartContacts();
+		ran = true;
+		unsigned room = overflowContacts.GetRoom();
+		unsigned used = generator->AddContact(overflowContacts.GetNext(), room);
+		if (used < room) return used;
 
-		currentBodyReg = currentBodyReg->next;
+		overflowContacts.Grow();
 	}
 }
 
 unsigned World::GenerateContacts()
 {
-	unsigned limit = maxContacts;
-	Contact* nextContact = contacts;
+	contacts.Clear();
+	stats.contactsRegenerated = 0;
+	stats.contactOverflows = 0;
+	stats.contactsDropped = 0;
+
+	// Gather the parts of every generator that splits its' work and run
+	// them all at once, so that small generators share the workers
+	generateParts.parts.clear();
+	for (ContactGenRegistration* registration = firstContactGenerator; registration; registration = registration->next)
+	{
+		registration->partCount = registration->generator->BeginContactParts();
+		registration->firstPart = (unsigned)generateParts.parts.size();
+		for (unsigned part = 0; part < registration->partCount; part++)
+		{
+			GeneratePartsTask::Part item = { registration->generator, part };
+			generateParts.parts.push_back(item);
+		}
+	}
+
+	unsigned partCount = (unsigned)generateParts.parts.size();
+	if (generateParts.partContacts.size() < partCount)
+	{
+		generateParts.partContacts.resize(partCount, ContactArena(minPartContacts));
+	}
+	if (partCount > 0) workers.Run(&generateParts, partCount);
 
 	ContactGenRegistration* currentContactGenReg = firstContactGenerator;
 
 	while (currentContactGenReg)
 	{
-		unsigned used = currentContactGenReg->generator->AddContact(nextContact, limit);
-		limit -= used;
-		nextContact += used;
+		ContactGeneratorStats& generatorStats = currentContactGenReg->stats;
+
+		// The contacts of the parts go in the generator's place, in order
+		if (currentContactGenReg->partCount > 0)
+		{
+			currentContactGenReg->generator->EndContactParts();
+
+			unsigned used = 0, dropped = 0;
+			for (unsigned part = 0; part < currentContactGenReg->partCount; part++)
+			{
+				const ContactArena& output = generateParts.partContacts[currentContactGenReg->firstPart + part];
+				unsigned appended = contacts.Append(output.GetContacts(), output.GetCount());
+				dropped += output.GetCount() - appended;
+				used += appended;
+			}
+
+			if (dropped > 0)
+			{
+				generatorStats.overflows++;
+				generatorStats.dropped += dropped;
+				stats.contactOverflows++;
+				stats.contactsDropped += dropped;
+			}
+			generatorStats.generated += used;
+			generatorStats.lastGenerated = used;
+
+			currentContactGenReg = currentContactGenReg->next;
+			continue;
+		}
+
+		// A generator is never run without room, the arena grows first,
+		// and one that is at its' limit has all its' contacts dropped
+		bool ran = false;
+		bool overflowed = contacts.GetRoom() == 0 && !contacts.Grow();
+		unsigned room = contacts.GetRoom();
+		unsigned used = 0;
+		if (!overflowed)
+		{
+			used = currentContactGenReg->generator->AddContact(contacts.GetNext(), room);
+			ran = true;
+		}
+
+		// A generator that filled its' room may have had more contacts,
+		// so it is run again with more room until it has some left over
+		while (!overflowed && used == room)
+		{
+			if (!contacts.Grow())
+			{
+				overflowed = true;
+				break;
+			}
+
+			generatorStats.regenerated++;
+			stats.contactsRegenerated++;
+			currentContactGenReg->generator->RestartContacts();
+			room = contacts.GetRoom();
+			used = currentContactGenReg->generator->AddContact(contacts.GetNext(), room);
+		}
+
+		if (overflowed)
+		{
+			// Run it again where there is no limit to find all it had,
+			// the ones that fit are the same ones it gave the first time
+			unsigned generated = RegenerateUnlimited(currentContactGenReg->generator, ran);
+			used = contacts.Append(overflowContacts.GetContacts(), generated);
 
-		// Check if we've run out of contacts to fill, 
-		// meaning we're missing contacts
-		if (limit <= 0) break;
+			generatorStats.overflows++;
+			generatorStats.dropped += generated - used;
+			stats.contactOverflows++;
+			stats.contactsDropped += generated - used;
+		}
+		else
+		{
+			contacts.Commit(used);
+		}
+		generatorStats.generated += used;
+		generatorStats.lastGenerated = used;
 
 		currentContactGenReg = currentContactGenReg->next;
 	}
 
+	if (islandContacts.size() < contacts.GetCapacity()) islandContacts.resize(contacts.GetCapacity());
+	stats.contactCapacity = contacts.GetCapacity();
+
 	// Return number of contacts used
-	return maxContacts - limit;
+	return contacts.GetCount();
 }
 
 void World::RunPhysics(double duration)
 {
-	BodyRegistration* currentBodyReg = firstBody;
+	std::chrono::steady_clock::time_point phaseStart = std::chrono::steady_clock::now();
+	StartContinuousBodies();
+	double continuousTime = SecondsSince(phaseStart);
+
+	// Integrate every body in one pass over the store
+	phaseStart = std::chrono::steady_clock::now();
+	bodies.Integrate(0, bodies.Size(), duration);
+
+	stats.integrateTime = SecondsSince(phaseStart);
+	stats.bodiesIntegrated = bodies.Size();
+
+	// Only bodies flagged for continuous collision detection are swept
+	phaseStart = std::chrono::steady_clock::now();
+	SweepContinuousBodies();
+	stats.continuousTime = continuousTime + SecondsSince(phaseStart);
+
+	phaseStart = std::chrono::steady_clock::now();
+	UpdateBroadphase(duration);
+	stats.broadphaseTime = SecondsSince(phaseStart);
+	stats.potentialContacts = (unsigned)potentialContacts.size();
+
+	phaseStart = std::chrono::steady_clock::now();
+	unsigned usedContacts = GenerateContacts();
+	stats.generateTime = SecondsSince(phaseStart);
+	stats.contactsGenerated = usedContacts;
 
-	while (currentBodyReg)
+	// Process generated contacts, contacts that cannot affect each
+	// other are resolved separately as the resolver slows down with
+	// the number of contacts it is given
+	phaseStart = std::chrono::steady_clock::now();
+	islands.Build(contacts.GetContacts(), usedContacts, bodies, islandContacts.data());
+
+	unsigned threadCount = workers.GetThreadCount();
+	resolveIslands.duration = duration;
+	if (resolveIslands.resolvers.size() != threadCount) resolveIslands.resolvers.assign(threadCount, resolver);
+	resolveIslands.velocityIterationsUsed.assign(threadCount, 0);
+	resolveIslands.positionIterationsUsed.assign(threadCount, 0);
+
+	if (solverType == ContactSolverType::SequentialImpulse)
 	{
-		// Remove all forces from the accumulator
-		currentBodyReg->body->Integrate(duration);
+		resolveIslands.impulseSolvers.resize(threadCount);
+		for (ImpulseSolver& solver : resolveIslands.impulseSolvers) solver.CopySettings(impulseSolver);
+		impulseCache.BeginFrame(usedContacts);
+	}
 
-		currentBodyReg = currentBodyReg->next;
+	workers.Run(&resolveIslands, islands.GetIslandCount());
+
+	if (solverType == ContactSolverType::SequentialImpulse) impulseCache.EndFrame();
+
+	stats.resolveTime = SecondsSince(phaseStart);
+	stats.islandCount = islands.GetIslandCount();
+	stats.velocityIterationsUsed = stats.positionIterationsUsed = 0;
+	for (unsigned worker = 0; worker < threadCount; worker++)
+	{
+		stats.velocityIterationsUsed += resolveIslands.velocityIterationsUsed[worker];
+		stats.positionIterationsUsed += resolveIslands.positionIterationsUsed[worker];
 	}
 
-	unsigned usedContacts = GenerateContacts();
+	sceneQuery.Update();
+
+	// Hashed after everything that moves bodies, so that a replay can
+	// be checked step by step
+	stats.stateHash = bodies.IsDeterministic() ? bodies.HashState() : 0;
+}
+
+void World::CastRays(const RayQuery* rays, unsigned count, QueryHit* hits)
+{
+	sceneQuery.CastRays(rays, count, hits, count >= minParallelQueries ? &workers : NULL);
+}
+
+void World::SweepSpheres(const SphereSweepQuery* sweeps, unsigned count, QueryHit* hits)
+{
+	sceneQuery.SweepSpheres(sweeps, count, hits, count >= minParallelQueries ? &workers : NULL);
+}
+
+unsigned World::OverlapSpheres(const SphereOverlapQuery* spheres, unsigned count, std::vector<QueryOverlap>& overlaps)
+{
+	return sceneQuery.OverlapSpheres(spheres, count, overlaps, count >= minParallelQueries ? &workers : NULL);
+}
+
+unsigned World::OverlapBoxes(const BoxOverlapQuery* boxes, unsigned count, std::vector<QueryOverlap>& overlaps)
+{
+	return sceneQuery.OverlapBoxes(boxes, count, overlaps, count >= minParallelQueries ? &workers : NULL);
+}
+
+void World::StartContinuousBodies()
+{
+	continuousBodies.clear();
+	continuousStarts.clear();
+	if (bodies.GetContinuousCount() == 0) return;
+
+	for (unsigned b = 0; b < bodies.Size(); b++)
+	{
+		if (bodies.continuousRadius[b] <= 0 || !bodies.isAwake[b]) continue;
+
+		continuousBodies.push_back(b);
+		continuousStarts.push_back(bodies.position.Get(b));
+	}
+}
+
+void World::SweepContinuousBodies()
+{
+	sweptBodies.clear();
+	continuousSweeps.clear();
+	for (size_t i = 0; i < continuousBodies.size(); i++)
+	{
+		unsigned b = continuousBodies[i];
+		double radius = bodies.continuousRadius[b];
+		Vector3 path = bodies.position.Get(b) - continuousStarts[i];
+
+		// A body that moves no further than its' radius has its' shapes
+		// overlap anything it passes at the end of the step or the start
+		double length = path.magnitude();
+		if (length <= radius) continue;
+
+		SphereSweepQuery sweep;
+		sweep.origin = continuousStarts[i];
+		sweep.direction = path * (1.0 / length);
+		sweep.length = length;
+		sweep.radius = radius;
+		sweep.ignoreBody = bodies.GetView(b);
+		continuousSweeps.push_back(sweep);
+		sweptBodies.push_back(b);
+	}
+
+	stats.bodiesSwept = (unsigned)sweptBodies.size();
+	stats.bodiesStopped = 0;
+	if (sweptBodies.empty()) return;
+
+	continuousHits.resize(sweptBodies.size());
+	SweepSpheres(continuousSweeps.data(), (unsigned)continuousSweeps.size(), continuousHits.data());
+
+	for (size_t i = 0; i < sweptBodies.size(); i++)
+	{
+		// Sweeps that start out touching a shape are left to the contacts
+		// the body already has with it
+		const QueryHit& hit = continuousHits[i];
+		if (hit.shape == SceneQuery::nullShape || hit.distance <= 0) continue;
+
+		const SphereSweepQuery& sweep = continuousSweeps[i];
+		unsigned b = sweptBodies[i];
+		bodies.position.Set(b, sweep.origin + sweep.direction * hit.distance);
+		bodies.CalculateDerivedData(b, b + 1);
+
+		// Without the speed it had into the shape the body cannot carry
+		// on into it before its' contacts push it back out
+		Vector3 velocity = bodies.velocity.Get(b);
+		double approach = velocity * hit.normal;
+		if (approach < 0) bodies.velocity.Set(b, velocity - hit.normal * approach);
+		stats.bodiesStopped++;
+	}
+}
+
+void World::UpdateBroadphase(double duration)
+{
+	potentialContacts.clear();
+	if (broadphaseType == BroadphaseType::None) return;
+
+	for (BroadphaseBody& entry : broadphaseBodies)
+	{
+		Matrix4 transform = entry.body->GetTransform();
+
+		// The box around the turned bounds, each world axis takes the
+		// reach of the body's axes along it
+		Vector3 centre = transform.getAxisVector(3);
+		Vector3 extent;
+		for (unsigned axis = 0; axis < 3; axis++)
+		{
+			const double* row = transform.data + axis * 4;
+			extent[axis] = abs(row[0]) * entry.halfSize.x + abs(row[1]) * entry.halfSize.y + abs(row[2]) * entry.halfSize.z;
+		}
+		BoundingBoxVolume volume(centre - extent, centre + extent);
+
+		if (broadphaseType == BroadphaseType::SweepAndPrune)
+		{
+			if (entry.proxy == DynamicAABBTree::nullNode) entry.proxy = broadphaseSweep.CreateProxy(volume, entry.body);
+			else broadphaseSweep.MoveProxy(entry.proxy, volume);
+		}
+		else if (entry.proxy == DynamicAABBTree::nullNode)
+		{
+			entry.proxy = broadphaseTree.CreateProxy(volume, entry.body);
+		}
+		else
+		{
+			broadphaseTree.MoveProxy(entry.proxy, volume, entry.body->GetVelocity() * duration);
+		}
+	}
+
+	if (broadphaseType == BroadphaseType::SweepAndPrune)
+	{
+		broadphaseSweep.GetPotentialContacts(potentialContacts);
+	}
+	else if (workers.GetThreadCount() > 1 && broadphaseTree.GetProxyCount() >= minParallelProxies)
+	{
+		broadphaseTree.GetPotentialContacts(potentialContacts, workers);
+	}
+	else
+	{
+		broadphaseTree.GetPotentialContacts(potentialContacts);
+	}
+
+	// Pairs come out in an order that depends on how the bodies have
+	// moved through the broadphase, which a restored snapshot does not
+	// bring back. In deterministic mode they are put in handle order
+	if (!bodies.IsDeterministic()) return;
+
+	for (PotentialContact& pair : potentialContacts)
+	{
+		if (pair.body[0]->GetHandle() > pair.body[1]->GetHandle()) std::swap(pair.body[0], pair.body[1]);
+	}
+	std::sort(potentialContacts.begin(), potentialContacts.end(),
+		[](const PotentialContact& one, const PotentialContact& two)
+	{
+		BodyHandle oneFirst = one.body[0]->GetHandle(), twoFirst = two.body[0]->GetHandle();
+		if (oneFirst != twoFirst) return oneFirst < twoFirst;
+		return one.body[1]->GetHandle() < two.body[1]->GetHandle();
+	});
+}
+
+void World::ResolveIslandsTask::Execute(unsigned item, unsigned worker)
+{
+	const ContactIsland& island = world->islands.GetIsland(world->islands.GetScheduledIsland(item));
+
+	if (world->solverType == ContactSolverType::SequentialImpulse)
+	{
+		// Each island warm starts from, and writes back to, the cache
+		// slots of its' own contacts
+		ImpulseSolver& solver = impulseSolvers[worker];
+		solver.iterationsUsed = 0;
+		solver.SolveContacts(world->islandContacts.data() + island.firstContact, island.contactCount, duration,
+			&world->impulseCache, island.firstContact);
+
+		velocityIterationsUsed[worker] += solver.iterationsUsed;
+		return;
+	}
+
+	ContactResolver& islandResolver = resolvers[worker];
+
+	// Iterations given to the world apply to each island
+	if (world->calculateResolverIterations) islandResolver.SetIterations(island.contactCount * 4);
+	islandResolver.velocityIterationsUsed = islandResolver.positionIterationsUsed = 0;
+	islandResolver.ResolveContacts(world->islandContacts.data() + island.firstContact, island.contactCount, duration);
+
+	velocityIterationsUsed[worker] += islandResolver.velocityIterationsUsed;
+	positionIterationsUsed[worker] += islandResolver.positionIterationsUsed;
+}
+
+// The columns of doubles a snapshot holds for every body
+static const unsigned snapshotColumns = 23;
+
+// Calls the given function with each column a snapshot holds, in order
+template <class Store, class Visit>
+static void ForEachSnapshotColumn(Store& store, Visit visit)
+{
+	visit(store.position.x); visit(store.position.y); visit(store.position.z);
+	visit(store.orientation.r); visit(store.orientation.i); visit(store.orientation.j); visit(store.orientation.k);
+	visit(store.velocity.x); visit(store.velocity.y); visit(store.velocity.z);
+	visit(store.rotation.x); visit(store.rotation.y); visit(store.rotation.z);
+	visit(store.lastFrameAcceleration.x); visit(store.lastFrameAcceleration.y); visit(store.lastFrameAcceleration.z);
+	visit(store.forceAccum.x); visit(store.forceAccum.y); visit(store.forceAccum.z);
+	visit(store.torqueAccum.x); visit(store.torqueAccum.y); visit(store.torqueAccum.z);
+	visit(store.motion);
+}
+
+// Copies the given number of bytes. An empty vector's data may be
+// null, which memcpy must not be given even when copying nothing
+static void CopySnapshotBytes(void* to, const void* from, size_t size)
+{
+	if (size > 0) memcpy(to, from, size);
+}
+
+// Returns the bytes a snapshot of the given number of bodies and
+// impulses takes. The impulses come straight after the columns of
+// doubles, so that they stay aligned, then the handles and sleep state
+static size_t GetSnapshotBytes(unsigned bodyCount, unsigned impulseCount)
+{
+	size_t size = sizeof(SnapshotHeader) + bodyCount * snapshotColumns * sizeof(double) +
+		impulseCount * sizeof(CachedImpulse) + bodyCount * (sizeof(BodyHandle) + sizeof(unsigned char));
+
+	// Rounded up so that every slot of a ring starts aligned
+	return (size + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+}
+
+size_t World::GetSnapshotSize() const
+{
+	// There is an impulse at most for each contact a step can generate
+	unsigned maxImpulses = contacts.GetCapacity();
+	if (contacts.GetLimit() > maxImpulses) maxImpulses = contacts.GetLimit();
+	return GetSnapshotBytes(bodies.Size(), maxImpulses);
+}
+
+bool World::SaveSnapshot(SnapshotRing& ring, unsigned frame) const
+{
+	unsigned count = bodies.Size();
+	const std::vector<CachedImpulse>& impulses = impulseCache.GetPrevious();
+	SnapshotHeader header = { frame, count, (unsigned)impulses.size(), 0 };
+
+	size_t size = GetSnapshotBytes(count, header.impulseCount);
+	if (size > ring.GetSlotSize() || frame == SnapshotRing::emptySnapshot) return false;
+	header.size = (unsigned)size;
 
-	// Process generated contacts
-	if (calculateResolverIterations) resolver.SetIterations(usedContacts * 4);
-	resolver.ResolveContacts(contacts, usedContacts, duration);
-}
\ No newline at end of file
+	unsigned char* slot = ring.GetSlot(frame);
+	unsigned char* next = slot + sizeof(header);
+	ForEachSnapshotColumn(bodies, [&](const std::vector<double>& column)
+	{
+		CopySnapshotBytes(next, column.data(), count * sizeof(double));
+		next += count * sizeof(double);
+	});
+
+	CopySnapshotBytes(next, impulses.data(), impulses.size() * sizeof(CachedImpulse));
+	next += impulses.size() * sizeof(CachedImpulse);
+
+	for (unsigned b = 0; b < count; b++)
+	{
+		BodyHandle handle = bodies.GetHandle(b);
+		memcpy(next, &handle, sizeof(handle));
+		next += sizeof(handle);
+	}
+	CopySnapshotBytes(next, bodies.isAwake.data(), count);
+
+	memcpy(slot, &header, sizeof(header));
+	return true;
+}
+
+bool World::RestoreSnapshot(const SnapshotRing& ring, unsigned frame)
+{
+	if (!ring.HasFrame(frame)) return false;
+
+	const unsigned char* slot = ring.GetSlot(frame);
+	SnapshotHeader header;
+	memcpy(&header, slot, sizeof(header));
+
+	// The columns are in store order, which adding or removing a body
+	// changes, so the handles must all still be where they were
+	unsigned count = bodies.Size();
+	if (header.bodyCount != count) return false;
+
+	const unsigned char* impulses = slot + sizeof(header) + count * snapshotColumns * sizeof(double);
+	const unsigned char* handles = impulses + header.impulseCount * sizeof(CachedImpulse);
+	for (unsigned b = 0; b < count; b++)
+	{
+		BodyHandle handle;
+		memcpy(&handle, handles + b * sizeof(handle), sizeof(handle));
+		if (handle != bodies.GetHandle(b)) return false;
+	}
+
+	const unsigned char* next = slot + sizeof(header);
+	ForEachSnapshotColumn(bodies, [&](std::vector<double>& column)
+	{
+		CopySnapshotBytes(column.data(), next, count * sizeof(double));
+		next += count * sizeof(double);
+	});
+	CopySnapshotBytes(bodies.isAwake.data(), handles + count * sizeof(BodyHandle), count);
+
+	impulseCache.SetPrevious((const CachedImpulse*)impulses, header.impulseCount);
+
+	// Rebuilding the transforms normalises the orientations, which the
+	// first run only did at the next StartFrame, so the saved ones are
+	// put back to be normalised once as they were
+	bodies.CalculateDerivedData(0, count);
+	next = slot + sizeof(header) + 3 * count * sizeof(double);
+	for (std::vector<double>* column : { &bodies.orientation.r, &bodies.orientation.i, &bodies.orientation.j, &bodies.orientation.k })
+	{
+		CopySnapshotBytes(column->data(), next, count * sizeof(double));
+		next += count * sizeof(double);
+	}
+	sceneQuery.Update();
+	return true;
+}
+
+bool World::Resimulate(SnapshotRing& ring, unsigned fromFrame, unsigned toFrame, double duration, FrameInput* input)
+{
+	if (!RestoreSnapshot(ring, fromFrame)) return false;
+
+	for (unsigned frame = fromFrame; frame < toFrame; frame++)
+	{
+		StartFrame();
+		if (input) input->ApplyInput(this, frame);
+		RunPhysics(duration);
+		SaveSnapshot(ring, frame + 1);
+	}
+	return true;
+}
@@ -1,48 +1,556 @@
 #pragma once
 
-#include "Body.h"
-#include "Contacts.h"
+#include "body.h"
+#include "BodyPool.h"
+#include "contacts.h"
+#include "ContactArena.h"
+#include "DynamicTree.h"
+#include "ImpulseSolver.h"
+#include "Islands.h"
+#include "SceneQuery.h"
+#include "SweepAndPrune.h"
+#include "WorkerPool.h"
+#include "WorldSnapshot.h"
 #include <complex>
 
+/**
+ * Holds the per-step counters and timings recorded by the world
+ * during RunPhysics. Times are given in seconds for the last step.
+ */
+struct WorldStats
+{
+	double integrateTime;
+	double broadphaseTime;
+	double generateTime;
+	double resolveTime;
+	double continuousTime;
+
+	unsigned bodiesIntegrated;
+	unsigned potentialContacts;
+	unsigned contactsGenerated;
+	unsigned islandCount;
+	unsigned velocityIterationsUsed;
+	unsigned positionIterationsUsed;
+
+	// Bodies with continuous collision detection that moved far enough
+	// to be swept, and those of them stopped short by a shape
+	unsigned bodiesSwept;
+	unsigned bodiesStopped;
+
+	// The hash of every body's state at the end of the step, in
+	// deterministic mode only, see World::HashState
+	unsigned long long stateHash;
+
+	// The room in the contact arena, how many times generators were run
+	// again after it grew, how many ran out of room at its' limit and
+	// the contacts they could not fit
+	unsigned contactCapacity;
+	unsigned contactsRegenerated;
+	unsigned contactOverflows;
+	unsigned contactsDropped;
+};
+
+/**
+ * Counts what one contact generator has given the world since it was
+ * added, see World::GetContactGeneratorStats.
+ */
+struct ContactGeneratorStats
+{
+	// Contacts generated in every step, and in the last one
+	unsigned long long generated;
+	unsigned lastGenerated;
+
+	// Times the generator filled the room it was given and was run
+	// again once the arena had grown
+	unsigned regenerated;
+
+	// Steps in which it filled the room it was given with the arena at
+	// its' limit, and the contacts that did not fit and were dropped
+	unsigned overflows;
+	unsigned long long dropped;
+};
+
+// The algorithms the world can resolve contacts with
+enum class ContactSolverType
+{
+	// Cyclone's iterative resolver, worst contact first
+	Resolver,
+
+	// Projected Gauss-Seidel over every contact, warm started
+	SequentialImpulse
+};
+
+// The ways the world can find pairs of bodies that may touch
+enum class BroadphaseType
+{
+	// No pairs are found, contact generators test what they like
+	None,
+
+	// A dynamic bounding box tree over the bodies given bounds
+	DynamicTree,
+
+	// Sweep and prune along x, for scenes that are mostly at rest
+	SweepAndPrune
+};
+
+class World;
+
+/**
+ * Puts what was given to the simulation for a frame, such as the
+ * forces a player's controls push bodies with, onto the world. It is
+ * called after the world's StartFrame and before RunPhysics, and again
+ * for the same frame whenever World::Resimulate runs it over.
+ */
+class FrameInput
+{
+public:
+	virtual void ApplyInput(World* world, unsigned frame) = 0;
+};
+
 class World
 {
 	bool calculateResolverIterations;
 
-	// Linked list of bodies
-	struct BodyRegistration
-	{
-		RigidBody* body;
-		BodyRegistration* next;
-	};
+	// Holds the state of every body in the world as parallel arrays
+	BodyStore bodies;
 
-	// Head of list of bodies
-	BodyRegistration* firstBody;
+	// Holds the bodies made by CreateBody
+	BodyPool bodyPool;
 
 	ContactResolver resolver;
 
+	ContactSolverType solverType;
+
+	// Holds the settings of the impulse solver, workers take copies
+	ImpulseSolver impulseSolver;
+
+	// Impulses from the last frame that the impulse solver starts from
+	ImpulseCache impulseCache;
+
 	struct ContactGenRegistration
 	{
 		ContactGenerator* generator;
 		ContactGenRegistration* next;
+		ContactGeneratorStats stats;
+
+		// The parts the generator split its' work into this step, and
+		// where they start in the parts run on the workers
+		unsigned partCount;
+		unsigned firstPart;
 	};
 
 	ContactGenRegistration* firstContactGenerator;
 
-	Contact* contacts;
+	// The contacts generated this step, in the order generated
+	ContactArena contacts;
 
-	unsigned maxContacts;
+	// Where a generator that ran out of room at the limit is run again,
+	// without a limit, to count the contacts that were dropped
+	ContactArena overflowContacts;
+
+	// Contacts sorted island by island, these are the ones resolved.
+	// Kept as large as the arena
+	std::vector<Contact> islandContacts;
+
+	ContactIslands islands;
+
+	BroadphaseType broadphaseType;
+
+	// A body the broadphase tracks, with its' bounds around its' origin
+	struct BroadphaseBody
+	{
+		RigidBody* body;
+		Vector3 halfSize;
+
+		// The body's proxy in the broadphase in use, if it has one
+		unsigned proxy;
+	};
+
+	std::vector<BroadphaseBody> broadphaseBodies;
+
+	// By the handle slot of each body, where its' entry is in
+	// broadphaseBodies, if it has one
+	std::vector<unsigned> broadphaseEntries;
+	DynamicAABBTree broadphaseTree;
+	SweepAndPrune broadphaseSweep;
+
+	// Pairs of bodies whose bounds overlapped at the last step
+	std::vector<PotentialContact> potentialContacts;
+
+	// The shapes scene queries are run against
+	SceneQuery sceneQuery;
+
+	// The awake bodies with continuous collision detection, by store
+	// index, and where each started the step
+	std::vector<unsigned> continuousBodies;
+	std::vector<Vector3> continuousStarts;
+
+	// The bodies that moved far enough to be swept, and their sweeps
+	std::vector<unsigned> sweptBodies;
+	std::vector<SphereSweepQuery> continuousSweeps;
+	std::vector<QueryHit> continuousHits;
+
+	WorkerPool workers;
+
+	// Resolves islands on the worker pool, each worker has its' own
+	// copy of the solvers so that islands do not share state
+	class ResolveIslandsTask : public WorkerTask
+	{
+	public:
+		World* world;
+		double duration;
+
+		std::vector<ContactResolver> resolvers;
+		std::vector<ImpulseSolver> impulseSolvers;
+		std::vector<unsigned> velocityIterationsUsed;
+		std::vector<unsigned> positionIterationsUsed;
+
+		virtual void Execute(unsigned item, unsigned worker);
+	};
+
+	ResolveIslandsTask resolveIslands;
+
+	// Runs the parts of the contact generators that split their work on
+	// the worker pool, each part into its' own arena
+	class GeneratePartsTask : public WorkerTask
+	{
+	public:
+		struct Part
+		{
+			ContactGenerator* generator;
+			unsigned part;
+		};
+
+		std::vector<Part> parts;
+
+		// By part, kept from step to step so that they stop growing
+		std::vector<ContactArena> partContacts;
+
+		virtual void Execute(unsigned item, unsigned worker);
+	};
+
+	GeneratePartsTask generateParts;
+
+	// Runs the given generator, which ran out of room at the limit, into
+	// overflowContacts until it fits, restarting it first if it has
+	// already run this step. Returns the number it generated
+	unsigned RegenerateUnlimited(ContactGenerator* generator, bool ran);
+
+	WorldStats stats;
 
 public:
+	/**
+	 * Creates a world with room for the given number of contacts to
+	 * start with. The room grows when the contacts of a step do not
+	 * fit, see SetContactLimit.
+	 */
 	World(unsigned maxContacts, unsigned iterations = 0);
 	~World();
 
+	// Moves the given body into the world and returns its' handle.
+	// The body stays a view onto its' state, destroying it removes
+	// it from the world. Bodies still in the world when it is
+	// destroyed are moved back to the default store.
+	BodyHandle AddBody(RigidBody* body);
+
+	// Moves the given body out of the world into the default store,
+	// and stops the broadphase tracking it
+	void RemoveBody(RigidBody* body);
+
+	/**
+	 * Creates an immovable body at the origin in the world and returns
+	 * its' handle. The world owns the body, which lives in a pool so
+	 * that creating and destroying bodies does not go to the system
+	 * allocator once the pool has grown to fit.
+	 */
+	BodyHandle CreateBody();
+
+	/**
+	 * Destroys a body made by CreateBody and stops the broadphase
+	 * tracking it. Returns false, doing nothing, if the handle is of
+	 * a body no longer in the world or of one added with AddBody.
+	 * Contact generators and joints must let go of the body first.
+	 */
+	bool DestroyBody(BodyHandle handle);
+
+	// Makes room for the given number of bodies in the world and its'
+	// pool, so that creating that many does not allocate
+	void ReserveBodies(unsigned capacity);
+
+	// Returns true if the handle is of a body still in the world
+	bool IsValid(BodyHandle handle) const
+	{
+		return bodies.IsValid(handle);
+	}
+
+	// Returns the body with the given handle, NULL if it has left the world
+	RigidBody* GetBody(BodyHandle handle) const
+	{
+		if (!bodies.IsValid(handle)) return NULL;
+		return bodies.GetView(bodies.GetIndex(handle));
+	}
+
+	// Returns the number of bodies in the world
+	unsigned GetBodyCount() const
+	{
+		return bodies.Size();
+	}
+
+	// Gives direct access to the body state arrays
+	BodyStore& GetBodyStore()
+	{
+		return bodies;
+	}
+
+	// Selects the instruction set bodies are integrated with
+	void SetIntegratorPath(IntegratorPath path)
+	{
+		bodies.SetIntegratorPath(path);
+	}
+
+	/**
+	 * Makes the simulation replay bit for bit on any x86 processor and
+	 * any number of threads: integration gives the same results on
+	 * every path, damping is worked out without the C library, and
+	 * broadphase pairs are sorted by handle so that their order does
+	 * not depend on the broadphase's history.
+	 * Replays must add bodies, generators and query shapes in the same
+	 * order, as that order is the order they are processed in. Each
+	 * step then records HashState in its' stats, so two runs can be
+	 * compared step by step and a divergence found where it started.
+	 */
+	void SetDeterministic(bool deterministic)
+	{
+		bodies.SetDeterministic(deterministic);
+	}
+
+	bool IsDeterministic() const
+	{
+		return bodies.IsDeterministic();
+	}
+
+	// Returns a 64 bit hash of the state of every body in the world
+	unsigned long long HashState() const
+	{
+		return bodies.HashState();
+	}
+
+	/**
+	 * Sets the number of threads islands are resolved on, zero uses
+	 * one per hardware thread. The results do not depend on the
+	 * number of threads.
+	 */
+	void SetThreadCount(unsigned threadCount);
+
+	unsigned GetThreadCount() const
+	{
+		return workers.GetThreadCount();
+	}
+
+	/**
+	 * Selects the algorithm contacts are resolved with. Switching
+	 * forgets the impulses the impulse solver warm starts from.
+	 */
+	void SetContactSolver(ContactSolverType type);
+
+	ContactSolverType GetContactSolver() const
+	{
+		return solverType;
+	}
+
+	// Gives access to the settings of the impulse solver
+	ImpulseSolver& GetImpulseSolver()
+	{
+		return impulseSolver;
+	}
+
+	/**
+	 * Selects how pairs of bodies that may touch are found each step.
+	 * Only bodies given bounds with SetBroadphaseBounds take part.
+	 */
+	void SetBroadphase(BroadphaseType type);
+
+	BroadphaseType GetBroadphase() const
+	{
+		return broadphaseType;
+	}
+
+	/**
+	 * Gives the body a box with the given half-sizes around its'
+	 * origin in the broadphase. The box is turned with the body, and
+	 * the bounds must be cleared before the body is destroyed. Bodies
+	 * that are not in the world are ignored.
+	 */
+	void SetBroadphaseBounds(RigidBody* body, const Vector3& halfSize);
+
+	// Stops the broadphase tracking the given body
+	void ClearBroadphaseBounds(RigidBody* body);
+
+	/**
+	 * Returns the pairs of bodies whose bounds overlapped at the last
+	 * step, for contact generators to test. Empty with no broadphase.
+	 */
+	const std::vector<PotentialContact>& GetPotentialContacts() const
+	{
+		return potentialContacts;
+	}
+
+	/**
+	 * Registers a shape for scene queries, returning its' handle.
+	 * Spheres and boxes are moved with their bodies at the end of
+	 * every step, and must be removed before their body is destroyed.
+	 */
+	unsigned AddQueryShape(CollisionSphere* sphere)
+	{
+		return sceneQuery.AddSphere(sphere);
+	}
+
+	unsigned AddQueryShape(CollisionBox* box)
+	{
+		return sceneQuery.AddBox(box);
+	}
+
+	unsigned AddQueryShape(const CollisionPlane* plane)
+	{
+		return sceneQuery.AddPlane(plane);
+	}
+
+	void RemoveQueryShape(unsigned shape)
+	{
+		sceneQuery.RemoveShape(shape);
+	}
+
+	// Brings the query shapes up to date with bodies moved outside of
+	// RunPhysics, such as while setting a scene up
+	void UpdateQueryShapes()
+	{
+		sceneQuery.Update();
+	}
+
+	/**
+	 * Runs a batch of scene queries, see SceneQuery. Large batches are
+	 * spread over the world's worker threads, with the same results as
+	 * on one thread.
+	 */
+	void CastRays(const RayQuery* rays, unsigned count, QueryHit* hits);
+	void SweepSpheres(const SphereSweepQuery* sweeps, unsigned count, QueryHit* hits);
+	unsigned OverlapSpheres(const SphereOverlapQuery* spheres, unsigned count, std::vector<QueryOverlap>& overlaps);
+	unsigned OverlapBoxes(const BoxOverlapQuery* boxes, unsigned count, std::vector<QueryOverlap>& overlaps);
+
+	SceneQuery& GetSceneQuery()
+	{
+		return sceneQuery;
+	}
+
+	/**
+	 * Returns the slot size a snapshot ring needs to hold snapshots of
+	 * the world with its' current bodies and as many cached impulses as
+	 * it has room for contacts, up to the contact limit if one is set.
+	 * Without a limit the room may grow, after which snapshots may no
+	 * longer fit.
+	 */
+	size_t GetSnapshotSize() const;
+
+	/**
+	 * Saves the state of the world at the start of the given frame into
+	 * the ring: the position, orientation, velocity, rotation, last
+	 * acceleration, force and torque, sleep state and motion of every
+	 * body, and the impulses the solver warm starts from. The impulses
+	 * are kept by body handle, so a body made after a destroyed one in
+	 * its' place never takes its' impulses. Settings such as masses and
+	 * damping are not saved, nor are the caches of contact generators.
+	 * Returns false if the snapshot does not fit in a slot.
+	 */
+	bool SaveSnapshot(SnapshotRing& ring, unsigned frame) const;
+
+	/**
+	 * Puts the world back to the start of the given frame. Returns
+	 * false, changing nothing, if the ring no longer holds the frame or
+	 * bodies have been added or removed since it was saved.
+	 */
+	bool RestoreSnapshot(const SnapshotRing& ring, unsigned frame);
+
+	/**
+	 * Rolls the world back to the start of fromFrame and runs it again
+	 * up to the start of toFrame, applying the input of each frame and
+	 * saving the snapshots of the frames it reaches over the old ones.
+	 * In deterministic mode, given the same inputs, the world ends up
+	 * exactly where it was. Returns false if fromFrame cannot be
+	 * restored.
+	 */
+	bool Resimulate(SnapshotRing& ring, unsigned fromFrame, unsigned toFrame, double duration, FrameInput* input);
+
+	// Registers the given contact generator with the world, generators
+	// are called in the order they were added.
+	void AddContactGenerator(ContactGenerator* generator);
+
+	// Returns the counters of the given generator, NULL if it was not added
+	const ContactGeneratorStats* GetContactGeneratorStats(const ContactGenerator* generator) const;
+
+	/**
+	 * Sets the most contacts a step can generate, zero for no limit,
+	 * which is the default. Without a limit no contacts are dropped, the
+	 * room for them grows until they fit.
+	 */
+	void SetContactLimit(unsigned limit)
+	{
+		contacts.SetLimit(limit);
+	}
+
+	// Returns the number of contacts a step can generate without growing
+	unsigned GetContactCapacity() const
+	{
+		return contacts.GetCapacity();
+	}
+
+	// Gives the room for contacts past the given number back, such as
+	// after a busy stretch. Steps grow it again if they need to
+	void ShrinkContacts(unsigned capacity);
+
+	// Returns the counters and timings of the last call to RunPhysics
+	const WorldStats& GetStats() const
+	{
+		return stats;
+	}
+
 	// Calls each of the registered contact generators to report 
 	// their contacts. Returns total number of generated contacts.
+	// A generator that fills the room it is given is run again once
+	// the room has grown, after its' RestartContacts is called.
+	// The parts of generators that split their work are run on the
+	// workers first, then their contacts are put in the generators'
+	// places in the order. Contacts past the limit are counted in the
+	// stats and dropped.
 
 	unsigned GenerateContacts();
 
 	void RunPhysics(double duration);
 
+	// Brings the broadphase up to date with the bodies and finds the
+	// pairs that may touch, called by RunPhysics
+	void UpdateBroadphase(double duration);
+
+	// Takes the given body out of whichever broadphase holds it
+	void DestroyBroadphaseProxy(BroadphaseBody& entry);
+
+	// Returns where the given body is in broadphaseBodies, or past
+	// its' end if the broadphase does not track it
+	unsigned FindBroadphaseEntry(const RigidBody* body) const;
+
+	// Notes where each awake body with continuous collision detection
+	// starts the step, called by RunPhysics before integrating
+	void StartContinuousBodies();
+
+	/**
+	 * Sweeps each body noted by StartContinuousBodies that has moved
+	 * further than its' radius along the straight path it moved along,
+	 * through the query shapes as they were at the start of the step,
+	 * and moves it back to where the sweep first met one. The body's
+	 * contacts then find it touching the shape. Called by RunPhysics
+	 * after integrating.
+	 */
+	void SweepContinuousBodies();
+
 	// Initializes the world for a simulation frame.
 	// Clears the force and torque accumulators for bodies in the world
 	// After calling this, the bodies can have their forces and torques